@@ -1,23 +1,48 @@
 #pragma once
 #include "common.h"
+#include "locks.h"
+#include "numa_placement.h"
+#include "packed_chain.h"
+#include "combining.h"
 #include <vector>
 #include <list>
 #include <atomic>
-#include <omp.h>
+#include <memory>
 
 // Adaptive Granularity Hashing (AGH-lite): Segment-Exact + striped locks per segment.
-// Goal: increase intra-segment concurrency with a small, static number of stripes K.
+// Goal: increase intra-segment concurrency with a small number of stripes K per
+// segment, sized to the contention each segment actually sees.
 //
 // Compile-time overrides:
 //   -DAGH_DEFAULT_SEGMENTS=128 (used only if bench doesn't set SB_DEFAULT_SEGMENTS)
-//   -DAGH_MAX_STRIPES=32
-//   -DAGH_STRIPE_FACTOR=2   // K ~ next_pow2(threads / STRIPE_FACTOR)
+//   -DAGH_MAX_STRIPES=32    // locks per segment, upper bound for K (power of two)
+//   -DAGH_STRIPE_FACTOR=2   // initial K ~ next_pow2(threads / STRIPE_FACTOR)
+//   -DAGH_ADAPTIVE=0, -DAGH_ADAPT_SAMPLE, -DAGH_ADAPT_WINDOW,
+//   -DAGH_SPLIT_CONTENTION, -DAGH_MERGE_QUIET   // see "Adaptive stripes"
 //
 // Notes:
-// - Exact bucket distribution across segments (no over-allocation).
-// - Stripe count K is decided at construction time (based on expected threads).
+// - Segment = top hash bits, bucket = low hash bits; buckets per segment are a
+//   power of two, so the requested count is rounded up per segment.
+// - The initial stripe count K comes from the expected thread count; after that
+//   each segment adapts its own K (see "Adaptive stripes" below).
 // - Each bucket maps to exactly one stripe (bucket_index & (K-1)), so locking is correct.
-// - No mid-run changes to stripe mapping (keeps it simple and safe).
+//   K <= buckets_per_segment, so the stripe is just the low hash bits and growth
+//   never moves a key to another stripe.
+// - A segment doubles its buckets once count > buckets_per_segment * AGH_MAX_LOAD_FACTOR.
+//   The grower holds all of that segment's stripes, so buckets_per_segment is
+//   stable for anyone holding one of them.
+//
+// Adaptive stripes:
+// - Every segment owns AGH_MAX_STRIPES locks; the first K are in use. Lockers
+//   try the lock first and count a failure as contention.
+// - Acquisitions are sampled (1 in AGH_ADAPT_SAMPLE per thread). Once a segment
+//   has seen about AGH_ADAPT_WINDOW of them, the thread that closes the window
+//   re-decides K while holding no lock: double it if more than
+//   AGH_SPLIT_CONTENTION of the acquisitions had to wait, halve it after
+//   AGH_MERGE_QUIET windows without any waiting.
+// - Changing K takes every lock of the segment, like growth; a locker re-checks
+//   K after acquiring and retries if it changed. Keys never move.
+// - -DAGH_ADAPTIVE=0 keeps the initial K for the table's lifetime.
 
 #ifndef AGH_DEFAULT_SEGMENTS
 #  ifdef SB_DEFAULT_SEGMENTS
@@ -35,31 +60,77 @@
 #define AGH_STRIPE_FACTOR 3
 #endif
 
-template<typename K, typename V>
+#ifndef AGH_ADAPTIVE
+#define AGH_ADAPTIVE 1
+#endif
+
+#ifndef AGH_ADAPT_SAMPLE
+#define AGH_ADAPT_SAMPLE 64        // power of two
+#endif
+
+#ifndef AGH_ADAPT_WINDOW
+#define AGH_ADAPT_WINDOW 4096      // sampled acquisitions per decision
+#endif
+
+#ifndef AGH_SPLIT_CONTENTION
+#define AGH_SPLIT_CONTENTION 0.01  // waiting fraction that doubles K
+#endif
+
+#ifndef AGH_MERGE_QUIET
+#define AGH_MERGE_QUIET 4          // uncontended windows that halve K
+#endif
+
+#ifndef AGH_MAX_LOAD_FACTOR
+#  ifdef SB_MAX_LOAD_FACTOR
+#    define AGH_MAX_LOAD_FACTOR SB_MAX_LOAD_FACTOR
+#  else
+#    define AGH_MAX_LOAD_FACTOR 1.0   // 0 disables growth
+#  endif
+#endif
+
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>>
 class AGHHashTable {
 private:
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
     static const size_t NUM_SEGMENTS = AGH_DEFAULT_SEGMENTS;
+    static_assert(NUM_SEGMENTS <= 65536, "batch grouping packs (segment, stripe) into 32 bits");
+    static_assert((NUM_SEGMENTS & (NUM_SEGMENTS - 1)) == 0, "AGH_DEFAULT_SEGMENTS must be a power of two");
+    static_assert((AGH_MAX_STRIPES & (AGH_MAX_STRIPES - 1)) == 0, "AGH_MAX_STRIPES must be a power of two");
+    static_assert((AGH_ADAPT_SAMPLE & (AGH_ADAPT_SAMPLE - 1)) == 0, "AGH_ADAPT_SAMPLE must be a power of two");
+
+    static constexpr unsigned log2_segments() {
+        unsigned s = 0;
+        while ((size_t(1) << s) < NUM_SEGMENTS) ++s;
+        return s;
+    }
 
     struct PaddedLock {
-        alignas(64) omp_lock_t l;
-        PaddedLock()  { omp_init_lock(&l); }
-        ~PaddedLock() { omp_destroy_lock(&l); }
+        alignas(64) RWSpinLock l;   // shared for search, exclusive for writers
+        PaddedLock() = default;
         PaddedLock(const PaddedLock&) = delete;
         PaddedLock& operator=(const PaddedLock&) = delete;
     };
 
     struct alignas(64) Segment {
-        std::vector<std::list<KeyValue<K,V>>> buckets;
-        std::vector<PaddedLock*> stripes;
-        size_t buckets_per_segment;
-        size_t stripe_count;      // power of two
-        size_t stripe_mask;       // stripe_count - 1
+        std::vector<Chain> buckets;
+        std::vector<PaddedLock*> stripes;         // AGH_MAX_STRIPES locks, the first stripe_count in use
+        std::atomic<size_t> buckets_per_segment;  // read before locking, re-checked after
+        std::atomic<size_t> count;                // elements in this segment
+        std::atomic<size_t> stripe_count;         // power of two; changed only with every lock held
+        int node = 0;             // NUMA node the buckets and stripes were placed on
+
+        // Contention since the last stripe decision.
+        std::atomic<size_t> sampled{0};           // acquisitions, in steps of AGH_ADAPT_SAMPLE
+        std::atomic<size_t> contended{0};         // acquisitions that found the lock taken
+        std::atomic<unsigned> quiet_windows{0};
+        std::atomic<size_t> splits{0}, merges{0};
+        std::unique_ptr<CombiningSlots> combine;  // set while combining is on; one for all stripes
 
         Segment(size_t bps, size_t stripes_pow2)
-            : buckets_per_segment(bps), stripe_count(stripes_pow2), stripe_mask(stripes_pow2 ? (stripes_pow2 - 1) : 0) {
+            : buckets_per_segment(bps), count(0), stripe_count(stripes_pow2) {
             buckets.resize(buckets_per_segment);
-            stripes.reserve(stripe_count);
-            for (size_t i = 0; i < stripe_count; ++i) stripes.push_back(new PaddedLock());
+            stripes.reserve(AGH_MAX_STRIPES);
+            for (size_t i = 0; i < AGH_MAX_STRIPES; ++i) stripes.push_back(new PaddedLock());
         }
         ~Segment() {
             for (auto* p : stripes) delete p;
@@ -71,21 +142,151 @@ private:
     };
 
     std::vector<Segment*> segments;
-    std::atomic<size_t> element_count;
+    ElementCounter element_count;
     size_t requested_bucket_count;
 
-    inline size_t seg_index(size_t h) const { return h % NUM_SEGMENTS; }
-    inline size_t bucket_index(size_t h, size_t bps) const { return (h / NUM_SEGMENTS) % bps; }
+    static size_t seg_index(size_t h) {
+        return log2_segments() ? h >> (sizeof(size_t) * 8 - log2_segments()) : 0;
+    }
+    static size_t bucket_index(size_t h, size_t bps) { return h & (bps - 1); }
 
-    static size_t next_pow2(size_t x) {
-        if (x <= 1) return 1;
-        --x;
-        x |= x >> 1; x |= x >> 2; x |= x >> 4;
-        x |= x >> 8; x |= x >> 16;
-#if INTPTR_MAX == INT64_MAX
-        x |= x >> 32;
-#endif
-        return x + 1;
+    // Lock the stripe owning key hash h; returns the bucket index valid under that lock.
+    // Must be called with no stripe of this table held (it may re-stripe s).
+    size_t lock_bucket(Segment* s, size_t h, size_t& stripe, bool shared) const {
+        if (AGH_ADAPTIVE) sample_acquisition(s);
+        while (true) {
+            size_t k = s->stripe_count.load(std::memory_order_acquire);
+            stripe = h & (k - 1);
+            RWSpinLock& l = s->stripes[stripe]->l;
+            if (!(shared ? l.try_lock_shared() : l.try_lock())) {
+                s->contended.fetch_add(1, std::memory_order_relaxed);
+                if (shared) l.lock_shared(); else l.lock();
+            }
+            if (s->stripe_count.load(std::memory_order_relaxed) == k) {
+                return bucket_index(h, s->buckets_per_segment.load(std::memory_order_acquire));
+            }
+            if (shared) l.unlock_shared(); else l.unlock();   // re-striped while we waited
+        }
+    }
+
+    // Run op(bucket index) with the stripe owning h held (shared for lookups).
+    // With combining on, requests go through s's slots; a combiner serves the
+    // ones that map to the stripe it holds. Same calling rule as lock_bucket.
+    template<typename Op>
+    bool with_bucket(Segment* s, size_t h, bool shared, Op& op) const {
+        size_t stripe;
+        if (!s->combine) {
+            size_t bi = lock_bucket(s, h, stripe, shared);
+            bool r = op(bi);
+            if (shared) s->stripes[stripe]->l.unlock_shared(); else s->stripes[stripe]->l.unlock();
+            return r;
+        }
+        if (AGH_ADAPTIVE) sample_acquisition(s);
+        bool waited = false;
+        auto try_lock = [&] {
+            size_t k = s->stripe_count.load(std::memory_order_acquire);
+            stripe = h & (k - 1);
+            RWSpinLock& l = s->stripes[stripe]->l;
+            if (shared ? l.try_lock_shared() : l.try_lock()) {
+                if (s->stripe_count.load(std::memory_order_relaxed) == k) return true;
+                if (shared) l.unlock_shared(); else l.unlock();   // re-striped
+            }
+            if (!waited) {
+                waited = true;
+                s->contended.fetch_add(1, std::memory_order_relaxed);
+            }
+            return false;
+        };
+        auto unlock = [&] {
+            if (shared) s->stripes[stripe]->l.unlock_shared(); else s->stripes[stripe]->l.unlock();
+        };
+        auto run = [&] { return op(bucket_index(h, s->buckets_per_segment.load(std::memory_order_acquire))); };
+        return s->combine->run(h, run, try_lock, unlock,
+                               [&](uint64_t tag) { return stripe_of(s, size_t(tag)) == stripe; }, !shared);
+    }
+
+    // Same for a hash and for any bucket index derived from it; stable while
+    // any stripe of s is held.
+    static size_t stripe_of(const Segment* s, size_t h) {
+        return h & (s->stripe_count.load(std::memory_order_relaxed) - 1);
+    }
+
+    static void lock_all(Segment* s) {
+        for (size_t i = 0; i < AGH_MAX_STRIPES; ++i) s->stripes[i]->l.lock();
+    }
+    static void unlock_all(Segment* s) {
+        for (size_t i = AGH_MAX_STRIPES; i-- > 0; ) s->stripes[i]->l.unlock();
+    }
+
+    // Counts every AGH_ADAPT_SAMPLE-th acquisition of the calling thread; the
+    // thread whose sample closes a segment's window makes the stripe decision.
+    static void sample_acquisition(Segment* s) {
+        static thread_local unsigned tick = 0;
+        if ((++tick & (AGH_ADAPT_SAMPLE - 1)) != 0) return;
+        size_t seen = s->sampled.fetch_add(AGH_ADAPT_SAMPLE, std::memory_order_relaxed) + AGH_ADAPT_SAMPLE;
+        if (seen >= AGH_ADAPT_WINDOW && seen - AGH_ADAPT_SAMPLE < AGH_ADAPT_WINDOW) adapt_stripes(s, seen);
+    }
+
+    static void adapt_stripes(Segment* s, size_t acquisitions) {
+        size_t waited = s->contended.exchange(0, std::memory_order_relaxed);
+        size_t k = s->stripe_count.load(std::memory_order_relaxed);
+        size_t target = k;
+        if (waited > acquisitions * AGH_SPLIT_CONTENTION) {
+            s->quiet_windows.store(0, std::memory_order_relaxed);
+            if (k * 2 <= AGH_MAX_STRIPES && k * 2 <= s->buckets_per_segment.load(std::memory_order_relaxed)) target = k * 2;
+        } else if (waited == 0 && k > 1) {
+            if (s->quiet_windows.fetch_add(1, std::memory_order_relaxed) + 1 >= AGH_MERGE_QUIET) target = k / 2;
+        } else {
+            s->quiet_windows.store(0, std::memory_order_relaxed);
+        }
+        if (target != k) {
+            lock_all(s);
+            if (target <= s->buckets_per_segment.load(std::memory_order_relaxed)) {
+                s->stripe_count.store(target, std::memory_order_release);
+                (target > k ? s->splits : s->merges).fetch_add(1, std::memory_order_relaxed);
+            }
+            unlock_all(s);
+            s->quiet_windows.store(0, std::memory_order_relaxed);
+            s->contended.store(0, std::memory_order_relaxed);   // waits for the re-striping itself
+        }
+        s->sampled.store(0, std::memory_order_relaxed);
+    }
+
+    // Hash a batch and group it by (segment, stripe), prefetching each stripe lock.
+    void group_batch(const K* keys, size_t n, BatchScratch& sc, bool for_write) const {
+        for (size_t i = 0; i < n; ++i) {
+            size_t h = HashFn{}(keys[i]);
+            size_t si = seg_index(h);
+            Segment* s = segments[si];
+            size_t stripe = stripe_of(s, h);
+            sc.hashes[i] = h;
+            sc.add(i, (uint64_t(si) << 16) | stripe);
+            if (for_write) prefetch_write(s->stripes[stripe]);
+            else prefetch_read(s->stripes[stripe]);
+        }
+        sc.sort(n, NUM_SEGMENTS * segments[0]->stripe_count.load(std::memory_order_relaxed));
+    }
+
+    void maybe_grow(Segment* s, size_t count) {
+        size_t bps = s->buckets_per_segment.load(std::memory_order_relaxed);
+        if (AGH_MAX_LOAD_FACTOR <= 0 || count <= bps * AGH_MAX_LOAD_FACTOR) return;
+
+        lock_all(s);
+        if (s->buckets_per_segment.load(std::memory_order_relaxed) == bps) {  // nobody beat us to it
+            rehash(s, bps * 2);
+        }
+        unlock_all(s);
+    }
+
+    // Caller holds every stripe of s (or has the table to itself). List nodes are spliced.
+    static void rehash(Segment* s, size_t new_bps) {
+        NumaPreferredScope numa(s->node);
+        std::vector<Chain> grown(new_bps);
+        for (auto& bucket : s->buckets) {
+            chain_drain<HashFn>(bucket, [&](size_t h) -> Chain& { return grown[bucket_index(h, new_bps)]; });
+        }
+        s->buckets.swap(grown);
+        s->buckets_per_segment.store(new_bps, std::memory_order_release);
     }
 
     static size_t choose_stripes(size_t buckets_per_segment, size_t expected_threads) {
@@ -111,15 +312,18 @@ public:
             #endif
         }
 
-        size_t base = bucket_count / NUM_SEGMENTS;
-        size_t rem  = bucket_count % NUM_SEGMENTS;
+        size_t bps = next_pow2((bucket_count + NUM_SEGMENTS - 1) / NUM_SEGMENTS);
 
-        segments.reserve(NUM_SEGMENTS);
-        for (size_t i = 0; i < NUM_SEGMENTS; ++i) {
-            size_t bps = base + (i < rem ? 1 : 0);
-            size_t stripes = choose_stripes(bps, expected_threads);
-            segments.push_back(new Segment(bps, stripes));
-        }
+        // Each segment is built on its home node when CHT_NUMA is set.
+        size_t stripes = choose_stripes(bps, expected_threads);
+        int nodes = numa_node_count();
+        segments.assign(NUM_SEGMENTS, nullptr);
+        numa_build(NUM_SEGMENTS,
+                   [&](size_t i) { return numa_segment_home(i, NUM_SEGMENTS, nodes); },
+                   [&](size_t i, int node) {
+                       segments[i] = new Segment(bps, stripes);
+                       segments[i]->node = node;
+                   });
     }
 
     ~AGHHashTable() {
@@ -132,61 +336,290 @@ public:
     AGHHashTable& operator=(AGHHashTable&&) = delete;
 
     bool insert(const K& key, const V& value) {
-        size_t h = Hash<K>{}(key);
-        size_t si = seg_index(h);
-        Segment* s = segments[si];
-        size_t bi = bucket_index(h, s->buckets_per_segment);
-        size_t stripe = (s->stripe_count > 1) ? (bi & s->stripe_mask) : 0;
+        size_t h = HashFn{}(key);
+        Segment* s = segments[seg_index(h)];
+        size_t n = 0;
+        auto op = [&](size_t bi) {
+            auto& bucket = s->buckets[bi];
+            if (auto* kv = chain_find(bucket, key)) { kv->value = value; return false; }
+            bucket.emplace_back(key, value);
+            n = s->count.fetch_add(1, std::memory_order_relaxed) + 1;
+            element_count.add(1);
+            return true;
+        };
+        bool inserted = with_bucket(s, h, false, op);
+        if (inserted) maybe_grow(s, n);
+        return inserted;
+    }
 
-        omp_set_lock(&s->stripes[stripe]->l);
-        auto& bucket = s->buckets[bi];
-        for (auto& kv : bucket) {
-            if (kv.key == key) { kv.value = value; omp_unset_lock(&s->stripes[stripe]->l); return false; }
-        }
-        bucket.emplace_back(key, value);
-        element_count.fetch_add(1, std::memory_order_relaxed);
-        omp_unset_lock(&s->stripes[stripe]->l);
-        return true;
+    // Read-modify-write operations (see common.h), one lock acquisition each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        size_t h = HashFn{}(key);
+        Segment* s = segments[seg_index(h)];
+        size_t n = 0;
+        auto op = [&](size_t bi) {
+            auto& bucket = s->buckets[bi];
+            if (auto* kv = chain_find(bucket, key)) {
+                fn(kv->value);
+                return false;
+            }
+            bucket.emplace_back(key, init);
+            n = s->count.fetch_add(1, std::memory_order_relaxed) + 1;
+            element_count.add(1);
+            return true;
+        };
+        bool inserted = with_bucket(s, h, false, op);
+        if (inserted) maybe_grow(s, n);
+        return inserted;
     }
 
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        size_t h = HashFn{}(key);
+        Segment* s = segments[seg_index(h)];
+        auto op = [&](size_t bi) {
+            auto* kv = chain_find(s->buckets[bi], key);
+            if (kv) fn(kv->value);
+            return kv != nullptr;
+        };
+        return with_bucket(s, h, false, op);
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
-        size_t h = Hash<K>{}(key);
-        size_t si = seg_index(h);
-        Segment* s = segments[si];
-        size_t bi = bucket_index(h, s->buckets_per_segment);
-        size_t stripe = (s->stripe_count > 1) ? (bi & s->stripe_mask) : 0;
+        size_t h = HashFn{}(key);
+        Segment* s = segments[seg_index(h)];
+        auto op = [&](size_t bi) {
+            const auto* kv = chain_find(s->buckets[bi], key);
+            if (kv) value = kv->value;
+            return kv != nullptr;
+        };
+        return with_bucket(s, h, true, op);
+    }
+
+    bool remove(const K& key) {
+        size_t h = HashFn{}(key);
+        Segment* s = segments[seg_index(h)];
+        auto op = [&](size_t bi) {
+            auto& bucket = s->buckets[bi];
+            for (auto it = bucket.begin(); it != bucket.end(); ++it) {
+                if (it->key == key) {
+                    bucket.erase(it);
+                    s->count.fetch_sub(1, std::memory_order_relaxed);
+                    element_count.sub(1);
+                    return true;
+                }
+            }
+            return false;
+        };
+        return with_bucket(s, h, false, op);
+    }
+
+    // Batched operations: keys are grouped by (segment, stripe) so each stripe lock
+    // is taken once per batch. A segment re-striped after grouping splits a
+    // group into runs, each under the stripe its keys map to now.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        group_batch(keys, n, sc, true);
 
-        omp_set_lock(&s->stripes[stripe]->l);
-        const auto& bucket = s->buckets[bi];
-        for (const auto& kv : bucket) {
-            if (kv.key == key) { value = kv.value; omp_unset_lock(&s->stripes[stripe]->l); return true; }
+        size_t added = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t group = BatchScratch::group_of(sc.order[g]);
+            Segment* s = segments[group >> 16];
+            size_t stripe;
+            size_t new_in_group = 0;
+
+            lock_bucket(s, sc.hashes[BatchScratch::index_of(sc.order[g])], stripe, false);
+            size_t bps = s->buckets_per_segment.load(std::memory_order_relaxed);
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == group; ++g) {
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                if (stripe_of(s, sc.hashes[i]) != stripe) break;
+                auto& bucket = s->buckets[bucket_index(sc.hashes[i], bps)];
+                auto* kv = chain_find(bucket, keys[i]);
+                bool is_new = kv == nullptr;
+                if (kv) kv->value = values[i];
+                if (is_new) bucket.emplace_back(keys[i], values[i]);
+                if (inserted) inserted[i] = is_new;
+                new_in_group += is_new;
+            }
+            size_t count = s->count.fetch_add(new_in_group, std::memory_order_relaxed) + new_in_group;
+            s->stripes[stripe]->l.unlock();
+            if (new_in_group) maybe_grow(s, count);
+            added += new_in_group;
         }
-        omp_unset_lock(&s->stripes[stripe]->l);
-        return false;
+        element_count.add(added);
+        return added;
     }
 
-    bool remove(const K& key) {
-        size_t h = Hash<K>{}(key);
-        size_t si = seg_index(h);
-        Segment* s = segments[si];
-        size_t bi = bucket_index(h, s->buckets_per_segment);
-        size_t stripe = (s->stripe_count > 1) ? (bi & s->stripe_mask) : 0;
-
-        omp_set_lock(&s->stripes[stripe]->l);
-        auto& bucket = s->buckets[bi];
-        for (auto it = bucket.begin(); it != bucket.end(); ++it) {
-            if (it->key == key) {
-                bucket.erase(it);
-                element_count.fetch_sub(1, std::memory_order_relaxed);
-                omp_unset_lock(&s->stripes[stripe]->l);
-                return true;
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        group_batch(keys, n, sc, false);
+
+        size_t hits = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t group = BatchScratch::group_of(sc.order[g]);
+            Segment* s = segments[group >> 16];
+            size_t stripe;
+
+            lock_bucket(s, sc.hashes[BatchScratch::index_of(sc.order[g])], stripe, true);
+            size_t bps = s->buckets_per_segment.load(std::memory_order_relaxed);
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == group; ++g) {
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                if (stripe_of(s, sc.hashes[i]) != stripe) break;
+                const auto* kv = chain_find(s->buckets[bucket_index(sc.hashes[i], bps)], keys[i]);
+                found[i] = kv != nullptr;
+                if (kv) values[i] = kv->value;
+                hits += found[i];
+            }
+            s->stripes[stripe]->l.unlock_shared();
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h): one group per segment, grown once to its
+    // final size and then filled by one thread on the segment's NUMA node.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, NUM_SEGMENTS, [](size_t h) { return seg_index(h); }, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t si = 0; si < NUM_SEGMENTS; ++si) {
+            Segment* s = segments[si];
+            size_t count = s->count.load(std::memory_order_relaxed);
+            size_t bps = s->buckets_per_segment.load(std::memory_order_relaxed);
+            if (AGH_MAX_LOAD_FACTOR > 0) {
+                size_t want = bps;
+                while (count + part.group_size(si) > want * AGH_MAX_LOAD_FACTOR) want *= 2;
+                if (want != bps) rehash(s, bps = want);
             }
+            NumaPreferredScope numa(s->node);
+            size_t seg_added = 0;
+            for (const BulkEntry* e = part.begin(si); e != part.end(si); ++e) {
+                seg_added += bulk_append(s->buckets[bucket_index(e->hash, bps)], first[e->index], unique);
+            }
+            s->count.store(count + seg_added, std::memory_order_relaxed);
+            added += seg_added;
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // One group per segment (see common.h); read while no writer is active.
+    static constexpr size_t group_count() { return NUM_SEGMENTS; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        for (const auto& chain : segments[g]->buckets) {
+            for (const auto& kv : chain) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    size_t size() const { return element_count.load(); }
+
+    // Memory accounting (see common.h). All AGH_MAX_STRIPES locks of a
+    // segment count, in use or not; each is a cache line, mostly padding.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        for (const Segment* s : segments) {
+            m.buckets += s->buckets.capacity() * sizeof(Chain);
+            for (const auto& chain : s->buckets) m.nodes += chain_node_bytes(chain);
+            m.locks += AGH_MAX_STRIPES * sizeof(RWSpinLock);
+            m.padding += AGH_MAX_STRIPES * (sizeof(PaddedLock) - sizeof(RWSpinLock));
+            const size_t header = sizeof(s->buckets) + sizeof(s->stripes) + sizeof(s->buckets_per_segment) +
+                                  sizeof(s->count) + sizeof(s->stripe_count) + sizeof(s->node) +
+                                  sizeof(s->sampled) + sizeof(s->contended) + sizeof(s->quiet_windows) +
+                                  sizeof(s->splits) + sizeof(s->merges) + sizeof(s->combine);
+            m.padding += sizeof(Segment) - header;
+            m.other += header + s->stripes.capacity() * sizeof(PaddedLock*);
+            if (s->combine) m.locks += sizeof(CombiningSlots);
+        }
+        usage_add_object(m, sizeof(*this) + segments.capacity() * sizeof(Segment*));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    // Rehashes each segment, holding all its stripes, down to the fewest
+    // buckets that hold its count (never below the constructor's or the
+    // stripes in use), then drops chain slack; see common.h.
+    size_t shrink_to_fit() {
+        const size_t min_bps = next_pow2((requested_bucket_count + NUM_SEGMENTS - 1) / NUM_SEGMENTS);
+        size_t freed = 0;
+        for (Segment* s : segments) {
+            lock_all(s);
+            const size_t before = s->buckets.capacity() * sizeof(Chain);
+            const size_t count = s->count.load(std::memory_order_relaxed);
+            size_t bps = std::max(min_bps, s->stripe_count.load(std::memory_order_relaxed));
+            if (AGH_MAX_LOAD_FACTOR > 0) {
+                while (count > bps * AGH_MAX_LOAD_FACTOR) bps *= 2;
+            } else {
+                bps = s->buckets_per_segment.load(std::memory_order_relaxed);
+            }
+            if (bps < s->buckets_per_segment.load(std::memory_order_relaxed)) rehash(s, bps);
+            freed += before - s->buckets.capacity() * sizeof(Chain);
+            for (auto& chain : s->buckets) freed += chain_shrink(chain);
+            unlock_all(s);
+        }
+        return freed;
+    }
+
+    // Buckets per chain length (see instrumentation.h); read while no writer is active.
+    std::vector<size_t> chain_length_histogram() const {
+        std::vector<size_t> hist;
+        for (auto s : segments) {
+            for (const auto& chain : s->buckets) chain_hist_add(hist, chain.size());
         }
-        omp_unset_lock(&s->stripes[stripe]->l);
-        return false;
+        return hist;
+    }
+    size_t effective_bucket_count() const {
+        size_t total = 0;
+        for (auto s : segments) total += s->buckets_per_segment.load(std::memory_order_relaxed);
+        return total;
     }
+    // Adaptive stripes: stripes in use across all segments, and how often
+    // segments have doubled / halved theirs.
+    size_t stripe_total() const {
+        size_t total = 0;
+        for (auto s : segments) total += s->stripe_count.load(std::memory_order_relaxed);
+        return total;
+    }
+    size_t stripe_splits() const {
+        size_t n = 0;
+        for (auto s : segments) n += s->splits.load(std::memory_order_relaxed);
+        return n;
+    }
+    size_t stripe_merges() const {
+        size_t n = 0;
+        for (auto s : segments) n += s->merges.load(std::memory_order_relaxed);
+        return n;
+    }
+    size_t segment_stripes(size_t seg) const { return segments[seg]->stripe_count.load(std::memory_order_relaxed); }
+
+    // Flat combining (see combining.h) for the single-key operations; batched
+    // ones keep taking the stripes. Switch it while no other thread uses the table.
+    void set_combining(bool on) {
+        for (auto s : segments) s->combine.reset(on ? new CombiningSlots() : nullptr);
+    }
+    bool combining() const { return segments[0]->combine != nullptr; }
+
+    // NUMA placement (see numa_placement.h).
+    static constexpr size_t segment_count() { return NUM_SEGMENTS; }
+    size_t segment_of(const K& key) const { return seg_index(HashFn{}(key)); }
+    int segment_node(size_t seg) const { return segments[seg]->node; }
 
-    size_t size() const { return element_count.load(std::memory_order_relaxed); }
-    size_t effective_bucket_count() const { return requested_bucket_count; }
     std::string getName() const { return "AGH-Striped"; }
 };
\ No newline at end of file
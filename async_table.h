@@ -0,0 +1,359 @@
+#ifndef ASYNC_TABLE_H
+#define ASYNC_TABLE_H
+
+#include "common.h"
+#include "locks.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef CHT_COROUTINES
+#include <coroutine>
+#endif
+
+// Asynchronous front end for any table: AsyncTable<K, V, Table> async(table, workers).
+//
+// Callers submit operations and carry on; worker threads run them against the
+// table and complete each one through a callback (submit), a std::future
+// (search, insert, ...) or, with -DCHT_COROUTINES and -std=c++20, an
+// awaitable (co_search, co_insert, ...). Submission is a lock-free push into
+// one of CHT_ASYNC_RINGS bounded rings. A thread always pushes to the same
+// ring and each ring has one worker, so one thread's operations run in the
+// order it submitted them. The one exception is a completion that submits
+// again while its ring is full: that request runs at once, ahead of the
+// ones already queued (see submit).
+//
+// A worker pops up to CHT_ASYNC_BATCH requests per pass. Runs of consecutive
+// searches go through the table's search_batch and runs of inserts through
+// insert_batch where the table has them: keys are grouped by the lock that
+// guards them and buckets are prefetched ahead (common.h). Independent
+// lookups submitted back to back therefore overlap their cache misses
+// instead of taking them one after another. Other operations run one by one.
+//
+// Completions run on the worker thread, so callbacks and resumed coroutines
+// should hand long work elsewhere. The table stays usable directly. Idle
+// workers spin, then yield, then sleep in 50us naps.
+//
+// Compile-time overrides:
+//   -DCHT_ASYNC_RINGS=64         // submission rings (a power of two)
+//   -DCHT_ASYNC_RING_SIZE=1024   // requests per ring (a power of two)
+//   -DCHT_ASYNC_BATCH=32         // requests a worker runs per pass
+//   -DCHT_COROUTINES             // co_await API (C++20)
+
+#ifndef CHT_ASYNC_RINGS
+#define CHT_ASYNC_RINGS 64
+#endif
+#ifndef CHT_ASYNC_RING_SIZE
+#define CHT_ASYNC_RING_SIZE 1024
+#endif
+#ifndef CHT_ASYNC_BATCH
+#define CHT_ASYNC_BATCH 32
+#endif
+
+enum class AsyncOp : uint8_t { Search, Insert, InsertIfAbsent, Increment, Remove };
+
+// ok is the table call's return value; value is what search found.
+template<typename V>
+struct AsyncResult {
+    bool ok;
+    V value;
+};
+
+// One operation in flight; the submitter owns it until complete is called.
+// value carries the argument in (insert, increment) and the result out (search).
+template<typename K, typename V>
+struct AsyncRequest {
+    AsyncOp op = AsyncOp::Search;
+    K key{};
+    V value{};
+    bool result = false;
+    void (*complete)(AsyncRequest&) = nullptr;
+    void* ctx = nullptr;   // free for the submitter
+};
+
+// Bounded multi-producer ring with one consumer (Vyukov's sequence-per-cell
+// queue). push fails when the ring is full.
+template<typename T>
+class AsyncRing {
+    struct Cell {
+        std::atomic<size_t> seq;
+        T* item;
+    };
+    Cell cells[CHT_ASYNC_RING_SIZE];
+    alignas(64) std::atomic<size_t> head{0};   // next push
+    alignas(64) size_t tail = 0;               // next pop; consumer only
+
+    static constexpr size_t MASK = CHT_ASYNC_RING_SIZE - 1;
+    static_assert((CHT_ASYNC_RING_SIZE & MASK) == 0, "CHT_ASYNC_RING_SIZE must be a power of two");
+
+public:
+    AsyncRing() {
+        for (size_t i = 0; i < CHT_ASYNC_RING_SIZE; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(T* item) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& c = cells[pos & MASK];
+            size_t seq = c.seq.load(std::memory_order_acquire);
+            intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.item = item;
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    T* pop() {
+        Cell& c = cells[tail & MASK];
+        if (c.seq.load(std::memory_order_acquire) != tail + 1) return nullptr;
+        T* item = c.item;
+        c.seq.store(tail + CHT_ASYNC_RING_SIZE, std::memory_order_release);
+        ++tail;
+        return item;
+    }
+};
+
+template<typename K, typename V, typename Table>
+class AsyncTable {
+public:
+    using Request = AsyncRequest<K, V>;
+    using Result = AsyncResult<V>;
+
+private:
+    template<typename T, typename = void>
+    struct HasSearchBatch : std::false_type {};
+    template<typename T>
+    struct HasSearchBatch<T, std::void_t<decltype(std::declval<const T&>().search_batch(
+        (const K*)nullptr, (V*)nullptr, (bool*)nullptr, size_t(0)))>> : std::true_type {};
+    template<typename T, typename = void>
+    struct HasInsertBatch : std::false_type {};
+    template<typename T>
+    struct HasInsertBatch<T, std::void_t<decltype(std::declval<T&>().insert_batch(
+        (const K*)nullptr, (const V*)nullptr, size_t(0), (bool*)nullptr))>> : std::true_type {};
+
+    struct FutureRequest : Request {
+        std::promise<Result> promise;
+    };
+
+    // Per-worker scratch for the batch calls, reused across passes.
+    struct Scratch {
+        std::vector<K> keys;
+        std::vector<V> values;
+        std::unique_ptr<bool[]> flags{new bool[CHT_ASYNC_BATCH]};
+    };
+
+    Table& table;
+    std::unique_ptr<AsyncRing<Request>[]> rings{new AsyncRing<Request>[CHT_ASYNC_RINGS]};
+    size_t worker_count;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopping{false};
+    static inline thread_local const AsyncTable* serving = nullptr;   // set on this table's workers
+
+    static unsigned thread_ring() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned id = next.fetch_add(1, std::memory_order_relaxed);
+        return id % CHT_ASYNC_RINGS;
+    }
+
+    void run_one(Request& r) {
+        switch (r.op) {
+            case AsyncOp::Search:         r.result = table.search(r.key, r.value); break;
+            case AsyncOp::Insert:         r.result = table.insert(r.key, r.value); break;
+            case AsyncOp::InsertIfAbsent: r.result = table.insert_if_absent(r.key, r.value); break;
+            case AsyncOp::Increment:      r.result = table.increment(r.key, r.value); break;
+            case AsyncOp::Remove:         r.result = table.remove(r.key); break;
+        }
+    }
+
+    void run_searches(Request** reqs, size_t n, Scratch& sc) {
+        if constexpr (HasSearchBatch<Table>::value) {
+            sc.keys.clear();
+            for (size_t i = 0; i < n; ++i) sc.keys.push_back(reqs[i]->key);
+            sc.values.resize(n);
+            table.search_batch(sc.keys.data(), sc.values.data(), sc.flags.get(), n);
+            for (size_t i = 0; i < n; ++i) {
+                reqs[i]->result = sc.flags[i];
+                if (sc.flags[i]) reqs[i]->value = sc.values[i];
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) run_one(*reqs[i]);
+        }
+    }
+
+    void run_inserts(Request** reqs, size_t n, Scratch& sc) {
+        if constexpr (HasInsertBatch<Table>::value) {
+            sc.keys.clear();
+            sc.values.clear();
+            for (size_t i = 0; i < n; ++i) {
+                sc.keys.push_back(reqs[i]->key);
+                sc.values.push_back(reqs[i]->value);
+            }
+            table.insert_batch(sc.keys.data(), sc.values.data(), n, sc.flags.get());
+            for (size_t i = 0; i < n; ++i) reqs[i]->result = sc.flags[i];
+        } else {
+            for (size_t i = 0; i < n; ++i) run_one(*reqs[i]);
+        }
+    }
+
+    // Runs a pass in order, batching runs of searches and of inserts.
+    void execute(Request** reqs, size_t n, Scratch& sc) {
+        for (size_t i = 0; i < n;) {
+            AsyncOp op = reqs[i]->op;
+            size_t j = i + 1;
+            if (op == AsyncOp::Search || op == AsyncOp::Insert) {
+                while (j < n && reqs[j]->op == op) ++j;
+            }
+            if (op == AsyncOp::Search) run_searches(reqs + i, j - i, sc);
+            else if (op == AsyncOp::Insert) run_inserts(reqs + i, j - i, sc);
+            else run_one(*reqs[i]);
+            for (size_t k = i; k < j; ++k) reqs[k]->complete(*reqs[k]);
+            i = j;
+        }
+    }
+
+    // Worker w drains rings w, w + workers, ...; it exits once stopping is
+    // set and a full sweep finds its rings empty. Each pass first takes at
+    // most an even share from every ring, then fills what is left of the
+    // batch, starting one ring later than the pass before, so a producer that
+    // keeps its ring full cannot starve the others.
+    void work(size_t w) {
+        serving = this;
+        Scratch sc;
+        Request* batch[CHT_ASYNC_BATCH];
+        const size_t served = (CHT_ASYNC_RINGS - w + worker_count - 1) / worker_count;
+        const size_t share = std::max<size_t>(1, CHT_ASYNC_BATCH / served);
+        size_t start = 0;
+        unsigned idle = 0;
+        while (true) {
+            bool stop = stopping.load(std::memory_order_acquire);
+            size_t n = 0;
+            for (size_t limit : {share, size_t(CHT_ASYNC_BATCH)}) {
+                for (size_t i = 0; i < served && n < CHT_ASYNC_BATCH; ++i) {
+                    AsyncRing<Request>& ring = rings[w + (start + i) % served * worker_count];
+                    for (size_t taken = 0; taken < limit && n < CHT_ASYNC_BATCH; ++taken) {
+                        Request* req = ring.pop();
+                        if (!req) break;
+                        batch[n++] = req;
+                    }
+                }
+            }
+            start = (start + 1) % served;
+            if (n) {
+                execute(batch, n, sc);
+                idle = 0;
+            } else if (stop) {
+                return;
+            } else if (++idle < 64) {
+                cpu_relax();
+            } else if (idle < 4096) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    }
+
+    template<typename Req>
+    Req* make(AsyncOp op, const K& key, const V& value) {
+        Req* r = new Req;
+        r->op = op;
+        r->key = key;
+        r->value = value;
+        return r;
+    }
+
+    std::future<Result> submit_future(AsyncOp op, const K& key, const V& value) {
+        FutureRequest* r = make<FutureRequest>(op, key, value);
+        std::future<Result> f = r->promise.get_future();
+        r->complete = [](Request& q) {
+            FutureRequest& fr = static_cast<FutureRequest&>(q);
+            fr.promise.set_value(Result{fr.result, fr.value});
+            delete &fr;
+        };
+        submit(*r);
+        return f;
+    }
+
+public:
+    explicit AsyncTable(Table& t, unsigned num_workers = 1)
+        : table(t), worker_count(std::min<size_t>(std::max(num_workers, 1u), CHT_ASYNC_RINGS)) {
+        workers.reserve(worker_count);
+        for (size_t w = 0; w < worker_count; ++w) workers.emplace_back([this, w] { work(w); });
+    }
+
+    // Runs everything already submitted, then stops the workers.
+    ~AsyncTable() {
+        stopping.store(true, std::memory_order_release);
+        for (auto& t : workers) t.join();
+    }
+
+    AsyncTable(const AsyncTable&) = delete;
+    AsyncTable& operator=(const AsyncTable&) = delete;
+
+    // Queues req; req.complete(req) runs on a worker once it is done. req must
+    // stay alive until then. Spins while this thread's ring is full; a worker
+    // (a resumed coroutine submitting again) runs req itself instead, since it
+    // may be the thread that would drain the ring. Such a req overtakes the
+    // worker's requests still in the ring, so a completion that needs them
+    // done first should wait for their results before submitting.
+    void submit(Request& req) {
+        AsyncRing<Request>& ring = rings[thread_ring()];
+        SpinBackoff backoff;
+        while (!ring.push(&req)) {
+            if (serving == this) {
+                run_one(req);
+                req.complete(req);
+                return;
+            }
+            backoff.pause();
+        }
+    }
+
+    std::future<Result> search(const K& key) { return submit_future(AsyncOp::Search, key, V{}); }
+    std::future<Result> insert(const K& key, const V& value) { return submit_future(AsyncOp::Insert, key, value); }
+    std::future<Result> insert_if_absent(const K& key, const V& value) { return submit_future(AsyncOp::InsertIfAbsent, key, value); }
+    std::future<Result> increment(const K& key, const V& delta) { return submit_future(AsyncOp::Increment, key, delta); }
+    std::future<Result> remove(const K& key) { return submit_future(AsyncOp::Remove, key, V{}); }
+
+#ifdef CHT_COROUTINES
+    // co_await table.co_search(key) suspends the coroutine until a worker has
+    // run the operation and resumes it on that worker. The request lives in
+    // the coroutine frame, so nothing is allocated.
+    class Awaitable : Request {
+        AsyncTable* owner;
+        std::coroutine_handle<> handle;
+
+    public:
+        Awaitable(AsyncTable* t, AsyncOp op, const K& key, const V& value) : owner(t) {
+            this->op = op;
+            this->key = key;
+            this->value = value;
+            this->complete = [](Request& q) { static_cast<Awaitable&>(q).handle.resume(); };
+        }
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) {
+            handle = h;
+            owner->submit(*this);   // may resume h at once; touch nothing after
+        }
+        Result await_resume() const noexcept { return Result{this->result, this->value}; }
+    };
+
+    Awaitable co_search(const K& key) { return Awaitable(this, AsyncOp::Search, key, V{}); }
+    Awaitable co_insert(const K& key, const V& value) { return Awaitable(this, AsyncOp::Insert, key, value); }
+    Awaitable co_insert_if_absent(const K& key, const V& value) { return Awaitable(this, AsyncOp::InsertIfAbsent, key, value); }
+    Awaitable co_increment(const K& key, const V& delta) { return Awaitable(this, AsyncOp::Increment, key, delta); }
+    Awaitable co_remove(const K& key) { return Awaitable(this, AsyncOp::Remove, key, V{}); }
+#endif
+};
+
+#endif // ASYNC_TABLE_H
@@ -0,0 +1,521 @@
+#include <bits/stdc++.h>
+#include <omp.h>
+#include <sched.h>
+
+#include "common.h"
+#include "sequential.h"
+#include "coarse_grained.h"
+#include "coarse_grained_padded.h"
+#include "fine_grained.h"
+#include "fine_grained_padded.h"
+#include "segment_based.h"
+#include "segment_based_padded.h"
+#include "lock_free.h"
+#include "agh_hash_table.h"
+#include "flat_hash_table.h"
+#include "cuckoo_hash_table.h"
+#include "split_ordered_table.h"
+#include "snapshot_table.h"
+#include "workload.h"
+#include "word_count/word_count_common.h"
+#include "deduplication/deduplication_common.h"
+#include "cache_sim/cache_sim_common.h"
+
+// In-process application benchmarks: the word count, deduplication and cache
+// simulation kernels of the three apps, run against every table plus two
+// std::unordered_map baselines on the same pre-built input. Each point gets
+// warmup runs and repeated trials on pinned threads; the CSV carries the
+// bench_matrix_simple columns (so scripts/plot_matrix.py reads it) plus
+// trial count and 95% confidence intervals.
+
+// ---- Baselines ----
+
+// std::unordered_map split into lock-protected shards, the usual way to
+// share one across threads. Shards are reserved up front.
+template<typename K, typename V, size_t Shards = 64>
+class ShardedStdMap {
+    struct alignas(64) Shard {
+        std::mutex m;
+        std::unordered_map<K, V> map;
+    };
+    std::unique_ptr<Shard[]> shards{new Shard[Shards]};
+
+    Shard& shard_of(const K& key) const { return shards[Hash<K>{}(key) % Shards]; }
+
+public:
+    explicit ShardedStdMap(size_t bucket_count) {
+        for (size_t s = 0; s < Shards; ++s) shards[s].map.reserve(bucket_count / Shards + 1);
+    }
+
+    bool insert(const K& key, const V& value) {
+        Shard& s = shard_of(key);
+        std::lock_guard<std::mutex> g(s.m);
+        auto r = s.map.insert_or_assign(key, value);
+        return r.second;
+    }
+    bool insert_if_absent(const K& key, const V& value) {
+        Shard& s = shard_of(key);
+        std::lock_guard<std::mutex> g(s.m);
+        return s.map.emplace(key, value).second;
+    }
+    bool increment(const K& key, const V& delta) {
+        Shard& s = shard_of(key);
+        std::lock_guard<std::mutex> g(s.m);
+        auto r = s.map.try_emplace(key, 0);
+        r.first->second += delta;
+        return r.second;
+    }
+    bool search(const K& key, V& value) const {
+        Shard& s = shard_of(key);
+        std::lock_guard<std::mutex> g(s.m);
+        auto it = s.map.find(key);
+        if (it == s.map.end()) return false;
+        value = it->second;
+        return true;
+    }
+    size_t size() const {
+        size_t n = 0;
+        for (size_t s = 0; s < Shards; ++s) n += shards[s].map.size();
+        return n;
+    }
+};
+
+// Marks the thread-local-merge baseline: each thread counts its slice into a
+// private std::unordered_map, then thread t merges the keys with
+// hash % T == t from every private map. No shared writes until the merge,
+// and the merge is parallel too. It has no lookups, so it skips the cache.
+struct ThreadLocalMerge {};
+
+// ---- Trials ----
+
+struct TrialResult {
+    double seconds;
+    size_t check;   // distinct keys at the end; every implementation must agree
+};
+
+struct Inputs {
+    std::vector<std::string> words;
+    std::vector<int> values;
+    std::vector<CacheOperation> cache_ops;
+};
+
+template<typename K>
+TrialResult run_thread_local_merge(const std::vector<K>& keys, int T, size_t buckets) {
+    std::vector<std::unordered_map<K, int>> local(T), merged(T);
+    for (int t = 0; t < T; ++t) {
+        local[t].reserve(buckets);
+        merged[t].reserve(buckets / T + 1);
+    }
+    double t0 = omp_get_wtime();
+    #pragma omp parallel num_threads(T)
+    {
+        int t = omp_get_thread_num();
+        auto& mine = local[t];
+        #pragma omp for
+        for (size_t i = 0; i < keys.size(); ++i) ++mine[keys[i]];
+        for (const auto& l : local) {
+            for (const auto& kv : l) {
+                if (Hash<K>{}(kv.first) % size_t(T) == size_t(t)) merged[t][kv.first] += kv.second;
+            }
+        }
+    }
+    double secs = omp_get_wtime() - t0;
+    size_t distinct = 0;
+    for (const auto& m : merged) distinct += m.size();
+    return {secs, distinct};
+}
+
+template<typename HT>
+TrialResult run_wordcount(const Inputs& in, int T, size_t buckets) {
+    if constexpr (std::is_same<HT, ThreadLocalMerge>::value) {
+        return run_thread_local_merge(in.words, T, buckets);
+    } else {
+        HT table(buckets);
+        double t0 = omp_get_wtime();
+        countWords(in.words, table, T, 0);
+        return {omp_get_wtime() - t0, table.size()};
+    }
+}
+
+template<typename HT>
+TrialResult run_dedup(const Inputs& in, int T, size_t buckets) {
+    if constexpr (std::is_same<HT, ThreadLocalMerge>::value) {
+        return run_thread_local_merge(in.values, T, buckets);
+    } else {
+        HT table(buckets);
+        size_t unique = 0;
+        double t0 = omp_get_wtime();
+        #pragma omp parallel for num_threads(T) reduction(+:unique)
+        for (size_t i = 0; i < in.values.size(); ++i) unique += table.insert_if_absent(in.values[i], 1);
+        return {omp_get_wtime() - t0, unique};
+    }
+}
+
+template<typename HT>
+TrialResult run_cache(const Inputs& in, int T, size_t buckets) {
+    HT table(buckets);
+    size_t hits = 0, misses = 0;
+    double t0 = omp_get_wtime();
+    replayOperations(table, in.cache_ops, T, hits, misses, false);
+    return {omp_get_wtime() - t0, table.size()};
+}
+
+// ---- Thread pinning ----
+// Thread i of a team of T is bound to the (i mod n)-th CPU this process may
+// run on. Runs before every trial: libgomp reuses its pool threads in order,
+// so the binding holds through the timed region that follows. Skipped when
+// OMP_PROC_BIND already places the threads.
+static std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int c = 0; c < CPU_SETSIZE; ++c) if (CPU_ISSET(c, &set)) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+static void pin_team(int T, const std::vector<int>& cpus) {
+    if (cpus.empty()) return;
+    #pragma omp parallel num_threads(T)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[size_t(omp_get_thread_num()) % cpus.size()], &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+}
+
+// ---- Statistics ----
+
+struct Summary {
+    double mean = 0.0, ci95 = 0.0;   // ci95: half-width of the 95% interval
+};
+
+static double student_t95(size_t df) {
+    static const double t[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    return df == 0 ? 0.0 : df <= 30 ? t[df - 1] : 1.960;
+}
+
+static Summary summarize(const std::vector<double>& xs) {
+    Summary s;
+    if (xs.empty()) return s;
+    for (double x : xs) s.mean += x;
+    s.mean /= double(xs.size());
+    if (xs.size() < 2) return s;
+    double var = 0.0;
+    for (double x : xs) var += (x - s.mean) * (x - s.mean);
+    var /= double(xs.size() - 1);
+    s.ci95 = student_t95(xs.size() - 1) * std::sqrt(var / double(xs.size()));
+    return s;
+}
+
+// ---- Driver ----
+
+struct Config {
+    std::vector<int> threads = {1, 2, 4, 8};
+    int trials = 5;
+    int warmup = 1;
+    bool pin = true;
+    std::vector<int> cpus;
+    size_t buckets = 8192;
+};
+
+struct Scenario {
+    std::string mix, dist;   // mix: wordcount|dedup|cache
+    double read_ratio = 0.0, theta = 0.0;
+    size_t ops = 0;
+    Inputs in;
+};
+
+struct Row {
+    std::string impl, mix, dist;
+    int threads;
+    size_t ops, buckets, check;
+    double read_ratio, theta;
+    Summary time, thr;
+    int trials;
+    double speedup, seq_baseline_s;
+};
+
+// Word count keys are strings; dedup and cache keys are ints.
+template<typename K, typename HT>
+static TrialResult run_trial(const Scenario& sc, int T, size_t buckets) {
+    if constexpr (std::is_same<K, std::string>::value) {
+        return run_wordcount<HT>(sc.in, T, buckets);
+    } else if constexpr (std::is_same<HT, ThreadLocalMerge>::value) {
+        return run_dedup<HT>(sc.in, T, buckets);
+    } else {
+        return sc.mix == "dedup" ? run_dedup<HT>(sc.in, T, buckets) : run_cache<HT>(sc.in, T, buckets);
+    }
+}
+
+// Runs warmup + trials at T threads; check receives the distinct-key count.
+template<typename K, typename HT>
+static std::vector<double> time_trials(const Scenario& sc, int T, const Config& c, size_t& check) {
+    std::vector<double> secs;
+    for (int i = 0; i < c.warmup + c.trials; ++i) {
+        if (c.pin) pin_team(T, c.cpus);
+        TrialResult r = run_trial<K, HT>(sc, T, c.buckets);
+        check = r.check;
+        if (i >= c.warmup) secs.push_back(r.seconds);
+    }
+    return secs;
+}
+
+template<typename K, typename HT>
+static bool run_impl(const std::string& name, const Scenario& sc, const Config& c,
+                     double seq_s, size_t expect, std::vector<Row>& rows) {
+    if (std::is_same<HT, ThreadLocalMerge>::value && sc.mix == "cache") return true;
+    for (int T : c.threads) {
+        size_t check = 0;
+        std::vector<double> secs = time_trials<K, HT>(sc, T, c, check);
+        if (check != expect) {
+            fprintf(stderr, "Error: %s %s T=%d found %zu distinct keys, expected %zu\n",
+                    name.c_str(), sc.mix.c_str(), T, check, expect);
+            return false;
+        }
+        std::vector<double> thr;
+        for (double s : secs) thr.push_back(double(sc.ops) / s / 1e6);
+        Row r{name, sc.mix, sc.dist, T, sc.ops, c.buckets, check, sc.read_ratio, sc.theta,
+              summarize(secs), summarize(thr), c.trials, 0.0, seq_s};
+        r.speedup = seq_s / r.time.mean;
+        rows.push_back(r);
+        printf("%-14s %9s %7s  T=%2d ops=%9zu  time=%.4f +-%.4f  thr=%.2f +-%.2f Mops  speedup=%.2f\n",
+               name.c_str(), sc.mix.c_str(), sc.dist.c_str(), T, sc.ops,
+               r.time.mean, r.time.ci95, r.thr.mean, r.thr.ci95, r.speedup);
+        fflush(stdout);
+    }
+    return true;
+}
+
+// Calls fn(id, label, tag) for every implementation; tag is a
+// std::common_type<HT> whose ::type is the table for key type K.
+template<typename K, typename Fn>
+static void for_each_impl(Fn fn) {
+    fn("coarse", "Coarse", std::common_type<CoarseGrainedHashTable<K, int>>{});
+    fn("coarse-padded", "Coarse-Padded", std::common_type<CoarseGrainedHashTablePadded<K, int>>{});
+    fn("fine", "Fine", std::common_type<FineGrainedHashTable<K, int>>{});
+    fn("fine-padded", "Fine-Padded", std::common_type<FineGrainedHashTablePadded<K, int>>{});
+    fn("segment", "Segment", std::common_type<SegmentBasedHashTable<K, int>>{});
+    fn("segment-padded", "Segment-Padded", std::common_type<SegmentBasedHashTablePadded<K, int>>{});
+    fn("lockfree", "Lock-Free", std::common_type<LockFreeHashTable<K, int>>{});
+    fn("agh", "AGH", std::common_type<AGHHashTable<K, int>>{});
+    fn("flat", "Flat", std::common_type<StripedFlatHashTable<K, int>>{});
+    fn("cuckoo", "Cuckoo", std::common_type<CuckooHashTable<K, int>>{});
+    fn("splitorder", "Split-Ordered", std::common_type<SplitOrderedHashTable<K, int>>{});
+    fn("snapshot", "Snapshot", std::common_type<SnapshotHashTable<K, int>>{});
+    fn("std-sharded", "Std-Sharded", std::common_type<ShardedStdMap<K, int>>{});
+    fn("std-tlmerge", "Std-TL-Merge", std::common_type<ThreadLocalMerge>{});
+}
+
+template<typename K>
+static bool run_scenario(const Scenario& sc, const std::set<std::string>& impls, const Config& c,
+                         std::vector<Row>& rows) {
+    // SequentialHashTable on one thread is the speedup baseline and the
+    // reference distinct-key count.
+    Config seq = c;
+    seq.threads = {1};
+    size_t expect = 0;
+    double seq_s = summarize(time_trials<K, SequentialHashTable<K, int>>(sc, 1, seq, expect)).mean;
+    printf("%-14s %9s %7s  T= 1 ops=%9zu  time=%.4f  distinct=%zu\n",
+           "Sequential", sc.mix.c_str(), sc.dist.c_str(), sc.ops, seq_s, expect);
+
+    bool ok = true;
+    for_each_impl<K>([&](const char* id, const char* label, auto tag) {
+        using HT = typename decltype(tag)::type;
+        if (ok && (impls.empty() || impls.count(id))) ok = run_impl<K, HT>(label, sc, c, seq_s, expect, rows);
+    });
+    return ok;
+}
+
+static bool known_impl(const std::string& id) {
+    bool found = false;
+    for_each_impl<int>([&](const char* name, const char*, auto) { found |= id == name; });
+    return found;
+}
+
+// ---- Inputs ----
+// Generated once from fixed seeds, so every implementation and every run
+// sees the same data. theta 0 draws keys uniformly, as the apps' generators do.
+
+static std::string vocab_word(size_t i) {
+    std::string word = "word";   // same spelling as word_count/generate_test_data
+    for (size_t num = i; num > 0; num /= 26) word += char('a' + (num % 26));
+    return word;
+}
+
+static std::vector<std::string> generate_words(size_t n, size_t vocab, double theta) {
+    std::vector<std::string> dict(vocab);
+    for (size_t i = 0; i < vocab; ++i) dict[i] = vocab_word(i);
+    std::mt19937_64 rng(1);
+    ZipfGen zipf(vocab, theta);
+    std::vector<std::string> words(n);
+    for (auto& w : words) w = dict[zipf.draw(rng) - 1];
+    return words;
+}
+
+static std::vector<int> generate_values(size_t n, size_t unique, double theta) {
+    std::mt19937_64 rng(2);
+    ZipfGen zipf(unique, theta);
+    std::vector<int> values(n);
+    for (auto& v : values) v = int(zipf.draw(rng) - 1);
+    return values;
+}
+
+static std::vector<CacheOperation> generate_cache_ops(size_t n, size_t keys, double read_ratio, double theta) {
+    std::vector<CacheOperation> ops = generateCacheOperations(n, keys, read_ratio, 3);
+    if (theta > 0.0) {
+        std::mt19937_64 rng(4);
+        ZipfGen zipf(keys, theta);
+        for (auto& op : ops) op.key = int(zipf.draw(rng) - 1);
+    }
+    return ops;
+}
+
+static void write_csv(std::ostream& os, const std::vector<Row>& rows) {
+    // bench_matrix_simple's columns first; mode is always strong (fixed input size).
+    os << "impl,mode,mix,dist,threads,ops,bucket_count,read_ratio,p_hot,time_s,throughput_mops,speedup,seq_baseline_s"
+       << ",trials,time_ci95_s,throughput_ci95_mops,distinct\n";
+    for (const Row& r : rows) {
+        os << r.impl << ",strong," << r.mix << "," << r.dist << ","
+           << r.threads << "," << r.ops << "," << r.buckets << ","
+           << std::fixed << std::setprecision(2) << r.read_ratio << ","
+           << std::fixed << std::setprecision(2) << r.theta << ","
+           << std::fixed << std::setprecision(6) << r.time.mean << ","
+           << std::fixed << std::setprecision(3) << r.thr.mean << ","
+           << std::fixed << std::setprecision(3) << r.speedup << ","
+           << std::fixed << std::setprecision(6) << r.seq_baseline_s << ","
+           << r.trials << ","
+           << std::fixed << std::setprecision(6) << r.time.ci95 << ","
+           << std::fixed << std::setprecision(3) << r.thr.ci95 << ","
+           << r.check << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    Config c;
+    std::vector<std::string> scenarios = {"wordcount", "dedup", "cache"};
+    std::set<std::string> impls;
+    std::vector<double> thetas = {0.0};
+    size_t n_words = 2'000'000, vocab = 20'000;
+    size_t n_values = 2'000'000, n_unique = 200'000;
+    size_t n_cache = 2'000'000, n_keys = 20'000;
+    double read_ratio = 0.8;
+    std::string words_file, dedup_file, out_path;
+
+    auto split = [](const std::string& list) {
+        std::vector<std::string> out;
+        std::stringstream ss(list);
+        for (std::string item; std::getline(ss, item, ',');) if (!item.empty()) out.push_back(item);
+        return out;
+    };
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg.rfind("--scenario=", 0)==0) scenarios = split(arg.substr(11));
+        else if (arg.rfind("--impl=", 0)==0) {
+            for (const std::string& i : split(arg.substr(7))) if (i != "all") impls.insert(i);
+        }
+        else if (arg.rfind("--threads=", 0)==0) {
+            c.threads.clear();
+            for (const std::string& t : split(arg.substr(10))) c.threads.push_back(std::atoi(t.c_str()));
+        }
+        else if (arg.rfind("--trials=", 0)==0) c.trials = std::atoi(arg.c_str() + 9);
+        else if (arg.rfind("--warmup=", 0)==0) c.warmup = std::atoi(arg.c_str() + 9);
+        else if (arg == "--no-pin") c.pin = false;
+        else if (arg.rfind("--buckets=", 0)==0) c.buckets = std::stoul(arg.substr(10));
+        else if (arg.rfind("--theta=", 0)==0) {
+            thetas.clear();
+            for (const std::string& t : split(arg.substr(8))) thetas.push_back(std::atof(t.c_str()));
+        }
+        else if (arg.rfind("--words=", 0)==0) n_words = std::stoul(arg.substr(8));
+        else if (arg.rfind("--vocab=", 0)==0) vocab = std::stoul(arg.substr(8));
+        else if (arg.rfind("--words-file=", 0)==0) words_file = arg.substr(13);
+        else if (arg.rfind("--values=", 0)==0) n_values = std::stoul(arg.substr(9));
+        else if (arg.rfind("--unique=", 0)==0) n_unique = std::stoul(arg.substr(9));
+        else if (arg.rfind("--dedup-file=", 0)==0) dedup_file = arg.substr(13);
+        else if (arg.rfind("--cache-ops=", 0)==0) n_cache = std::stoul(arg.substr(12));
+        else if (arg.rfind("--keys=", 0)==0) n_keys = std::stoul(arg.substr(7));
+        else if (arg.rfind("--read-ratio=", 0)==0) read_ratio = std::atof(arg.c_str() + 13);
+        else if (arg.rfind("--out=", 0)==0) out_path = arg.substr(6);
+        else {
+            fprintf(stderr, "Usage: %s [--scenario=wordcount,dedup,cache] [--impl=all|coarse,...,std-sharded,std-tlmerge]\n"
+                            "       [--threads=1,2,4,8] [--trials=5] [--warmup=1] [--no-pin] [--buckets=8192] [--theta=0,...]\n"
+                            "       [--words=N] [--vocab=N] [--words-file=FILE] [--values=N] [--unique=N] [--dedup-file=FILE]\n"
+                            "       [--cache-ops=N] [--keys=N] [--read-ratio=R] [--out=FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    for (const std::string& i : impls) {
+        if (!known_impl(i)) {
+            fprintf(stderr, "Error: unknown --impl %s\n", i.c_str());
+            return 1;
+        }
+    }
+    for (const std::string& s : scenarios) {
+        if (s != "wordcount" && s != "dedup" && s != "cache") {
+            fprintf(stderr, "Error: --scenario must list wordcount|dedup|cache\n");
+            return 1;
+        }
+    }
+    if (c.trials < 1 || c.warmup < 0 || c.threads.empty() ||
+        std::any_of(c.threads.begin(), c.threads.end(), [](int t) { return t < 1; })) {
+        fprintf(stderr, "Error: need --trials >= 1, --warmup >= 0 and --threads >= 1\n");
+        return 1;
+    }
+    if (thetas.empty() || std::any_of(thetas.begin(), thetas.end(), [](double t) { return t < 0.0; })) {
+        fprintf(stderr, "Error: --theta must list values >= 0\n");
+        return 1;
+    }
+    if (c.pin && std::getenv("OMP_PROC_BIND")) c.pin = false;
+    if (c.pin) c.cpus = allowed_cpus();
+    printf("trials=%d warmup=%d pinning=%s\n", c.trials, c.warmup,
+           c.pin ? (std::to_string(c.cpus.size()) + " cpus").c_str() : "off");
+
+    std::vector<Row> rows;
+    for (const std::string& s : scenarios) {
+        // A file input replaces the generated one, so it runs once, not per theta.
+        bool from_file = (s == "wordcount" && !words_file.empty()) || (s == "dedup" && !dedup_file.empty());
+        for (double theta : from_file ? std::vector<double>{0.0} : thetas) {
+            Scenario sc;
+            sc.mix = s;
+            sc.theta = theta;
+            sc.dist = from_file ? "file" : theta > 0.0 ? "zipf" : "uniform";
+            bool ok;
+            if (s == "wordcount") {
+                sc.in.words = from_file ? readWordsFromFile(words_file) : generate_words(n_words, vocab, theta);
+                sc.ops = sc.in.words.size();
+            } else if (s == "dedup") {
+                sc.in.values = from_file ? readIntegersFromFile(dedup_file) : generate_values(n_values, n_unique, theta);
+                sc.ops = sc.in.values.size();
+            } else {
+                sc.in.cache_ops = generate_cache_ops(n_cache, n_keys, read_ratio, theta);
+                sc.ops = sc.in.cache_ops.size();
+                sc.read_ratio = read_ratio;
+            }
+            if (sc.ops == 0) {
+                fprintf(stderr, "Error: no input for %s\n", s.c_str());
+                return 1;
+            }
+            ok = (s == "wordcount") ? run_scenario<std::string>(sc, impls, c, rows)
+                                    : run_scenario<int>(sc, impls, c, rows);
+            if (!ok) return 1;
+        }
+    }
+
+    std::cout << "CSV_RESULTS_BEGIN\n";
+    write_csv(std::cout, rows);
+    std::cout << "CSV_RESULTS_END\n";
+    if (!out_path.empty()) {
+        std::ofstream out(out_path);
+        if (!out) {
+            fprintf(stderr, "Error: cannot write %s\n", out_path.c_str());
+            return 1;
+        }
+        write_csv(out, rows);
+        printf("Wrote %s\n", out_path.c_str());
+    }
+    return 0;
+}
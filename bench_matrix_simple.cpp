@@ -8,18 +8,113 @@
 #include "segment_based.h"
 #include "lock_free.h"
 #include "agh_hash_table.h"
+#include "flat_hash_table.h"
+#include "cuckoo_hash_table.h"
+#include "split_ordered_table.h"
+#include "snapshot_table.h"
+#include "instrumentation.h"
+#include "hotset.h"
+#include "workload.h"
+#include <unistd.h>
 
-// Simple hot-set generator: p_hot = probability of choosing from [0, hotN),
-// otherwise choose from [hotN, universe)
-struct HotsetGen {
-    int universe, hotN; double p_hot;
-    std::mt19937 gen;
-    std::uniform_int_distribution<int> hotD, coldD;
-    std::uniform_real_distribution<double> coin;
-    HotsetGen(int u, int h, double p, uint32_t seed)
-        : universe(u), hotN(std::max(1,h)), p_hot(p), gen(seed),
-          hotD(0, std::max(0,h-1)), coldD(std::min(h,u-1), std::max(0,u-1)), coin(0.0,1.0) {}
-    int draw() { return (coin(gen) < p_hot) ? hotD(gen) : coldD(gen); }
+// ---- Allocation accounting (--alloc-stats) ----
+// Every global operator new in this process is counted in a per-thread slot,
+// so the pool's own slab refills are included in the totals.
+namespace alloc_stats {
+    struct alignas(64) Slot { std::atomic<uint64_t> n{0}; };
+    static Slot slots[256];
+    static std::atomic<unsigned> next_slot{0};
+    inline Slot& local() {
+        static thread_local Slot& s = slots[next_slot.fetch_add(1, std::memory_order_relaxed) % 256];
+        return s;
+    }
+    inline uint64_t total() {
+        uint64_t t = 0;
+        for (auto& s : slots) t += s.n.load(std::memory_order_relaxed);
+        return t;
+    }
+    inline double rss_mb() {
+        long pages = 0, resident = 0;
+        FILE* f = std::fopen("/proc/self/statm", "r");
+        if (!f) return 0.0;
+        if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(f);
+        return double(resident) * double(sysconf(_SC_PAGESIZE)) / (1024.0 * 1024.0);
+    }
+}
+
+// noinline keeps GCC from pairing the inlined malloc/free with new/delete call sites.
+__attribute__((noinline)) void* operator new(size_t n) {
+    alloc_stats::local().n.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// ---- Instrumentation (--instrument, needs -DCHT_INSTRUMENT) ----
+// Latency is sampled (one call in CHT_LATENCY_SAMPLE, a whole batch call in
+// batch mode) and includes the two clock reads. Lock counters cover the
+// mixed phase only; chain columns stay empty for tables without
+// chain_length_histogram() (flat, cuckoo, snapshot).
+struct InstrumentStats {
+    double lat_p50_ns = 0.0, lat_p99_ns = 0.0, lat_p999_ns = 0.0;
+    double lock_acq_per_op = 0.0, lock_contended_pct = 0.0, lock_wait_ns_per_op = 0.0, lock_hot_pct = 0.0;
+    double chain_mean = -1.0, chain_p99 = 0.0, chain_max = 0.0;
+};
+
+template <class HT, class = void>
+struct HasChainHistogram : std::false_type {};
+template <class HT>
+struct HasChainHistogram<HT, std::void_t<decltype(std::declval<const HT&>().chain_length_histogram())>> : std::true_type {};
+
+// Per-thread latency samples; compiles to nothing without CHT_INSTRUMENT.
+struct LatencySampler {
+#ifdef CHT_INSTRUMENT
+    LatencyHistogram hist;
+    bool on;
+    unsigned tick = 0;
+    uint64_t start = 0;
+    explicit LatencySampler(bool enabled) : on(enabled) {}
+    bool begin() {
+        if (!on || (++tick & (CHT_LATENCY_SAMPLE - 1))) return false;
+        start = instrument_now_ns();
+        return true;
+    }
+    void end() { hist.record(instrument_now_ns() - start); }
+#else
+    explicit LatencySampler(bool) {}
+    bool begin() { return false; }
+    void end() {}
+#endif
+};
+
+// ---- Memory footprint (--mem-stats) ----
+// With --mem-stats, memory_usage() (common.h) is read once the timed loop is
+// done, then shrink_to_fit() runs and the total is read again, so churn rows
+// show how much slack the deletes left behind. mem_shrunk_mb stays empty for
+// tables without shrink_to_fit. Without the flag neither call is made.
+template <class HT, class = void>
+struct HasMemoryUsage : std::false_type {};
+template <class HT>
+struct HasMemoryUsage<HT, std::void_t<decltype(std::declval<const HT&>().memory_usage())>> : std::true_type {};
+template <class HT, class = void>
+struct HasShrinkToFit : std::false_type {};
+template <class HT>
+struct HasShrinkToFit<HT, std::void_t<decltype(std::declval<HT&>().shrink_to_fit())>> : std::true_type {};
+
+struct MemStats {
+    MemoryUsage usage;
+    double shrunk_mb = -1.0;      // total after shrink_to_fit
+};
+
+// Mixed-phase measurements besides time.
+struct RunStats {
+    double allocs_per_op = 0.0;
+    double rss_mb = 0.0;          // process RSS with the table still populated
+    double local_pct = -1.0;      // mixed-phase ops on a segment homed on the caller's node
+    InstrumentStats inst;
+    MemStats mem;
 };
 
 struct Row {
@@ -27,11 +122,102 @@ struct Row {
     int threads, ops, buckets;
     double read_ratio, p_hot;
     double time_s, thr_mops, speedup, seq_baseline_s;
+    double allocs_per_op, rss_mb;   // only reported with --alloc-stats
+    double local_pct;               // only reported with --numa-stats
+    InstrumentStats inst;           // only reported with --instrument
+    MemStats mem;                   // only reported with --mem-stats
 };
 
+// ---- NUMA locality (--numa-stats) ----
+// Tables that expose segment_of/segment_node (segment, agh) get every
+// mixed-phase key checked against the calling thread's node. The check runs
+// inside the timed loop, so use it for placement studies, not for throughput.
+template <class HT, class = void>
+struct HasSegmentNodes : std::false_type {};
+template <class HT>
+struct HasSegmentNodes<HT, std::void_t<decltype(std::declval<const HT&>().segment_node(0))>> : std::true_type {};
+
+struct NumaTally {
+    uint64_t local = 0, remote = 0;
+    template <class HT>
+    void add(const HT& ht, int key, int node) {
+        if constexpr (HasSegmentNodes<HT>::value) {
+            if (ht.segment_node(ht.segment_of(key)) == node) ++local; else ++remote;
+        }
+    }
+};
+
+// Counters shared by the timed loops: allocations, NUMA tally and latency
+// samples, folded into RunStats once the loop is done.
+struct MixedPhase {
+    bool numa_stats, instrument, mem_stats;
+    std::atomic<uint64_t> local_ops{0}, remote_ops{0};
+    uint64_t allocs0 = 0;
+#ifdef CHT_INSTRUMENT
+    LatencyHistogram latency;
+#endif
+    MixedPhase(bool numa, bool inst, bool mem) : numa_stats(numa), instrument(inst), mem_stats(mem) {
+#ifdef CHT_INSTRUMENT
+        if (instrument) lock_probe::reset();
+#endif
+        allocs0 = alloc_stats::total();
+    }
+
+    // Called by each thread at the end of the loop.
+    void merge(const NumaTally& tally, LatencySampler& lat) {
+        local_ops.fetch_add(tally.local, std::memory_order_relaxed);
+        remote_ops.fetch_add(tally.remote, std::memory_order_relaxed);
+#ifdef CHT_INSTRUMENT
+        #pragma omp critical(cht_latency_merge)
+        latency.merge(lat.hist);
+#else
+        (void)lat;
+#endif
+    }
+
+    template <class HT>
+    void finish(HT& ht, int ops, RunStats* stats) {
+        if (!stats) return;
+        stats->allocs_per_op = double(alloc_stats::total() - allocs0) / std::max(1, ops);
+        stats->rss_mb = alloc_stats::rss_mb();
+        uint64_t counted = local_ops.load() + remote_ops.load();
+        if (counted) stats->local_pct = 100.0 * double(local_ops.load()) / double(counted);
+#ifdef CHT_INSTRUMENT
+        if (instrument) {
+            InstrumentStats& in = stats->inst;
+            in.lat_p50_ns = double(latency.percentile(0.50));
+            in.lat_p99_ns = double(latency.percentile(0.99));
+            in.lat_p999_ns = double(latency.percentile(0.999));
+            LockStats ls = lock_probe::collect();
+            double n = std::max(1, ops);
+            in.lock_acq_per_op = double(ls.acquisitions) / n;
+            if (ls.acquisitions) in.lock_contended_pct = 100.0 * double(ls.contended) / double(ls.acquisitions);
+            in.lock_wait_ns_per_op = double(ls.wait_ns) / n;
+            in.lock_hot_pct = ls.hot_wait_pct;
+            if constexpr (HasChainHistogram<HT>::value) {
+                ChainStats cs = chain_stats(ht.chain_length_histogram());
+                in.chain_mean = cs.mean;
+                in.chain_p99 = double(cs.p99);
+                in.chain_max = double(cs.max);
+            }
+        }
+#endif
+        if (!mem_stats) return;
+        if constexpr (HasMemoryUsage<HT>::value) stats->mem.usage = ht.memory_usage();
+        if constexpr (HasShrinkToFit<HT>::value) {
+            ht.shrink_to_fit();
+            stats->mem.shrunk_mb = double(ht.memory_usage().total()) / (1 << 20);
+        }
+    }
+};
+
+// batch > 0 issues the mixed phase through search_batch/insert_batch in chunks
+// of `batch` operations per thread instead of one call per key.
 template <class HT>
 double run_workload(int threads, int total_ops, double read_ratio, bool skewed,
-                    int bucket_count, double p_hot, double hot_frac) {
+                    int bucket_count, double p_hot, double hot_frac, int batch = 0,
+                    RunStats* stats = nullptr, bool numa_stats = false, bool instrument = false,
+                    bool mem_stats = false) {
     HT ht(bucket_count);
     int initial = total_ops/2, mixed = total_ops - initial;
 
@@ -40,27 +226,98 @@ double run_workload(int threads, int total_ops, double read_ratio, bool skewed,
 
     HotsetGen hot(initial, std::max(1, int(initial*hot_frac)), p_hot, 12345);
 
+    MixedPhase phase(numa_stats, instrument, mem_stats);
     double t0 = omp_get_wtime();
     #pragma omp parallel num_threads(threads)
     {
         int tid = omp_get_thread_num();
         std::mt19937 rng(0xC0FFEE + tid);
         std::uniform_real_distribution<double> coin(0.0,1.0);
+        NumaTally tally;
+        int node = numa_stats ? numa_current_node() : 0;
+        LatencySampler lat(instrument);
+
+        if (batch <= 0) {
+            #pragma omp for
+            for (int i=0;i<mixed;++i) {
+                bool is_read = coin(rng) < read_ratio;
+                int key = skewed ? hot.draw() : (i % initial);
+                if (numa_stats) tally.add(ht, is_read ? key : initial + i, node);
+                bool timed = lat.begin();
+                if (is_read) { int v; ht.search(key, v); }
+                else { ht.insert(initial + i, i); }
+                if (timed) lat.end();
+            }
+        } else {
+            std::vector<int> rkeys(batch), rvals(batch), wkeys(batch), wvals(batch);
+            std::unique_ptr<bool[]> found(new bool[batch]);
+            #pragma omp for
+            for (int c=0;c<mixed;c+=batch) {
+                int nr = 0, nw = 0;
+                for (int i=c;i<std::min(mixed, c+batch);++i) {
+                    bool is_read = coin(rng) < read_ratio;
+                    int key = skewed ? hot.draw() : (i % initial);
+                    if (numa_stats) tally.add(ht, is_read ? key : initial + i, node);
+                    if (is_read) rkeys[nr++] = key;
+                    else { wkeys[nw] = initial + i; wvals[nw++] = i; }
+                }
+                bool timed = lat.begin();
+                if (nr) ht.search_batch(rkeys.data(), rvals.data(), found.get(), nr);
+                if (nw) ht.insert_batch(wkeys.data(), wvals.data(), nw);
+                if (timed) lat.end();
+            }
+        }
+        phase.merge(tally, lat);
+    }
+    double elapsed = omp_get_wtime() - t0;
+    phase.finish(ht, mixed, stats);
+    return elapsed;
+}
+
+// Replays pregenerated op streams (workload.h), one per thread, after
+// loading keys [0, preload). Only the replay is timed. The hit count keeps
+// the compiler from dropping lookups whose result is unused; pass `hits` to read it.
+template <class HT>
+double run_ops(const std::vector<std::vector<WorkOp>>& streams, int preload, int bucket_count,
+               RunStats* stats = nullptr, bool numa_stats = false, bool instrument = false,
+               bool mem_stats = false, uint64_t* hits = nullptr) {
+    HT ht(bucket_count);
+    int threads = int(streams.size());
+    int ops = 0;
+    for (const auto& s : streams) ops += int(s.size());
 
-        #pragma omp for
-        for (int i=0;i<mixed;++i) {
-            bool is_read = coin(rng) < read_ratio;
-            int key = skewed ? hot.draw() : (i % initial);
-            if (is_read) { int v; ht.search(key, v); }
-            else { ht.insert(initial + i, i); }
+    #pragma omp parallel for num_threads(threads)
+    for (int i=0;i<preload;++i) ht.insert(i, i*2);
+
+    std::atomic<uint64_t> hit_count{0};
+    MixedPhase phase(numa_stats, instrument, mem_stats);
+    double t0 = omp_get_wtime();
+    #pragma omp parallel num_threads(threads)
+    {
+        const std::vector<WorkOp>& mine = streams[omp_get_thread_num()];
+        NumaTally tally;
+        int node = numa_stats ? numa_current_node() : 0;
+        LatencySampler lat(instrument);
+        uint64_t my_hits = 0;
+        for (const WorkOp& op : mine) {
+            if (numa_stats) tally.add(ht, op.key, node);
+            bool timed = lat.begin();
+            my_hits += apply_op<int>(ht, op);
+            if (timed) lat.end();
         }
+        hit_count.fetch_add(my_hits, std::memory_order_relaxed);
+        phase.merge(tally, lat);
     }
-    return omp_get_wtime() - t0;
+    double elapsed = omp_get_wtime() - t0;
+    if (hits) *hits = hit_count.load();
+    phase.finish(ht, ops, stats);
+    return elapsed;
 }
 
 // Per-configuration sequential baseline cache
 struct BaselineKey {
     std::string mode;
+    std::string mix;    // workload name; empty for the read-ratio mixes
     double read_ratio;
     std::string dist;
     int buckets;
@@ -68,6 +325,7 @@ struct BaselineKey {
     int ops;
     bool operator<(const BaselineKey& o) const {
         if (mode != o.mode) return mode < o.mode;
+        if (mix != o.mix) return mix < o.mix;
         if (read_ratio != o.read_ratio) return read_ratio < o.read_ratio;
         if (dist != o.dist) return dist < o.dist;
         if (buckets != o.buckets) return buckets < o.buckets;
@@ -76,17 +334,51 @@ struct BaselineKey {
     }
 };
 
-static double get_baseline(const BaselineKey& k, double hot_frac,
-                           std::map<BaselineKey,double>& cache) {
+template <class Run>
+static double cached_baseline(const BaselineKey& k, std::map<BaselineKey,double>& cache, Run run) {
     auto it = cache.find(k);
     if (it != cache.end()) return it->second;
-    bool skewed = (k.dist == "skew");
-    double t = run_workload<SequentialHashTable<int,int>>(1, k.ops, k.read_ratio,
-                                                          skewed, k.buckets, k.p_hot, hot_frac);
+    double t = run();
     cache[k] = t;
     return t;
 }
 
+static double get_baseline(const BaselineKey& k, double hot_frac,
+                           std::map<BaselineKey,double>& cache) {
+    return cached_baseline(k, cache, [&] {
+        bool skewed = (k.dist == "skew");
+        return run_workload<SequentialHashTable<int,int>>(1, k.ops, k.read_ratio,
+                                                          skewed, k.buckets, k.p_hot, hot_frac);
+    });
+}
+
+// One --workload or --trace entry. Rows keep the matrix conventions: ops
+// counts the preloaded keys too, read_ratio is the share of reads and scans,
+// and p_hot carries theta for the zipf rows.
+struct WorkloadRun {
+    std::string mix, dist;          // e.g. "ycsb-a","zipf" or "<trace file>","trace"
+    WorkloadSpec spec;              // generated workloads
+    const Trace* trace = nullptr;   // trace replay: strong mode only, its own op count
+
+    double read_ratio() const { return trace ? 0.0 : spec.mix.read + spec.mix.scan; }
+    double theta() const { return trace ? 0.0 : spec.theta; }
+    int preload(int ops) const { return trace ? trace->preload : ops / 2; }
+    std::vector<std::vector<WorkOp>> streams(int threads, int ops) const {
+        return trace ? split_trace(*trace, threads) : generate_workload(with_preload(ops), threads, size_t(ops - ops / 2));
+    }
+    WorkloadSpec with_preload(int ops) const {
+        WorkloadSpec s = spec;
+        s.preload = ops / 2;
+        return s;
+    }
+};
+
+// Read/write percentages of a mix, e.g. "80/20".
+static std::string mix_label(double read_ratio) {
+    int r = int(read_ratio * 100 + 0.5);
+    return std::to_string(r) + "/" + std::to_string(100 - r);
+}
+
 template <class HT>
 void run_matrix_for_impl(const std::string& impl_name,
                          std::vector<Row>& out,
@@ -95,42 +387,77 @@ void run_matrix_for_impl(const std::string& impl_name,
                          const std::vector<double>& mixes,
                          const std::vector<int>& buckets_vec,
                          const std::vector<double>& p_hots,
-                         double hot_frac)
+                         double hot_frac,
+                         int batch,
+                         bool numa_stats,
+                         bool instrument,
+                         bool mem_stats,
+                         const std::vector<WorkloadRun>& workloads)
 {
     std::map<BaselineKey,double> baseline_cache;
 
+    // --workload / --trace replace the read-ratio x uniform/skew sweep.
+    auto sweep_workloads = [&](const std::string& mode) {
+        for (const WorkloadRun& w : workloads) {
+            if (w.trace && mode != "strong") continue;
+            for (int buckets : buckets_vec) {
+                for (int T : threads_vec) {
+                    int ops = w.trace ? w.trace->preload + int(w.trace->ops.size())
+                                      : (mode=="strong") ? strong_ops : weak_ops_per_thread * T;
+                    BaselineKey bk{mode, w.mix, w.read_ratio(), w.dist, buckets, w.theta(), ops};
+                    double base_t = cached_baseline(bk, baseline_cache, [&] {
+                        return run_ops<SequentialHashTable<int,int>>(w.streams(1, ops), w.preload(ops), buckets);
+                    });
+
+                    RunStats st;
+                    double t = run_ops<HT>(w.streams(T, ops), w.preload(ops), buckets, &st, numa_stats, instrument, mem_stats);
+                    double thr = (double)ops / t / 1e6;
+                    double spd = base_t / t;
+                    out.push_back(Row{impl_name, mode, w.mix, w.dist,
+                                      T, ops, buckets, w.read_ratio(), w.theta(), t, thr, spd, base_t, st.allocs_per_op, st.rss_mb, st.local_pct, st.inst, st.mem});
+                    printf("%-14s %s %6s %7s  T=%2d ops=%8d buckets=%7d theta=%4.2f  time=%.4f  thr=%.2f Mops  speedup=%.2f\n",
+                           impl_name.c_str(), mode.c_str(), w.mix.c_str(), w.dist.c_str(),
+                           T, ops, buckets, w.theta(), t, thr, spd);
+                }
+            }
+        }
+    };
+
     auto sweep = [&](const std::string& mode) {
+        if (!workloads.empty()) { sweep_workloads(mode); return; }
         for (double mix : mixes) {
             for (int buckets : buckets_vec) {
                 // Uniform
                 for (int T : threads_vec) {
                     int ops = (mode=="strong") ? strong_ops : weak_ops_per_thread * T;
-                    BaselineKey bk{mode, mix, "uniform", buckets, 0.0, ops};
+                    BaselineKey bk{mode, "", mix, "uniform", buckets, 0.0, ops};
                     double base_t = get_baseline(bk, hot_frac, baseline_cache);
 
-                    double t = run_workload<HT>(T, ops, mix, false, buckets, 0.0, hot_frac);
+                    RunStats st;
+                    double t = run_workload<HT>(T, ops, mix, false, buckets, 0.0, hot_frac, batch, &st, numa_stats, instrument, mem_stats);
                     double thr = (double)ops / t / 1e6;
                     double spd = base_t / t;
-                    out.push_back(Row{impl_name, mode, (mix==0.8?"80/20":"50/50"), "uniform",
-                                      T, ops, buckets, mix, 0.0, t, thr, spd, base_t});
+                    out.push_back(Row{impl_name, mode, mix_label(mix), "uniform",
+                                      T, ops, buckets, mix, 0.0, t, thr, spd, base_t, st.allocs_per_op, st.rss_mb, st.local_pct, st.inst, st.mem});
                     printf("%-14s %s %6s %7s  T=%2d ops=%8d buckets=%7d  time=%.4f  thr=%.2f Mops  speedup=%.2f\n",
-                           impl_name.c_str(), mode.c_str(), (mix==0.8?"80/20":"50/50"), "uniform",
+                           impl_name.c_str(), mode.c_str(), mix_label(mix).c_str(), "uniform",
                            T, ops, buckets, t, thr, spd);
                 }
                 // Skew (p_hot sweep)
                 for (double ph : p_hots) {
                     for (int T : threads_vec) {
                         int ops = (mode=="strong") ? strong_ops : weak_ops_per_thread * T;
-                        BaselineKey bk{mode, mix, "skew", buckets, ph, ops};
+                        BaselineKey bk{mode, "", mix, "skew", buckets, ph, ops};
                         double base_t = get_baseline(bk, hot_frac, baseline_cache);
 
-                        double t = run_workload<HT>(T, ops, mix, true, buckets, ph, hot_frac);
+                        RunStats st;
+                        double t = run_workload<HT>(T, ops, mix, true, buckets, ph, hot_frac, batch, &st, numa_stats, instrument, mem_stats);
                         double thr = (double)ops / t / 1e6;
                         double spd = base_t / t;
-                        out.push_back(Row{impl_name, mode, (mix==0.8?"80/20":"50/50"), "skew",
-                                          T, ops, buckets, mix, ph, t, thr, spd, base_t});
+                        out.push_back(Row{impl_name, mode, mix_label(mix), "skew",
+                                          T, ops, buckets, mix, ph, t, thr, spd, base_t, st.allocs_per_op, st.rss_mb, st.local_pct, st.inst, st.mem});
                         printf("%-14s %s %6s %7s  T=%2d ops=%8d buckets=%7d p_hot=%4.2f  time=%.4f  thr=%.2f Mops  speedup=%.2f\n",
-                               impl_name.c_str(), mode.c_str(), (mix==0.8?"80/20":"50/50"), "skew",
+                               impl_name.c_str(), mode.c_str(), mix_label(mix).c_str(), "skew",
                                T, ops, buckets, ph, t, thr, spd);
                     }
                 }
@@ -142,9 +469,108 @@ void run_matrix_for_impl(const std::string& impl_name,
     sweep("weak");
 }
 
+// Node allocator under test for the list-based tables (--alloc=pool|std).
+template <class A>
+using KVAlloc = typename std::allocator_traits<A>::template rebind_alloc<KeyValue<int,int>>;
+
+struct MatrixConfig {
+    std::vector<int> threads_vec;
+    int strong_ops, weak_ops_per_thread;
+    std::vector<double> mixes;
+    std::vector<int> buckets_vec;
+    std::vector<double> p_hots;
+    double hot_frac;
+    int batch;
+    bool numa_stats;
+    bool instrument;
+    bool mem_stats;
+    bool combining;
+    std::vector<WorkloadRun> workloads;
+};
+
+// --combining: the segment-locked tables with flat combining on (combining.h).
+template <class HT>
+struct Combined : HT {
+    explicit Combined(int buckets) : HT(buckets) { this->set_combining(true); }
+};
+
+template <class HT, class Label>
+void run_combinable(Label label, const char* name, const MatrixConfig& c, std::vector<Row>& rows) {
+    if (c.combining) {
+        run_matrix_for_impl<Combined<HT>>(label(name), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else {
+        run_matrix_for_impl<HT>(label(name), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    }
+}
+
+template <class A, class H, class Label>
+bool run_impl(const std::string& impl, Label label, const MatrixConfig& c, std::vector<Row>& rows) {
+    using NA = KVAlloc<A>;
+    if (impl=="coarse") {
+        run_matrix_for_impl<CoarseGrainedHashTable<int,int,H,NA>>(label("Coarse"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="fine") {
+        run_matrix_for_impl<FineGrainedHashTable<int,int,H,NA>>(label("Fine"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="segment") {
+        run_combinable<SegmentBasedHashTable<int,int,H,NA>>(label, "Segment", c, rows);
+    } else if (impl=="lockfree" || impl=="lock-free") {
+        run_matrix_for_impl<LockFreeHashTable<int,int,H,NA>>(label("Lock-Free"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="agh") {
+        run_combinable<AGHHashTable<int,int,H,NA>>(label, "AGH", c, rows);
+    } else if (impl=="flat") {
+        // No chain nodes: the allocator choice does not apply.
+        run_matrix_for_impl<StripedFlatHashTable<int,int,H>>(label("Flat"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="cuckoo") {
+        // Open addressing as well: no chain nodes.
+        run_matrix_for_impl<CuckooHashTable<int,int,H>>(label("Cuckoo"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="splitorder" || impl=="split-ordered") {
+        // Lock-free and growable: the bucket count is only the starting size.
+        run_matrix_for_impl<SplitOrderedHashTable<int,int,H,NA>>(label("Split-Ordered"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="snapshot") {
+        // Copy-on-write flat segments: every write copies one segment.
+        run_matrix_for_impl<SnapshotHashTable<int,int,H>>(label("Snapshot"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// --lock=<name> runs the lock-policy tables (coarse, fine, segment) with lock L.
+template <class A, class H, class L, class Label>
+bool run_locked_impl(const std::string& impl, Label label, const MatrixConfig& c, std::vector<Row>& rows) {
+    using NA = KVAlloc<A>;
+    if (impl=="coarse") {
+        run_matrix_for_impl<CoarseGrainedHashTable<int,int,H,NA,L>>(label("Coarse"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="fine") {
+        run_matrix_for_impl<FineGrainedHashTable<int,int,H,NA,L>>(label("Fine"), rows, c.threads_vec, c.strong_ops, c.weak_ops_per_thread, c.mixes, c.buckets_vec, c.p_hots, c.hot_frac, c.batch, c.numa_stats, c.instrument, c.mem_stats, c.workloads);
+    } else if (impl=="segment") {
+        run_combinable<SegmentBasedHashTable<int,int,H,NA,L>>(label, "Segment", c, rows);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Lock names accepted by --lock, with the label suffix their rows get.
+static const std::map<std::string, std::string> LOCK_LABELS = {
+    {"rwspin", "RWSpin"}, {"ttas", "TTAS"}, {"ticket", "Ticket"},
+    {"mcs", "MCS"}, {"shared_mutex", "SharedMutex"}, {"omp", "Omp"},
+};
+
+template <class A, class H, class Label>
+bool run_with_lock(const std::string& lock, const std::string& impl, Label label, const MatrixConfig& c, std::vector<Row>& rows) {
+    if (lock == "default") return run_impl<A, H>(impl, label, c, rows);
+    if (lock == "rwspin") return run_locked_impl<A, H, RWSpinLock>(impl, label, c, rows);
+    if (lock == "ttas") return run_locked_impl<A, H, TTASLock>(impl, label, c, rows);
+    if (lock == "ticket") return run_locked_impl<A, H, TicketLock>(impl, label, c, rows);
+    if (lock == "mcs") return run_locked_impl<A, H, MCSLock>(impl, label, c, rows);
+    if (lock == "shared_mutex") return run_locked_impl<A, H, SharedMutexLock>(impl, label, c, rows);
+    return run_locked_impl<A, H, OmpLock>(impl, label, c, rows);
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s --impl=<coarse|fine|segment|lockfree>\n", argv[0]);
+        fprintf(stderr, "Usage: %s --impl=<coarse|fine|segment|lockfree|agh|flat|cuckoo|splitorder|snapshot> [--batch=N] [--alloc=pool|std] [--alloc-stats] [--hash=mix|std] [--numa-stats] [--lock=rwspin|ttas|ticket|mcs|shared_mutex|omp] [--combining] [--instrument] [--mem-stats]\n"
+                        "       [--workload=a,b,c,d,e,f,churn|ycsb|all] [--theta=0.99,...] [--trace=FILE] [--record-trace=FILE]\n", argv[0]);
         return 1;
     }
     std::string impl_arg = argv[1];
@@ -152,37 +578,191 @@ int main(int argc, char** argv) {
     if (impl_arg.rfind("--impl=", 0)==0) impl = impl_arg.substr(7);
     else { fprintf(stderr, "Error: use --impl=<...>\n"); return 1; }
 
+    int batch = 0;
+    std::string alloc = "pool";
+    bool alloc_report = false;
+    bool numa_report = false;
+    bool instrument = false;
+    bool combining = false;
+    bool mem_report = false;
+    std::string hash = "mix";
+    std::string lock = "default";
+    std::vector<std::string> workload_names;
+    std::vector<double> thetas = {0.99};
+    std::string trace_path, record_path;
+    auto split = [](const std::string& list) {
+        std::vector<std::string> out;
+        std::stringstream ss(list);
+        for (std::string item; std::getline(ss, item, ',');) if (!item.empty()) out.push_back(item);
+        return out;
+    };
+    for (int a = 2; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg.rfind("--batch=", 0)==0) batch = std::atoi(arg.c_str() + 8);
+        else if (arg.rfind("--alloc=", 0)==0) alloc = arg.substr(8);
+        else if (arg == "--alloc-stats") alloc_report = true;
+        else if (arg == "--numa-stats") numa_report = true;
+        else if (arg == "--instrument") instrument = true;
+        else if (arg == "--combining") combining = true;
+        else if (arg == "--mem-stats") mem_report = true;
+        else if (arg.rfind("--lock=", 0)==0) lock = arg.substr(7);
+        else if (arg.rfind("--hash=", 0)==0) hash = arg.substr(7);
+        else if (arg.rfind("--workload=", 0)==0) {
+            for (const std::string& w : split(arg.substr(11))) {
+                if (w == "ycsb" || w == "all") {
+                    for (const auto& m : workload_mixes()) {
+                        if (w == "all" || std::strcmp(m.name, "churn") != 0) workload_names.push_back(m.name);
+                    }
+                } else {
+                    workload_names.push_back(w);
+                }
+            }
+        }
+        else if (arg.rfind("--theta=", 0)==0) {
+            thetas.clear();
+            for (const std::string& t : split(arg.substr(8))) thetas.push_back(std::atof(t.c_str()));
+        }
+        else if (arg.rfind("--trace=", 0)==0) trace_path = arg.substr(8);
+        else if (arg.rfind("--record-trace=", 0)==0) record_path = arg.substr(15);
+        else { fprintf(stderr, "Error: unknown option %s\n", arg.c_str()); return 1; }
+    }
+    if (alloc != "pool" && alloc != "std") {
+        fprintf(stderr, "Error: --alloc must be pool or std\n");
+        return 1;
+    }
+    if (hash != "mix" && hash != "std") {
+        fprintf(stderr, "Error: --hash must be mix or std\n");
+        return 1;
+    }
+#ifndef CHT_INSTRUMENT
+    if (instrument) {
+        fprintf(stderr, "Error: --instrument needs a build with -DCHT_INSTRUMENT\n");
+        return 1;
+    }
+#endif
+    for (const std::string& w : workload_names) {
+        if (!find_workload_mix(w)) {
+            fprintf(stderr, "Error: --workload must list a|b|c|d|e|f|churn (or ycsb, all)\n");
+            return 1;
+        }
+    }
+    if (thetas.empty() || std::any_of(thetas.begin(), thetas.end(), [](double t) { return t < 0.0; })) {
+        fprintf(stderr, "Error: --theta must list values >= 0\n");
+        return 1;
+    }
+    if (batch > 0 && (!workload_names.empty() || !trace_path.empty())) {
+        fprintf(stderr, "Error: --batch does not apply to --workload/--trace\n");
+        return 1;
+    }
+    if (!record_path.empty()) {
+        // One stream of strong-mode size, for the first workload and theta; replays with --trace.
+        if (workload_names.empty()) {
+            fprintf(stderr, "Error: --record-trace needs --workload\n");
+            return 1;
+        }
+        const int ops = 2'000'000;
+        WorkloadSpec spec;
+        spec.mix = *find_workload_mix(workload_names[0]);
+        spec.theta = thetas[0];
+        spec.preload = ops / 2;
+        Trace rec;
+        rec.preload = spec.preload;
+        rec.ops = std::move(generate_workload(spec, 1, size_t(ops - ops / 2))[0]);
+        if (!save_trace(record_path, rec)) {
+            fprintf(stderr, "Error: cannot write %s\n", record_path.c_str());
+            return 1;
+        }
+        fprintf(stderr, "Wrote %zu ops (preload %d) to %s\n", rec.ops.size(), rec.preload, record_path.c_str());
+        return 0;
+    }
+    Trace trace;
+    if (!trace_path.empty() && !load_trace(trace_path, trace)) {
+        fprintf(stderr, "Error: %s is not a readable trace\n", trace_path.c_str());
+        return 1;
+    }
+    if (lock != "default" && !LOCK_LABELS.count(lock)) {
+        fprintf(stderr, "Error: --lock must be rwspin|ttas|ticket|mcs|shared_mutex|omp\n");
+        return 1;
+    }
+    if (lock != "default" && impl != "coarse" && impl != "fine" && impl != "segment") {
+        fprintf(stderr, "Error: --lock applies to coarse|fine|segment only\n");
+        return 1;
+    }
+    if (combining && impl != "segment" && impl != "agh") {
+        fprintf(stderr, "Error: --combining applies to segment|agh only\n");
+        return 1;
+    }
+    // Batched / std-allocator / std-hash / lock-policy / combining rows get their own impl label so they plot as a separate series
+    auto label = [&](const char* name) {
+        std::string s = name;
+        if (batch > 0) s += "-B" + std::to_string(batch);
+        if (alloc == "std") s += "-StdAlloc";
+        if (hash == "std") s += "-StdHash";
+        if (lock != "default") s += "-" + LOCK_LABELS.at(lock);
+        if (combining) s += "-FC";
+        return s;
+    };
+
     const char* bind = std::getenv("OMP_PROC_BIND");
     const char* places = std::getenv("OMP_PLACES");
     fprintf(stderr, "OMP_PROC_BIND=%s  OMP_PLACES=%s\n", bind?bind:"(null)", places?places:"(null)");
+    fprintf(stderr, "NUMA nodes: %d of %d (CHT_NUMA_NODES caps)\n", numa_node_count(), numa_machine_nodes());
 
-    std::vector<int> threads_vec = {1,2,4,8,16};
-    int strong_ops = 2'000'000;
-    int weak_ops_per_thread = 250'000;
-    std::vector<double> mixes = {0.8, 0.5};
-    std::vector<int> buckets_vec = {16384, 65536, 262144, 1048576};
-    std::vector<double> p_hots = {0.7, 0.9, 0.99};
-    double hot_frac = 0.10;
+    MatrixConfig cfg;
+    cfg.threads_vec = {1,2,4,8,16};
+    cfg.strong_ops = 2'000'000;
+    cfg.weak_ops_per_thread = 250'000;
+    cfg.mixes = {0.8, 0.5, 0.99, 1.0};   // 99/1 and 100/0 for the read-mostly tables
+    cfg.buckets_vec = {16384, 65536, 262144, 1048576};
+    cfg.p_hots = {0.7, 0.9, 0.99};
+    cfg.hot_frac = 0.10;
+    cfg.batch = batch;
+    cfg.numa_stats = numa_report;
+    cfg.instrument = instrument;
+    cfg.mem_stats = mem_report;
+    cfg.combining = combining;
+    for (const std::string& w : workload_names) {
+        for (double theta : thetas) {
+            WorkloadRun run;
+            run.mix = (w == "churn") ? w : "ycsb-" + w;
+            run.dist = "zipf";
+            run.spec.mix = *find_workload_mix(w);
+            run.spec.theta = theta;
+            cfg.workloads.push_back(run);
+        }
+    }
+    if (!trace_path.empty()) {
+        WorkloadRun run;
+        run.mix = trace_path.substr(trace_path.find_last_of('/') + 1);
+        run.dist = "trace";
+        run.trace = &trace;
+        cfg.workloads.push_back(run);
+    }
 
     std::vector<Row> rows;
 
-    if (impl=="coarse") {
-        run_matrix_for_impl<CoarseGrainedHashTable<int,int>>("Coarse", rows, threads_vec, strong_ops, weak_ops_per_thread, mixes, buckets_vec, p_hots, hot_frac);
-    } else if (impl=="fine") {
-        run_matrix_for_impl<FineGrainedHashTable<int,int>>("Fine", rows, threads_vec, strong_ops, weak_ops_per_thread, mixes, buckets_vec, p_hots, hot_frac);
-    } else if (impl=="segment") {
-        run_matrix_for_impl<SegmentBasedHashTable<int,int>>("Segment", rows, threads_vec, strong_ops, weak_ops_per_thread, mixes, buckets_vec, p_hots, hot_frac);
-    } else if (impl=="lockfree" || impl=="lock-free") {
-        run_matrix_for_impl<LockFreeHashTable<int,int>>("Lock-Free", rows, threads_vec, strong_ops, weak_ops_per_thread, mixes, buckets_vec, p_hots, hot_frac);
-    } else if (impl=="agh") {
-        run_matrix_for_impl<AGHHashTable<int,int>>("AGH", rows, threads_vec, strong_ops, weak_ops_per_thread, mixes, buckets_vec, p_hots, hot_frac);
+    bool known;
+    if (hash == "std") {
+        known = (alloc == "std") ? run_with_lock<std::allocator<int>, StdHash<int>>(lock, impl, label, cfg, rows)
+                                 : run_with_lock<PoolAllocator<int>, StdHash<int>>(lock, impl, label, cfg, rows);
     } else {
-        fprintf(stderr, "Error: --impl must be one of coarse|fine|segment|segment-exact|lockfree|agh\n");
+        known = (alloc == "std") ? run_with_lock<std::allocator<int>, Hash<int>>(lock, impl, label, cfg, rows)
+                                 : run_with_lock<PoolAllocator<int>, Hash<int>>(lock, impl, label, cfg, rows);
+    }
+    if (!known) {
+        fprintf(stderr, "Error: --impl must be one of coarse|fine|segment|segment-exact|lockfree|agh|flat|cuckoo|splitorder|snapshot\n");
         return 1;
     }
 
+    // --alloc-stats / --numa-stats / --instrument / --mem-stats append their columns last so positional parsers keep working.
+    // local_pct is empty for tables without segments, the chain columns for tables without chains.
     std::cout << "CSV_RESULTS_BEGIN\n";
-    std::cout << "impl,mode,mix,dist,threads,ops,bucket_count,read_ratio,p_hot,time_s,throughput_mops,speedup,seq_baseline_s\n";
+    std::cout << "impl,mode,mix,dist,threads,ops,bucket_count,read_ratio,p_hot,time_s,throughput_mops,speedup,seq_baseline_s"
+              << (alloc_report ? ",allocs_per_op,rss_mb" : "")
+              << (numa_report ? ",local_pct" : "")
+              << (instrument ? ",lat_p50_ns,lat_p99_ns,lat_p999_ns,lock_acq_per_op,lock_contended_pct,lock_wait_ns_per_op,lock_hot_pct,chain_mean,chain_p99,chain_max" : "")
+              << (mem_report ? ",mem_mb,bytes_per_entry,mem_buckets_mb,mem_nodes_mb,mem_locks_mb,mem_padding_mb,mem_other_mb,mem_shrunk_mb" : "")
+              << "\n";
     for (auto& r : rows) {
         std::cout << r.impl << "," << r.mode << "," << r.mix << "," << r.dist << ","
                   << r.threads << "," << r.ops << "," << r.buckets << ","
@@ -191,9 +771,41 @@ int main(int argc, char** argv) {
                   << std::fixed << std::setprecision(6) << r.time_s << ","
                   << std::fixed << std::setprecision(3) << r.thr_mops << ","
                   << std::fixed << std::setprecision(3) << r.speedup << ","
-                  << std::fixed << std::setprecision(6) << r.seq_baseline_s
-                  << "\n";
+                  << std::fixed << std::setprecision(6) << r.seq_baseline_s;
+        if (alloc_report) {
+            std::cout << "," << std::fixed << std::setprecision(4) << r.allocs_per_op
+                      << "," << std::fixed << std::setprecision(1) << r.rss_mb;
+        }
+        if (numa_report) {
+            std::cout << ",";
+            if (r.local_pct >= 0) std::cout << std::fixed << std::setprecision(1) << r.local_pct;
+        }
+        if (instrument) {
+            const InstrumentStats& in = r.inst;
+            std::cout << "," << std::fixed << std::setprecision(0) << in.lat_p50_ns
+                      << "," << in.lat_p99_ns << "," << in.lat_p999_ns
+                      << "," << std::fixed << std::setprecision(3) << in.lock_acq_per_op
+                      << "," << std::fixed << std::setprecision(2) << in.lock_contended_pct
+                      << "," << std::fixed << std::setprecision(1) << in.lock_wait_ns_per_op
+                      << "," << in.lock_hot_pct << ",";
+            if (in.chain_mean >= 0) {
+                std::cout << std::fixed << std::setprecision(2) << in.chain_mean
+                          << "," << std::fixed << std::setprecision(0) << in.chain_p99 << "," << in.chain_max;
+            } else {
+                std::cout << ",,";
+            }
+        }
+        if (mem_report) {
+            const MemoryUsage& m = r.mem.usage;
+            auto mb = [](size_t bytes) { return double(bytes) / (1 << 20); };
+            std::cout << "," << std::fixed << std::setprecision(2) << mb(m.total())
+                      << "," << std::fixed << std::setprecision(1) << m.bytes_per_entry()
+                      << "," << std::fixed << std::setprecision(2) << mb(m.buckets) << "," << mb(m.nodes)
+                      << "," << mb(m.locks) << "," << mb(m.padding) << "," << mb(m.other) << ",";
+            if (r.mem.shrunk_mb >= 0) std::cout << r.mem.shrunk_mb;
+        }
+        std::cout << "\n";
     }
     std::cout << "CSV_RESULTS_END\n";
     return 0;
-}
\ No newline at end of file
+}
@@ -19,30 +19,7 @@ double cacheSimWithLibrary(const vector<CacheOperation>& operations, int num_thr
     
     double start_time = omp_get_wtime();
     
-    #pragma omp parallel num_threads(num_threads) reduction(+:cache_hits, cache_misses)
-    {
-        #pragma omp for
-        for (size_t i = 0; i < operations.size(); ++i) {
-            const auto& op = operations[i];
-            
-            if (op.op == 'R') {
-                int value;
-                if (cache.search(op.key, value)) {
-                    cache_hits++;
-                } else {
-                    cache_misses++;
-                }
-            } else {
-                int existing_value;
-                if (cache.search(op.key, existing_value)) {
-                    cache.insert(op.key, op.value);
-                } else {
-                    cache.insert(op.key, op.value);
-                    cache_misses++;
-                }
-            }
-        }
-    }
+    replayOperations(cache, operations, num_threads, cache_hits, cache_misses, false);
     
     double end_time = omp_get_wtime();
     
@@ -4,6 +4,7 @@
 #include <vector>
 #include <random>
 #include <string>
+#include <omp.h>
 
 // Cache access sequence (key-value pair)
 struct CacheOperation {
@@ -12,13 +13,14 @@ struct CacheOperation {
     char op;  // 'R' = read, 'W' = write
 };
 
-// Generate random cache operation sequence
-inline std::vector<CacheOperation> generateCacheOperations(size_t num_ops, size_t key_range, double read_ratio) {
+// Generate random cache operation sequence; seed 0 draws one from random_device
+inline std::vector<CacheOperation> generateCacheOperations(size_t num_ops, size_t key_range, double read_ratio,
+                                                           unsigned seed = 0) {
     std::vector<CacheOperation> operations;
     operations.reserve(num_ops);
     
     std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(seed ? seed : rd());
     std::uniform_real_distribution<double> op_dist(0.0, 1.0);
     std::uniform_int_distribution<int> key_dist(0, key_range - 1);
     std::uniform_int_distribution<int> value_dist(1, 1000);
@@ -34,5 +36,38 @@ inline std::vector<CacheOperation> generateCacheOperations(size_t num_ops, size_
     return operations;
 }
 
+// Replay operations against cache. With read_through, a read miss also
+// fills the cache, as a bounded cache in front of a backing store would.
+template<typename Cache>
+inline void replayOperations(Cache& cache, const std::vector<CacheOperation>& operations, int num_threads,
+                      size_t& cache_hits, size_t& cache_misses, bool read_through) {
+    // Execute cache operations in parallel
+    #pragma omp parallel num_threads(num_threads) reduction(+:cache_hits, cache_misses)
+    {
+        #pragma omp for
+        for (size_t i = 0; i < operations.size(); ++i) {
+            const auto& op = operations[i];
+            
+            if (op.op == 'R') {
+                // Read operation: lookup cache
+                int value;
+                if (cache.search(op.key, value)) {
+                    cache_hits++;
+                } else {
+                    cache_misses++;
+                    if (read_through) cache.insert(op.key, op.value);
+                }
+            } else {
+                // Write operation: insert or update cache in one locked pass.
+                // insert returns true only for the thread that added the key,
+                // so each first write is counted as a miss exactly once.
+                if (cache.insert(op.key, op.value)) {
+                    cache_misses++;
+                }
+            }
+        }
+    }
+}
+
 #endif // CACHE_SIM_COMMON_H
 
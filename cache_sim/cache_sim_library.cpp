@@ -3,68 +3,77 @@
 #include <omp.h>
 #include <iomanip>
 #include "../fine_grained.h"
+#include "../segment_based.h"
+#include "../clock_cache.h"
 #include "cache_sim_common.h"
 
 using namespace std;
 
-// Cache simulation using concurrent hash table library
+// Replays operations against a cache that is already built, so only the
+// replay is timed (as at baseline, construction is not).
+template<typename Cache>
+double timedReplay(Cache& cache, const vector<CacheOperation>& operations, int num_threads,
+                   size_t& cache_hits, size_t& cache_misses, bool read_through) {
+    double start_time = omp_get_wtime();
+    replayOperations(cache, operations, num_threads, cache_hits, cache_misses, read_through);
+    double end_time = omp_get_wtime();
+    return end_time - start_time;
+}
+
+// Cache simulation using concurrent hash table library.
+// capacity == 0: unbounded FineGrainedHashTable, reads never fill; with
+// flat_combining, a SegmentBasedHashTable with combining on (combining.h).
+// capacity > 0: ClockCache holding at most capacity entries (read-through);
+// evictions receives the number of entries it evicted.
 double cacheSimWithLibrary(const vector<CacheOperation>& operations, int num_threads, 
-                           size_t& total_ops, size_t& cache_hits, size_t& cache_misses) {
-    FineGrainedHashTable<int, int> cache(8192);  // Fine-grained locking implementation
-    
+                           size_t& total_ops, size_t& cache_hits, size_t& cache_misses,
+                           size_t capacity = 0, size_t* evictions = nullptr, bool flat_combining = false) {
     total_ops = operations.size();
     cache_hits = 0;
     cache_misses = 0;
+    if (evictions) *evictions = 0;
     
-    double start_time = omp_get_wtime();
-    
-    // Execute cache operations in parallel
-    #pragma omp parallel num_threads(num_threads) reduction(+:cache_hits, cache_misses)
-    {
-        #pragma omp for
-        for (size_t i = 0; i < operations.size(); ++i) {
-            const auto& op = operations[i];
-            
-            if (op.op == 'R') {
-                // Read operation: lookup cache
-                int value;
-                if (cache.search(op.key, value)) {
-                    cache_hits++;
-                } else {
-                    cache_misses++;
-                }
-            } else {
-                // Write operation: insert or update cache
-                // insert returns true if new insertion, false if key already existed
-                // This avoids race condition - insert is atomic
-                int dummy;
-                bool was_new = !cache.search(op.key, dummy);
-                cache.insert(op.key, op.value);  // Insert or update atomically
-                if (was_new) {
-                    cache_misses++;  // First write counts as miss
-                }
-                // Note: There's still a small race condition in the miss counting,
-                // but the cache operation itself is correct
-            }
-        }
+    if (capacity == 0 && flat_combining) {
+        SegmentBasedHashTable<int, int> cache(8192);
+        cache.set_combining(true);
+        return timedReplay(cache, operations, num_threads, cache_hits, cache_misses, false);
+    } else if (capacity == 0) {
+        FineGrainedHashTable<int, int> cache(8192);  // Fine-grained locking implementation
+        return timedReplay(cache, operations, num_threads, cache_hits, cache_misses, false);
+    } else {
+        ClockCache<int, int> cache(capacity);  // sharded CLOCK eviction
+        double time = timedReplay(cache, operations, num_threads, cache_hits, cache_misses, true);
+        if (evictions) *evictions = cache.evictions();
+        return time;
     }
-    
-    double end_time = omp_get_wtime();
-    
-    return end_time - start_time;
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 5) {
-        cerr << "Usage: " << argv[0] << " <num_operations> <key_range> <read_ratio> <num_threads>" << endl;
+    // --flat-combining may appear anywhere; the rest are positional.
+    vector<string> args;
+    bool flat_combining = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--flat-combining") flat_combining = true;
+        else args.push_back(arg);
+    }
+    if (args.size() < 4) {
+        cerr << "Usage: " << argv[0] << " <num_operations> <key_range> <read_ratio> <num_threads> [capacity] [--flat-combining]" << endl;
         cerr << "Example: " << argv[0] << " 1000000 10000 0.8 4" << endl;
+        cerr << "Example: " << argv[0] << " 1000000 10000 0.8 4 2000   # bounded CLOCK cache" << endl;
+        cerr << "Example: " << argv[0] << " 1000000 100 0.2 8 --flat-combining   # unbounded, segment table with combining" << endl;
         return 1;
     }
     
-    size_t num_ops = stoull(argv[1]);
-    size_t key_range = stoull(argv[2]);
-    double read_ratio = stod(argv[3]);
-    int num_threads = stoi(argv[4]);
+    size_t num_ops = stoull(args[0]);
+    size_t key_range = stoull(args[1]);
+    double read_ratio = stod(args[2]);
+    int num_threads = stoi(args[3]);
+    size_t capacity = (args.size() >= 5) ? stoull(args[4]) : 0;
+    if (flat_combining && capacity > 0) {
+        cerr << "Error: --flat-combining applies to the unbounded cache only" << endl;
+        return 1;
+    }
     
     cout << "=====================================" << endl;
     cout << "  Cache Simulation (Using Library)" << endl;
@@ -73,18 +82,26 @@ int main(int argc, char* argv[]) {
     cout << "Key range: " << key_range << endl;
     cout << "Read ratio: " << read_ratio << endl;
     cout << "Threads: " << num_threads << endl;
+    if (capacity > 0) {
+        cout << "Capacity: " << capacity << " entries (CLOCK eviction)" << endl;
+    } else {
+        cout << "Capacity: unbounded" << (flat_combining ? " (segment-based, flat combining)" : "") << endl;
+    }
     cout << endl;
     
     // Generate operation sequence
     vector<CacheOperation> operations = generateCacheOperations(num_ops, key_range, read_ratio);
     
     size_t total_ops = 0, cache_hits = 0, cache_misses = 0;
-    double time = cacheSimWithLibrary(operations, num_threads, total_ops, cache_hits, cache_misses);
+    size_t evictions = 0;
+    double time = cacheSimWithLibrary(operations, num_threads, total_ops, cache_hits, cache_misses,
+                                      capacity, &evictions, flat_combining);
     
     cout << fixed << setprecision(4);
     cout << "Total operations: " << total_ops << endl;
     cout << "Cache hits: " << cache_hits << endl;
     cout << "Cache misses: " << cache_misses << endl;
+    cout << "Evictions: " << evictions << endl;
     cout << "Hit ratio: " << fixed << setprecision(2) 
          << (100.0 * cache_hits / (cache_hits + cache_misses)) << "%" << endl;
     cout << "Time: " << fixed << setprecision(4) << time << " seconds" << endl;
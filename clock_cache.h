@@ -0,0 +1,191 @@
+#ifndef CLOCK_CACHE_H
+#define CLOCK_CACHE_H
+
+#include "common.h"
+#include "flat_hash_table.h"
+#include "locks.h"
+#include <cstdint>
+#include <memory>
+
+// Bounded concurrent cache with CLOCK (second-chance) eviction.
+//
+// The capacity is split across independent shards. Each shard keeps its
+// entries in fixed slot arrays plus a FlatHashTable index from key to slot.
+// A hit only takes the shard lock shared and sets the slot's reference bit,
+// so reads never reorder anything. A miss that needs room takes the lock
+// exclusively and sweeps the clock hand: referenced slots get their bit
+// cleared and a second chance, and the first unreferenced one is evicted.
+//
+// Compile-time overrides:
+//   -DCLOCK_MAX_SHARDS=64     // shards (power of two); fewer for tiny capacities
+
+#ifndef CLOCK_MAX_SHARDS
+#define CLOCK_MAX_SHARDS 64
+#endif
+
+template<typename K, typename V, typename HashFn = Hash<K>>
+class ClockCache {
+private:
+    static_assert((CLOCK_MAX_SHARDS & (CLOCK_MAX_SHARDS - 1)) == 0, "CLOCK_MAX_SHARDS must be a power of two");
+    static constexpr size_t MIN_SHARD_ENTRIES = 64;   // small shards skew the hit ratio
+
+    struct alignas(64) Shard {
+        RWSpinLock lock;                          // shared for hits, exclusive for changes
+        FlatHashTable<K, uint32_t, HashFn> index; // key -> slot
+        std::vector<K> keys;
+        std::vector<V> values;
+        std::unique_ptr<std::atomic<uint8_t>[]> referenced;
+        std::vector<uint32_t> free_slots;         // slots emptied by remove()
+        uint32_t used = 0;                        // slots handed out so far
+        uint32_t hand = 0;
+        std::atomic<size_t> evictions{0};
+
+        explicit Shard(uint32_t cap)
+            : index(cap * 2), keys(cap), values(cap), referenced(new std::atomic<uint8_t>[cap]) {
+            for (uint32_t i = 0; i < cap; ++i) referenced[i].store(0, std::memory_order_relaxed);
+        }
+        Shard(const Shard&) = delete;
+        Shard& operator=(const Shard&) = delete;
+    };
+
+    std::vector<Shard*> shards;
+    uint32_t per_shard;
+    unsigned shard_bits;
+    ElementCounter element_count;
+
+    size_t shard_index(size_t h) const {
+        return shard_bits ? h >> (sizeof(size_t) * 8 - shard_bits) : 0;
+    }
+
+    // Caller holds s->lock exclusively and the shard is full.
+    uint32_t evict(Shard* s) {
+        while (true) {
+            uint32_t slot = s->hand;
+            s->hand = (s->hand + 1 == per_shard) ? 0 : s->hand + 1;
+            if (s->referenced[slot].load(std::memory_order_relaxed)) {
+                s->referenced[slot].store(0, std::memory_order_relaxed);
+                continue;
+            }
+            s->index.remove(s->keys[slot]);
+            s->evictions.fetch_add(1, std::memory_order_relaxed);
+            element_count.sub(1);
+            return slot;
+        }
+    }
+
+public:
+    // capacity is rounded up to a multiple of the shard count. Each shard
+    // evicts on its own once its share is full, so the cache as a whole can
+    // start evicting slightly before it holds capacity() entries.
+    explicit ClockCache(size_t capacity) : element_count(0) {
+        if (capacity == 0) capacity = 1;
+        size_t n = 1;
+        shard_bits = 0;
+        while (n * 2 <= CLOCK_MAX_SHARDS && n * 2 * MIN_SHARD_ENTRIES <= capacity) { n *= 2; ++shard_bits; }
+        per_shard = uint32_t((capacity + n - 1) / n);
+        shards.reserve(n);
+        for (size_t i = 0; i < n; ++i) shards.push_back(new Shard(per_shard));
+    }
+
+    ~ClockCache() {
+        for (auto s : shards) delete s;
+    }
+
+    ClockCache(const ClockCache&) = delete;
+    ClockCache& operator=(const ClockCache&) = delete;
+
+    // Hit: copies the value out and marks the entry recently used.
+    bool search(const K& key, V& value) const {
+        size_t h = HashFn{}(key);
+        Shard* s = shards[shard_index(h)];
+        s->lock.lock_shared();
+        uint32_t slot;
+        bool hit = s->index.search_hashed(key, slot, h);
+        if (hit) {
+            value = s->values[slot];
+            if (!s->referenced[slot].load(std::memory_order_relaxed)) {
+                s->referenced[slot].store(1, std::memory_order_relaxed);
+            }
+        }
+        s->lock.unlock_shared();
+        return hit;
+    }
+
+    // Insert or update; returns true if key was not cached (evicting another entry if full).
+    bool insert(const K& key, const V& value) {
+        size_t h = HashFn{}(key);
+        Shard* s = shards[shard_index(h)];
+        s->lock.lock();
+        uint32_t slot;
+        if (s->index.search_hashed(key, slot, h)) {
+            s->values[slot] = value;
+            s->referenced[slot].store(1, std::memory_order_relaxed);
+            s->lock.unlock();
+            return false;
+        }
+        if (!s->free_slots.empty()) {
+            slot = s->free_slots.back();
+            s->free_slots.pop_back();
+        } else if (s->used < per_shard) {
+            slot = s->used++;
+        } else {
+            slot = evict(s);
+        }
+        s->keys[slot] = key;
+        s->values[slot] = value;
+        s->referenced[slot].store(0, std::memory_order_relaxed);  // must be hit again to earn a second chance
+        s->index.insert_hashed(key, slot, h);
+        element_count.add(1);
+        s->lock.unlock();
+        return true;
+    }
+
+    bool remove(const K& key) {
+        size_t h = HashFn{}(key);
+        Shard* s = shards[shard_index(h)];
+        s->lock.lock();
+        uint32_t slot;
+        bool found = s->index.search_hashed(key, slot, h);
+        if (found) {
+            s->index.remove_hashed(key, h);
+            s->keys[slot] = K();
+            s->values[slot] = V();
+            s->free_slots.push_back(slot);
+            element_count.sub(1);
+        }
+        s->lock.unlock();
+        return found;
+    }
+
+    size_t size() const { return element_count.load(); }
+    size_t capacity() const { return size_t(per_shard) * shards.size(); }
+
+    size_t evictions() const {
+        size_t n = 0;
+        for (auto s : shards) n += s->evictions.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // Memory accounting (see common.h): slot arrays and each shard's index
+    // are buckets. Capacity is fixed, so there is nothing to shrink.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        for (const Shard* s : shards) {
+            m += s->index.memory_usage();
+            m.buckets += s->keys.capacity() * sizeof(K) + s->values.capacity() * sizeof(V) +
+                         size_t(per_shard) * sizeof(std::atomic<uint8_t>) + s->free_slots.capacity() * sizeof(uint32_t);
+            m.locks += sizeof(RWSpinLock);
+            const size_t header = sizeof(s->keys) + sizeof(s->values) + sizeof(s->referenced) +
+                                  sizeof(s->free_slots) + sizeof(s->used) + sizeof(s->hand) + sizeof(s->evictions);
+            m.padding += sizeof(Shard) - header - sizeof(s->index) - sizeof(RWSpinLock);
+            m.other += header;
+        }
+        usage_add_object(m, sizeof(*this) + shards.capacity() * sizeof(Shard*));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    std::string getName() const { return "Clock-Cache"; }
+};
+
+#endif // CLOCK_CACHE_H
@@ -2,76 +2,101 @@
 #define COARSE_GRAINED_H
 
 #include "common.h"
+#include "packed_chain.h"
+#include "locks.h"
 
-template<typename K, typename V>
+// Lock: any lock from locks.h; OmpLock keeps the original omp_lock_t baseline.
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>,
+         typename Lock = OmpLock>
 class CoarseGrainedHashTable {
 private:
-    std::vector<std::list<KeyValue<K, V>>> buckets;
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
+    std::vector<Chain> buckets;
     size_t bucket_count;
-    mutable omp_lock_t global_lock;  // Global lock (mutable allows use in const functions)
-    std::atomic<size_t> element_count;
+    mutable Lock global_lock;  // Global lock (mutable allows use in const functions)
+    ElementCounter element_count;
     
     size_t hash(const K& key) const {
-        return Hash<K>{}(key) % bucket_count;
+        return HashFn{}(key) & (bucket_count - 1);  // bucket_count is a power of two
     }
 
 public:
     CoarseGrainedHashTable(size_t bucket_count = 1024) 
-        : bucket_count(bucket_count), element_count(0) {
-        buckets.resize(bucket_count);
-        omp_init_lock(&global_lock);
-    }
-    
-    ~CoarseGrainedHashTable() {
-        omp_destroy_lock(&global_lock);
+        : bucket_count(next_pow2(bucket_count)), element_count(0) {
+        buckets.resize(this->bucket_count);
     }
     
     // Insert operation
     bool insert(const K& key, const V& value) {
-        omp_set_lock(&global_lock);  // Lock the entire table
+        global_lock.lock();  // Lock the entire table
         
         size_t idx = hash(key);
         auto& bucket = buckets[idx];
         
         // Check if key already exists
-        for (auto& kv : bucket) {
-            if (kv.key == key) {
-                kv.value = value;  // Update value
-                omp_unset_lock(&global_lock);
-                return false;  // Key already exists
-            }
+        if (auto* kv = chain_find(bucket, key)) {
+            kv->value = value;  // Update value
+            global_lock.unlock();
+            return false;  // Key already exists
         }
         
         // Insert new key-value pair
         bucket.emplace_back(key, value);
-        element_count++;
+        element_count.add(1);
         
-        omp_unset_lock(&global_lock);
+        global_lock.unlock();
         return true;
     }
     
     // search operation
+    // Read-modify-write operations (see common.h), one lock acquisition each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        global_lock.lock();
+        auto& bucket = buckets[hash(key)];
+        bool inserted = false;
+        if (auto* kv = chain_find(bucket, key)) {
+            fn(kv->value);
+        } else {
+            bucket.emplace_back(key, init);
+            element_count.add(1);
+            inserted = true;
+        }
+        global_lock.unlock();
+        return inserted;
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        global_lock.lock();
+        auto* kv = chain_find(buckets[hash(key)], key);
+        if (kv) fn(kv->value);
+        global_lock.unlock();
+        return kv != nullptr;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
-        omp_set_lock(&global_lock);
+        global_lock.lock_shared();
         
         size_t idx = hash(key);
         const auto& bucket = buckets[idx];
         
-        for (const auto& kv : bucket) {
-            if (kv.key == key) {
-                value = kv.value;
-                omp_unset_lock(&global_lock);
-                return true;
-            }
+        if (const auto* kv = chain_find(bucket, key)) {
+            value = kv->value;
+            global_lock.unlock_shared();
+            return true;
         }
         
-        omp_unset_lock(&global_lock);
+        global_lock.unlock_shared();
         return false;
     }
     
     // delete operation
     bool remove(const K& key) {
-        omp_set_lock(&global_lock);
+        global_lock.lock();
         
         size_t idx = hash(key);
         auto& bucket = buckets[idx];
@@ -79,19 +104,129 @@ public:
         for (auto it = bucket.begin(); it != bucket.end(); ++it) {
             if (it->key == key) {
                 bucket.erase(it);
-                element_count--;
-                omp_unset_lock(&global_lock);
+                element_count.sub(1);
+                global_lock.unlock();
                 return true;
             }
         }
         
-        omp_unset_lock(&global_lock);
+        global_lock.unlock();
         return false;
     }
     
+    // Batched operations: one global lock acquisition per batch; buckets are
+    // prefetched before the lock is taken.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = hash(keys[i]);
+            prefetch_write(&buckets[sc.hashes[i]]);
+        }
+        size_t added = 0;
+        global_lock.lock();
+        for (size_t i = 0; i < n; ++i) {
+            auto& bucket = buckets[sc.hashes[i]];
+            auto* kv = chain_find(bucket, keys[i]);
+            bool is_new = kv == nullptr;
+            if (kv) kv->value = values[i];
+            if (is_new) bucket.emplace_back(keys[i], values[i]);
+            if (inserted) inserted[i] = is_new;
+            added += is_new;
+        }
+        global_lock.unlock();
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = hash(keys[i]);
+            prefetch_read(&buckets[sc.hashes[i]]);
+        }
+        size_t hits = 0;
+        global_lock.lock_shared();
+        for (size_t i = 0; i < n; ++i) {
+            const auto* kv = chain_find(buckets[sc.hashes[i]], keys[i]);
+            found[i] = kv != nullptr;
+            if (kv) values[i] = kv->value;
+            hits += found[i];
+        }
+        global_lock.unlock_shared();
+        return hits;
+    }
+    
+    // Bulk load (see common.h): bucket ranges are filled by one thread each.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkBucketGroups groups(bucket_count);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, groups.count, groups, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t g = 0; g < groups.count; ++g) {
+            for (const BulkEntry* e = part.begin(g); e != part.end(g); ++e) {
+                added += bulk_append(buckets[e->hash & (bucket_count - 1)], first[e->index], unique);
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // Bucket ranges as groups (see common.h); read while no writer is active.
+    size_t group_count() const { return BulkBucketGroups(bucket_count).count; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        BulkBucketGroups groups(bucket_count);
+        for (size_t b = groups.first_bucket(g); b < groups.first_bucket(g + 1); ++b) {
+            for (const auto& kv : buckets[b]) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Memory accounting (see common.h). shrink_to_fit takes the lock per
+    // bucket, so it does not stall the table for the whole pass.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.buckets = buckets.capacity() * sizeof(Chain);
+        for (const auto& chain : buckets) m.nodes += chain_node_bytes(chain);
+        m.locks = sizeof(Lock);
+        usage_add_object(m, sizeof(*this) - sizeof(Lock));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    size_t shrink_to_fit() {
+        size_t freed = 0;
+        for (auto& chain : buckets) {
+            global_lock.lock();
+            freed += chain_shrink(chain);
+            global_lock.unlock();
+        }
+        return freed;
+    }
+
     size_t size() const {
         return element_count.load();
     }
+
+    // Buckets per chain length (see instrumentation.h); read while no writer is active.
+    std::vector<size_t> chain_length_histogram() const {
+        std::vector<size_t> hist;
+        for (const auto& chain : buckets) chain_hist_add(hist, chain.size());
+        return hist;
+    }
     
     std::string getName() const {
         return "Coarse-Grained";
@@ -2,23 +2,25 @@
 #define COARSE_GRAINED_PADDED_H
 
 #include "common.h"
+#include "packed_chain.h"
 
-template<typename K, typename V>
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>>
 class CoarseGrainedHashTablePadded {
 private:
-    std::vector<std::list<KeyValue<K,V>>> buckets;
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
+    std::vector<Chain> buckets;
     size_t bucket_count;
     alignas(64) mutable omp_lock_t global_lock; // aligned to reduce cache-line contention
-    std::atomic<size_t> element_count;
+    ElementCounter element_count;
 
     size_t hash(const K& key) const {
-        return Hash<K>{}(key) % bucket_count;
+        return HashFn{}(key) & (bucket_count - 1);  // bucket_count is a power of two
     }
 
 public:
     CoarseGrainedHashTablePadded(size_t bucket_count = 1024)
-        : bucket_count(bucket_count), element_count(0) {
-        buckets.resize(bucket_count);
+        : bucket_count(next_pow2(bucket_count)), element_count(0) {
+        buckets.resize(this->bucket_count);
         omp_init_lock(&global_lock);
     }
 
@@ -34,11 +36,40 @@ public:
             if (kv.key == key) { kv.value = value; omp_unset_lock(&global_lock); return false; }
         }
         bucket.emplace_back(key, value);
-        element_count++;
+        element_count.add(1);
         omp_unset_lock(&global_lock);
         return true;
     }
 
+    // Read-modify-write operations (see common.h), one lock acquisition each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        omp_set_lock(&global_lock);
+        auto& bucket = buckets[hash(key)];
+        bool inserted = false;
+        if (auto* kv = chain_find(bucket, key)) {
+            fn(kv->value);
+        } else {
+            bucket.emplace_back(key, init);
+            element_count.add(1);
+            inserted = true;
+        }
+        omp_unset_lock(&global_lock);
+        return inserted;
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        omp_set_lock(&global_lock);
+        auto* kv = chain_find(buckets[hash(key)], key);
+        if (kv) fn(kv->value);
+        omp_unset_lock(&global_lock);
+        return kv != nullptr;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
         omp_set_lock(&global_lock);
         size_t idx = hash(key);
@@ -57,7 +88,7 @@ public:
         for (auto it = bucket.begin(); it != bucket.end(); ++it) {
             if (it->key == key) {
                 bucket.erase(it);
-                element_count--;
+                element_count.sub(1);
                 omp_unset_lock(&global_lock);
                 return true;
             }
@@ -66,6 +97,111 @@ public:
         return false;
     }
 
+    // Batched operations: one global lock acquisition per batch; buckets are
+    // prefetched before the lock is taken.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = hash(keys[i]);
+            prefetch_write(&buckets[sc.hashes[i]]);
+        }
+        size_t added = 0;
+        omp_set_lock(&global_lock);
+        for (size_t i = 0; i < n; ++i) {
+            auto& bucket = buckets[sc.hashes[i]];
+            auto* kv = chain_find(bucket, keys[i]);
+            bool is_new = kv == nullptr;
+            if (kv) kv->value = values[i];
+            if (is_new) bucket.emplace_back(keys[i], values[i]);
+            if (inserted) inserted[i] = is_new;
+            added += is_new;
+        }
+        omp_unset_lock(&global_lock);
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = hash(keys[i]);
+            prefetch_read(&buckets[sc.hashes[i]]);
+        }
+        size_t hits = 0;
+        omp_set_lock(&global_lock);
+        for (size_t i = 0; i < n; ++i) {
+            const auto* kv = chain_find(buckets[sc.hashes[i]], keys[i]);
+            found[i] = kv != nullptr;
+            if (kv) values[i] = kv->value;
+            hits += found[i];
+        }
+        omp_unset_lock(&global_lock);
+        return hits;
+    }
+
+    // Bulk load (see common.h): bucket ranges are filled by one thread each.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkBucketGroups groups(bucket_count);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, groups.count, groups, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t g = 0; g < groups.count; ++g) {
+            for (const BulkEntry* e = part.begin(g); e != part.end(g); ++e) {
+                added += bulk_append(buckets[e->hash & (bucket_count - 1)], first[e->index], unique);
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // Bucket ranges as groups (see common.h); read while no writer is active.
+    size_t group_count() const { return BulkBucketGroups(bucket_count).count; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        BulkBucketGroups groups(bucket_count);
+        for (size_t b = groups.first_bucket(g); b < groups.first_bucket(g + 1); ++b) {
+            for (const auto& kv : buckets[b]) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Memory accounting (see common.h); padding includes the filler around
+    // the aligned lock.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.buckets = buckets.capacity() * sizeof(Chain);
+        for (const auto& chain : buckets) m.nodes += chain_node_bytes(chain);
+        m.locks = sizeof(omp_lock_t);
+        const size_t fields = sizeof(buckets) + sizeof(bucket_count) + sizeof(element_count);
+        m.padding = sizeof(*this) - fields - sizeof(omp_lock_t);
+        usage_add_object(m, fields);
+        m.entries = element_count.load();
+        return m;
+    }
+
+    size_t shrink_to_fit() {
+        size_t freed = 0;
+        for (auto& chain : buckets) {
+            omp_set_lock(&global_lock);
+            freed += chain_shrink(chain);
+            omp_unset_lock(&global_lock);
+        }
+        return freed;
+    }
+
     size_t size() const { return element_count.load(); }
     std::string getName() const { return "Coarse-Grained-Padded"; }
 };
@@ -0,0 +1,145 @@
+#ifndef COMBINING_H
+#define COMBINING_H
+
+#include "locks.h"
+#include <atomic>
+#include <cstdint>
+
+// Flat combining for the segment-locked tables: set_combining(true) on
+// SegmentBasedHashTable or AGHHashTable.
+//
+// A thread that finds its lock taken does not queue on the lock word. It
+// publishes the operation in one of the lock's CHT_COMBINE_SLOTS request
+// slots and waits. A thread holding the lock exclusively runs every
+// published request its lock covers before it unlocks. Under skew, a hot
+// segment's writes then run back to back on one core while its buckets are
+// in cache, and the waiters spin on their own slots instead of the lock line.
+// A waiter that gets the lock first takes its request back and runs it
+// itself. An uncontended operation still costs one try_lock.
+//
+// A waiter that takes a shared lock for a lookup runs only its own request;
+// only exclusive holders combine.
+//
+// Requests live on the waiter's stack. A slot moves FREE -> FILLING ->
+// PENDING, then either back to FREE (withdrawn) or to TAKEN -> DONE -> FREE
+// (served). The state word carries a sequence number, so a combiner's CAS
+// cannot take a request that was withdrawn and replaced after it read the
+// tag. Threads share slots round-robin. A thread whose slot is busy just
+// spins on try_lock, as without combining. Operations, including upsert's
+// fn, may therefore run on another thread.
+//
+// Compile-time overrides:
+//   -DCHT_COMBINE_SLOTS=16   // request slots per lock
+
+#ifndef CHT_COMBINE_SLOTS
+#define CHT_COMBINE_SLOTS 16
+#endif
+
+class CombiningSlots {
+    enum : uint32_t { FREE = 0, FILLING = 1, PENDING = 2, TAKEN = 3, STATE_MASK = 3, SEQ = 4 };
+
+    struct Slot {
+        std::atomic<uint32_t> state{FREE};  // sequence in the high bits
+        std::atomic<uint64_t> tag{0};       // read by combiners before they claim
+        bool (*run)(void*) = nullptr;
+        void* op = nullptr;
+        bool result = false;
+        std::atomic<bool> done{false};
+    };
+
+    Slot slots[CHT_COMBINE_SLOTS];
+    std::atomic<uint32_t> pending{0};   // published and not yet withdrawn or taken
+
+    static unsigned thread_slot() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned id = next.fetch_add(1, std::memory_order_relaxed);
+        return id % CHT_COMBINE_SLOTS;
+    }
+
+    template<typename Op>
+    static bool invoke(void* op) { return (*static_cast<Op*>(op))(); }
+
+    // FREE -> FILLING for this thread's slot; nullptr if another thread has it.
+    Slot* claim() {
+        Slot& sl = slots[thread_slot()];
+        uint32_t w = sl.state.load(std::memory_order_relaxed);
+        if ((w & STATE_MASK) != FREE) return nullptr;
+        uint32_t seq = (w & ~STATE_MASK) + SEQ;
+        if (!sl.state.compare_exchange_strong(w, seq | FILLING, std::memory_order_acquire, std::memory_order_relaxed)) return nullptr;
+        return &sl;
+    }
+
+    // PENDING -> FREE; false if a combiner took the request.
+    bool withdraw(Slot& sl) {
+        uint32_t w = sl.state.load(std::memory_order_relaxed);
+        if ((w & STATE_MASK) != PENDING ||
+            !sl.state.compare_exchange_strong(w, (w & ~STATE_MASK) | FREE, std::memory_order_relaxed)) return false;
+        pending.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    static bool collect(Slot& sl) {
+        SpinBackoff backoff;
+        while (!sl.done.load(std::memory_order_acquire)) backoff.pause();
+        bool r = sl.result;
+        sl.state.store((sl.state.load(std::memory_order_relaxed) & ~STATE_MASK) | FREE, std::memory_order_release);
+        return r;
+    }
+
+public:
+    CombiningSlots() = default;
+    CombiningSlots(const CombiningSlots&) = delete;
+    CombiningSlots& operator=(const CombiningSlots&) = delete;
+
+    // Runs the published requests whose tag accept(tag) admits; the caller
+    // holds the lock those requests wait for, exclusively. Returns how many ran.
+    template<typename Accept>
+    size_t serve(Accept accept) {
+        size_t served = 0;
+        if (pending.load(std::memory_order_acquire) == 0) return 0;
+        for (Slot& sl : slots) {
+            uint32_t w = sl.state.load(std::memory_order_acquire);
+            if ((w & STATE_MASK) != PENDING || !accept(sl.tag.load(std::memory_order_relaxed))) continue;
+            if (!sl.state.compare_exchange_strong(w, (w & ~STATE_MASK) | TAKEN, std::memory_order_acquire, std::memory_order_relaxed)) continue;
+            pending.fetch_sub(1, std::memory_order_relaxed);
+            sl.result = sl.run(sl.op);
+            sl.done.store(true, std::memory_order_release);
+            ++served;
+        }
+        return served;
+    }
+
+    // Runs op() (returning bool) under the lock that try_lock() takes and
+    // unlock() releases; see above. tag identifies the request for accept.
+    // With combiner false (shared locks) a holder runs only its own op.
+    template<typename Op, typename TryLock, typename Unlock, typename Accept>
+    bool run(uint64_t tag, Op& op, TryLock try_lock, Unlock unlock, Accept accept, bool combiner = true) {
+        auto locked = [&](bool r) {
+            if (combiner) serve(accept);
+            unlock();
+            return r;
+        };
+        if (try_lock()) return locked(op());
+
+        Slot* sl = claim();
+        if (sl) {
+            sl->tag.store(tag, std::memory_order_relaxed);
+            sl->run = &invoke<Op>;
+            sl->op = &op;
+            sl->done.store(false, std::memory_order_relaxed);
+            pending.fetch_add(1, std::memory_order_relaxed);
+            sl->state.store((sl->state.load(std::memory_order_relaxed) & ~STATE_MASK) | PENDING, std::memory_order_release);
+        }
+        SpinBackoff backoff;
+        while (true) {
+            if (sl && sl->done.load(std::memory_order_acquire)) return collect(*sl);
+            if (try_lock()) {
+                if (!sl || withdraw(*sl)) return locked(op());
+                return locked(collect(*sl));   // served before we got the lock
+            }
+            backoff.pause();
+        }
+    }
+};
+
+#endif // COMBINING_H
@@ -8,16 +8,98 @@
 #include <stdexcept>
 #include <omp.h>
 #include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "pool_allocator.h"
+#include "sharded_counter.h"
 
-template<typename K>
-// implement a hash function for the key K is parameter can help to define different 
-struct Hash {
-    size_t operator()(const K& key) const {
-        return std::hash<K>{}(key);
-        // make key map to integer(hash value)
+// ---- Hashing ----
+// Every table takes its hash as a policy (default Hash<K>) and carves segment,
+// stripe and bucket indices out of separate bit ranges of the 64-bit result
+// with power-of-two masks, so the hash must be well mixed in every bit.
+// std::hash is the identity for integers on libstdc++, hence the finalizers.
+
+// murmur3 fmix64: full avalanche, a few cycles.
+inline uint64_t hash_mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// 64x64 -> 128 multiply folded to 64 bits (wyhash's mixing primitive).
+inline uint64_t hash_mum(uint64_t a, uint64_t b) {
+    __uint128_t r = static_cast<__uint128_t>(a) * b;
+    return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+}
+
+inline uint64_t hash_load64(const unsigned char* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+inline uint64_t hash_load32(const unsigned char* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+
+// wyhash-style byte hash: 16 bytes per multiply, no per-byte loop. Tails are
+// read with overlapping word loads, so short keys (words) cost one or two
+// loads and a couple of multiplies.
+inline uint64_t hash_bytes(const void* data, size_t len, uint64_t seed = 0) {
+    const uint64_t K0 = 0xa0761d6478bd642fULL, K1 = 0xe7037ed1a0b428dbULL;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ K0;
+    size_t n = len;
+    for (; n > 16; n -= 16, p += 16) {
+        h = hash_mum(hash_load64(p) ^ K1, hash_load64(p + 8) ^ h);
     }
+    uint64_t a = 0, b = 0;
+    if (n >= 8) {
+        a = hash_load64(p);
+        b = hash_load64(p + n - 8);
+    } else if (n >= 4) {
+        a = hash_load32(p);
+        b = hash_load32(p + n - 4);
+    } else if (n > 0) {
+        a = (uint64_t(p[0]) << 16) | (uint64_t(p[n >> 1]) << 8) | p[n - 1];
+    }
+    return hash_mum(K1 ^ len, hash_mum(a ^ K1, b ^ h));
+}
+
+template<typename K, typename Enable = void>
+struct Hash {
+    size_t operator()(const K& key) const { return hash_mix64(std::hash<K>{}(key)); }
+};
+
+template<typename K>
+struct Hash<K, typename std::enable_if<std::is_integral<K>::value || std::is_enum<K>::value>::type> {
+    size_t operator()(const K& key) const { return hash_mix64(static_cast<uint64_t>(key)); }
+};
+
+template<>
+struct Hash<std::string> {
+    size_t operator()(const std::string& key) const { return hash_bytes(key.data(), key.size()); }
+};
+
+// Unmixed std::hash (the old default), kept for comparisons.
+template<typename K>
+struct StdHash {
+    size_t operator()(const K& key) const { return std::hash<K>{}(key); }
 };
 
+inline size_t next_pow2(size_t x) {
+    if (x <= 1) return 1;
+    --x;
+    x |= x >> 1; x |= x >> 2; x |= x >> 4;
+    x |= x >> 8; x |= x >> 16;
+#if INTPTR_MAX == INT64_MAX
+    x |= x >> 32;
+#endif
+    return x + 1;
+}
+
 template<typename K, typename V>
 struct KeyValue {
     K key;
@@ -25,4 +107,273 @@ struct KeyValue {
     
     KeyValue(const K& k, const V& v) : key(k), value(v) {}
 };
+
+// ---- Read-modify-write operations ----
+// Every table offers these as a single pass under the key's lock:
+//   upsert(key, fn, init)        fn(value) if present, otherwise insert init
+//   insert_if_absent(key, value) insert without ever overwriting
+//   compute_if_present(key, fn)  fn(value) if present
+//   increment(key, delta)        upsert that adds delta (V needs +=)
+// All but compute_if_present return true if the key was inserted;
+// compute_if_present returns true if it was found. fn runs with the lock
+// held, so it must not call back into the table. LockFreeHashTable applies
+// fn in a CAS loop instead, where it may run more than once.
+
+// Chain lookup for the list-based tables; caller holds the bucket's lock.
+template<typename Chain, typename K>
+inline auto chain_find(Chain& chain, const K& key) -> decltype(&chain.front()) {
+    for (auto& kv : chain) {
+        if (kv.key == key) return &kv;
+    }
+    return nullptr;
+}
+
+// ---- Batched operations (insert_batch / search_batch) ----
+// Tables hash a whole batch up front, then visit keys grouped by the lock that
+// guards them so each lock is taken once per group. Target buckets are
+// prefetched BATCH_PREFETCH_DISTANCE keys ahead of the walk, which keeps a
+// bounded number of misses in flight however large the batch is.
+//   -DBATCH_PREFETCH_DISTANCE=8
+
+#ifndef BATCH_PREFETCH_DISTANCE
+#define BATCH_PREFETCH_DISTANCE 8
+#endif
+
+inline void prefetch_read(const void* p)  { __builtin_prefetch(p, 0, 3); }
+inline void prefetch_write(const void* p) { __builtin_prefetch(p, 1, 3); }
+
+// Per-thread scratch reused across batch calls (no allocation in steady state).
+struct BatchScratch {
+    std::vector<size_t> hashes;
+    std::vector<uint64_t> order;   // (group << 32) | key index
+
+    void prepare(size_t n) {
+        if (hashes.size() < n) { hashes.resize(n); order.resize(n); }
+    }
+    void add(size_t i, uint64_t group) { order[i] = (group << 32) | uint64_t(i); }
+    // Groups become contiguous; within a group keys keep their batch order,
+    // so a key repeated in one batch behaves as if applied sequentially.
+    // Sorting only pays off when groups repeat often; sparse batches are left
+    // in order and callers still coalesce adjacent keys of the same group.
+    void sort(size_t n, size_t group_count) {
+        if (n >= 4 * group_count) std::sort(order.begin(), order.begin() + n);
+    }
+    static uint32_t group_of(uint64_t o) { return uint32_t(o >> 32); }
+    static uint32_t index_of(uint64_t o) { return uint32_t(o); }
+};
+
+inline BatchScratch& batch_scratch() {
+    static thread_local BatchScratch scratch;
+    return scratch;
+}
+
+// ---- Bulk loading (bulk_build) ----
+// bulk_build(first, last, unique) loads a random-access range of std::pair or
+// KeyValue entries in two parallel passes instead of one locked insert each:
+// 1. bulk_partition counting-sorts (hash, position) records by the group the
+//    table assigns to each hash: segment, stripe or bucket range. Threads
+//    count their slice, prefix sums give every (thread, group) its own output
+//    range, then threads scatter their slices. The sort is stable, so a key
+//    repeated in the range keeps its last value, as with insert.
+// 2. The table hands whole groups to threads, so each group is filled by one
+//    thread without taking locks, and is sized for its final count first.
+// unique = true promises the keys are distinct and not yet in the table, so
+// entries are appended without scanning for duplicates. bulk_build must not
+// run concurrently with any other call on the same table. Returns the number
+// of keys added.
+//   -DCHT_BULK_GROUPS=1024   // bucket ranges for tables without segments
+
+#ifndef CHT_BULK_GROUPS
+#define CHT_BULK_GROUPS 1024
+#endif
+
+template<typename K, typename V> const K& bulk_key(const std::pair<K, V>& e) { return e.first; }
+template<typename K, typename V> const V& bulk_value(const std::pair<K, V>& e) { return e.second; }
+template<typename K, typename V> const K& bulk_key(const KeyValue<K, V>& e) { return e.key; }
+template<typename K, typename V> const V& bulk_value(const KeyValue<K, V>& e) { return e.value; }
+
+struct BulkEntry {
+    size_t hash;
+    size_t index;   // position in the source range
+};
+
+struct BulkPartition {
+    std::unique_ptr<BulkEntry[]> entries;   // grouped; left uninitialized until scattered
+    std::vector<size_t> start;              // group g is entries[start[g], start[g + 1])
+
+    size_t group_size(size_t g) const { return start[g + 1] - start[g]; }
+    const BulkEntry* begin(size_t g) const { return entries.get() + start[g]; }
+    const BulkEntry* end(size_t g) const { return entries.get() + start[g + 1]; }
+};
+
+// Small ranges are not worth waking a team for.
+inline int bulk_threads(size_t n) {
+    return int(std::max<size_t>(1, std::min<size_t>(size_t(omp_get_max_threads()), n / 4096)));
+}
+
+template<typename HashFn, typename It, typename GroupOf>
+void bulk_partition(It first, size_t n, size_t groups, GroupOf group_of, BulkPartition& out) {
+    const int threads = bulk_threads(n);
+    std::vector<size_t> offsets(size_t(threads) * groups, 0);   // [thread][group]
+    out.entries.reset(new BulkEntry[n ? n : 1]);
+    out.start.assign(groups + 1, 0);
+
+    #pragma omp parallel num_threads(threads)
+    {
+        const size_t t = size_t(omp_get_thread_num());
+        const size_t lo = n * t / threads, hi = n * (t + 1) / threads;
+        size_t* mine = &offsets[t * groups];
+        for (size_t i = lo; i < hi; ++i) mine[group_of(HashFn{}(bulk_key(first[i])))]++;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            size_t pos = 0;
+            for (size_t g = 0; g < groups; ++g) {
+                out.start[g] = pos;
+                for (int u = 0; u < threads; ++u) {
+                    size_t c = offsets[size_t(u) * groups + g];
+                    offsets[size_t(u) * groups + g] = pos;
+                    pos += c;
+                }
+            }
+            out.start[groups] = pos;
+        }
+        for (size_t i = lo; i < hi; ++i) {
+            size_t h = HashFn{}(bulk_key(first[i]));
+            out.entries[mine[group_of(h)]++] = BulkEntry{h, i};
+        }
+    }
+}
+
+// Appends one range entry to a list-based table's chain; false if the key
+// was already there (its value is replaced, as insert would).
+template<typename Chain, typename E>
+inline bool bulk_append(Chain& chain, const E& src, bool unique) {
+    if (!unique) {
+        if (auto* kv = chain_find(chain, bulk_key(src))) { kv->value = bulk_value(src); return false; }
+    }
+    chain.emplace_back(bulk_key(src), bulk_value(src));
+    return true;
+}
+
+// Groups for tables indexed by h & (bucket_count - 1): contiguous bucket ranges.
+struct BulkBucketGroups {
+    size_t mask;
+    unsigned shift = 0;
+    size_t count;
+
+    explicit BulkBucketGroups(size_t bucket_count) : mask(bucket_count - 1), count(bucket_count) {
+        while (count > CHT_BULK_GROUPS) { count >>= 1; ++shift; }
+    }
+    size_t operator()(size_t h) const { return (h & mask) >> shift; }
+    // Group g holds buckets [first_bucket(g), first_bucket(g + 1)).
+    size_t first_bucket(size_t g) const { return g << shift; }
+};
+
+// ---- Iteration (for_each / parallel_for_each / top_k) ----
+// The same groups, read back: every table splits itself into group_count()
+// disjoint parts (segments, stripes or bucket ranges) and
+// for_each_in_group(g, fn) calls fn(key, value) for each entry of part g.
+// for_each(fn) visits all groups in turn; parallel_for_each(fn, threads)
+// hands whole groups to OpenMP threads, so fn must be thread-safe. Like
+// chain_length_histogram, these read while no writer is active, except on
+// the lock-free, split-ordered and snapshot tables, whose walks are safe
+// alongside writers (weakly consistent: a key present for the whole walk is
+// seen once, keys added or removed meanwhile may or may not be).
+
+// K, V and HashFn of a table type; every table is Table<K, V, HashFn, ...>.
+template<typename HT> struct TableTypes;
+template<template<typename...> class T, typename K, typename V, typename H, typename... Rest>
+struct TableTypes<T<K, V, H, Rest...>> {
+    using key_type = K;
+    using value_type = V;
+    using hasher = H;
+};
+
+// The k entries with the largest values, largest first (ties: smaller key
+// first). Each thread keeps a k-entry heap over the groups it visits and the
+// heaps are merged at the end: one parallel pass, no copy of the table.
+template<typename HT>
+std::vector<std::pair<typename TableTypes<HT>::key_type, typename TableTypes<HT>::value_type>>
+top_k(const HT& ht, size_t k, int threads = omp_get_max_threads()) {
+    using K = typename TableTypes<HT>::key_type;
+    using V = typename TableTypes<HT>::value_type;
+    using E = std::pair<K, V>;
+    auto better = [](const E& a, const E& b) {
+        return b.second < a.second || (!(a.second < b.second) && a.first < b.first);
+    };
+    if (k == 0) return {};
+    std::vector<std::vector<E>> heaps(size_t(std::max(threads, 1)));   // front = worst kept entry
+    #pragma omp parallel num_threads(threads)
+    {
+        std::vector<E>& heap = heaps[size_t(omp_get_thread_num())];
+        #pragma omp for schedule(dynamic, 1)
+        for (size_t g = 0; g < ht.group_count(); ++g) {
+            ht.for_each_in_group(g, [&](const K& key, const V& value) {
+                if (heap.size() < k) {
+                    heap.emplace_back(key, value);
+                    std::push_heap(heap.begin(), heap.end(), better);
+                    return;
+                }
+                const E& worst = heap.front();
+                if (!(worst.second < value) && (value < worst.second || !(key < worst.first))) return;
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = E(key, value);
+                std::push_heap(heap.begin(), heap.end(), better);
+            });
+        }
+    }
+    std::vector<E> all;
+    for (auto& h : heaps) all.insert(all.end(), std::make_move_iterator(h.begin()), std::make_move_iterator(h.end()));
+    size_t keep = std::min(k, all.size());
+    std::partial_sort(all.begin(), all.begin() + keep, all.end(), better);
+    all.resize(keep);
+    return all;
+}
+
+// ---- Memory accounting (memory_usage / shrink_to_fit) ----
+// memory_usage() splits the bytes a table holds by what they are for. Sizes
+// come from sizeof, so they are exact for the table's own structures; a list
+// node counts as two links plus its entry. Not counted: allocator headers,
+// pool slabs not handed out yet, heap owned by keys or values themselves
+// (long strings) and nodes still waiting for epoch reclamation. Like size(),
+// read it while no writer is active.
+//
+// shrink_to_fit() hands memory back after mass deletes on the list-chained
+// and flat tables: packed chains drop their growth slack, and tables that
+// grow (segment, AGH, flat, striped flat) rehash down to the fewest buckets
+// that hold their entries, never below what they were built with. It takes
+// one lock at a time, so other threads keep working meanwhile. Returns the
+// bytes handed back to the allocators, which is not memory returned to the
+// OS: malloc may keep it, and list nodes (which go back to Alloc on every
+// remove already) stay on the PoolAllocator free lists, whose slabs are
+// never released (pool_allocator.h).
+struct MemoryUsage {
+    size_t buckets = 0;   // bucket and slot arrays, entries stored in place
+    size_t nodes = 0;     // entries stored outside them: list nodes, chain blocks
+    size_t locks = 0;     // lock words
+    size_t padding = 0;   // alignment filler around buckets, locks and segments
+    size_t other = 0;     // table object, directories, segment headers
+    size_t entries = 0;
+
+    size_t total() const { return buckets + nodes + locks + padding + other; }
+    double bytes_per_entry() const { return entries ? double(total()) / double(entries) : 0.0; }
+
+    MemoryUsage& operator+=(const MemoryUsage& o) {
+        buckets += o.buckets;
+        nodes += o.nodes;
+        locks += o.locks;
+        padding += o.padding;
+        other += o.other;
+        entries += o.entries;
+        return *this;
+    }
+};
+
+// The table object itself: other, except its ElementCounter's slot padding.
+inline void usage_add_object(MemoryUsage& m, size_t object_bytes) {
+    m.padding += ElementCounter::padding_bytes();
+    m.other += object_bytes - ElementCounter::padding_bytes();
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,223 @@
+#ifndef CONCURRENT_SET_H
+#define CONCURRENT_SET_H
+
+#include "common.h"
+#include "locks.h"
+#include <limits>
+#include <memory>
+
+// Concurrent set of integer keys, for membership-only workloads such as
+// deduplication. Keys live in open-addressed arrays of atomics (linear
+// probing, no per-key allocation, no value), so a key costs sizeof(K) /
+// load factor bytes. Inserters claim empty slots with a CAS while holding
+// their shard's lock shared; only growing a shard takes it exclusively.
+// One key value is reserved as the empty marker and tracked in a flag.
+//
+// Compile-time overrides:
+//   -DSET_SHARDS=64           // independent shards (power of two)
+//   -DSET_MAX_LOAD=0.8        // a shard doubles beyond this fill ratio
+
+#ifndef SET_SHARDS
+#define SET_SHARDS 64
+#endif
+
+#ifndef SET_MAX_LOAD
+#define SET_MAX_LOAD 0.8
+#endif
+
+template<typename K, typename HashFn = Hash<K>>
+class ConcurrentSet {
+    static_assert(std::is_integral<K>::value, "ConcurrentSet stores integer keys");
+    static const size_t NUM_SHARDS = SET_SHARDS;
+    static_assert((NUM_SHARDS & (NUM_SHARDS - 1)) == 0, "SET_SHARDS must be a power of two");
+    static constexpr K EMPTY = std::numeric_limits<K>::max();
+    static constexpr size_t MIN_SHARD_SLOTS = 16;
+
+    static constexpr unsigned log2_shards() {
+        unsigned s = 0;
+        while ((size_t(1) << s) < NUM_SHARDS) ++s;
+        return s;
+    }
+
+    struct alignas(64) Shard {
+        RWSpinLock lock;                       // shared: insert/contains, exclusive: grow
+        std::atomic<size_t> count{0};
+        std::unique_ptr<std::atomic<K>[]> slots;
+        size_t capacity;                       // power of two
+
+        explicit Shard(size_t cap) : capacity(cap) { slots = make_slots(cap); }
+        Shard(const Shard&) = delete;
+        Shard& operator=(const Shard&) = delete;
+    };
+
+    std::vector<Shard*> shards;
+    std::atomic<bool> has_empty_key{false};
+
+    static std::unique_ptr<std::atomic<K>[]> make_slots(size_t cap) {
+        std::unique_ptr<std::atomic<K>[]> s(new std::atomic<K>[cap]);
+        for (size_t i = 0; i < cap; ++i) s[i].store(EMPTY, std::memory_order_relaxed);
+        return s;
+    }
+
+    // Shard from the top hash bits, slot from the low ones.
+    static size_t shard_index(size_t h) {
+        return log2_shards() ? h >> (sizeof(size_t) * 8 - log2_shards()) : 0;
+    }
+
+    // Double s unless another thread already grew it past old_cap.
+    void grow(Shard* s, size_t old_cap) {
+        s->lock.lock();
+        if (s->capacity == old_cap) {
+            size_t cap = old_cap * 2;
+            auto grown = make_slots(cap);
+            for (size_t i = 0; i < old_cap; ++i) {
+                K k = s->slots[i].load(std::memory_order_relaxed);
+                if (k == EMPTY) continue;
+                size_t pos = HashFn{}(k) & (cap - 1);
+                while (grown[pos].load(std::memory_order_relaxed) != EMPTY) pos = (pos + 1) & (cap - 1);
+                grown[pos].store(k, std::memory_order_relaxed);
+            }
+            s->slots.swap(grown);
+            s->capacity = cap;
+        }
+        s->lock.unlock();
+    }
+
+public:
+    explicit ConcurrentSet(size_t expected_keys = 1024) {
+        size_t per_shard = next_pow2(size_t(expected_keys / SET_MAX_LOAD) / NUM_SHARDS + 1);
+        if (per_shard < MIN_SHARD_SLOTS) per_shard = MIN_SHARD_SLOTS;
+        shards.reserve(NUM_SHARDS);
+        for (size_t i = 0; i < NUM_SHARDS; ++i) shards.push_back(new Shard(per_shard));
+    }
+
+    ~ConcurrentSet() {
+        for (auto s : shards) delete s;
+    }
+
+    ConcurrentSet(const ConcurrentSet&) = delete;
+    ConcurrentSet& operator=(const ConcurrentSet&) = delete;
+
+    // Returns true if key was not yet in the set (exactly one caller wins).
+    bool insert_unique(K key) {
+        if (key == EMPTY) return !has_empty_key.exchange(true, std::memory_order_acq_rel);
+
+        size_t h = HashFn{}(key);
+        Shard* s = shards[shard_index(h)];
+        while (true) {
+            s->lock.lock_shared();
+            size_t cap = s->capacity;
+            size_t pos = h & (cap - 1);
+            for (size_t probes = 0; probes < cap; ++probes, pos = (pos + 1) & (cap - 1)) {
+                K cur = s->slots[pos].load(std::memory_order_acquire);
+                if (cur == EMPTY &&
+                    s->slots[pos].compare_exchange_strong(cur, key, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    size_t n = s->count.fetch_add(1, std::memory_order_relaxed) + 1;
+                    s->lock.unlock_shared();
+                    if (n > cap * SET_MAX_LOAD) grow(s, cap);
+                    return true;
+                }
+                if (cur == key) {  // present, or claimed by a racing inserter of the same key
+                    s->lock.unlock_shared();
+                    return false;
+                }
+            }
+            // Filled up by racing inserts before anyone could grow it.
+            s->lock.unlock_shared();
+            grow(s, cap);
+        }
+    }
+
+    bool contains(K key) const {
+        if (key == EMPTY) return has_empty_key.load(std::memory_order_acquire);
+
+        size_t h = HashFn{}(key);
+        Shard* s = shards[shard_index(h)];
+        s->lock.lock_shared();
+        size_t cap = s->capacity;
+        size_t pos = h & (cap - 1);
+        bool found = false;
+        for (size_t probes = 0; probes < cap; ++probes, pos = (pos + 1) & (cap - 1)) {
+            K cur = s->slots[pos].load(std::memory_order_acquire);
+            if (cur == key) { found = true; break; }
+            if (cur == EMPTY) break;
+        }
+        s->lock.unlock_shared();
+        return found;
+    }
+
+    // Insert keys[0..n) using num_threads threads (0 = OpenMP default);
+    // returns how many of them were new.
+    size_t insert_all(const K* keys, size_t n, int num_threads = 0) {
+        if (num_threads <= 0) num_threads = omp_get_max_threads();
+        size_t added = 0;
+        #pragma omp parallel for num_threads(num_threads) schedule(static, 4096) reduction(+:added)
+        for (size_t i = 0; i < n; ++i) {
+            added += insert_unique(keys[i]);
+        }
+        return added;
+    }
+
+    size_t size() const {
+        size_t n = has_empty_key.load(std::memory_order_relaxed) ? 1 : 0;
+        for (auto s : shards) n += s->count.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // Iteration as for the tables (see common.h), but fn(key): one group per
+    // shard, the reserved empty key reported with group 0. Read while no
+    // insert is running.
+    static constexpr size_t group_count() { return NUM_SHARDS; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        if (g == 0 && has_empty_key.load(std::memory_order_relaxed)) fn(EMPTY);
+        const Shard* s = shards[g];
+        for (size_t i = 0; i < s->capacity; ++i) {
+            K k = s->slots[i].load(std::memory_order_relaxed);
+            if (k != EMPTY) fn(k);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Total slots across shards (each sizeof(K) bytes).
+    size_t slot_count() const {
+        size_t n = 0;
+        for (auto s : shards) n += s->capacity;
+        return n;
+    }
+
+    // Memory accounting (see common.h); slots are the buckets. The set has
+    // no remove, so there is nothing to shrink.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        for (const Shard* s : shards) {
+            m.buckets += s->capacity * sizeof(std::atomic<K>);
+            m.locks += sizeof(RWSpinLock);
+            const size_t header = sizeof(s->count) + sizeof(s->slots) + sizeof(s->capacity);
+            m.padding += sizeof(Shard) - header - sizeof(RWSpinLock);
+            m.other += header;
+        }
+        m.other += sizeof(*this) + shards.capacity() * sizeof(Shard*);
+        m.entries = size();
+        return m;
+    }
+
+    std::string getName() const { return "Concurrent-Set"; }
+};
+
+// Number of distinct values in keys[0..n), counted in parallel.
+template<typename K>
+size_t count_distinct(const K* keys, size_t n, int num_threads = 0) {
+    ConcurrentSet<K> set(n / 8);
+    return set.insert_all(keys, n, num_threads);
+}
+
+#endif // CONCURRENT_SET_H
@@ -0,0 +1,449 @@
+#ifndef CUCKOO_HASH_TABLE_H
+#define CUCKOO_HASH_TABLE_H
+
+#include "common.h"
+#include "locks.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Concurrent cuckoo hash table in the style of libcuckoo.
+//
+// Every key has two candidate buckets of CUCKOO_SLOTS slots. Each slot keeps
+// a 1-byte tag (high hash bits, 0 = empty) beside its key and value, so one
+// SIMD compare of a bucket's tags finds the slots worth a key compare. A
+// lookup reads at most two buckets, however full the table is. The second
+// bucket is derived from the first and the tag (partial-key cuckoo hashing),
+// so entries can be moved without rehashing their keys.
+//
+// Buckets are guarded by a fixed set of lock stripes (bucket & (stripes - 1)).
+// When both of a key's buckets are full, the insert searches breadth-first,
+// reading one bucket at a time under its stripe, for a short chain of moves
+// that ends in a free slot. It then applies the moves back to front, each
+// one under the two stripes it touches and only if the entry is still where
+// the search saw it. A reader holding both of a key's stripes therefore
+// always finds it in one of its buckets. If no path is found, or the fill is
+// already above CUCKOO_MAX_LOAD, the table doubles under all stripes.
+//
+// Compile-time overrides:
+//   -DCUCKOO_SLOTS=4             // slots per bucket, 4 or 8
+//   -DCUCKOO_LOCK_STRIPES=1024   // power of two
+//   -DCUCKOO_MAX_BFS=256         // buckets one path search may visit
+//   -DCUCKOO_MAX_LOAD=0.95       // grow instead of searching a path beyond this fill
+
+#ifndef CUCKOO_SLOTS
+#define CUCKOO_SLOTS 4
+#endif
+
+#ifndef CUCKOO_LOCK_STRIPES
+#define CUCKOO_LOCK_STRIPES 1024
+#endif
+
+#ifndef CUCKOO_MAX_BFS
+#define CUCKOO_MAX_BFS 256
+#endif
+
+#ifndef CUCKOO_MAX_LOAD
+#define CUCKOO_MAX_LOAD 0.95
+#endif
+
+template<typename K, typename V, typename HashFn = Hash<K>>
+class CuckooHashTable {
+private:
+    static constexpr size_t SLOTS = CUCKOO_SLOTS;
+    static_assert(SLOTS == 4 || SLOTS == 8, "CUCKOO_SLOTS must be 4 or 8");
+    static constexpr size_t NUM_STRIPES = CUCKOO_LOCK_STRIPES;
+    static_assert((NUM_STRIPES & (NUM_STRIPES - 1)) == 0, "CUCKOO_LOCK_STRIPES must be a power of two");
+    static constexpr unsigned MAX_PATH = 5;          // moves per displacement chain
+    static constexpr unsigned REHASH_WALK = 500;     // eviction steps per key while growing
+
+    struct alignas(64) Bucket {
+        uint8_t tags[SLOTS];   // 0 = empty
+        K keys[SLOTS];
+        V values[SLOTS];
+        Bucket() : tags{}, keys{}, values{} {}
+    };
+
+    struct PaddedLock {
+        alignas(64) RWSpinLock l;
+    };
+
+    // One step of a path search: bucket, and which slot of the parent leads here.
+    struct PathNode {
+        size_t bucket;
+        int parent;
+        int slot;
+        unsigned depth;
+    };
+
+    std::vector<Bucket> buckets;
+    std::atomic<size_t> mask;   // buckets.size() - 1; changes only with every stripe held
+    // Unlocked copy of buckets.data(), used only to aim the prefetches in
+    // lock_key. grow stores it before mask, so a reader's index is always in
+    // range; a stale pointer just prefetches a useless line.
+    std::atomic<const Bucket*> hint_data;
+    std::unique_ptr<PaddedLock[]> stripes;
+    ElementCounter element_count;
+
+    static uint8_t tag_of(size_t h) {
+        uint8_t t = uint8_t(h >> (sizeof(size_t) * 8 - 8));
+        return t ? t : 1;
+    }
+    // Symmetric: alt_index(alt_index(i, t, m), t, m) == i.
+    static size_t alt_index(size_t i, uint8_t tag, size_t m) {
+        return (i ^ (size_t(tag) * size_t(0xc6a4a7935bd1e995ULL))) & m;
+    }
+    static size_t stripe_of(size_t bucket) { return bucket & (NUM_STRIPES - 1); }
+
+    // Bitmask of the slots of b whose tag equals tag (tag 0 finds the empty ones).
+    static unsigned match(const Bucket& b, uint8_t tag) {
+#if defined(__SSE2__)
+        __m128i t;
+        if (SLOTS == 8) {
+            t = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b.tags));
+        } else {
+            int32_t w;
+            std::memcpy(&w, b.tags, 4);
+            t = _mm_cvtsi32_si128(w);
+        }
+        return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(t, _mm_set1_epi8(char(tag))))) & ((1u << SLOTS) - 1);
+#else
+        unsigned m = 0;
+        for (size_t s = 0; s < SLOTS; ++s) m |= unsigned(b.tags[s] == tag) << s;
+        return m;
+#endif
+    }
+
+    static int find_in(const Bucket& b, const K& key, uint8_t tag) {
+        for (unsigned m = match(b, tag); m; m &= m - 1) {
+            int s = __builtin_ctz(m);
+            if (b.keys[s] == key) return s;
+        }
+        return -1;
+    }
+
+    static int free_slot(const Bucket& b) {
+        unsigned m = match(b, 0);
+        return m ? __builtin_ctz(m) : -1;
+    }
+
+    static void store(Bucket& b, int s, uint8_t tag, const K& key, const V& value) {
+        b.tags[s] = tag;
+        b.keys[s] = key;
+        b.values[s] = value;
+    }
+
+    static void clear(Bucket& b, int s) {
+        b.tags[s] = 0;
+        b.keys[s] = K();
+        b.values[s] = V();
+    }
+
+    void lock_stripe(size_t s, bool shared) const {
+        if (shared) stripes[s].l.lock_shared(); else stripes[s].l.lock();
+    }
+    void unlock_stripe(size_t s, bool shared) const {
+        if (shared) stripes[s].l.unlock_shared(); else stripes[s].l.unlock();
+    }
+
+    // Locks the stripes of buckets a and b (lower stripe first). Fails, holding
+    // nothing, if the table was resized away from mask m in the meantime.
+    bool lock_two(size_t a, size_t b, size_t m, bool shared) const {
+        size_t s1 = std::min(stripe_of(a), stripe_of(b)), s2 = std::max(stripe_of(a), stripe_of(b));
+        lock_stripe(s1, shared);
+        if (s2 != s1) lock_stripe(s2, shared);
+        if (mask.load(std::memory_order_relaxed) == m) return true;
+        unlock_two(a, b, shared);
+        return false;
+    }
+    void unlock_two(size_t a, size_t b, bool shared) const {
+        size_t s1 = std::min(stripe_of(a), stripe_of(b)), s2 = std::max(stripe_of(a), stripe_of(b));
+        if (s2 != s1) unlock_stripe(s2, shared);
+        unlock_stripe(s1, shared);
+    }
+
+    // Locks both buckets of hash h; b1/b2 stay valid until unlock_two(b1, b2).
+    size_t lock_key(size_t h, uint8_t tag, size_t& b1, size_t& b2, bool shared) const {
+        while (true) {
+            size_t m = mask.load(std::memory_order_acquire);
+            b1 = h & m;
+            b2 = alt_index(b1, tag, m);
+            const Bucket* base = hint_data.load(std::memory_order_relaxed);
+            prefetch_read(base + b1);   // both misses overlap with taking the locks
+            prefetch_read(base + b2);
+            if (lock_two(b1, b2, m, shared)) return m;
+        }
+    }
+
+    // Frees a slot in b1 or b2 by moving entries along a cuckoo path. Returns
+    // false if no path exists within the search limits; true means "retry"
+    // (room was made, or the table changed under the search).
+    bool make_room(size_t b1, size_t b2, size_t m) {
+        static thread_local std::vector<PathNode> q;
+        q.clear();
+        q.push_back({b1, -1, -1, 0});
+        q.push_back({b2, -1, -1, 0});
+        for (size_t i = 0; i < q.size(); ++i) {
+            size_t x = q[i].bucket;
+            uint8_t tags[SLOTS];
+            lock_stripe(stripe_of(x), true);
+            bool resized = mask.load(std::memory_order_relaxed) != m;
+            if (!resized) std::memcpy(tags, buckets[x].tags, SLOTS);
+            unlock_stripe(stripe_of(x), true);
+            if (resized) return true;
+
+            for (size_t s = 0; s < SLOTS; ++s) {
+                if (tags[s] == 0) return q[i].depth == 0 || apply_path(q, i, m);
+            }
+            if (q[i].depth == MAX_PATH) continue;
+            for (size_t s = 0; s < SLOTS && q.size() < CUCKOO_MAX_BFS; ++s) {
+                q.push_back({alt_index(x, tags[s], m), int(i), int(s), q[i].depth + 1});
+            }
+        }
+        return false;
+    }
+
+    // Moves the entries along the path ending at q[end], last hop first.
+    bool apply_path(const std::vector<PathNode>& q, size_t end, size_t m) {
+        for (size_t j = end; q[j].parent >= 0; j = size_t(q[j].parent)) {
+            size_t src = q[size_t(q[j].parent)].bucket, dst = q[j].bucket;
+            int slot = q[j].slot;
+            if (!lock_two(src, dst, m, false)) return true;
+            Bucket& from = buckets[src];
+            Bucket& to = buckets[dst];
+            uint8_t tag = from.tags[slot];
+            int f = free_slot(to);
+            bool still_valid = tag != 0 && alt_index(src, tag, m) == dst && f >= 0;
+            if (still_valid) {
+                store(to, f, tag, from.keys[slot], from.values[slot]);
+                clear(from, slot);
+            }
+            unlock_two(src, dst, false);
+            if (!still_valid) return true;   // moved by someone else; search again
+        }
+        return true;
+    }
+
+    // Places an entry into a table nobody else can see (used while growing).
+    static bool place_private(std::vector<Bucket>& tbl, size_t m, uint8_t tag, K key, V value, size_t h) {
+        size_t i = h & m;
+        for (unsigned step = 0; step < REHASH_WALK; ++step) {
+            for (size_t b : {i, alt_index(i, tag, m)}) {
+                int s = free_slot(tbl[b]);
+                if (s >= 0) { store(tbl[b], s, tag, key, value); return true; }
+            }
+            // Evict from the other bucket and carry the evicted entry on.
+            i = alt_index(i, tag, m);
+            int s = int(step % SLOTS);
+            std::swap(tag, tbl[i].tags[s]);
+            std::swap(key, tbl[i].keys[s]);
+            std::swap(value, tbl[i].values[s]);
+        }
+        return false;
+    }
+
+    void grow(size_t old_mask) {
+        for (size_t s = 0; s < NUM_STRIPES; ++s) stripes[s].l.lock();
+        if (mask.load(std::memory_order_relaxed) == old_mask) {   // nobody beat us to it
+            for (size_t n = buckets.size() * 2; ; n *= 2) {
+                std::vector<Bucket> grown(n);
+                bool ok = true;
+                for (const Bucket& b : buckets) {
+                    for (size_t s = 0; s < SLOTS && ok; ++s) {
+                        if (b.tags[s]) ok = place_private(grown, n - 1, b.tags[s], b.keys[s], b.values[s], HashFn{}(b.keys[s]));
+                    }
+                    if (!ok) break;
+                }
+                if (ok) {
+                    buckets.swap(grown);
+                    hint_data.store(buckets.data(), std::memory_order_release);
+                    mask.store(n - 1, std::memory_order_release);
+                    break;
+                }
+            }
+        }
+        for (size_t s = NUM_STRIPES; s-- > 0; ) stripes[s].l.unlock();
+    }
+
+    // Applies fn to key's value if present, otherwise stores init; true if inserted.
+    template<typename F>
+    bool upsert_impl(const K& key, F& fn, const V& init) {
+        size_t h = HashFn{}(key);
+        uint8_t tag = tag_of(h);
+        while (true) {
+            size_t b1, b2;
+            size_t m = lock_key(h, tag, b1, b2, false);
+            Bucket& a = buckets[b1];
+            Bucket& b = buckets[b2];
+            Bucket* hit = nullptr;
+            int s;
+            if ((s = find_in(a, key, tag)) >= 0) hit = &a;
+            else if ((s = find_in(b, key, tag)) >= 0) hit = &b;
+            if (hit) {
+                fn(hit->values[s]);
+                unlock_two(b1, b2, false);
+                return false;
+            }
+            Bucket* target = (s = free_slot(a)) >= 0 ? &a : ((s = free_slot(b)) >= 0 ? &b : nullptr);
+            if (target) {
+                store(*target, s, tag, key, init);
+                element_count.add(1);
+                unlock_two(b1, b2, false);
+                return true;
+            }
+            unlock_two(b1, b2, false);
+            bool full = element_count.load() >= (m + 1) * SLOTS * CUCKOO_MAX_LOAD;
+            if (full || !make_room(b1, b2, m)) grow(m);
+        }
+    }
+
+public:
+    // bucket_count is the number of entries to size for (rounded up to whole buckets).
+    explicit CuckooHashTable(size_t bucket_count = 1024)
+        : buckets(next_pow2((bucket_count + SLOTS - 1) / SLOTS)),
+          mask(buckets.size() - 1),
+          hint_data(buckets.data()),
+          stripes(new PaddedLock[NUM_STRIPES]),
+          element_count(0) {}
+
+    CuckooHashTable(const CuckooHashTable&) = delete;
+    CuckooHashTable& operator=(const CuckooHashTable&) = delete;
+
+    bool insert(const K& key, const V& value) {
+        auto assign = [&](V& v) { v = value; };
+        return upsert_impl(key, assign, value);
+    }
+
+    // Read-modify-write operations (see common.h), under both bucket stripes.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) { return upsert_impl(key, fn, init); }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        size_t h = HashFn{}(key);
+        uint8_t tag = tag_of(h);
+        size_t b1, b2;
+        lock_key(h, tag, b1, b2, false);
+        int s = find_in(buckets[b1], key, tag);
+        size_t b = b1;
+        if (s < 0) { s = find_in(buckets[b2], key, tag); b = b2; }
+        if (s >= 0) fn(buckets[b].values[s]);
+        unlock_two(b1, b2, false);
+        return s >= 0;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
+    bool search(const K& key, V& value) const {
+        size_t h = HashFn{}(key);
+        uint8_t tag = tag_of(h);
+        size_t b1, b2;
+        lock_key(h, tag, b1, b2, true);
+        int s = find_in(buckets[b1], key, tag);
+        size_t b = b1;
+        if (s < 0) { s = find_in(buckets[b2], key, tag); b = b2; }
+        if (s >= 0) value = buckets[b].values[s];
+        unlock_two(b1, b2, true);
+        return s >= 0;
+    }
+
+    bool remove(const K& key) {
+        size_t h = HashFn{}(key);
+        uint8_t tag = tag_of(h);
+        size_t b1, b2;
+        lock_key(h, tag, b1, b2, false);
+        int s = find_in(buckets[b1], key, tag);
+        size_t b = b1;
+        if (s < 0) { s = find_in(buckets[b2], key, tag); b = b2; }
+        if (s >= 0) {
+            clear(buckets[b], s);
+            element_count.sub(1);
+        }
+        unlock_two(b1, b2, false);
+        return s >= 0;
+    }
+
+    // Batched operations: one key at a time (every key locks its own pair of stripes).
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        size_t added = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bool is_new = insert(keys[i], values[i]);
+            if (inserted) inserted[i] = is_new;
+            added += is_new;
+        }
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        size_t hits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            found[i] = search(keys[i], values[i]);
+            hits += found[i];
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h). A key may land in either of two buckets, so
+    // the range cannot be split into lock-free groups: the table is grown once
+    // for the final count, then threads insert in parallel under the stripe
+    // locks without further growth, so a key repeated in the range keeps one
+    // of its values, not necessarily the last. unique saves nothing here.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        (void)unique;
+        size_t n = size_t(last - first);
+        size_t want = element_count.load() + n;
+        while (want > slot_count() * CUCKOO_MAX_LOAD) grow(mask.load(std::memory_order_relaxed));
+        size_t added = 0;
+        #pragma omp parallel for reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t i = 0; i < n; ++i) added += insert(bulk_key(first[i]), bulk_value(first[i]));
+        return added;
+    }
+
+    // Bucket ranges as groups (see common.h); read while no writer is active.
+    size_t group_count() const { return BulkBucketGroups(buckets.size()).count; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        BulkBucketGroups groups(buckets.size());
+        for (size_t b = groups.first_bucket(g); b < groups.first_bucket(g + 1); ++b) {
+            const Bucket& bk = buckets[b];
+            for (size_t s = 0; s < SLOTS; ++s) {
+                if (bk.tags[s]) fn(bk.keys[s], bk.values[s]);
+            }
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Memory accounting (see common.h). There is no shrink_to_fit: moving
+    // every entry into half the buckets can fail where doubling cannot.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        const size_t slot_bytes = SLOTS * (sizeof(uint8_t) + sizeof(K) + sizeof(V));
+        m.buckets = buckets.capacity() * slot_bytes;
+        m.padding = buckets.capacity() * (sizeof(Bucket) - slot_bytes);
+        m.locks = NUM_STRIPES * sizeof(RWSpinLock);
+        m.padding += NUM_STRIPES * (sizeof(PaddedLock) - sizeof(RWSpinLock));
+        usage_add_object(m, sizeof(*this));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    size_t size() const { return element_count.load(); }
+    size_t slot_count() const { return (mask.load(std::memory_order_relaxed) + 1) * SLOTS; }
+    double load_factor() const { return double(size()) / double(slot_count()); }
+    std::string getName() const { return "Cuckoo"; }
+};
+
+#endif // CUCKOO_HASH_TABLE_H
@@ -21,14 +21,17 @@ double deduplicateWithLibrary(const string& filename, int num_threads, size_t& t
     
     double start_time = omp_get_wtime();
     
+    // Keys go in batches: one lock acquisition per touched bucket per batch,
+    // with the buckets prefetched (insert returns false for existing keys)
+    const size_t BATCH = 256;
     #pragma omp parallel num_threads(num_threads)
     {
-        #pragma omp for
-        for (size_t i = 0; i < data.size(); ++i) {
-            bool exists;
-            if (!seen.search(data[i], exists)) {
-                seen.insert(data[i], true);
-            }
+        bool flags[BATCH];
+        std::fill(flags, flags + BATCH, true);
+        #pragma omp for schedule(static)
+        for (size_t start = 0; start < data.size(); start += BATCH) {
+            size_t n = std::min(BATCH, data.size() - start);
+            seen.insert_batch(&data[start], flags, n);
         }
     }
     
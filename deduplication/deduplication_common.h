@@ -6,42 +6,254 @@
 #include <sstream>
 #include <string>
 #include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <omp.h>
+#include "../mapped_file.h"
 
-// Read integer data from file
-inline std::vector<int> readIntegersFromFile(const std::string& filename) {
-    std::vector<int> data;
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        return data;
+// ---- Binary input format ----
+// A 24-byte header followed by `count` raw little-endian integers of `width`
+// bytes (4 or 8). The header keeps the payload 8-byte aligned, so a mapped
+// file is used in place with no parse step.
+struct DedupBinaryHeader {
+    char magic[8];       // DEDUP_MAGIC
+    uint32_t width;      // bytes per integer: 4 or 8
+    uint32_t reserved;
+    uint64_t count;
+};
+static_assert(sizeof(DedupBinaryHeader) == 24, "header layout is part of the file format");
+
+const char DEDUP_MAGIC[8] = {'C', 'H', 'T', 'D', 'E', 'D', 'U', 'P'};
+
+inline bool hostIsLittleEndian() {
+    const uint16_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+inline bool hasDedupMagic(const char* data, size_t size) {
+    return size >= sizeof(DedupBinaryHeader) && std::memcmp(data, DEDUP_MAGIC, sizeof(DEDUP_MAGIC)) == 0;
+}
+
+// Writes a binary file; the header's count is filled in by close().
+class DedupBinaryWriter {
+    std::ofstream out;
+    uint32_t width;
+    uint64_t count = 0;
+    std::vector<char> buffer;
+
+    void flushBuffer() {
+        out.write(buffer.data(), buffer.size());
+        buffer.clear();
     }
-    
-    int value;
-    while (file >> value) {
-        data.push_back(value);
+
+public:
+    DedupBinaryWriter(const std::string& filename, uint32_t bytes_per_value)
+        : out(filename, std::ios::binary), width(bytes_per_value) {
+        DedupBinaryHeader h = {};
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));   // placeholder
+        buffer.reserve(1 << 16);
+    }
+    ~DedupBinaryWriter() { close(); }
+
+    bool is_open() const { return out.is_open(); }
+
+    void write(int64_t value) {
+        uint64_t bits = static_cast<uint64_t>(value);
+        for (uint32_t i = 0; i < width; i++) buffer.push_back(char(bits >> (8 * i)));
+        count++;
+        if (buffer.size() >= (1 << 16)) flushBuffer();
+    }
+
+    void close() {
+        if (!out.is_open()) return;
+        flushBuffer();
+        DedupBinaryHeader h = {};
+        std::memcpy(h.magic, DEDUP_MAGIC, sizeof(DEDUP_MAGIC));
+        h.width = width;
+        h.count = count;
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.close();
+    }
+};
+
+// ---- Text input ----
+// Whitespace-separated decimal integers, parsed in parallel: the file is cut
+// into 1 MiB chunks, a number belongs to the chunk it starts in, and each
+// chunk's values are appended in file order at the end.
+
+const size_t DEDUP_PARSE_CHUNK = size_t(1) << 20;
+
+inline bool isDedupSpace(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+template<typename T>
+inline void parseIntegerRange(const char* d, size_t size, size_t begin, size_t end, std::vector<T>& out) {
+    size_t i = begin;
+    if (i > 0 && !isDedupSpace(d[i - 1])) {
+        while (i < size && !isDedupSpace(d[i])) i++;   // belongs to the previous chunk
+    }
+    while (i < end) {
+        while (i < end && isDedupSpace(d[i])) i++;
+        if (i >= end) break;
+        bool negative = (d[i] == '-');
+        if (d[i] == '-' || d[i] == '+') i++;
+        uint64_t v = 0;
+        bool digits = false;
+        while (i < size && d[i] >= '0' && d[i] <= '9') {
+            v = v * 10 + uint64_t(d[i] - '0');
+            digits = true;
+            i++;
+        }
+        if (digits) out.push_back(static_cast<T>(negative ? -int64_t(v) : int64_t(v)));
+        while (i < size && !isDedupSpace(d[i])) i++;   // ignore the rest of a malformed token
     }
-    
-    file.close();
-    return data;
 }
 
-// Generate test data with duplicates and save to file
-inline void generateDedupData(const std::string& filename, size_t total_count, size_t unique_count) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        return;
+template<typename T>
+inline std::vector<T> parseIntegersParallel(const char* data, size_t size, int num_threads) {
+    size_t chunks = (size + DEDUP_PARSE_CHUNK - 1) / DEDUP_PARSE_CHUNK;
+    std::vector<std::vector<T>> pieces(chunks);
+
+    #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (size_t c = 0; c < chunks; c++) {
+        size_t begin = c * DEDUP_PARSE_CHUNK;
+        pieces[c].reserve(DEDUP_PARSE_CHUNK / 4);
+        parseIntegerRange(data, size, begin, std::min(size, begin + DEDUP_PARSE_CHUNK), pieces[c]);
     }
-    
+
+    std::vector<size_t> offset(chunks + 1, 0);
+    for (size_t c = 0; c < chunks; c++) offset[c + 1] = offset[c] + pieces[c].size();
+    std::vector<T> result(offset[chunks]);
+
+    #pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (size_t c = 0; c < chunks; c++) {
+        std::copy(pieces[c].begin(), pieces[c].end(), result.begin() + offset[c]);
+        std::vector<T>().swap(pieces[c]);
+    }
+    return result;
+}
+
+// ---- Loading ----
+// Integers of a dedup input, text or binary. A binary file whose width
+// matches T (on a little-endian host) is read in place from the mapping;
+// anything else is parsed or converted into an owned vector.
+template<typename T>
+class DedupInput {
+    MappedFile file;
+    std::vector<T> owned;
+    const T* ptr = nullptr;
+    size_t count = 0;
+    bool ok = false;
+    bool binary = false;
+
+    void own() {
+        ptr = owned.data();
+        count = owned.size();
+        ok = true;
+    }
+
+public:
+    DedupInput(const std::string& filename, int num_threads) : file(filename) {
+        if (!file.valid()) return;
+        const char* d = file.data();
+        if (!hasDedupMagic(d, file.size())) {
+            owned = parseIntegersParallel<T>(d, file.size(), num_threads);
+            own();
+            return;
+        }
+
+        DedupBinaryHeader h;
+        std::memcpy(&h, d, sizeof(h));
+        if (!hostIsLittleEndian() || (h.width != 4 && h.width != 8) ||
+            h.count > (file.size() - sizeof(h)) / h.width) {
+            return;   // unsupported or truncated
+        }
+        binary = true;
+        const char* payload = d + sizeof(h);
+        if (h.width == sizeof(T)) {
+            ptr = reinterpret_cast<const T*>(payload);
+            count = size_t(h.count);
+            ok = true;
+            return;
+        }
+        owned.resize(size_t(h.count));
+        #pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (size_t i = 0; i < owned.size(); i++) {
+            if (h.width == 4) {
+                int32_t v;
+                std::memcpy(&v, payload + 4 * i, 4);
+                owned[i] = static_cast<T>(v);
+            } else {
+                int64_t v;
+                std::memcpy(&v, payload + 8 * i, 8);
+                owned[i] = static_cast<T>(v);
+            }
+        }
+        own();
+    }
+
+    DedupInput(const DedupInput&) = delete;
+    DedupInput& operator=(const DedupInput&) = delete;
+
+    bool valid() const { return ok; }
+    bool is_binary() const { return binary; }
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+};
+
+// Integer width of a binary file's payload, or 4 (int) for text files.
+inline unsigned dedupFileWidth(const std::string& filename) {
+    MappedFile file(filename);
+    if (!file.valid() || !hasDedupMagic(file.data(), file.size())) return 4;
+    DedupBinaryHeader h;
+    std::memcpy(&h, file.data(), sizeof(h));
+    return h.width == 8 ? 8 : 4;
+}
+
+// Read integer data from file (text or binary)
+inline std::vector<int> readIntegersFromFile(const std::string& filename) {
+    DedupInput<int> input(filename, omp_get_max_threads());
+    if (!input.valid()) {
+        return std::vector<int>();
+    }
+    return std::vector<int>(input.data(), input.data() + input.size());
+}
+
+// Generate test data with duplicates and save to file.
+// binary_width 0 writes text; 4 or 8 writes the binary format.
+inline bool generateDedupData(const std::string& filename, size_t total_count, size_t unique_count,
+                              unsigned binary_width = 0) {
     // Generate list of unique values
     std::vector<int> unique_values;
     for (size_t i = 0; i < unique_count; i++) {
         unique_values.push_back(static_cast<int>(i));
     }
-    
+
     // Random number generator
     std::random_device rd;
     std::mt19937 gen(rd());
     std::uniform_int_distribution<> dis(0, unique_values.size() - 1);
-    
+
+    if (binary_width) {
+        DedupBinaryWriter writer(filename, binary_width);
+        if (!writer.is_open()) {
+            return false;
+        }
+        for (size_t i = 0; i < total_count; i++) {
+            writer.write(unique_values[dis(gen)]);
+        }
+        writer.close();
+        return true;
+    }
+
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+
     // Generate data with duplicates
     const size_t values_per_line = 20;
     for (size_t i = 0; i < total_count; i++) {
@@ -50,9 +262,9 @@ inline void generateDedupData(const std::string& filename, size_t total_count, s
         }
         file << unique_values[dis(gen)] << " ";
     }
-    
+
     file.close();
+    return true;
 }
 
 #endif // DEDUPLICATION_COMMON_H
-
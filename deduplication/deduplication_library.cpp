@@ -1,52 +1,75 @@
+#include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 #include <omp.h>
 #include <iomanip>
-#include "../fine_grained.h"
+#include "../concurrent_set.h"
 #include "deduplication_common.h"
 
 using namespace std;
 
-// Data deduplication using concurrent hash table library
-double deduplicateWithLibrary(const string& filename, int num_threads, size_t& total_count, size_t& unique_count) {
-    FineGrainedHashTable<int, bool> seen(8192);  // Fine-grained locking implementation
+// Data deduplication using concurrent hash table library.
+// T is the key type: int for text and int32 binary input, int64_t for int64
+// binary. Binary input is used in place from the mapping; load_seconds
+// receives the time spent loading (parsing, for text) before the timed phase,
+// set_bytes the memory held by the set's key slots. A non-empty output_file
+// receives the unique values, one per line, formatted shard by shard in
+// parallel after the timed phase.
+template<typename T>
+double deduplicateWithLibrary(const string& filename, int num_threads, size_t& total_count, size_t& unique_count,
+                              double* load_seconds = nullptr, size_t* set_bytes = nullptr,
+                              const string& output_file = "") {
+    ConcurrentSet<T> seen(8192);  // keys only, open addressing with CAS-claimed slots
     
-    vector<int> data = readIntegersFromFile(filename);
-    if (data.empty()) {
+    double load_start = omp_get_wtime();
+    DedupInput<T> data(filename, num_threads);
+    if (!data.valid() || data.size() == 0) {
         cerr << "Error: Cannot read file or file is empty: " << filename << endl;
         return -1;
     }
+    if (load_seconds) *load_seconds = omp_get_wtime() - load_start;
     
     total_count = data.size();
     
     double start_time = omp_get_wtime();
     
-    // Parallel deduplication: use hash table to record seen values
-    #pragma omp parallel num_threads(num_threads)
-    {
-        #pragma omp for
-        for (size_t i = 0; i < data.size(); ++i) {
-            // Use insert - it returns false if key already exists
-            // This avoids race condition between search and insert
-            seen.insert(data[i], true);
-            // insert handles both cases: new insertion and existing key
-        }
-    }
+    // Parallel deduplication: record every value in the set; insert_unique
+    // is true only for the first occurrence
+    seen.insert_all(data.data(), data.size(), num_threads);
     
     double end_time = omp_get_wtime();
     unique_count = seen.size();
+    if (set_bytes) *set_bytes = seen.slot_count() * sizeof(T);
+    
+    if (!output_file.empty()) {
+        vector<string> text(seen.group_count());
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(num_threads)
+        for (size_t g = 0; g < seen.group_count(); g++) {
+            seen.for_each_in_group(g, [&](T v) { text[g] += to_string(v); text[g] += '\n'; });
+        }
+        ofstream out(output_file);
+        for (const auto& t : text) out << t;
+        if (!out) {
+            cerr << "Error: Cannot write output file: " << output_file << endl;
+            return -1;
+        }
+    }
     
     return end_time - start_time;
 }
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        cerr << "Usage: " << argv[0] << " <input_file> <num_threads>" << endl;
+        cerr << "Usage: " << argv[0] << " <input_file> <num_threads> [output_file]" << endl;
+        cerr << "       input_file: text, or binary from generate_dedup_data --binary" << endl;
+        cerr << "       output_file receives the unique values, one per line" << endl;
         return 1;
     }
     
     string filename = argv[1];
     int num_threads = stoi(argv[2]);
+    string output_file = argc >= 4 ? argv[3] : "";
     
     size_t total_count = 0;
     size_t unique_count = 0;
@@ -58,7 +81,12 @@ int main(int argc, char* argv[]) {
     cout << "Threads: " << num_threads << endl;
     cout << endl;
     
-    double time = deduplicateWithLibrary(filename, num_threads, total_count, unique_count);
+    unsigned width = dedupFileWidth(filename);
+    double load_time = 0;
+    size_t set_bytes = 0;
+    double time = (width == 8)
+        ? deduplicateWithLibrary<int64_t>(filename, num_threads, total_count, unique_count, &load_time, &set_bytes, output_file)
+        : deduplicateWithLibrary<int>(filename, num_threads, total_count, unique_count, &load_time, &set_bytes, output_file);
     
     if (time < 0) {
         return 1;
@@ -67,9 +95,12 @@ int main(int argc, char* argv[]) {
     cout << fixed << setprecision(4);
     cout << "Total items: " << total_count << endl;
     cout << "Unique items: " << unique_count << endl;
+    cout << "Load time: " << load_time << " seconds" << endl;
     cout << "Time: " << time << " seconds" << endl;
     cout << "Throughput: " << fixed << setprecision(2) 
          << (total_count / time / 1e6) << " M items/second" << endl;
+    cout << "Set memory: " << fixed << setprecision(2) << (double)set_bytes / unique_count
+         << " bytes/unique key" << endl;
     
     return 0;
 }
@@ -2,132 +2,269 @@
 #define FINE_GRAINED_H
 
 #include "common.h"
+#include "packed_chain.h"
+#include "locks.h"
+#include <memory>
 
-template<typename K, typename V>
+// Buckets (chain head + lock) are stored inline in one array, so a lookup
+// touches no separate lock allocation. Lock: any lock from locks.h.
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>,
+         typename Lock = RWSpinLock>
 class FineGrainedHashTable {
 private:
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
     struct Bucket {
-        std::list<KeyValue<K, V>> data;
-        omp_lock_t lock;
+        Chain data;
+        Lock lock;  // shared for search, exclusive for writers
         
-        Bucket() {
-            omp_init_lock(&lock);
-        }
-        
-        ~Bucket() {
-            omp_destroy_lock(&lock);
-        }
+        Bucket() = default;
         
         // Disable copy
         Bucket(const Bucket&) = delete;
         Bucket& operator=(const Bucket&) = delete;
     };
     
-    std::vector<Bucket*> buckets;
+    std::unique_ptr<Bucket[]> buckets;
     size_t bucket_count;
-    std::atomic<size_t> element_count;
+    ElementCounter element_count;
     
     size_t hash(const K& key) const {
-        return Hash<K>{}(key) % bucket_count;
+        return HashFn{}(key) & (bucket_count - 1);  // bucket_count is a power of two
     }
 
-public:
-    FineGrainedHashTable(size_t bucket_count = 1024) 
-        : bucket_count(bucket_count), element_count(0) {
-        
-        for (size_t i = 0; i < bucket_count; ++i) {
-            buckets.push_back(new Bucket());
-        }
+    // Chain helpers for the batched paths; caller holds the bucket lock.
+    static bool insert_into(Chain& chain, const K& key, const V& value) {
+        if (auto* kv = chain_find(chain, key)) { kv->value = value; return false; }
+        chain.emplace_back(key, value);
+        return true;
     }
-    
-    ~FineGrainedHashTable() {
-        for (auto bucket : buckets) {
-            delete bucket;
-        }
+
+    static bool find_in(const Chain& chain, const K& key, V& value) {
+        if (const auto* kv = chain_find(chain, key)) { value = kv->value; return true; }
+        return false;
+    }
+
+    void prefetch_bucket(const BatchScratch& sc, size_t j, size_t n, bool for_write) const {
+        if (j >= n) return;
+        const Bucket* b = &buckets[BatchScratch::group_of(sc.order[j])];
+        if (for_write) prefetch_write(b); else prefetch_read(b);
     }
+
+public:
+    FineGrainedHashTable(size_t bucket_count = 1024) 
+        : buckets(new Bucket[next_pow2(bucket_count)]), bucket_count(next_pow2(bucket_count)), element_count(0) {}
     
     bool insert(const K& key, const V& value) {
         size_t idx = hash(key);
-        Bucket* bucket = buckets[idx];
+        Bucket* bucket = &buckets[idx];
         
-        omp_set_lock(&bucket->lock);  // Lock only this bucket
+        bucket->lock.lock();  // Lock only this bucket
         
         // Check if key already exists
-        for (auto& kv : bucket->data) {
-            if (kv.key == key) {
-                kv.value = value;
-                omp_unset_lock(&bucket->lock);
-                return false;
-            }
+        if (auto* kv = chain_find(bucket->data, key)) {
+            kv->value = value;
+            bucket->lock.unlock();
+            return false;
         }
         
         bucket->data.emplace_back(key, value);
-        element_count++;
+        element_count.add(1);
         
-        omp_unset_lock(&bucket->lock);
+        bucket->lock.unlock();
         return true;
     }
 
-    bool increment(const K& key, const V& delta) {
-        size_t idx = hash(key);
-        Bucket* bucket = buckets[idx];
-
-        omp_set_lock(&bucket->lock);
-        for (auto& kv : bucket->data) {
-            if (kv.key == key) {
-                kv.value += delta;      // requires V to support operator+=
-                omp_unset_lock(&bucket->lock);
-                return false;           // updated existing
-            }
+    // Read-modify-write operations (see common.h), one lock acquisition each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        Bucket* b = &buckets[hash(key)];
+        b->lock.lock();
+        auto& bucket = b->data;
+        bool inserted = false;
+        if (auto* kv = chain_find(bucket, key)) {
+            fn(kv->value);
+        } else {
+            bucket.emplace_back(key, init);
+            element_count.add(1);
+            inserted = true;
         }
-        // not found: insert with initial value = delta
-        bucket->data.emplace_back(key, delta);
-        element_count++;
-        omp_unset_lock(&bucket->lock);
-        return true;                    // inserted new
+        b->lock.unlock();
+        return inserted;
     }
-    
-    
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        Bucket* b = &buckets[hash(key)];
+        b->lock.lock();
+        auto* kv = chain_find(b->data, key);
+        if (kv) fn(kv->value);
+        b->lock.unlock();
+        return kv != nullptr;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
         size_t idx = hash(key);
-        Bucket* bucket = buckets[idx];
+        Bucket* bucket = &buckets[idx];
         
-        omp_set_lock(&bucket->lock);
+        bucket->lock.lock_shared();
         
-        for (const auto& kv : bucket->data) {
-            if (kv.key == key) {
-                value = kv.value;
-                omp_unset_lock(&bucket->lock);
-                return true;
-            }
+        if (const auto* kv = chain_find(bucket->data, key)) {
+            value = kv->value;
+            bucket->lock.unlock_shared();
+            return true;
         }
         
-        omp_unset_lock(&bucket->lock);
+        bucket->lock.unlock_shared();
         return false;
     }
     
     bool remove(const K& key) {
         size_t idx = hash(key);
-        Bucket* bucket = buckets[idx];
+        Bucket* bucket = &buckets[idx];
         
-        omp_set_lock(&bucket->lock);
+        bucket->lock.lock();
         
         for (auto it = bucket->data.begin(); it != bucket->data.end(); ++it) {
             if (it->key == key) {
                 bucket->data.erase(it);
-                element_count--;
-                omp_unset_lock(&bucket->lock);
+                element_count.sub(1);
+                bucket->lock.unlock();
                 return true;
             }
         }
         
-        omp_unset_lock(&bucket->lock);
+        bucket->lock.unlock();
         return false;
     }
     
+    // Batched insert: returns the number of new keys, inserted[i] (optional)
+    // reports each key. Keys are grouped by bucket so each lock is taken once.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            size_t idx = hash(keys[i]);
+            sc.add(i, idx);
+        }
+        sc.sort(n, bucket_count);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, true);
+
+        size_t added = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t idx = BatchScratch::group_of(sc.order[g]);
+            Bucket* bucket = &buckets[idx];
+            bucket->lock.lock();
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == idx; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, true);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                bool is_new = insert_into(bucket->data, keys[i], values[i]);
+                if (inserted) inserted[i] = is_new;
+                added += is_new;
+            }
+            bucket->lock.unlock();
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            size_t idx = hash(keys[i]);
+            sc.add(i, idx);
+        }
+        sc.sort(n, bucket_count);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, false);
+
+        size_t hits = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t idx = BatchScratch::group_of(sc.order[g]);
+            Bucket* bucket = &buckets[idx];
+            bucket->lock.lock_shared();
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == idx; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, false);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                found[i] = find_in(bucket->data, keys[i], values[i]);
+                hits += found[i];
+            }
+            bucket->lock.unlock_shared();
+        }
+        return hits;
+    }
+    
+    // Bulk load (see common.h): bucket ranges are filled by one thread each.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkBucketGroups groups(bucket_count);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, groups.count, groups, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t g = 0; g < groups.count; ++g) {
+            for (const BulkEntry* e = part.begin(g); e != part.end(g); ++e) {
+                added += bulk_append(buckets[e->hash & (bucket_count - 1)].data, first[e->index], unique);
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // Bucket ranges as groups (see common.h); read while no writer is active.
+    size_t group_count() const { return BulkBucketGroups(bucket_count).count; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        BulkBucketGroups groups(bucket_count);
+        for (size_t b = groups.first_bucket(g); b < groups.first_bucket(g + 1); ++b) {
+            for (const auto& kv : buckets[b].data) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Memory accounting (see common.h).
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.buckets = bucket_count * sizeof(Chain);
+        m.locks = bucket_count * sizeof(Lock);
+        m.padding = bucket_count * (sizeof(Bucket) - sizeof(Chain) - sizeof(Lock));
+        for (size_t i = 0; i < bucket_count; ++i) m.nodes += chain_node_bytes(buckets[i].data);
+        usage_add_object(m, sizeof(*this));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    size_t shrink_to_fit() {
+        size_t freed = 0;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            buckets[i].lock.lock();
+            freed += chain_shrink(buckets[i].data);
+            buckets[i].lock.unlock();
+        }
+        return freed;
+    }
+
     size_t size() const {
         return element_count.load();
     }
+
+    // Buckets per chain length (see instrumentation.h); read while no writer is active.
+    std::vector<size_t> chain_length_histogram() const {
+        std::vector<size_t> hist;
+        for (size_t i = 0; i < bucket_count; ++i) chain_hist_add(hist, buckets[i].data.size());
+        return hist;
+    }
     
     std::string getName() const {
         return "Fine-Grained";
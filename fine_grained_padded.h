@@ -2,12 +2,14 @@
 #define FINE_GRAINED_PADDED_H
 
 #include "common.h"
+#include "packed_chain.h"
 
-template<typename K, typename V>
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>>
 class FineGrainedHashTablePadded {
 private:
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
     struct alignas(64) Bucket {
-        std::list<KeyValue<K,V>> data;
+        Chain data;
         omp_lock_t lock;
         Bucket() { omp_init_lock(&lock); }
         ~Bucket() { omp_destroy_lock(&lock); }
@@ -17,17 +19,23 @@ private:
 
     std::vector<Bucket*> buckets;
     size_t bucket_count;
-    std::atomic<size_t> element_count;
+    ElementCounter element_count;
 
     size_t hash(const K& key) const {
-        return Hash<K>{}(key) % bucket_count;
+        return HashFn{}(key) & (bucket_count - 1);  // bucket_count is a power of two
+    }
+
+    void prefetch_bucket(const BatchScratch& sc, size_t j, size_t n, bool for_write) const {
+        if (j >= n) return;
+        const Bucket* b = buckets[BatchScratch::group_of(sc.order[j])];
+        if (for_write) prefetch_write(b); else prefetch_read(b);
     }
 
 public:
     FineGrainedHashTablePadded(size_t bucket_count = 1024)
-        : bucket_count(bucket_count), element_count(0) {
-        buckets.reserve(bucket_count);
-        for (size_t i = 0; i < bucket_count; ++i) {
+        : bucket_count(next_pow2(bucket_count)), element_count(0) {
+        buckets.reserve(this->bucket_count);
+        for (size_t i = 0; i < this->bucket_count; ++i) {
             buckets.push_back(new Bucket());
         }
     }
@@ -37,25 +45,6 @@ public:
     }
     
 
-    bool increment(const K& key, const V& delta) {
-        size_t idx = hash(key);
-        Bucket* bucket = buckets[idx];
-
-        omp_set_lock(&bucket->lock);
-        for (auto& kv : bucket->data) {
-            if (kv.key == key) {
-                kv.value += delta;      // requires V to support operator+=
-                omp_unset_lock(&bucket->lock);
-                return false;           // updated existing
-            }
-        }
-        // not found: insert with initial value = delta
-        bucket->data.emplace_back(key, delta);
-        element_count++;
-        omp_unset_lock(&bucket->lock);
-        return true;                    // inserted new
-    }
-
     bool insert(const K& key, const V& value) {
         size_t idx = hash(key);
         Bucket* b = buckets[idx];
@@ -64,11 +53,42 @@ public:
             if (kv.key == key) { kv.value = value; omp_unset_lock(&b->lock); return false; }
         }
         b->data.emplace_back(key, value);
-        element_count++;
+        element_count.add(1);
         omp_unset_lock(&b->lock);
         return true;
     }
 
+    // Read-modify-write operations (see common.h), one lock acquisition each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        Bucket* b = buckets[hash(key)];
+        omp_set_lock(&b->lock);
+        auto& bucket = b->data;
+        bool inserted = false;
+        if (auto* kv = chain_find(bucket, key)) {
+            fn(kv->value);
+        } else {
+            bucket.emplace_back(key, init);
+            element_count.add(1);
+            inserted = true;
+        }
+        omp_unset_lock(&b->lock);
+        return inserted;
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        Bucket* b = buckets[hash(key)];
+        omp_set_lock(&b->lock);
+        auto* kv = chain_find(b->data, key);
+        if (kv) fn(kv->value);
+        omp_unset_lock(&b->lock);
+        return kv != nullptr;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
         size_t idx = hash(key);
         Bucket* b = buckets[idx];
@@ -87,7 +107,7 @@ public:
         for (auto it = b->data.begin(); it != b->data.end(); ++it) {
             if (it->key == key) {
                 b->data.erase(it);
-                element_count--;
+                element_count.sub(1);
                 omp_unset_lock(&b->lock);
                 return true;
             }
@@ -96,6 +116,120 @@ public:
         return false;
     }
 
+    // Batched operations: keys are grouped by bucket so each lock is taken
+    // once per batch; buckets are prefetched a few keys ahead of the walk.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) sc.add(i, hash(keys[i]));
+        sc.sort(n, bucket_count);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, true);
+
+        size_t added = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t idx = BatchScratch::group_of(sc.order[g]);
+            Bucket* b = buckets[idx];
+            omp_set_lock(&b->lock);
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == idx; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, true);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                auto* kv = chain_find(b->data, keys[i]);
+                bool is_new = kv == nullptr;
+                if (kv) kv->value = values[i];
+                if (is_new) b->data.emplace_back(keys[i], values[i]);
+                if (inserted) inserted[i] = is_new;
+                added += is_new;
+            }
+            omp_unset_lock(&b->lock);
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) sc.add(i, hash(keys[i]));
+        sc.sort(n, bucket_count);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, false);
+
+        size_t hits = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t idx = BatchScratch::group_of(sc.order[g]);
+            Bucket* b = buckets[idx];
+            omp_set_lock(&b->lock);
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == idx; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, false);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                const auto* kv = chain_find(b->data, keys[i]);
+                found[i] = kv != nullptr;
+                if (kv) values[i] = kv->value;
+                hits += found[i];
+            }
+            omp_unset_lock(&b->lock);
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h): bucket ranges are filled by one thread each.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkBucketGroups groups(bucket_count);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, groups.count, groups, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t g = 0; g < groups.count; ++g) {
+            for (const BulkEntry* e = part.begin(g); e != part.end(g); ++e) {
+                added += bulk_append(buckets[e->hash & (bucket_count - 1)]->data, first[e->index], unique);
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // Bucket ranges as groups (see common.h); read while no writer is active.
+    size_t group_count() const { return BulkBucketGroups(bucket_count).count; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        BulkBucketGroups groups(bucket_count);
+        for (size_t b = groups.first_bucket(g); b < groups.first_bucket(g + 1); ++b) {
+            for (const auto& kv : buckets[b]->data) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Memory accounting (see common.h); every bucket is its own cache line.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.buckets = bucket_count * sizeof(Chain);
+        m.locks = bucket_count * sizeof(omp_lock_t);
+        m.padding = bucket_count * (sizeof(Bucket) - sizeof(Chain) - sizeof(omp_lock_t));
+        for (const Bucket* b : buckets) m.nodes += chain_node_bytes(b->data);
+        usage_add_object(m, sizeof(*this) + buckets.capacity() * sizeof(Bucket*));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    size_t shrink_to_fit() {
+        size_t freed = 0;
+        for (Bucket* b : buckets) {
+            omp_set_lock(&b->lock);
+            freed += chain_shrink(b->data);
+            omp_unset_lock(&b->lock);
+        }
+        return freed;
+    }
+
     size_t size() const { return element_count.load(); }
     std::string getName() const { return "Fine-Grained-Padded"; }
 };
@@ -0,0 +1,517 @@
+#ifndef FLAT_HASH_TABLE_H
+#define FLAT_HASH_TABLE_H
+
+#include "common.h"
+#include "locks.h"
+#include <cstdint>
+#include <utility>
+
+// Open-addressing tables with Robin Hood linear probing.
+// Keys and values live in contiguous slot arrays (no per-entry allocation, no
+// pointer chasing); a parallel byte array holds each slot's probe distance + 1
+// (0 = empty). Deletion uses backward shifting, so there are no tombstones.
+//
+// Compile-time overrides:
+//   -DFLAT_DEFAULT_STRIPES=256   // stripes in StripedFlatHashTable (power of two)
+
+#ifndef FLAT_DEFAULT_STRIPES
+#define FLAT_DEFAULT_STRIPES 256
+#endif
+
+// Read-only view of one table's slot arrays, as saved and mapped by persist.h.
+template<typename K, typename V>
+struct FlatSlots {
+    const uint8_t* dist;
+    const K* keys;
+    const V* values;
+    size_t capacity;   // power of two
+};
+
+template<typename K, typename V, typename HashFn = Hash<K>>
+class FlatHashTable {
+private:
+    static constexpr double MAX_LOAD = 0.8;
+    static constexpr uint8_t MAX_DIST = 250;  // grow before a distance overflows its byte
+
+    std::vector<uint8_t> dist;   // 0 = empty, otherwise probe distance + 1
+    std::vector<K> keys;
+    std::vector<V> values;
+    size_t capacity;             // power of two
+    size_t mask;
+    size_t element_count;
+    size_t min_capacity;         // shrink_to_fit stops here
+
+    static size_t round_up_pow2(size_t x) {
+        size_t p = 8;
+        while (p < x) p <<= 1;
+        return p;
+    }
+
+    inline size_t home(size_t h) const { return h & mask; }
+
+    bool find_slot(const K& key, size_t h, size_t& pos) const {
+        pos = home(h);
+        for (uint8_t d = 1; ; ++d) {
+            if (dist[pos] < d) return false;  // an entry this far out would have displaced it
+            if (keys[pos] == key) return true;
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    // Robin Hood placement of a key known to be absent.
+    void place(K key, V value, size_t h) {
+        size_t pos = home(h);
+        uint8_t d = 1;
+        while (true) {
+            if (dist[pos] == 0) {
+                dist[pos] = d;
+                keys[pos] = std::move(key);
+                values[pos] = std::move(value);
+                element_count++;
+                return;
+            }
+            if (dist[pos] < d) {
+                // Steal the slot from the richer entry and keep probing with it.
+                std::swap(d, dist[pos]);
+                std::swap(key, keys[pos]);
+                std::swap(value, values[pos]);
+                h = HashFn{}(key);
+            }
+            pos = (pos + 1) & mask;
+            if (++d >= MAX_DIST) {
+                grow();
+                place(std::move(key), std::move(value), h);
+                return;
+            }
+        }
+    }
+
+    void grow() { rehash(capacity * 2); }
+
+    void rehash(size_t new_capacity) {
+        std::vector<uint8_t> old_dist;
+        std::vector<K> old_keys;
+        std::vector<V> old_values;
+        old_dist.swap(dist);
+        old_keys.swap(keys);
+        old_values.swap(values);
+
+        capacity = new_capacity;
+        mask = capacity - 1;
+        element_count = 0;
+        dist.assign(capacity, 0);
+        keys.resize(capacity);
+        values.resize(capacity);
+        for (size_t i = 0; i < old_dist.size(); ++i) {
+            if (old_dist[i]) {
+                size_t h = HashFn{}(old_keys[i]);
+                place(std::move(old_keys[i]), std::move(old_values[i]), h);
+            }
+        }
+    }
+
+public:
+    explicit FlatHashTable(size_t initial_capacity = 1024)
+        : capacity(round_up_pow2(initial_capacity)), mask(capacity - 1), element_count(0), min_capacity(capacity) {
+        dist.assign(capacity, 0);
+        keys.resize(capacity);
+        values.resize(capacity);
+    }
+
+    // *_hashed variants take a precomputed HashFn value so striped callers hash once.
+    bool insert_hashed(const K& key, const V& value, size_t h) {
+        size_t pos;
+        if (find_slot(key, h, pos)) {
+            values[pos] = value;
+            return false;
+        }
+        if (element_count + 1 > capacity * MAX_LOAD) grow();
+        place(key, value, h);
+        return true;
+    }
+
+    template<typename F>
+    bool upsert_hashed(const K& key, F& fn, const V& init, size_t h) {
+        size_t pos;
+        if (find_slot(key, h, pos)) {
+            fn(values[pos]);
+            return false;
+        }
+        if (element_count + 1 > capacity * MAX_LOAD) grow();
+        place(key, init, h);
+        return true;
+    }
+
+    template<typename F>
+    bool compute_if_present_hashed(const K& key, F& fn, size_t h) {
+        size_t pos;
+        if (!find_slot(key, h, pos)) return false;
+        fn(values[pos]);
+        return true;
+    }
+
+    bool search_hashed(const K& key, V& value, size_t h) const {
+        size_t pos;
+        if (!find_slot(key, h, pos)) return false;
+        value = values[pos];
+        return true;
+    }
+
+    bool remove_hashed(const K& key, size_t h) {
+        size_t pos;
+        if (!find_slot(key, h, pos)) return false;
+
+        // Backward shift: pull displaced successors one slot closer to home.
+        size_t next = (pos + 1) & mask;
+        while (dist[next] > 1) {
+            keys[pos] = std::move(keys[next]);
+            values[pos] = std::move(values[next]);
+            dist[pos] = dist[next] - 1;
+            pos = next;
+            next = (next + 1) & mask;
+        }
+        dist[pos] = 0;
+        keys[pos] = K();
+        values[pos] = V();
+        element_count--;
+        return true;
+    }
+
+    // For a key known to be absent: skips the lookup.
+    void insert_unique_hashed(const K& key, const V& value, size_t h) {
+        if (element_count + 1 > capacity * MAX_LOAD) grow();
+        place(key, value, h);
+    }
+
+    // Grows once so that n entries fit under the load limit.
+    void reserve(size_t n) {
+        size_t target = capacity;
+        while (n > target * MAX_LOAD) target *= 2;
+        if (target != capacity) rehash(target);
+    }
+
+    bool insert(const K& key, const V& value) { return insert_hashed(key, value, HashFn{}(key)); }
+    bool search(const K& key, V& value) const { return search_hashed(key, value, HashFn{}(key)); }
+    bool remove(const K& key) { return remove_hashed(key, HashFn{}(key)); }
+
+    // Read-modify-write operations (see common.h).
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) { return upsert_hashed(key, fn, init, HashFn{}(key)); }
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) { return compute_if_present_hashed(key, fn, HashFn{}(key)); }
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
+    // Visits every entry as fn(key, value), in slot order.
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (dist[i]) fn(keys[i], values[i]);
+        }
+    }
+
+    // The whole table is one group (see common.h).
+    size_t group_count() const { return 1; }
+    template<typename F>
+    void for_each_in_group(size_t, F fn) const { for_each(fn); }
+    // A single group, so this runs on the calling thread.
+    template<typename F>
+    void parallel_for_each(F fn, int = 1) const { for_each(fn); }
+
+    FlatSlots<K, V> slots() const { return FlatSlots<K, V>{dist.data(), keys.data(), values.data(), capacity}; }
+    FlatSlots<K, V> flat_group(size_t) const { return slots(); }
+
+    // Replaces the contents with a copy of src, slot for slot. src must come
+    // from a table with the same HashFn, or lookups will miss.
+    void assign_slots(const FlatSlots<K, V>& src) {
+        capacity = src.capacity;
+        mask = capacity - 1;
+        dist.assign(src.dist, src.dist + capacity);
+        keys.assign(src.keys, src.keys + capacity);
+        values.assign(src.values, src.values + capacity);
+        element_count = capacity - size_t(std::count(dist.begin(), dist.end(), uint8_t(0)));
+    }
+
+    // Flat image loading (persist.h): one group, copied as is.
+    template<typename SlotsOf>
+    bool load_flat_groups(size_t groups, SlotsOf slots_of) {
+        if (groups != 1) return false;
+        assign_slots(slots_of(0));
+        return true;
+    }
+
+    // Bulk load (see common.h); single-threaded here, but sized once up front.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        reserve(element_count + size_t(last - first));
+        size_t added = 0;
+        for (It it = first; it != last; ++it) {
+            size_t h = HashFn{}(bulk_key(*it));
+            if (unique) { insert_unique_hashed(bulk_key(*it), bulk_value(*it), h); ++added; }
+            else added += insert_hashed(bulk_key(*it), bulk_value(*it), h);
+        }
+        return added;
+    }
+
+    // Memory accounting (see common.h): all slot arrays are buckets.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.buckets = dist.capacity() + keys.capacity() * sizeof(K) + values.capacity() * sizeof(V);
+        m.other = sizeof(*this);
+        m.entries = element_count;
+        return m;
+    }
+
+    // Rehashes down to the smallest capacity that holds size() under the
+    // load limit, never below the constructor's. Returns the slot bytes released.
+    size_t shrink_to_fit() {
+        size_t target = min_capacity;
+        while (element_count > target * MAX_LOAD) target *= 2;
+        if (target >= capacity) return 0;
+        const size_t before = memory_usage().buckets;
+        rehash(target);
+        return before - memory_usage().buckets;
+    }
+
+    size_t size() const { return element_count; }
+    size_t slot_count() const { return capacity; }
+    std::string getName() const { return "Flat"; }
+};
+
+// Concurrent variant: the key space is split across independent flat tables,
+// each guarded by its own lock. Stripes grow independently of each other.
+template<typename K, typename V, typename HashFn = Hash<K>>
+class StripedFlatHashTable {
+private:
+    static const size_t NUM_STRIPES = FLAT_DEFAULT_STRIPES;
+    static_assert((NUM_STRIPES & (NUM_STRIPES - 1)) == 0, "FLAT_DEFAULT_STRIPES must be a power of two");
+
+    static constexpr unsigned log2_stripes() {
+        unsigned s = 0;
+        while ((size_t(1) << s) < NUM_STRIPES) ++s;
+        return s;
+    }
+
+    struct alignas(64) Stripe {
+        FlatHashTable<K,V,HashFn> table;
+        RWSpinLock lock;   // shared for search, exclusive for writers
+        explicit Stripe(size_t cap) : table(cap) {}
+        Stripe(const Stripe&) = delete;
+        Stripe& operator=(const Stripe&) = delete;
+    };
+
+    std::vector<Stripe*> stripes;
+    ElementCounter element_count;
+
+    // Stripe takes the top bits; the stripe's table probes with the low ones.
+    static size_t stripe_index(size_t h) {
+        return log2_stripes() ? h >> (sizeof(size_t) * 8 - log2_stripes()) : 0;
+    }
+
+public:
+    explicit StripedFlatHashTable(size_t bucket_count = 1024) : element_count(0) {
+        size_t per_stripe = bucket_count / NUM_STRIPES;
+        stripes.reserve(NUM_STRIPES);
+        for (size_t i = 0; i < NUM_STRIPES; ++i) {
+            stripes.push_back(new Stripe(per_stripe));
+        }
+    }
+
+    ~StripedFlatHashTable() {
+        for (auto s : stripes) delete s;
+    }
+
+    StripedFlatHashTable(const StripedFlatHashTable&) = delete;
+    StripedFlatHashTable& operator=(const StripedFlatHashTable&) = delete;
+
+    bool insert(const K& key, const V& value) {
+        size_t h = HashFn{}(key);
+        Stripe* s = stripes[stripe_index(h)];
+        s->lock.lock();
+        bool inserted = s->table.insert_hashed(key, value, h);
+        s->lock.unlock();
+        if (inserted) element_count.add(1);
+        return inserted;
+    }
+
+    // Read-modify-write operations (see common.h), one stripe lock each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        size_t h = HashFn{}(key);
+        Stripe* s = stripes[stripe_index(h)];
+        s->lock.lock();
+        bool inserted = s->table.upsert_hashed(key, fn, init, h);
+        s->lock.unlock();
+        if (inserted) element_count.add(1);
+        return inserted;
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        size_t h = HashFn{}(key);
+        Stripe* s = stripes[stripe_index(h)];
+        s->lock.lock();
+        bool found = s->table.compute_if_present_hashed(key, fn, h);
+        s->lock.unlock();
+        return found;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
+    bool search(const K& key, V& value) const {
+        size_t h = HashFn{}(key);
+        Stripe* s = stripes[stripe_index(h)];
+        s->lock.lock_shared();
+        bool found = s->table.search_hashed(key, value, h);
+        s->lock.unlock_shared();
+        return found;
+    }
+
+    bool remove(const K& key) {
+        size_t h = HashFn{}(key);
+        Stripe* s = stripes[stripe_index(h)];
+        s->lock.lock();
+        bool removed = s->table.remove_hashed(key, h);
+        s->lock.unlock();
+        if (removed) element_count.sub(1);
+        return removed;
+    }
+
+    // Batched operations: keys are grouped by stripe so each lock is taken once.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            size_t si = stripe_index(sc.hashes[i]);
+            prefetch_write(stripes[si]);
+            sc.add(i, si);
+        }
+        sc.sort(n, NUM_STRIPES);
+
+        size_t added = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t si = BatchScratch::group_of(sc.order[g]);
+            Stripe* s = stripes[si];
+            s->lock.lock();
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == si; ++g) {
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                bool is_new = s->table.insert_hashed(keys[i], values[i], sc.hashes[i]);
+                if (inserted) inserted[i] = is_new;
+                added += is_new;
+            }
+            s->lock.unlock();
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            size_t si = stripe_index(sc.hashes[i]);
+            prefetch_read(stripes[si]);
+            sc.add(i, si);
+        }
+        sc.sort(n, NUM_STRIPES);
+
+        size_t hits = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t si = BatchScratch::group_of(sc.order[g]);
+            Stripe* s = stripes[si];
+            s->lock.lock_shared();
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == si; ++g) {
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                found[i] = s->table.search_hashed(keys[i], values[i], sc.hashes[i]);
+                hits += found[i];
+            }
+            s->lock.unlock_shared();
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h): one group per stripe, reserved once and filled
+    // by one thread without its lock.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, NUM_STRIPES, [](size_t h) { return stripe_index(h); }, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t si = 0; si < NUM_STRIPES; ++si) {
+            auto& table = stripes[si]->table;
+            table.reserve(table.size() + part.group_size(si));
+            for (const BulkEntry* e = part.begin(si); e != part.end(si); ++e) {
+                const auto& src = first[e->index];
+                if (unique) { table.insert_unique_hashed(bulk_key(src), bulk_value(src), e->hash); ++added; }
+                else added += table.insert_hashed(bulk_key(src), bulk_value(src), e->hash);
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // One group per stripe (see common.h); read while no writer is active.
+    static constexpr size_t group_count() { return NUM_STRIPES; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const { stripes[g]->table.for_each(fn); }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    FlatSlots<K, V> flat_group(size_t g) const { return stripes[g]->table.slots(); }
+
+    // Flat image loading (persist.h): stripes are copied in parallel, which
+    // needs an image with exactly one group per stripe. Empty table only, with
+    // exclusive access.
+    template<typename SlotsOf>
+    bool load_flat_groups(size_t groups, SlotsOf slots_of) {
+        if (groups != NUM_STRIPES) return false;
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added)
+        for (size_t g = 0; g < NUM_STRIPES; ++g) {
+            stripes[g]->table.assign_slots(slots_of(g));
+            added += stripes[g]->table.size();
+        }
+        element_count.add(added);
+        return true;
+    }
+
+    // Memory accounting (see common.h). shrink_to_fit shrinks one stripe at
+    // a time under its exclusive lock.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        for (const Stripe* s : stripes) {
+            m += s->table.memory_usage();
+            m.locks += sizeof(RWSpinLock);
+            m.padding += sizeof(Stripe) - sizeof(s->table) - sizeof(RWSpinLock);
+        }
+        usage_add_object(m, sizeof(*this) + stripes.capacity() * sizeof(Stripe*));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    size_t shrink_to_fit() {
+        size_t freed = 0;
+        for (Stripe* s : stripes) {
+            s->lock.lock();
+            freed += s->table.shrink_to_fit();
+            s->lock.unlock();
+        }
+        return freed;
+    }
+
+    size_t size() const { return element_count.load(); }
+    std::string getName() const { return "Flat-Striped"; }
+};
+
+#endif // FLAT_HASH_TABLE_H
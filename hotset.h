@@ -1,17 +1,19 @@
 #ifndef HOTSET_H
 #define HOTSET_H
 
+#include <algorithm>
+#include <cstdint>
 #include <random>
 
 // Simple hot-set generator: p_hot probability to choose from [0, hotN),
-// otherwise choose from [hotN, universe).
+// otherwise choose from [hotN, universe). hotN is clamped into [1, universe).
 class HotsetGen {
 public:
     HotsetGen(int universe, int hotN, double p_hot, uint32_t seed)
-        : universe_(universe), hotN_(hotN), p_hot_(p_hot),
+        : universe_(universe), hotN_(std::max(1, std::min(hotN, universe - 1))), p_hot_(p_hot),
           gen_(seed),
           dist_hot_(0, hotN_ - 1),
-          dist_cold_(hotN_, universe_ - 1),
+          dist_cold_(std::min(hotN_, universe - 1), std::max(0, universe - 1)),
           coin_(0.0, 1.0) {}
 
     int draw() {
@@ -0,0 +1,210 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Measurement hooks for latency, lock contention and chain lengths.
+//
+// Built only with -DCHT_INSTRUMENT; otherwise the lock probes expand to
+// nothing and locks.h compiles exactly as before.
+// - LatencyHistogram: log-linear (HDR-style) nanosecond buckets, about 3%
+//   precision. Keep one per thread and merge() them at the end.
+// - Lock probes: every lock in locks.h records its acquisitions and, for the
+//   ones that had to wait, the time spent waiting. Counters are per thread
+//   slot (as in sharded_counter.h), and wait time is also binned by lock
+//   address so the share that lands on the hottest lock shows up.
+// - chain_hist_add: what each table's chain_length_histogram() is built from.
+//   That call is always available, but it only reads the table while nobody
+//   writes to it.
+//
+// Compile-time overrides:
+//   -DCHT_LATENCY_SAMPLE=64   // time one operation in this many (power of two)
+
+#ifndef CHT_LATENCY_SAMPLE
+#define CHT_LATENCY_SAMPLE 64
+#endif
+
+inline uint64_t instrument_now_ns() {
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+class LatencyHistogram {
+    static constexpr unsigned SUB_BITS = 5;                       // 32 linear steps per power of two
+    static constexpr unsigned HALF = 1u << (SUB_BITS - 1);
+    static constexpr unsigned BUCKETS = (64 - SUB_BITS + 2) * HALF;
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+
+    static unsigned index(uint64_t ns) {
+        if (ns < (uint64_t(1) << SUB_BITS)) return unsigned(ns);
+        unsigned shift = unsigned(63 - __builtin_clzll(ns)) - (SUB_BITS - 1);
+        return shift * HALF + unsigned(ns >> shift);
+    }
+    // Smallest value that lands in bucket i.
+    static uint64_t lower_bound(unsigned i) {
+        if (i < (1u << SUB_BITS)) return i;
+        unsigned shift = i / HALF - 1;
+        return uint64_t(i - shift * HALF) << shift;
+    }
+
+public:
+    LatencyHistogram() { std::memset(counts, 0, sizeof(counts)); }
+
+    void record(uint64_t ns) { counts[index(ns)]++; total++; }
+
+    void merge(const LatencyHistogram& o) {
+        for (unsigned i = 0; i < BUCKETS; ++i) counts[i] += o.counts[i];
+        total += o.total;
+    }
+
+    uint64_t samples() const { return total; }
+
+    // Value at quantile q (0..1), as the lower edge of its bucket; 0 if empty.
+    uint64_t percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = uint64_t(q * double(total - 1)) + 1, seen = 0;
+        for (unsigned i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return lower_bound(i);
+        }
+        return lower_bound(BUCKETS - 1);
+    }
+};
+
+// Snapshot of the lock probe counters.
+struct LockStats {
+    uint64_t acquisitions = 0;
+    uint64_t contended = 0;       // acquisitions that had to wait
+    uint64_t wait_ns = 0;
+    double hot_wait_pct = 0.0;    // share of wait_ns on the most-waited-on lock bin
+};
+
+namespace lock_probe {
+
+static constexpr unsigned SLOTS = 64;
+static constexpr unsigned HOT_BINS = 256;   // lock addresses hashed into this many bins
+
+struct alignas(64) Slot {
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    std::atomic<uint64_t> wait_ns{0};
+    std::atomic<uint64_t> hot[HOT_BINS];
+    Slot() { for (auto& h : hot) h.store(0, std::memory_order_relaxed); }
+};
+
+inline Slot* slots() {
+    static Slot s[SLOTS];
+    return s;
+}
+
+inline Slot& local() {
+    static std::atomic<unsigned> next{0};
+    static thread_local unsigned id = next.fetch_add(1, std::memory_order_relaxed) % SLOTS;
+    return slots()[id];
+}
+
+inline unsigned bin_of(const void* lock) {
+    uint64_t a = uint64_t(reinterpret_cast<uintptr_t>(lock)) >> 2;
+    return unsigned((a * 0x9E3779B97F4A7C15ULL) >> 56) % HOT_BINS;
+}
+
+inline bool count(bool acquired) {
+    if (acquired) local().acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return acquired;
+}
+
+// Lives across a blocking acquisition; counts it as contended when done.
+class Wait {
+    const void* lock;
+    uint64_t start;
+public:
+    explicit Wait(const void* l) : lock(l), start(instrument_now_ns()) {}
+    ~Wait() {
+        uint64_t ns = instrument_now_ns() - start;
+        Slot& s = local();
+        s.acquisitions.fetch_add(1, std::memory_order_relaxed);
+        s.contended.fetch_add(1, std::memory_order_relaxed);
+        s.wait_ns.fetch_add(ns, std::memory_order_relaxed);
+        s.hot[bin_of(lock)].fetch_add(ns, std::memory_order_relaxed);
+    }
+    Wait(const Wait&) = delete;
+    Wait& operator=(const Wait&) = delete;
+};
+
+// Call while no thread is taking locks.
+inline void reset() {
+    for (unsigned i = 0; i < SLOTS; ++i) {
+        Slot& s = slots()[i];
+        s.acquisitions.store(0, std::memory_order_relaxed);
+        s.contended.store(0, std::memory_order_relaxed);
+        s.wait_ns.store(0, std::memory_order_relaxed);
+        for (auto& h : s.hot) h.store(0, std::memory_order_relaxed);
+    }
+}
+
+inline LockStats collect() {
+    LockStats st;
+    std::vector<uint64_t> bins(HOT_BINS, 0);
+    for (unsigned i = 0; i < SLOTS; ++i) {
+        Slot& s = slots()[i];
+        st.acquisitions += s.acquisitions.load(std::memory_order_relaxed);
+        st.contended += s.contended.load(std::memory_order_relaxed);
+        st.wait_ns += s.wait_ns.load(std::memory_order_relaxed);
+        for (unsigned b = 0; b < HOT_BINS; ++b) bins[b] += s.hot[b].load(std::memory_order_relaxed);
+    }
+    if (st.wait_ns) st.hot_wait_pct = 100.0 * double(*std::max_element(bins.begin(), bins.end())) / double(st.wait_ns);
+    return st;
+}
+
+} // namespace lock_probe
+
+// Used at the top of a lock's blocking acquire: returns right away if the
+// uninstrumented attempt try_expr succeeds, otherwise times the rest of the call.
+#ifdef CHT_INSTRUMENT
+#define CHT_LOCK_PROBE(try_expr) \
+    if (lock_probe::count(try_expr)) return; \
+    lock_probe::Wait cht_lock_wait_(this)
+#define CHT_TRY_LOCK_PROBE(try_expr) lock_probe::count(try_expr)
+#else
+#define CHT_LOCK_PROBE(try_expr) ((void)0)
+#define CHT_TRY_LOCK_PROBE(try_expr) (try_expr)
+#endif
+
+// ---- Chain-length distribution ----
+// hist[n] = buckets holding n entries; grows to the longest chain seen.
+inline void chain_hist_add(std::vector<size_t>& hist, size_t n) {
+    if (hist.size() <= n) hist.resize(n + 1, 0);
+    hist[n]++;
+}
+
+struct ChainStats {
+    double mean = 0.0;   // over non-empty buckets
+    size_t p99 = 0;      // over non-empty buckets
+    size_t max = 0;
+};
+
+inline ChainStats chain_stats(const std::vector<size_t>& hist) {
+    ChainStats st;
+    size_t buckets = 0, entries = 0;
+    for (size_t n = 1; n < hist.size(); ++n) {
+        buckets += hist[n];
+        entries += n * hist[n];
+        if (hist[n]) st.max = n;
+    }
+    if (!buckets) return st;
+    st.mean = double(entries) / double(buckets);
+    size_t rank = size_t(0.99 * double(buckets - 1)) + 1, seen = 0;
+    for (size_t n = 1; n < hist.size(); ++n) {
+        seen += hist[n];
+        if (seen >= rank) { st.p99 = n; break; }
+    }
+    return st;
+}
+
+#endif // INSTRUMENTATION_H
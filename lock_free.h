@@ -2,19 +2,51 @@
 #define LOCK_FREE_H
 
 #include "common.h"
+#include "reclaim.h"
+#include "instrumentation.h"
 #include <atomic>
 #include <memory>
 
-template<typename K, typename V>
+// Harris/Michael lock-free chaining: each bucket is a singly linked list.
+// - remove() first marks the victim's next pointer (logical deletion), then
+//   unlinks it with a CAS on the predecessor; traversals help unlink marked nodes.
+// - Unlinked nodes are retired through epoch-based reclamation (reclaim.h), so
+//   concurrent readers never touch freed memory.
+// - Values are AtomicValue cells: updates are atomic stores, never torn writes.
+// New nodes are pushed at the head; an insert only succeeds if the head is still
+// the one its duplicate scan started from, which keeps keys unique.
+// Nodes come from Alloc (rebound to the node type), the per-thread pool by default.
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>>
 class LockFreeHashTable {
 private:
     struct Node {
         K key;
-        V value;
-        std::atomic<Node*> next;
-        
+        AtomicValue<V> value;
+        std::atomic<Node*> next;   // low bit set = this node is logically deleted
+
         Node(const K& k, const V& v) : key(k), value(v), next(nullptr) {}
     };
+    using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+
+    static Node* make_node(const K& k, const V& v) {
+        NodeAlloc a;
+        Node* n = a.allocate(1);
+        try {
+            ::new (static_cast<void*>(n)) Node(k, v);
+        } catch (...) {
+            a.deallocate(n, 1);
+            throw;
+        }
+        return n;
+    }
+
+    // Also the EBR deleter for retired nodes.
+    static void destroy_node(void* p) {
+        Node* n = static_cast<Node*>(p);
+        n->~Node();
+        NodeAlloc a;
+        a.deallocate(n, 1);
+    }
     
     struct Bucket {
         std::atomic<Node*> head;
@@ -33,116 +65,315 @@ private:
     
     std::vector<Bucket> buckets;
     size_t bucket_count;
-    std::atomic<size_t> element_count;
+    ElementCounter element_count;
     
     size_t hash(const K& key) const {
-        return Hash<K>{}(key) % bucket_count;
+        return HashFn{}(key) & (bucket_count - 1);  // bucket_count is a power of two
+    }
+
+    // Locate key in the list at head, unlinking marked nodes on the way.
+    // On return, cur is the matching node (or nullptr), prev the link that pointed
+    // at it, and first the head value this (final) traversal started from.
+    // Caller must hold an EpochGuard.
+    bool find(std::atomic<Node*>& head, const K& key,
+              std::atomic<Node*>*& prev, Node*& cur, Node*& first) {
+    retry:
+        prev = &head;
+        cur = head.load(std::memory_order_acquire);
+        first = cur;
+        while (cur) {
+            Node* next = cur->next.load(std::memory_order_acquire);
+            if (is_marked(next)) {
+                Node* succ = without_mark(next);
+                Node* expected = cur;
+                if (!prev->compare_exchange_strong(expected, succ, std::memory_order_acq_rel)) goto retry;
+                EpochDomain::instance().retire(cur, &destroy_node);
+                if (prev == &head) first = succ;
+                cur = succ;
+                continue;
+            }
+            if (cur->key == key) return true;
+            prev = &cur->next;
+            cur = next;
+        }
+        return false;
     }
 
 public:
     LockFreeHashTable(size_t bucket_count = 1024) 
-        : bucket_count(bucket_count), element_count(0) {
-        buckets.reserve(bucket_count);
-        for (size_t i = 0; i < bucket_count; ++i) {
+        : bucket_count(next_pow2(bucket_count)), element_count(0) {
+        buckets.reserve(this->bucket_count);
+        for (size_t i = 0; i < this->bucket_count; ++i) {
             buckets.emplace_back();
         }
     }
     
+    // Not safe against concurrent operations; nodes already retired belong to EBR.
     ~LockFreeHashTable() {
         for (size_t i = 0; i < bucket_count; ++i) {
             Node* current = buckets[i].head.load();
             while (current) {
-                Node* next = current->next.load();
-                delete current;
+                Node* next = without_mark(current->next.load());
+                destroy_node(current);
                 current = next;
             }
         }
     }
     
     bool insert(const K& key, const V& value) {
+        EpochGuard guard;
+        auto& head = buckets[hash(key)].head;
+        Node* new_node = nullptr;
 
-
-        size_t idx = hash(key);
-        Node* new_node = new Node(key, value);
-        
         while (true) {
-            Node* head = buckets[idx].head.load();
-            
-            // Check if key already exists
-            Node* current = head;
-            while (current) {
-                if (current->key == key) {
-                    // Key exists, update value (simplified version, should use CAS in practice)
-                    current->value = value;
-                    delete new_node;
-                    return false;
-                }
-                current = current->next.load();
+            std::atomic<Node*>* prev;
+            Node *cur, *first;
+            if (find(head, key, prev, cur, first)) {
+                cur->value.store(value);
+                if (new_node) destroy_node(new_node);
+                return false;
             }
-            
-            // Try to insert at the head of the list
-            new_node->next.store(head);
-            if (buckets[idx].head.compare_exchange_weak(head, new_node)) {
-                element_count++;
+            if (!new_node) new_node = make_node(key, value);
+            new_node->next.store(first, std::memory_order_relaxed);
+            if (head.compare_exchange_weak(first, new_node, std::memory_order_release, std::memory_order_relaxed)) {
+                element_count.add(1);
                 return true;
             }
-            // CAS failed, retry
+            // Head moved (insert or unlink): rescan for duplicates
         }
     }
     
+    // Read-modify-write operations (see common.h). A present value is updated
+    // with a CAS loop, so fn may run more than once and must be side-effect free.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        EpochGuard guard;
+        auto& head = buckets[hash(key)].head;
+        Node* new_node = nullptr;
+
+        while (true) {
+            std::atomic<Node*>* prev;
+            Node *cur, *first;
+            if (find(head, key, prev, cur, first)) {
+                cur->value.update(fn);
+                if (new_node) destroy_node(new_node);
+                return false;
+            }
+            if (!new_node) new_node = make_node(key, init);
+            new_node->next.store(first, std::memory_order_relaxed);
+            if (head.compare_exchange_weak(first, new_node, std::memory_order_release, std::memory_order_relaxed)) {
+                element_count.add(1);
+                return true;
+            }
+        }
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        EpochGuard guard;
+        std::atomic<Node*>* prev;
+        Node *cur, *first;
+        if (!find(buckets[hash(key)].head, key, prev, cur, first)) return false;
+        cur->value.update(fn);
+        return true;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
-        size_t idx = hash(key);
-        Node* current = buckets[idx].head.load();
+        EpochGuard guard;
+        Node* current = buckets[hash(key)].head.load(std::memory_order_acquire);
         
         while (current) {
-            if (current->key == key) {
-                value = current->value;
+            Node* next = current->next.load(std::memory_order_acquire);
+            if (!is_marked(next) && current->key == key) {
+                value = current->value.load();
                 return true;
             }
-            current = current->next.load();
+            current = without_mark(next);
         }
         
         return false;
     }
     
     bool remove(const K& key) {
-        size_t idx = hash(key);
-        
+        EpochGuard guard;
+        auto& head = buckets[hash(key)].head;
+
         while (true) {
-            Node* head = buckets[idx].head.load();
-            Node* current = head;
-            Node* prev = nullptr;
-            
-            // Find the node to delete
-            while (current) {
-                if (current->key == key) {
-                    if (prev == nullptr) {
-                        // Delete head node
-                        if (buckets[idx].head.compare_exchange_weak(head, current->next.load())) {
-                            delete current;
-                            element_count--;
-                            return true;
-                        }
-                    } else {
-                        // Delete middle node (simplified version)
-                        prev->next.store(current->next.load());
-                        delete current;
-                        element_count--;
-                        return true;
-                    }
-                    break;  // Retry
-                }
-                prev = current;
-                current = current->next.load();
+            std::atomic<Node*>* prev;
+            Node *cur, *first;
+            if (!find(head, key, prev, cur, first)) return false;  // Not found
+
+            Node* next = cur->next.load(std::memory_order_acquire);
+            if (is_marked(next)) continue;  // lost the race to another remover; rescan
+            if (!cur->next.compare_exchange_weak(next, with_mark(next), std::memory_order_acq_rel)) continue;
+
+            // Logically deleted; now try to unlink, otherwise let a traversal do it.
+            Node* expected = cur;
+            if (prev->compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+                EpochDomain::instance().retire(cur, &destroy_node);
+            } else {
+                find(head, key, prev, cur, first);
             }
-            
-            if (!current) return false;  // Not found
+            element_count.sub(1);
+            return true;
         }
     }
     
+    // Batched operations: no locks to group, but all bucket heads are prefetched
+    // up front and the whole batch runs inside one epoch critical section.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        EpochGuard guard;
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = hash(keys[i]);
+            prefetch_read(&buckets[sc.hashes[i]]);
+        }
+        size_t added = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bool is_new = insert(keys[i], values[i]);
+            if (inserted) inserted[i] = is_new;
+            added += is_new;
+        }
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        EpochGuard guard;
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = hash(keys[i]);
+            prefetch_read(&buckets[sc.hashes[i]]);
+        }
+        size_t hits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            found[i] = search(keys[i], values[i]);
+            hits += found[i];
+        }
+        return hits;
+    }
+    
+    // Bulk load (see common.h): bucket ranges are filled by one thread each,
+    // with plain stores since nobody else may use the table meanwhile.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkBucketGroups groups(bucket_count);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, groups.count, groups, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t g = 0; g < groups.count; ++g) {
+            for (const BulkEntry* e = part.begin(g); e != part.end(g); ++e) {
+                const auto& src = first[e->index];
+                auto& head = buckets[e->hash & (bucket_count - 1)].head;
+                Node* hit = nullptr;
+                for (Node* c = unique ? nullptr : head.load(std::memory_order_relaxed); c && !hit; ) {
+                    Node* next = c->next.load(std::memory_order_relaxed);
+                    if (!is_marked(next) && c->key == bulk_key(src)) hit = c;
+                    c = without_mark(next);
+                }
+                if (hit) { hit->value.store(bulk_value(src)); continue; }
+                Node* node = make_node(bulk_key(src), bulk_value(src));
+                node->next.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                head.store(node, std::memory_order_relaxed);
+                ++added;
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // Bucket ranges as groups (see common.h), skipping deleted nodes. Each
+    // group is walked under an EpochGuard, so writers may run meanwhile.
+    size_t group_count() const { return BulkBucketGroups(bucket_count).count; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        EpochGuard guard;
+        BulkBucketGroups groups(bucket_count);
+        for (size_t b = groups.first_bucket(g); b < groups.first_bucket(g + 1); ++b) {
+            for (Node* c = buckets[b].head.load(std::memory_order_acquire); c; ) {
+                Node* next = c->next.load(std::memory_order_acquire);
+                if (!is_marked(next)) fn(c->key, c->value.load());
+                c = without_mark(next);
+            }
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Weakly consistent cursor, safe alongside writers (see common.h):
+    //   for (auto it = ht.iterate(); it.valid(); it.next()) use(it.key(), it.value());
+    // It holds an EpochGuard for its whole life, which delays reclamation for
+    // every thread, so keep it short-lived and on the thread that created it.
+    class Iterator {
+        const LockFreeHashTable* table;
+        EpochGuard guard;
+        size_t bucket = 0;
+        Node* node;
+
+        // Moves on to the first live node at or after node.
+        void settle() {
+            while (true) {
+                for (; node; node = without_mark(node->next.load(std::memory_order_acquire))) {
+                    if (!is_marked(node->next.load(std::memory_order_acquire))) return;
+                }
+                if (++bucket >= table->bucket_count) return;
+                node = table->buckets[bucket].head.load(std::memory_order_acquire);
+            }
+        }
+
+    public:
+        explicit Iterator(const LockFreeHashTable& t)
+            : table(&t), node(t.buckets[0].head.load(std::memory_order_acquire)) { settle(); }
+
+        bool valid() const { return node != nullptr; }
+        const K& key() const { return node->key; }
+        V value() const { return node->value.load(); }
+        void next() {
+            node = without_mark(node->next.load(std::memory_order_acquire));
+            settle();
+        }
+    };
+
+    Iterator iterate() const { return Iterator(*this); }
+
     size_t size() const {
         return element_count.load();
     }
+
+    // Memory accounting (see common.h). There is no shrink_to_fit: the
+    // bucket array never grows and removed nodes already go back through EBR.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.buckets = buckets.capacity() * sizeof(Bucket);
+        m.nodes = element_count.load() * sizeof(Node);
+        usage_add_object(m, sizeof(*this));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    // Buckets per chain length (see instrumentation.h); read while no writer is active.
+    std::vector<size_t> chain_length_histogram() const {
+        std::vector<size_t> hist;
+        for (size_t i = 0; i < bucket_count; ++i) {
+            size_t n = 0;
+            for (Node* c = buckets[i].head.load(); c; c = without_mark(c->next.load())) ++n;
+            chain_hist_add(hist, n);
+        }
+        return hist;
+    }
     
     std::string getName() const {
         return "Lock-Free";
@@ -0,0 +1,305 @@
+#ifndef LOCKS_H
+#define LOCKS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <shared_mutex>
+#include <thread>
+#include <omp.h>
+#include "instrumentation.h"
+
+// Lightweight user-space locks used by the striped tables.
+//
+// Every lock here has the same interface, so tables can take the lock type
+// as a template parameter: lock / try_lock / unlock plus lock_shared /
+// try_lock_shared / unlock_shared. RWSpinLock and SharedMutexLock really
+// share; the exclusive-only locks map the shared calls to the exclusive ones.
+// With -DCHT_INSTRUMENT each lock reports acquisitions and wait time to the
+// probes in instrumentation.h; the blocking paths try once uninstrumented
+// (the try_acquire* helpers) so only real waits are timed.
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Spin briefly, then yield so oversubscribed runs still make progress.
+struct SpinBackoff {
+    unsigned spins = 0;
+    void pause() {
+        if (++spins < 64) cpu_relax();
+        else std::this_thread::yield();
+    }
+};
+
+// Reader-writer spinlock: many concurrent readers or one writer.
+// A waiting writer sets PENDING, which holds off new readers so writers are
+// not starved by a steady read stream. 4 bytes; no kernel calls.
+class RWSpinLock {
+    static constexpr uint32_t WRITER  = 1;
+    static constexpr uint32_t PENDING = 2;
+    static constexpr uint32_t READER  = 4;
+    std::atomic<uint32_t> state{0};
+
+    bool try_acquire() {
+        uint32_t s = state.load(std::memory_order_relaxed);
+        return (s & ~PENDING) == 0 &&
+               state.compare_exchange_strong(s, WRITER, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+    bool try_acquire_shared() {
+        uint32_t s = state.fetch_add(READER, std::memory_order_acquire);
+        if (!(s & (WRITER | PENDING))) return true;
+        state.fetch_sub(READER, std::memory_order_relaxed);
+        return false;
+    }
+
+public:
+    RWSpinLock() = default;
+    RWSpinLock(const RWSpinLock&) = delete;
+    RWSpinLock& operator=(const RWSpinLock&) = delete;
+
+    void lock() {
+        CHT_LOCK_PROBE(try_acquire());
+        SpinBackoff backoff;
+        while (true) {
+            uint32_t s = state.load(std::memory_order_relaxed);
+            if ((s & ~PENDING) == 0) {
+                if (state.compare_exchange_weak(s, WRITER, std::memory_order_acquire, std::memory_order_relaxed)) return;
+            } else if (!(s & PENDING)) {
+                state.fetch_or(PENDING, std::memory_order_relaxed);
+            }
+            backoff.pause();
+        }
+    }
+
+    bool try_lock() { return CHT_TRY_LOCK_PROBE(try_acquire()); }
+
+    void unlock() { state.fetch_and(~WRITER, std::memory_order_release); }
+
+    void lock_shared() {
+        CHT_LOCK_PROBE(try_acquire_shared());
+        SpinBackoff backoff;
+        while (true) {
+            uint32_t s = state.fetch_add(READER, std::memory_order_acquire);
+            if (!(s & (WRITER | PENDING))) return;
+            state.fetch_sub(READER, std::memory_order_relaxed);
+            while (state.load(std::memory_order_relaxed) & (WRITER | PENDING)) backoff.pause();
+        }
+    }
+
+    bool try_lock_shared() { return CHT_TRY_LOCK_PROBE(try_acquire_shared()); }
+
+    void unlock_shared() { state.fetch_sub(READER, std::memory_order_release); }
+};
+
+// Exclusive-only locks get their shared calls from here.
+template<typename L>
+struct ExclusiveAsShared {
+    void lock_shared() { static_cast<L*>(this)->lock(); }
+    bool try_lock_shared() { return static_cast<L*>(this)->try_lock(); }
+    void unlock_shared() { static_cast<L*>(this)->unlock(); }
+};
+
+// Test-and-test-and-set spinlock in one byte. Waiters spin on a plain load
+// and back off exponentially (1, 2, 4, ... pauses, then yield).
+class TTASLock : public ExclusiveAsShared<TTASLock> {
+    std::atomic<uint8_t> locked{0};
+
+    bool try_acquire() {
+        return !locked.load(std::memory_order_relaxed) && !locked.exchange(1, std::memory_order_acquire);
+    }
+
+public:
+    TTASLock() = default;
+    TTASLock(const TTASLock&) = delete;
+    TTASLock& operator=(const TTASLock&) = delete;
+
+    void lock() {
+        CHT_LOCK_PROBE(try_acquire());
+        unsigned delay = 1;
+        while (locked.exchange(1, std::memory_order_acquire)) {
+            do {
+                if (delay <= 64) {
+                    for (unsigned i = 0; i < delay; ++i) cpu_relax();
+                    delay *= 2;
+                } else {
+                    std::this_thread::yield();
+                }
+            } while (locked.load(std::memory_order_relaxed));
+        }
+    }
+
+    bool try_lock() { return CHT_TRY_LOCK_PROBE(try_acquire()); }
+
+    void unlock() { locked.store(0, std::memory_order_release); }
+};
+
+// FIFO ticket lock: 4 bytes, waiters back off in proportion to their place in line.
+class TicketLock : public ExclusiveAsShared<TicketLock> {
+    std::atomic<uint16_t> next{0};
+    std::atomic<uint16_t> serving{0};
+
+    bool try_acquire() {
+        uint16_t s = serving.load(std::memory_order_relaxed);
+        uint16_t expected = s;
+        return next.load(std::memory_order_relaxed) == s &&
+               next.compare_exchange_strong(expected, uint16_t(s + 1), std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+public:
+    TicketLock() = default;
+    TicketLock(const TicketLock&) = delete;
+    TicketLock& operator=(const TicketLock&) = delete;
+
+    void lock() {
+        CHT_LOCK_PROBE(try_acquire());
+        uint16_t ticket = next.fetch_add(1, std::memory_order_relaxed);
+        for (unsigned rounds = 0; ; ++rounds) {
+            uint16_t ahead = uint16_t(ticket - serving.load(std::memory_order_acquire));
+            if (ahead == 0) return;
+            if (rounds < 64) {
+                for (unsigned i = 0; i < 8u * ahead; ++i) cpu_relax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool try_lock() { return CHT_TRY_LOCK_PROBE(try_acquire()); }
+
+    void unlock() {
+        serving.store(uint16_t(serving.load(std::memory_order_relaxed) + 1), std::memory_order_release);
+    }
+};
+
+// MCS queue lock: each waiter spins on its own queue node, so a handoff
+// touches one waiter's cache line instead of every waiter's. Nodes come from
+// a small per-thread pool, so a thread may hold up to MAX_HELD MCS locks at once.
+class MCSLock : public ExclusiveAsShared<MCSLock> {
+    struct alignas(64) Node {
+        std::atomic<Node*> next{nullptr};
+        std::atomic<bool> waiting{false};
+    };
+    static constexpr unsigned MAX_HELD = 8;
+
+    struct NodePool {
+        Node nodes[MAX_HELD];
+        unsigned used = 0;   // bitmask of nodes in use
+    };
+    static NodePool& pool() {
+        static thread_local NodePool p;
+        return p;
+    }
+    static Node* acquire_node() {
+        NodePool& p = pool();
+        unsigned i = __builtin_ctz(~p.used);
+        if (i >= MAX_HELD) std::abort();   // more MCS locks held than nodes
+        p.used |= 1u << i;
+        Node* n = &p.nodes[i];
+        n->next.store(nullptr, std::memory_order_relaxed);
+        return n;
+    }
+    static void release_node(Node* n) {
+        NodePool& p = pool();
+        p.used &= ~(1u << unsigned(n - p.nodes));
+    }
+
+    std::atomic<Node*> tail{nullptr};
+    Node* holder = nullptr;   // written and read only by the lock holder
+
+    bool try_acquire() {
+        if (tail.load(std::memory_order_relaxed)) return false;
+        Node* me = acquire_node();
+        Node* expected = nullptr;
+        if (!tail.compare_exchange_strong(expected, me, std::memory_order_acquire, std::memory_order_relaxed)) {
+            release_node(me);
+            return false;
+        }
+        holder = me;
+        return true;
+    }
+
+public:
+    MCSLock() = default;
+    MCSLock(const MCSLock&) = delete;
+    MCSLock& operator=(const MCSLock&) = delete;
+
+    void lock() {
+        CHT_LOCK_PROBE(try_acquire());
+        Node* me = acquire_node();
+        me->waiting.store(true, std::memory_order_relaxed);
+        Node* prev = tail.exchange(me, std::memory_order_acq_rel);
+        if (prev) {
+            prev->next.store(me, std::memory_order_release);
+            SpinBackoff backoff;
+            while (me->waiting.load(std::memory_order_acquire)) backoff.pause();
+        }
+        holder = me;
+    }
+
+    bool try_lock() { return CHT_TRY_LOCK_PROBE(try_acquire()); }
+
+    void unlock() {
+        Node* me = holder;
+        Node* succ = me->next.load(std::memory_order_acquire);
+        if (!succ) {
+            Node* expected = me;
+            if (tail.compare_exchange_strong(expected, nullptr, std::memory_order_release, std::memory_order_relaxed)) {
+                release_node(me);
+                return;
+            }
+            SpinBackoff backoff;   // a successor is linking itself in
+            while (!(succ = me->next.load(std::memory_order_acquire))) backoff.pause();
+        }
+        succ->waiting.store(false, std::memory_order_release);
+        release_node(me);
+    }
+};
+
+// std::shared_mutex behind the common interface (blocks in the kernel when contended).
+class SharedMutexLock {
+    std::shared_mutex m;
+
+public:
+    SharedMutexLock() = default;
+    SharedMutexLock(const SharedMutexLock&) = delete;
+    SharedMutexLock& operator=(const SharedMutexLock&) = delete;
+
+    void lock() {
+        CHT_LOCK_PROBE(m.try_lock());
+        m.lock();
+    }
+    bool try_lock() { return CHT_TRY_LOCK_PROBE(m.try_lock()); }
+    void unlock() { m.unlock(); }
+    void lock_shared() {
+        CHT_LOCK_PROBE(m.try_lock_shared());
+        m.lock_shared();
+    }
+    bool try_lock_shared() { return CHT_TRY_LOCK_PROBE(m.try_lock_shared()); }
+    void unlock_shared() { m.unlock_shared(); }
+};
+
+// OpenMP lock behind the common interface, the original baseline.
+class OmpLock : public ExclusiveAsShared<OmpLock> {
+    omp_lock_t l;
+
+public:
+    OmpLock() { omp_init_lock(&l); }
+    ~OmpLock() { omp_destroy_lock(&l); }
+    OmpLock(const OmpLock&) = delete;
+    OmpLock& operator=(const OmpLock&) = delete;
+
+    void lock() {
+        CHT_LOCK_PROBE(omp_test_lock(&l) != 0);
+        omp_set_lock(&l);
+    }
+    bool try_lock() { return CHT_TRY_LOCK_PROBE(omp_test_lock(&l) != 0); }
+    void unlock() { omp_unset_lock(&l); }
+};
+
+#endif // LOCKS_H
@@ -0,0 +1,102 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP 1
+#endif
+
+// Read-only view of a whole file. Regular files are memory-mapped, so pages
+// are faulted in by whichever thread first touches them and nothing is
+// copied; anything that cannot be mapped (pipes, other platforms) is read
+// into an owned buffer instead. The kernel is told to read ahead unless
+// random_access is set (lookups straight over the file). Movable, not copyable.
+class MappedFile {
+    const char* ptr = nullptr;
+    size_t len = 0;
+    bool mapped = false;
+    bool ok = false;
+    std::vector<char> fallback;
+
+    void release() {
+#ifdef MAPPED_FILE_MMAP
+        if (mapped) munmap(const_cast<char*>(ptr), len);
+#endif
+        ptr = nullptr;
+        len = 0;
+        mapped = false;
+        ok = false;
+        fallback.clear();
+    }
+
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string& path, bool random_access = false) {
+#ifdef MAPPED_FILE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            len = size_t(st.st_size);
+            if (len == 0) {
+                ok = true;  // mmap rejects empty ranges
+            } else {
+                void* p = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    madvise(p, len, random_access ? MADV_RANDOM : MADV_SEQUENTIAL);
+                    ptr = static_cast<const char*>(p);
+                    mapped = ok = true;
+                } else {
+                    len = 0;
+                }
+            }
+        }
+        ::close(fd);
+        if (ok) return;
+#endif
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return;
+        fallback.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        ptr = fallback.data();
+        len = fallback.size();
+        ok = true;
+    }
+
+    ~MappedFile() { release(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& o) noexcept { *this = std::move(o); }
+    MappedFile& operator=(MappedFile&& o) noexcept {
+        if (this != &o) {
+            release();
+            fallback.swap(o.fallback);
+            ptr = o.mapped ? o.ptr : fallback.data();
+            len = o.len;
+            mapped = o.mapped;
+            ok = o.ok;
+            o.ptr = nullptr;
+            o.len = 0;
+            o.mapped = o.ok = false;
+        }
+        return *this;
+    }
+
+    bool valid() const { return ok; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,164 @@
+#ifndef NUMA_PLACEMENT_H
+#define NUMA_PLACEMENT_H
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include <sched.h>
+#include <unistd.h>
+
+#ifdef CHT_LIBNUMA
+#include <numa.h>
+#endif
+
+// NUMA placement for the segmented tables (SegmentBasedHashTable, AGHHashTable).
+//
+// Segments are homed on nodes in contiguous blocks: segment i of n lives on
+// node i * nodes / n. With -DCHT_NUMA a table builds its segments from an
+// OpenMP team, each thread building the segments homed on the node it runs
+// on, so every bucket array is first-touched there. That needs the threads
+// pinned (OMP_PROC_BIND=close/spread, OMP_PLACES=cores). Adding -DCHT_LIBNUMA
+// (and -lnuma) also sets the preferred node while a segment is built or grown,
+// so placement holds whichever thread does it. Without either flag a table
+// still reports a home node per segment, but all memory comes from the
+// constructing thread's node.
+//
+// Environment:
+//   CHT_NUMA_NODES=<n>   use at most n nodes (for sweeps; 1 = no spreading)
+
+// Nodes of the machine as the kernel reports them (1 if unknown).
+inline int numa_machine_nodes() {
+#ifdef CHT_LIBNUMA
+    if (numa_available() >= 0) return numa_num_configured_nodes();
+    return 1;
+#else
+    static const int nodes = [] {
+        int n = 0;
+        while (access(("/sys/devices/system/node/node" + std::to_string(n)).c_str(), F_OK) == 0) ++n;
+        return n > 0 ? n : 1;
+    }();
+    return nodes;
+#endif
+}
+
+// Nodes segments are spread over: the machine's, capped by CHT_NUMA_NODES.
+inline int numa_node_count() {
+    int n = numa_machine_nodes();
+    if (const char* env = std::getenv("CHT_NUMA_NODES")) {
+        int cap = std::atoi(env);
+        if (cap > 0 && cap < n) n = cap;
+    }
+    return n;
+}
+
+#ifndef CHT_LIBNUMA
+// cpu -> node from /sys/devices/system/node/node<N>/cpulist ("0-7,16-23").
+inline const std::vector<int>& numa_cpu_nodes() {
+    static const std::vector<int> map = [] {
+        std::vector<int> m;
+        for (int node = 0; node < numa_machine_nodes(); ++node) {
+            std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!std::getline(in, list)) continue;
+            size_t i = 0;
+            while (i < list.size()) {
+                size_t end = list.find(',', i);
+                if (end == std::string::npos) end = list.size();
+                std::string range = list.substr(i, end - i);
+                size_t dash = range.find('-');
+                int lo = std::atoi(range.c_str());
+                int hi = (dash == std::string::npos) ? lo : std::atoi(range.c_str() + dash + 1);
+                if (hi >= int(m.size())) m.resize(hi + 1, 0);
+                for (int c = lo; c <= hi; ++c) m[c] = node;
+                i = end + 1;
+            }
+        }
+        return m;
+    }();
+    return map;
+}
+#endif
+
+// Node of the CPU the calling thread is running on (0 if unknown).
+inline int numa_current_node() {
+    int cpu = sched_getcpu();
+    if (cpu < 0) return 0;
+#ifdef CHT_LIBNUMA
+    int node = numa_available() >= 0 ? numa_node_of_cpu(cpu) : 0;
+    return node < 0 ? 0 : node;
+#else
+    const std::vector<int>& m = numa_cpu_nodes();
+    return size_t(cpu) < m.size() ? m[cpu] : 0;
+#endif
+}
+
+// Home node of segment seg out of num_segments.
+inline int numa_segment_home(size_t seg, size_t num_segments, int nodes) {
+    return int(seg * size_t(nodes) / num_segments);
+}
+
+// While alive, the calling thread's new pages come from `node` (libnuma only).
+class NumaPreferredScope {
+public:
+    explicit NumaPreferredScope(int node) {
+#ifdef CHT_LIBNUMA
+        active = numa_available() >= 0 && numa_machine_nodes() > 1;
+        if (active) numa_set_preferred(node);
+#else
+        (void)node;
+#endif
+    }
+    ~NumaPreferredScope() {
+#ifdef CHT_LIBNUMA
+        if (active) numa_set_localalloc();
+#endif
+    }
+    NumaPreferredScope(const NumaPreferredScope&) = delete;
+    NumaPreferredScope& operator=(const NumaPreferredScope&) = delete;
+
+private:
+#ifdef CHT_LIBNUMA
+    bool active = false;
+#endif
+};
+
+// Calls build(i, node) for every i < count. With CHT_NUMA each index is built
+// by a thread running on home_of(i) when the team has one; the rest (and
+// everything without CHT_NUMA) are built by the caller. `node` is where the
+// memory was first touched, as far as we can tell.
+template<typename HomeOf, typename Build>
+void numa_build(size_t count, HomeOf home_of, Build build) {
+    std::unique_ptr<std::atomic<bool>[]> built(new std::atomic<bool>[count]);
+    for (size_t i = 0; i < count; ++i) built[i].store(false, std::memory_order_relaxed);
+#ifdef CHT_NUMA
+    if (numa_node_count() > 1) {
+        #pragma omp parallel
+        {
+            int node = numa_current_node();
+            for (size_t i = 0; i < count; ++i) {
+                if (home_of(i) == node && !built[i].exchange(true, std::memory_order_relaxed)) {
+                    NumaPreferredScope scope(node);
+                    build(i, node);
+                }
+            }
+        }
+    }
+#endif
+    int here = numa_current_node();
+    for (size_t i = 0; i < count; ++i) {
+        if (built[i].load(std::memory_order_relaxed)) continue;
+#ifdef CHT_LIBNUMA
+        NumaPreferredScope scope(home_of(i));
+        build(i, numa_machine_nodes() > 1 ? home_of(i) : here);
+#else
+        (void)home_of;
+        build(i, here);
+#endif
+    }
+}
+
+#endif // NUMA_PLACEMENT_H
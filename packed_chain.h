@@ -0,0 +1,237 @@
+#ifndef PACKED_CHAIN_H
+#define PACKED_CHAIN_H
+
+#include "common.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Bucket chains without per-entry nodes, for small trivially copyable types.
+//
+// The list-based tables (sequential, coarse, fine, segment, AGH) take their
+// Chain from ChainFor<K, V, Alloc>. When K and V are trivially copyable and
+// a KeyValue<K, V> fits in 16 bytes (<int,int>, <int,bool>, <long,long>...)
+// that is a PackedChain: the entries sit in one contiguous array, the first
+// one inline in the 16-byte chain itself and the rest in one heap block that
+// doubles as it fills. Removing an entry moves the last one into its place,
+// so there are no tombstones and chains stay unordered. An <int,int> entry
+// costs 8 bytes plus the chain header and growth slack, against a 24-byte
+// list head and a separately allocated node for std::list. Any other type
+// keeps std::list. Either way memory comes from Alloc: the heap block is one
+// Alloc (rebound to KeyValue<K, V>) request of cap entries. Alloc must be
+// stateless, as the chain keeps no copy of it.
+//
+// Lookups compare keys four at a time with no branch per entry; for 4-byte
+// integer keys they compare a cache line of entries (8) per step with SSE2.
+//
+// Compile-time overrides:
+//   -DCHT_LIST_CHAINS   // always use std::list for chains
+
+template<typename K, typename V, typename Alloc = std::allocator<KeyValue<K, V>>>
+class PackedChain {
+    using KV = KeyValue<K, V>;
+    using KVAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<KV>;
+    static constexpr uint32_t INLINE = sizeof(KV) >= sizeof(KV*) ? 1 : uint32_t(sizeof(KV*) / sizeof(KV));
+
+    uint32_t n = 0;
+    uint32_t cap = INLINE;   // > INLINE: entries live in heap
+    union Storage {
+        alignas(KV) unsigned char local[INLINE * sizeof(KV)];
+        KV* heap;
+    } store;
+
+    bool on_heap() const { return cap > INLINE; }
+    KV* slots() { return on_heap() ? store.heap : reinterpret_cast<KV*>(store.local); }
+    const KV* slots() const { return on_heap() ? store.heap : reinterpret_cast<const KV*>(store.local); }
+
+    void grow() {
+        uint32_t new_cap = cap < 4 ? 4 : cap * 2;
+        KV* block = KVAlloc().allocate(new_cap);
+        std::memcpy(static_cast<void*>(block), slots(), n * sizeof(KV));
+        release();
+        store.heap = block;
+        cap = new_cap;
+    }
+
+    void release() {
+        if (on_heap()) KVAlloc().deallocate(store.heap, cap);
+        cap = INLINE;
+    }
+
+    // Index of key among the first n entries, or n. Entries are compared in
+    // groups whose equality bits are or-ed into a mask before one branch.
+    uint32_t index_of(const K& key) const {
+        const KV* d = slots();
+        uint32_t i = 0;
+#if defined(__SSE2__)
+        if constexpr (std::is_integral<K>::value && sizeof(K) == 4 && sizeof(KV) == 8) {
+            const __m128i needle = _mm_set1_epi32(int32_t(key));
+            for (; i + 8 <= n; i += 8) {   // one 64-byte line: lanes alternate key, value
+                const __m128i* p = reinterpret_cast<const __m128i*>(d + i);
+                unsigned m = 0;
+                for (unsigned q = 0; q < 4; ++q) {
+                    unsigned lanes = unsigned(_mm_movemask_ps(_mm_castsi128_ps(
+                        _mm_cmpeq_epi32(_mm_loadu_si128(p + q), needle))));
+                    m |= ((lanes & 1u) | ((lanes >> 1) & 2u)) << (2 * q);
+                }
+                if (m) return i + uint32_t(__builtin_ctz(m));
+            }
+        }
+#endif
+        for (; i + 4 <= n; i += 4) {
+            unsigned m = unsigned(d[i].key == key) | unsigned(d[i + 1].key == key) << 1 |
+                         unsigned(d[i + 2].key == key) << 2 | unsigned(d[i + 3].key == key) << 3;
+            if (m) return i + uint32_t(__builtin_ctz(m));
+        }
+        for (; i < n; ++i) {
+            if (d[i].key == key) return i;
+        }
+        return n;
+    }
+
+public:
+    using value_type = KV;
+    using iterator = KV*;
+    using const_iterator = const KV*;
+
+    PackedChain() = default;
+    ~PackedChain() { release(); }
+
+    PackedChain(PackedChain&& o) noexcept : n(o.n), cap(o.cap), store(o.store) {
+        o.n = 0;
+        o.cap = INLINE;
+    }
+    PackedChain& operator=(PackedChain&& o) noexcept {
+        if (this != &o) {
+            release();
+            n = o.n;
+            cap = o.cap;
+            store = o.store;
+            o.n = 0;
+            o.cap = INLINE;
+        }
+        return *this;
+    }
+    PackedChain(const PackedChain&) = delete;
+    PackedChain& operator=(const PackedChain&) = delete;
+
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    KV* begin() { return slots(); }
+    KV* end() { return slots() + n; }
+    const KV* begin() const { return slots(); }
+    const KV* end() const { return slots() + n; }
+    KV& front() { return slots()[0]; }
+
+    void emplace_back(const K& key, const V& value) {
+        if (n == cap) grow();
+        ::new (static_cast<void*>(slots() + n)) KV(key, value);
+        ++n;
+    }
+
+    // Moves the last entry into pos; iterators past pos are invalidated.
+    void erase(KV* pos) {
+        *pos = slots()[n - 1];
+        if (--n == 0) release();
+    }
+
+    void clear() {
+        n = 0;
+        release();
+    }
+
+    // Bytes of the heap block, 0 while entries are inline.
+    size_t heap_bytes() const { return on_heap() ? size_t(cap) * sizeof(KV) : 0; }
+
+    // Moves the entries back inline if they fit, otherwise into a block of
+    // max(4, n) slots. Returns the bytes handed back to Alloc.
+    size_t shrink_to_fit() {
+        const uint32_t want = n <= INLINE ? INLINE : (n < 4 ? 4 : n);
+        if (!on_heap() || want >= cap) return 0;
+        KV* old = store.heap;
+        const size_t freed = heap_bytes() - (want > INLINE ? size_t(want) * sizeof(KV) : 0);
+        if (want == INLINE) {
+            std::memcpy(static_cast<void*>(store.local), old, n * sizeof(KV));
+        } else {
+            store.heap = KVAlloc().allocate(want);
+            std::memcpy(static_cast<void*>(store.heap), old, n * sizeof(KV));
+        }
+        KVAlloc().deallocate(old, cap);
+        cap = want;
+        return freed;
+    }
+
+    KV* find(const K& key) {
+        uint32_t i = index_of(key);
+        return i < n ? slots() + i : nullptr;
+    }
+    const KV* find(const K& key) const {
+        uint32_t i = index_of(key);
+        return i < n ? slots() + i : nullptr;
+    }
+};
+
+// More specialized than the generic chain_find in common.h.
+template<typename K, typename V, typename Alloc>
+inline KeyValue<K, V>* chain_find(PackedChain<K, V, Alloc>& chain, const K& key) { return chain.find(key); }
+template<typename K, typename V, typename Alloc>
+inline const KeyValue<K, V>* chain_find(const PackedChain<K, V, Alloc>& chain, const K& key) { return chain.find(key); }
+
+#ifdef CHT_LIST_CHAINS
+template<typename K, typename V> struct use_packed_chain : std::false_type {};
+#else
+template<typename K, typename V>
+struct use_packed_chain : std::integral_constant<bool,
+    std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value && sizeof(KeyValue<K, V>) <= 16> {};
+#endif
+
+template<typename K, typename V, typename Alloc>
+using ChainFor = typename std::conditional<use_packed_chain<K, V>::value,
+                                           PackedChain<K, V, Alloc>, std::list<KeyValue<K, V>, Alloc>>::type;
+
+template<typename Chain> struct is_packed_chain : std::false_type {};
+template<typename K, typename V, typename Alloc> struct is_packed_chain<PackedChain<K, V, Alloc>> : std::true_type {};
+
+// Moves every entry of src into the chain dst(h) picks for its hash, leaving
+// src empty: packed entries are copied, list nodes spliced.
+template<typename HashFn, typename Chain, typename DstOf>
+inline void chain_drain(Chain& src, DstOf dst) {
+    if constexpr (is_packed_chain<Chain>::value) {
+        for (const auto& kv : src) dst(HashFn{}(kv.key)).emplace_back(kv.key, kv.value);
+        src.clear();
+    } else {
+        while (!src.empty()) {
+            Chain& to = dst(HashFn{}(src.front().key));
+            to.splice(to.end(), src, src.begin());
+        }
+    }
+}
+
+// Bytes a chain holds outside its bucket (MemoryUsage::nodes): the packed
+// heap block, or one node per list entry.
+template<typename Chain>
+inline size_t chain_node_bytes(const Chain& chain) {
+    if constexpr (is_packed_chain<Chain>::value) {
+        return chain.heap_bytes();
+    } else {
+        return chain.size() * (2 * sizeof(void*) + sizeof(typename Chain::value_type));
+    }
+}
+
+// Drops a packed chain's growth slack; list chains have none. Returns the
+// bytes handed back to Alloc.
+template<typename Chain>
+inline size_t chain_shrink(Chain& chain) {
+    if constexpr (is_packed_chain<Chain>::value) {
+        return chain.shrink_to_fit();
+    } else {
+        (void)chain;
+        return 0;
+    }
+}
+
+#endif // PACKED_CHAIN_H
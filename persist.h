@@ -0,0 +1,327 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "common.h"
+#include "flat_hash_table.h"
+#include "mapped_file.h"
+
+// Saving a table to disk and loading it back, for restarts that skip the
+// rebuild from source data.
+//
+// save_snapshot writes the groups of a table (see common.h) in parallel,
+// each thread to its own byte range of the file, into a temporary file that
+// is renamed over path once complete. Every position in the file is an offset
+// from its start, so it can be mapped anywhere. Keys and values are stored
+// raw, so they must be trivially copyable, and the file is only read back on
+// a machine with the same byte order and type sizes.
+// - Entry layout (chained, lock-free, cuckoo and split-ordered tables): the
+//   KeyValue records of each group, one after the other. load_snapshot maps
+//   the file and bulk_builds any table straight from the mapping.
+// - Flat layout (Flat, Flat-Striped and Snapshot tables): each group's
+//   Robin Hood slot arrays exactly as they are in memory. FlatSnapshotView
+//   searches them in place over the mapping, with no load step at all, and
+//   load_snapshot copies them slot for slot into an empty table of the same
+//   kind and grouping. Any other table rebuilds from the entries instead.
+//
+// File: a 64-byte SnapshotHeader, then uint64 index[groups + 1] (the first
+// record or slot of each group), then the data at data_offset:
+//   entries  count records of record_size bytes
+//   flat     dist[slots], then keys[slots], then values[slots], each region
+//            starting on a 64-byte boundary (slots = index[groups])
+
+struct SnapshotHeader {
+    char magic[8];          // "CHTSNAP" and a NUL
+    uint32_t version;       // 1
+    uint32_t layout;        // SnapshotLayout
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t record_size;   // entry layout only
+    uint32_t reserved;
+    uint64_t count;         // entries in the table
+    uint64_t groups;
+    uint64_t hash_tag;      // flat slots are only reused under the same HashFn
+    uint64_t data_offset;
+};
+static_assert(sizeof(SnapshotHeader) == 64, "snapshot header layout");
+
+enum SnapshotLayout : uint32_t { SNAPSHOT_ENTRIES = 0, SNAPSHOT_FLAT = 1 };
+
+template<typename HT, typename = void>
+struct has_flat_groups : std::false_type {};
+template<typename HT>
+struct has_flat_groups<HT, std::void_t<decltype(std::declval<const HT&>().flat_group(size_t(0)))>> : std::true_type {};
+
+template<typename K, typename HashFn>
+inline uint64_t snapshot_hash_tag() { return uint64_t(HashFn{}(K())) ^ 0x9E3779B97F4A7C15ULL; }
+
+inline uint64_t snapshot_align(uint64_t x) { return (x + 63) & ~uint64_t(63); }
+
+// Offsets of the three flat regions for a file of `slots` slots in total.
+struct FlatRegions {
+    uint64_t dist, keys, values, end;
+    FlatRegions(uint64_t data_offset, uint64_t slots, size_t key_size, size_t value_size)
+        : dist(data_offset),
+          keys(snapshot_align(dist + slots)),
+          values(snapshot_align(keys + slots * key_size)),
+          end(values + slots * value_size) {}
+};
+
+// Positional writes into a file that becomes `path` on commit().
+class SnapshotWriter {
+    std::string path, tmp;
+    std::FILE* f = nullptr;
+    std::atomic<bool> failed{false};
+
+public:
+    explicit SnapshotWriter(const std::string& p) : path(p), tmp(p + ".tmp") {
+        f = std::fopen(tmp.c_str(), "wb");
+        failed = (f == nullptr);
+    }
+    ~SnapshotWriter() {
+        if (f) { std::fclose(f); std::remove(tmp.c_str()); }
+    }
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    bool ok() const { return !failed; }
+
+    // Safe to call from several threads at once.
+    void write_at(const void* p, size_t n, uint64_t offset) {
+        if (failed || n == 0) return;
+#ifdef MAPPED_FILE_MMAP
+        const char* src = static_cast<const char*>(p);
+        while (n) {
+            ssize_t w = ::pwrite(fileno(f), src, n, off_t(offset));
+            if (w <= 0) { failed = true; return; }
+            src += w; n -= size_t(w); offset += uint64_t(w);
+        }
+#else
+        #pragma omp critical(snapshot_writer)
+        {
+            if (std::fseek(f, long(offset), SEEK_SET) != 0 || std::fwrite(p, 1, n, f) != n) failed = true;
+        }
+#endif
+    }
+
+    bool commit() {
+        bool closed = std::fclose(f) == 0;
+        f = nullptr;
+        if (failed || !closed || std::rename(tmp.c_str(), path.c_str()) != 0) {
+            std::remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+// Saves ht to path; false on any I/O error (path is then left untouched).
+// Read while no writer is active, as for_each_in_group requires.
+template<typename HT>
+bool save_snapshot(const HT& ht, const std::string& path) {
+    using K = typename TableTypes<HT>::key_type;
+    using V = typename TableTypes<HT>::value_type;
+    using HashFn = typename TableTypes<HT>::hasher;
+    using Record = KeyValue<K, V>;
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                  "snapshots store keys and values as raw bytes");
+
+    const size_t groups = ht.group_count();
+    std::vector<uint64_t> index(groups + 1, 0);
+    SnapshotHeader hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic, "CHTSNAP", 8);
+    hdr.version = 1;
+    hdr.key_size = uint32_t(sizeof(K));
+    hdr.value_size = uint32_t(sizeof(V));
+    hdr.groups = groups;
+    hdr.hash_tag = snapshot_hash_tag<K, HashFn>();
+    hdr.data_offset = snapshot_align(sizeof(hdr) + index.size() * sizeof(uint64_t));
+    const int threads = bulk_threads(ht.size());
+
+    SnapshotWriter out(path);
+    if (!out.ok()) return false;
+    bool complete = true;
+    if constexpr (has_flat_groups<HT>::value) {
+        hdr.layout = SNAPSHOT_FLAT;
+        for (size_t g = 0; g < groups; ++g) index[g + 1] = index[g] + ht.flat_group(g).capacity;
+        const FlatRegions r(hdr.data_offset, index[groups], sizeof(K), sizeof(V));
+        size_t count = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:count) num_threads(threads)
+        for (size_t g = 0; g < groups; ++g) {
+            FlatSlots<K, V> s = ht.flat_group(g);
+            out.write_at(s.dist, s.capacity, r.dist + index[g]);
+            out.write_at(s.keys, s.capacity * sizeof(K), r.keys + index[g] * sizeof(K));
+            out.write_at(s.values, s.capacity * sizeof(V), r.values + index[g] * sizeof(V));
+            count += s.capacity - size_t(std::count(s.dist, s.dist + s.capacity, uint8_t(0)));
+        }
+        hdr.count = count;
+    } else {
+        hdr.layout = SNAPSHOT_ENTRIES;
+        hdr.record_size = uint32_t(sizeof(Record));
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < groups; ++g) {
+            size_t c = 0;
+            ht.for_each_in_group(g, [&](const K&, const V&) { ++c; });
+            index[g + 1] = c;
+        }
+        for (size_t g = 0; g < groups; ++g) index[g + 1] += index[g];
+        hdr.count = index[groups];
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < groups; ++g) {
+            std::vector<Record> buf;
+            buf.reserve(index[g + 1] - index[g]);
+            ht.for_each_in_group(g, [&](const K& k, const V& v) { buf.emplace_back(k, v); });
+            if (buf.size() != index[g + 1] - index[g]) {   // a writer got in between the passes
+                #pragma omp atomic write
+                complete = false;
+                continue;
+            }
+            out.write_at(buf.data(), buf.size() * sizeof(Record), hdr.data_offset + index[g] * sizeof(Record));
+        }
+    }
+    out.write_at(index.data(), index.size() * sizeof(uint64_t), sizeof(hdr));
+    out.write_at(&hdr, sizeof(hdr), 0);
+    return complete && out.commit();
+}
+
+// A validated view of a snapshot file held by a MappedFile.
+struct SnapshotImage {
+    SnapshotHeader hdr;
+    const uint64_t* index = nullptr;
+    const char* base = nullptr;
+
+    bool parse(const MappedFile& file, size_t key_size, size_t value_size) {
+        if (!file.valid() || file.size() < sizeof(hdr)) return false;
+        std::memcpy(&hdr, file.data(), sizeof(hdr));
+        if (std::memcmp(hdr.magic, "CHTSNAP", 8) != 0 || hdr.version != 1) return false;
+        if (hdr.key_size != key_size || hdr.value_size != value_size || hdr.groups == 0) return false;
+        uint64_t index_end = sizeof(hdr) + (hdr.groups + 1) * sizeof(uint64_t);
+        if (hdr.groups > file.size() || index_end > hdr.data_offset || hdr.data_offset > file.size()) return false;
+        base = file.data();
+        index = reinterpret_cast<const uint64_t*>(base + sizeof(hdr));
+        for (uint64_t g = 0; g < hdr.groups; ++g) {
+            if (index[g] > index[g + 1]) return false;
+        }
+        uint64_t end = hdr.layout == SNAPSHOT_FLAT
+            ? FlatRegions(hdr.data_offset, index[hdr.groups], key_size, value_size).end
+            : hdr.data_offset + index[hdr.groups] * hdr.record_size;
+        if (hdr.layout == SNAPSHOT_ENTRIES && index[hdr.groups] != hdr.count) return false;
+        return (hdr.layout == SNAPSHOT_FLAT || hdr.layout == SNAPSHOT_ENTRIES) && end <= file.size();
+    }
+
+    template<typename K, typename V>
+    FlatSlots<K, V> flat_group(size_t g) const {
+        const FlatRegions r(hdr.data_offset, index[hdr.groups], sizeof(K), sizeof(V));
+        return FlatSlots<K, V>{reinterpret_cast<const uint8_t*>(base + r.dist) + index[g],
+                               reinterpret_cast<const K*>(base + r.keys) + index[g],
+                               reinterpret_cast<const V*>(base + r.values) + index[g],
+                               size_t(index[g + 1] - index[g])};
+    }
+};
+
+// Loads a snapshot into ht (normally empty) with exclusive access; false if
+// the file is missing, damaged, or saved for other key or value types.
+template<typename HT>
+bool load_snapshot(const std::string& path, HT& ht) {
+    using K = typename TableTypes<HT>::key_type;
+    using V = typename TableTypes<HT>::value_type;
+    using HashFn = typename TableTypes<HT>::hasher;
+    using Record = KeyValue<K, V>;
+
+    MappedFile file(path);
+    SnapshotImage img;
+    if (!img.parse(file, sizeof(K), sizeof(V))) return false;
+    const size_t groups = size_t(img.hdr.groups);
+    const bool empty = ht.size() == 0;
+
+    if (img.hdr.layout == SNAPSHOT_ENTRIES) {
+        if (img.hdr.record_size != sizeof(Record)) return false;
+        const Record* first = reinterpret_cast<const Record*>(img.base + img.hdr.data_offset);
+        ht.bulk_build(first, first + img.hdr.count, empty);
+        return true;
+    }
+
+    if constexpr (has_flat_groups<HT>::value) {
+        if (empty && img.hdr.hash_tag == snapshot_hash_tag<K, HashFn>() &&
+            ht.load_flat_groups(groups, [&](size_t g) { return img.flat_group<K, V>(g); })) {
+            return true;
+        }
+    }
+    // A flat image this table cannot take slot for slot: gather its entries.
+    std::vector<uint64_t> start(groups + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(bulk_threads(img.hdr.count))
+    for (size_t g = 0; g < groups; ++g) {
+        FlatSlots<K, V> s = img.flat_group<K, V>(g);
+        start[g + 1] = s.capacity - size_t(std::count(s.dist, s.dist + s.capacity, uint8_t(0)));
+    }
+    for (size_t g = 0; g < groups; ++g) start[g + 1] += start[g];
+    std::vector<std::pair<K, V>> entries(start[groups]);
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(bulk_threads(img.hdr.count))
+    for (size_t g = 0; g < groups; ++g) {
+        FlatSlots<K, V> s = img.flat_group<K, V>(g);
+        size_t out = start[g];
+        for (size_t i = 0; i < s.capacity; ++i) {
+            if (s.dist[i]) entries[out++] = std::make_pair(s.keys[i], s.values[i]);
+        }
+    }
+    ht.bulk_build(entries.begin(), entries.end(), empty);
+    return true;
+}
+
+// Read-only lookups straight over a flat-layout snapshot file: open() maps
+// it and checks the header, and nothing else is read until a search touches
+// its slots, so startup costs the same however big the table is. Searches
+// are safe from any number of threads. HashFn must be the saved table's.
+template<typename K, typename V, typename HashFn = Hash<K>>
+class FlatSnapshotView {
+    MappedFile file;
+    SnapshotImage img;
+    unsigned bits = 0;   // group = top `bits` hash bits, as the flat tables split
+    const uint8_t* dist = nullptr;
+    const K* keys = nullptr;
+    const V* values = nullptr;
+
+public:
+    bool open(const std::string& path) {
+        file = MappedFile(path, true);
+        if (!img.parse(file, sizeof(K), sizeof(V)) || img.hdr.layout != SNAPSHOT_FLAT ||
+            img.hdr.hash_tag != snapshot_hash_tag<K, HashFn>()) return false;
+        bits = 0;
+        while ((uint64_t(1) << bits) < img.hdr.groups) ++bits;
+        if ((uint64_t(1) << bits) != img.hdr.groups) return false;
+        for (uint64_t g = 0; g < img.hdr.groups; ++g) {
+            uint64_t cap = img.index[g + 1] - img.index[g];
+            if (cap == 0 || (cap & (cap - 1))) return false;
+        }
+        FlatSlots<K, V> s = img.flat_group<K, V>(0);
+        dist = s.dist;
+        keys = s.keys;
+        values = s.values;
+        return true;
+    }
+
+    bool search(const K& key, V& value) const {
+        size_t h = HashFn{}(key);
+        size_t g = bits ? h >> (sizeof(size_t) * 8 - bits) : 0;
+        const size_t base = size_t(img.index[g]), mask = size_t(img.index[g + 1]) - base - 1;
+        size_t pos = h & mask;
+        for (unsigned d = 1; ; ++d) {
+            if (dist[base + pos] < d) return false;
+            if (keys[base + pos] == key) { value = values[base + pos]; return true; }
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    size_t size() const { return size_t(img.hdr.count); }
+    size_t group_count() const { return size_t(img.hdr.groups); }
+};
+
+#endif // PERSIST_H
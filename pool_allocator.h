@@ -0,0 +1,173 @@
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Per-thread slab allocator for fixed-size chain nodes.
+//
+// Each thread carves nodes out of slabs and keeps freed nodes on a private
+// free list, so steady-state inserts and removes never reach malloc or a
+// shared lock. A node freed by another thread simply joins that thread's
+// list. When a thread exits, its free list is donated to a global depot that
+// threads draw from before cutting a new slab. Slabs are kept until exit.
+//
+// Compile-time overrides:
+//   -DPOOL_SLAB_BYTES=65536
+//   -DCHT_STD_ALLOCATOR        // list-based tables default to std::allocator
+
+#ifndef POOL_SLAB_BYTES
+#define POOL_SLAB_BYTES 65536
+#endif
+
+template<size_t Size, size_t Align>
+class NodePool {
+    struct FreeNode { FreeNode* next; };
+
+    static constexpr size_t round_up(size_t x, size_t a) { return (x + a - 1) / a * a; }
+    static constexpr size_t ALIGN = Align > alignof(FreeNode) ? Align : alignof(FreeNode);
+    static constexpr size_t BLOCK = round_up(Size > sizeof(FreeNode) ? Size : sizeof(FreeNode), ALIGN);
+    static constexpr size_t PER_SLAB = POOL_SLAB_BYTES / BLOCK > 0 ? POOL_SLAB_BYTES / BLOCK : 1;
+    static_assert(ALIGN <= alignof(std::max_align_t), "over-aligned nodes are not supported");
+
+    struct Depot {
+        std::mutex m;
+        FreeNode* head = nullptr;
+        std::vector<void*> slabs;
+    };
+
+    // Leaked on purpose: nodes may still be freed from static destructors.
+    static Depot& depot() {
+        static Depot* d = new Depot();
+        return *d;
+    }
+
+    struct Cache {
+        FreeNode* free = nullptr;
+        char* bump = nullptr;
+        char* bump_end = nullptr;
+
+        ~Cache() {
+            // Whatever is left of the current slab goes back as free nodes too.
+            for (; bump != bump_end; bump += BLOCK) push(reinterpret_cast<FreeNode*>(bump));
+            donate(free);
+            free = nullptr;
+            alive() = false;
+        }
+
+        void push(FreeNode* n) { n->next = free; free = n; }
+    };
+
+    // Stays readable after Cache is destroyed (trivially destructible).
+    static bool& alive() {
+        static thread_local bool flag = true;
+        return flag;
+    }
+
+    static Cache& cache() {
+        static thread_local Cache c;
+        return c;
+    }
+
+    static void donate(FreeNode* list) {
+        if (!list) return;
+        FreeNode* tail = list;
+        while (tail->next) tail = tail->next;
+        Depot& d = depot();
+        std::lock_guard<std::mutex> g(d.m);
+        tail->next = d.head;
+        d.head = list;
+    }
+
+    static void* refill(Cache& c) {
+        Depot& d = depot();
+        {
+            std::lock_guard<std::mutex> g(d.m);
+            if (d.head) {
+                // Take the whole depot list; it is rarely long.
+                c.free = d.head->next;
+                FreeNode* n = d.head;
+                d.head = nullptr;
+                return n;
+            }
+        }
+        if (c.bump == c.bump_end) {
+            char* slab = static_cast<char*>(::operator new(PER_SLAB * BLOCK));
+            {
+                std::lock_guard<std::mutex> g(d.m);
+                d.slabs.push_back(slab);
+            }
+            c.bump = slab;
+            c.bump_end = slab + PER_SLAB * BLOCK;
+        }
+        void* p = c.bump;
+        c.bump += BLOCK;
+        return p;
+    }
+
+public:
+    static void* allocate() {
+        if (!alive()) return ::operator new(BLOCK);  // thread is shutting down
+        Cache& c = cache();
+        if (c.free) {
+            FreeNode* n = c.free;
+            c.free = n->next;
+            return n;
+        }
+        return refill(c);
+    }
+
+    static void deallocate(void* p) noexcept {
+        FreeNode* n = static_cast<FreeNode*>(p);
+        if (!alive()) {
+            n->next = nullptr;
+            donate(n);
+            return;
+        }
+        cache().push(n);
+    }
+
+    static size_t slab_count() {
+        Depot& d = depot();
+        std::lock_guard<std::mutex> g(d.m);
+        return d.slabs.size();
+    }
+};
+
+// Standard allocator front end: single-object requests (list and table nodes)
+// come from NodePool, anything larger (packed chain blocks, see
+// packed_chain.h) from the global allocator. Stateless, so all instances
+// compare equal and lists may splice between each other.
+template<typename T>
+struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template<typename U> PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n == 1) return static_cast<T*>(NodePool<sizeof(T), alignof(T)>::allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (n == 1) NodePool<sizeof(T), alignof(T)>::deallocate(p);
+        else ::operator delete(p);
+    }
+};
+
+template<typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+template<typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
+
+#ifdef CHT_STD_ALLOCATOR
+template<typename T> using DefaultNodeAllocator = std::allocator<T>;
+#else
+template<typename T> using DefaultNodeAllocator = PoolAllocator<T>;
+#endif
+
+#endif // POOL_ALLOCATOR_H
@@ -0,0 +1,224 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Epoch-based reclamation (EBR) for node-based lock-free structures.
+//
+// Usage:
+//   EpochGuard g;                      // around every traversal/update
+//   ... unlink node ...
+//   EpochDomain::instance().retire(node);
+//
+// A retired node is freed only after the global epoch has advanced twice,
+// i.e. once every thread that was inside a guard when it was unlinked has
+// left it. Guards nest. Thread records are recycled when threads exit, so
+// OpenMP thread pools of any size work without registration.
+
+class EpochDomain {
+public:
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    void enter() {
+        ThreadRecord* rec = local();
+        if (rec->nesting++ == 0) {
+            uint64_t e = global_epoch.load(std::memory_order_relaxed);
+            rec->epoch.store((e << 1) | ACTIVE, std::memory_order_relaxed);
+            // Publish the announcement before reading any shared node pointer.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void exit() {
+        ThreadRecord* rec = local();
+        if (--rec->nesting == 0) {
+            rec->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    void retire(void* p, void (*deleter)(void*)) {
+        ThreadRecord* rec = local();
+        uint64_t e = global_epoch.load(std::memory_order_acquire);
+        Bag& bag = rec->limbo[e % 3];
+        if (bag.epoch != e) {
+            // Anything left in this slot was retired at least three epochs ago.
+            free_bag(bag);
+            bag.epoch = e;
+        }
+        bag.items.push_back(Retired{p, deleter});
+        if (++rec->retire_count % COLLECT_INTERVAL == 0) collect(rec);
+    }
+
+    template<typename T>
+    void retire(T* p) {
+        retire(static_cast<void*>(p), [](void* q) { delete static_cast<T*>(q); });
+    }
+
+    ~EpochDomain() {
+        ThreadRecord* rec = records.load();
+        while (rec) {
+            ThreadRecord* next = rec->next;
+            for (auto& bag : rec->limbo) free_bag(bag);
+            delete rec;
+            rec = next;
+        }
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+private:
+    static constexpr uint64_t ACTIVE = 1;
+    static constexpr unsigned COLLECT_INTERVAL = 64;
+
+    struct Retired {
+        void* p;
+        void (*deleter)(void*);
+    };
+
+    struct Bag {
+        uint64_t epoch = 0;
+        std::vector<Retired> items;
+    };
+
+    struct alignas(64) ThreadRecord {
+        std::atomic<uint64_t> epoch{0};   // (local epoch << 1) | ACTIVE, or 0 when quiescent
+        std::atomic<bool> in_use{true};
+        ThreadRecord* next = nullptr;
+        unsigned nesting = 0;
+        uint64_t retire_count = 0;
+        Bag limbo[3];
+    };
+
+    // Releases the thread's record for reuse when the thread exits.
+    struct LocalHandle {
+        ThreadRecord* rec = nullptr;
+        ~LocalHandle() { if (rec) rec->in_use.store(false, std::memory_order_release); }
+    };
+
+    std::atomic<uint64_t> global_epoch{1};
+    std::atomic<ThreadRecord*> records{nullptr};
+
+    EpochDomain() = default;
+
+    ThreadRecord* local() {
+        static thread_local LocalHandle handle;
+        if (!handle.rec) handle.rec = acquire_record();
+        return handle.rec;
+    }
+
+    ThreadRecord* acquire_record() {
+        for (ThreadRecord* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            bool expected = false;
+            if (!r->in_use.load(std::memory_order_relaxed) &&
+                r->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return r;  // inherits the previous owner's pending limbo bags
+            }
+        }
+        ThreadRecord* r = new ThreadRecord();
+        ThreadRecord* head = records.load(std::memory_order_relaxed);
+        do {
+            r->next = head;
+        } while (!records.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+        return r;
+    }
+
+    // Advance the global epoch if every active thread has observed the current one.
+    bool try_advance() {
+        uint64_t e = global_epoch.load(std::memory_order_acquire);
+        for (ThreadRecord* r = records.load(std::memory_order_acquire); r; r = r->next) {
+            uint64_t le = r->epoch.load(std::memory_order_acquire);
+            if ((le & ACTIVE) && (le >> 1) != e) return false;
+        }
+        return global_epoch.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel);
+    }
+
+    void collect(ThreadRecord* rec) {
+        try_advance();
+        uint64_t e = global_epoch.load(std::memory_order_acquire);
+        for (auto& bag : rec->limbo) {
+            if (!bag.items.empty() && bag.epoch + 2 <= e) free_bag(bag);
+        }
+    }
+
+    static void free_bag(Bag& bag) {
+        for (auto& r : bag.items) r.deleter(r.p);
+        bag.items.clear();
+    }
+};
+
+// RAII critical section for EpochDomain::instance().
+struct EpochGuard {
+    EpochGuard()  { EpochDomain::instance().enter(); }
+    ~EpochGuard() { EpochDomain::instance().exit(); }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+// Low-bit deletion marks on node pointers (Harris-style logical deletion).
+template<typename T> inline bool is_marked(T* p) { return reinterpret_cast<uintptr_t>(p) & 1; }
+template<typename T> inline T* with_mark(T* p) { return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(p) | 1); }
+template<typename T> inline T* without_mark(T* p) { return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(1)); }
+
+// Value cell that readers may load while writers replace it.
+// Small trivially copyable values live inline in a std::atomic; anything else
+// is held by pointer, swapped atomically and the old copy retired through EBR.
+// Callers must be inside an EpochGuard.
+template<typename V, bool Inline = std::is_trivially_copyable<V>::value && sizeof(V) <= sizeof(uint64_t)>
+class AtomicValue {
+    std::atomic<V> v;
+public:
+    explicit AtomicValue(const V& init) : v(init) {}
+    V load() const { return v.load(std::memory_order_acquire); }
+    void store(const V& nv) { v.store(nv, std::memory_order_release); }
+
+    // CAS loop; fn may run more than once.
+    template<typename F>
+    V update(F fn) {
+        V cur = v.load(std::memory_order_acquire);
+        while (true) {
+            V next = cur;
+            fn(next);
+            if (v.compare_exchange_weak(cur, next, std::memory_order_acq_rel, std::memory_order_acquire)) return next;
+        }
+    }
+};
+
+template<typename V>
+class AtomicValue<V, false> {
+    std::atomic<V*> p;
+public:
+    explicit AtomicValue(const V& init) : p(new V(init)) {}
+    ~AtomicValue() { delete p.load(std::memory_order_relaxed); }
+    AtomicValue(const AtomicValue&) = delete;
+    AtomicValue& operator=(const AtomicValue&) = delete;
+
+    V load() const { return *p.load(std::memory_order_acquire); }
+    void store(const V& nv) {
+        V* old = p.exchange(new V(nv), std::memory_order_acq_rel);
+        EpochDomain::instance().retire(old);
+    }
+
+    template<typename F>
+    V update(F fn) {
+        V* cur = p.load(std::memory_order_acquire);
+        while (true) {
+            V* next = new V(*cur);
+            fn(*next);
+            if (p.compare_exchange_weak(cur, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                V result = *next;
+                EpochDomain::instance().retire(cur);
+                return result;
+            }
+            delete next;
+        }
+    }
+};
+
+#endif // RECLAIM_H
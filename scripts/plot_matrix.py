@@ -24,6 +24,9 @@ EXPECTED_COLS = {
     "read_ratio","p_hot","time_s","throughput_mops","speedup","seq_baseline_s"
 }
 
+# Rows from bench_apps (application kernels) get their own figures
+APP_MIXES = ["wordcount", "dedup", "cache"]
+
 # Configuration for headline vs appendix figures
 EXCLUDE_FOR_HEADLINE = {"Coarse", "Coarse-Padded"}  # remove coarse variants from main plots
 LOG_SCALE_FIGS = True
@@ -171,6 +174,25 @@ def efficiency_plot(df, fname, title):
     plt.savefig(fname)
     plt.close()
 
+def app_figures(df):
+    # One strong-scaling figure per app and key distribution; error bars are
+    # bench_apps' 95% confidence intervals.
+    for mix in APP_MIXES:
+        for dist in sorted(df.loc[df["mix"]==mix, "dist"].unique()):
+            sub = df[(df["mix"]==mix) & (df["dist"]==dist)]
+            plt.figure(figsize=(6.3,3.9))
+            for impl, g in sub.groupby("impl"):
+                g = g.sort_values("threads")
+                err = g["throughput_ci95_mops"] if "throughput_ci95_mops" in g.columns else None
+                plt.errorbar(g["threads"], g["throughput_mops"], yerr=err, marker="o", capsize=3, label=impl)
+            plt.title(f"{mix} ({dist}), strong scaling")
+            plt.xlabel("Threads")
+            plt.ylabel("Throughput (Mops/s)")
+            plt.legend(loc="best", fontsize="small")
+            plt.tight_layout()
+            plt.savefig(os.path.join(OUTDIR, f"fig_app_{mix}_{dist}.png"))
+            plt.close()
+
 def main():
     print("[info] Loading matrix CSVs.")
     csvs = discover_matrix_csvs()
@@ -178,6 +200,11 @@ def main():
     df = add_avg_chain(df)
 
     ensure_outdir(OUTDIR)
+    app_figures(df[df["mix"].isin(APP_MIXES)])
+    df = df[~df["mix"].isin(APP_MIXES)]
+    if df.empty:
+        print(f"[done] Figures written to {OUTDIR}/")
+        return
     mix80 = "80/20" if "80/20" in df["mix"].unique() else sorted(df["mix"].unique())[0]
     hiB, midB = pick_top_buckets(df)
     skew_ph = pick_skew_ph(df)
@@ -2,21 +2,58 @@
 set -euo pipefail
 
 if [ $# -ne 1 ]; then
-  echo "Usage: $0 <impl: coarse|fine|segment|lockfree|agh>" >&2
+  echo "Usage: $0 <impl: coarse|fine|segment|lockfree|agh|flat|cuckoo|splitorder|snapshot>" >&2
+  echo "  NUMA_NODES=\"1 2 4\"  sweep NUMA node counts (segment placement + --numa-stats)" >&2
+  echo "  LIBNUMA=1           also bind segment memory with libnuma (needs -lnuma)" >&2
+  echo "  LOCKS=\"ttas mcs\"    one run per lock policy, coarse|fine|segment only (LOCKS=all for every lock)" >&2
+  echo "  INSTRUMENT=1        build with -DCHT_INSTRUMENT and add latency/lock/chain columns (--instrument)" >&2
   exit 1
 fi
 
 IMPL="$1"
+NUMA_NODES="${NUMA_NODES:-}"
+LOCKS="${LOCKS:-}"
 
-g++ -std=c++17 -O3 -fopenmp ../bench_matrix_simple.cpp -o ../bench_matrix_simple
+NUMA_FLAGS=()
+if [ -n "${NUMA_NODES}" ]; then
+  NUMA_FLAGS+=(-DCHT_NUMA)
+  if [ "${LIBNUMA:-0}" = "1" ]; then
+    NUMA_FLAGS+=(-DCHT_LIBNUMA -lnuma)
+  fi
+fi
+
+EXTRA_ARGS=()
+if [ "${INSTRUMENT:-0}" = "1" ]; then
+  NUMA_FLAGS+=(-DCHT_INSTRUMENT)
+  EXTRA_ARGS+=(--instrument)
+fi
+
+g++ -std=c++17 -O3 -fopenmp ../bench_matrix_simple.cpp ${NUMA_FLAGS[@]+"${NUMA_FLAGS[@]}"} -o ../bench_matrix_simple
 
 export OMP_PROC_BIND=close
 export OMP_PLACES=cores
 
-OUT="../results/${IMPL}_matrix.out"
-CSV="../results/${IMPL}_matrix.csv"
-
-./../bench_matrix_simple --impl="${IMPL}" | tee "${OUT}"
+run() {
+  local tag="$1"; shift
+  local out="../results/${IMPL}${tag}_matrix.out"
+  local csv="../results/${IMPL}${tag}_matrix.csv"
+  ./../bench_matrix_simple --impl="${IMPL}" ${EXTRA_ARGS[@]+"${EXTRA_ARGS[@]}"} "$@" | tee "${out}"
+  awk '/CSV_RESULTS_BEGIN/{f=1;next}/CSV_RESULTS_END/{f=0}f' "${out}" > "${csv}"
+  echo "Wrote ${csv} (full log ${out})"
+}
 
-awk '/CSV_RESULTS_BEGIN/{f=1;next}/CSV_RESULTS_END/{f=0}f' "${OUT}" > "${CSV}"
-echo "Wrote ${CSV} (full log ${OUT})"
\ No newline at end of file
+if [ -n "${LOCKS}" ]; then
+  [ "${LOCKS}" = "all" ] && LOCKS="default rwspin ttas ticket mcs shared_mutex omp"
+  for l in ${LOCKS}; do
+    run "_lock-${l}" --lock="${l}"
+  done
+elif [ -z "${NUMA_NODES}" ]; then
+  run ""
+else
+  # spread puts threads on every node, so each node has builders and local work.
+  export OMP_PROC_BIND=spread
+  for n in ${NUMA_NODES}; do
+    export CHT_NUMA_NODES="${n}"
+    run "_numa${n}" --numa-stats
+  done
+fi
@@ -6,6 +6,8 @@ set -euo pipefail
 #   -DSB_DEFAULT_SEGMENTS / -DAGH_DEFAULT_SEGMENTS => S (fixed at 512 by default)
 #   -DAGH_MAX_STRIPES => M in {8,16,32}
 #   -DAGH_STRIPE_FACTOR => F in {1,2,3}
+# AGH now re-stripes each segment at runtime from measured lock contention, so
+# M only caps the stripes per segment and F only picks the starting point.
 #
 # Slices we run:
 #   mode=strong, mix=80/20
@@ -2,10 +2,14 @@
 #define SEGMENT_BASED_H
 
 #include "common.h"
+#include "locks.h"
+#include "numa_placement.h"
+#include "packed_chain.h"
+#include "combining.h"
 #include <vector>
 #include <list>
 #include <atomic>
-#include <omp.h>
+#include <memory>
 
 // Compile-time override:
 //   g++ ... -DSB_DEFAULT_SEGMENTS=256
@@ -13,20 +17,44 @@
 #define SB_DEFAULT_SEGMENTS 512
 #endif
 
-template<typename K, typename V>
+// Per-segment growth: a segment doubles its bucket vector (under its own lock)
+// once its element count exceeds buckets_per_segment * SB_MAX_LOAD_FACTOR.
+// Other segments keep serving traffic. -DSB_MAX_LOAD_FACTOR=0 disables growth.
+#ifndef SB_MAX_LOAD_FACTOR
+#define SB_MAX_LOAD_FACTOR 1.0
+#endif
+
+// Lock: any lock from locks.h, one per segment.
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>,
+         typename Lock = RWSpinLock>
 class SegmentBasedHashTable {
 private:
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
     static const size_t NUM_SEGMENTS = SB_DEFAULT_SEGMENTS;
+    static_assert((NUM_SEGMENTS & (NUM_SEGMENTS - 1)) == 0, "SB_DEFAULT_SEGMENTS must be a power of two");
+
+    static constexpr unsigned log2_segments() {
+        unsigned s = 0;
+        while ((size_t(1) << s) < NUM_SEGMENTS) ++s;
+        return s;
+    }
 
     struct alignas(64) Segment {
-        std::vector<std::list<KeyValue<K,V>>> buckets;
+        std::vector<Chain> buckets;
         size_t buckets_per_segment;
-        omp_lock_t lock;
-        explicit Segment(size_t bps) : buckets_per_segment(bps) {
+        size_t count;             // elements in this segment (guarded by lock)
+        Lock lock;                // shared for search, exclusive for writers
+        // Unlocked copies of (buckets.data(), buckets_per_segment) used only to
+        // aim batch prefetches; a stale pair just prefetches a useless line.
+        std::atomic<const Chain*> hint_data;
+        std::atomic<size_t> hint_bps;
+        int node = 0;             // NUMA node the bucket array was placed on
+        std::unique_ptr<CombiningSlots> combine;   // set while combining is on
+        explicit Segment(size_t bps) : buckets_per_segment(bps), count(0) {
             buckets.resize(buckets_per_segment);
-            omp_init_lock(&lock);
+            hint_data.store(buckets.data(), std::memory_order_relaxed);
+            hint_bps.store(bps, std::memory_order_relaxed);
         }
-        ~Segment() { omp_destroy_lock(&lock); }
         Segment(const Segment&) = delete;
         Segment& operator=(const Segment&) = delete;
         Segment(Segment&&) = delete;
@@ -34,29 +62,98 @@ private:
     };
 
     std::vector<Segment*> segments;
-    std::atomic<size_t> element_count;
+    ElementCounter element_count;
     size_t requested_bucket_count;
 
-    inline size_t segment_index(size_t h) const { return h % NUM_SEGMENTS; }
+    // Segment from the top hash bits, bucket from the bottom ones; both
+    // counts are powers of two, so indexing is a shift and a mask.
+    static size_t segment_index(size_t h) {
+        return log2_segments() ? h >> (sizeof(size_t) * 8 - log2_segments()) : 0;
+    }
+    static size_t bucket_of(size_t h, size_t bps) { return h & (bps - 1); }
 
     inline size_t bucket_in_segment(size_t h, size_t seg) const {
-        // Use higher hash bits to avoid reusing low bits for both segment and bucket
-        size_t bps = segments[seg]->buckets_per_segment;
-        return (h / NUM_SEGMENTS) % bps;
+        return bucket_of(h, segments[seg]->buckets_per_segment);
+    }
+
+    // Caller holds s->lock.
+    void maybe_grow(Segment* s) {
+        if (SB_MAX_LOAD_FACTOR <= 0 || s->count <= s->buckets_per_segment * SB_MAX_LOAD_FACTOR) return;
+        rehash(s, s->buckets_per_segment * 2);
+    }
+
+    // Smallest power-of-two bucket count (>= bps) that holds count under the load factor.
+    static size_t buckets_for(size_t count, size_t bps) {
+        if (SB_MAX_LOAD_FACTOR <= 0) return bps;
+        while (count > bps * SB_MAX_LOAD_FACTOR) bps *= 2;
+        return bps;
+    }
+
+    // Caller holds s->lock (or, in bulk_build, has the table to itself).
+    // List nodes are spliced, not reallocated.
+    void rehash(Segment* s, size_t new_bps) {
+        NumaPreferredScope numa(s->node);
+        std::vector<Chain> grown(new_bps);
+        for (auto& bucket : s->buckets) {
+            chain_drain<HashFn>(bucket, [&](size_t h) -> Chain& { return grown[bucket_of(h, new_bps)]; });
+        }
+        s->buckets.swap(grown);
+        s->buckets_per_segment = new_bps;
+        s->hint_data.store(s->buckets.data(), std::memory_order_relaxed);
+        s->hint_bps.store(new_bps, std::memory_order_relaxed);
+    }
+
+    // Run op (returning bool) with s->lock held exclusively, or shared for
+    // lookups; through s's combining slots when combining is on.
+    template<typename Op>
+    static bool exclusive(Segment* s, Op& op) {
+        if (!s->combine) {
+            s->lock.lock();
+            bool r = op();
+            s->lock.unlock();
+            return r;
+        }
+        return s->combine->run(0, op, [s] { return s->lock.try_lock(); }, [s] { s->lock.unlock(); },
+                               [](uint64_t) { return true; });
+    }
+    template<typename Op>
+    static bool shared(Segment* s, Op& op) {
+        if (!s->combine) {
+            s->lock.lock_shared();
+            bool r = op();
+            s->lock.unlock_shared();
+            return r;
+        }
+        return s->combine->run(0, op, [s] { return s->lock.try_lock_shared(); }, [s] { s->lock.unlock_shared(); },
+                               [](uint64_t) { return true; }, false);
+    }
+
+    // Prefetch the bucket head for batch position j without taking the lock.
+    void prefetch_bucket(const BatchScratch& sc, size_t j, size_t n, bool for_write) const {
+        if (j >= n) return;
+        const Segment* s = segments[BatchScratch::group_of(sc.order[j])];
+        const auto* base = s->hint_data.load(std::memory_order_relaxed);
+        size_t bps = s->hint_bps.load(std::memory_order_relaxed);
+        const void* p = base + bucket_of(sc.hashes[BatchScratch::index_of(sc.order[j])], bps);
+        if (for_write) prefetch_write(p); else prefetch_read(p);
     }
 
 public:
     explicit SegmentBasedHashTable(size_t bucket_count = 1024)
         : element_count(0), requested_bucket_count(bucket_count) {
 
-        size_t base = bucket_count / NUM_SEGMENTS;
-        size_t rem  = bucket_count % NUM_SEGMENTS;
+        // Requested buckets are spread evenly, rounded up to a power of two per segment.
+        size_t bps = next_pow2((bucket_count + NUM_SEGMENTS - 1) / NUM_SEGMENTS);
 
-        segments.reserve(NUM_SEGMENTS);
-        for (size_t i = 0; i < NUM_SEGMENTS; ++i) {
-            size_t bps = base + (i < rem ? 1 : 0);
-            segments.push_back(new Segment(bps));
-        }
+        // Each segment is built on its home node when CHT_NUMA is set.
+        int nodes = numa_node_count();
+        segments.assign(NUM_SEGMENTS, nullptr);
+        numa_build(NUM_SEGMENTS,
+                   [&](size_t i) { return numa_segment_home(i, NUM_SEGMENTS, nodes); },
+                   [&](size_t i, int node) {
+                       segments[i] = new Segment(bps);
+                       segments[i]->node = node;
+                   });
     }
 
     SegmentBasedHashTable(const SegmentBasedHashTable&) = delete;
@@ -69,53 +166,268 @@ public:
     }
 
     bool insert(const K& key, const V& value) {
-        size_t h = Hash<K>{}(key);
-        size_t seg = segment_index(h);
-        Segment* s = segments[seg];
-        omp_set_lock(&s->lock);
-        auto& bucket = s->buckets[bucket_in_segment(h, seg)];
-        for (auto& kv : bucket) {
-            if (kv.key == key) { kv.value = value; omp_unset_lock(&s->lock); return false; }
-        }
-        bucket.emplace_back(key, value);
-        element_count.fetch_add(1, std::memory_order_relaxed);
-        omp_unset_lock(&s->lock);
-        return true;
+        size_t h = HashFn{}(key);
+        Segment* s = segments[segment_index(h)];
+        auto op = [&] {
+            auto& bucket = s->buckets[bucket_of(h, s->buckets_per_segment)];
+            if (auto* kv = chain_find(bucket, key)) { kv->value = value; return false; }
+            bucket.emplace_back(key, value);
+            s->count++;
+            maybe_grow(s);
+            element_count.add(1);
+            return true;
+        };
+        return exclusive(s, op);
+    }
+
+    // Read-modify-write operations (see common.h), one lock acquisition each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        size_t h = HashFn{}(key);
+        Segment* s = segments[segment_index(h)];
+        auto op = [&] {
+            auto& bucket = s->buckets[bucket_of(h, s->buckets_per_segment)];
+            if (auto* kv = chain_find(bucket, key)) {
+                fn(kv->value);
+                return false;
+            }
+            bucket.emplace_back(key, init);
+            s->count++;
+            maybe_grow(s);
+            element_count.add(1);
+            return true;
+        };
+        return exclusive(s, op);
     }
 
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        size_t h = HashFn{}(key);
+        Segment* s = segments[segment_index(h)];
+        auto op = [&] {
+            auto* kv = chain_find(s->buckets[bucket_of(h, s->buckets_per_segment)], key);
+            if (kv) fn(kv->value);
+            return kv != nullptr;
+        };
+        return exclusive(s, op);
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
-        size_t h = Hash<K>{}(key);
-        size_t seg = segment_index(h);
-        Segment* s = segments[seg];
-        omp_set_lock(&s->lock);
-        const auto& bucket = s->buckets[bucket_in_segment(h, seg)];
-        for (const auto& kv : bucket) {
-            if (kv.key == key) { value = kv.value; omp_unset_lock(&s->lock); return true; }
-        }
-        omp_unset_lock(&s->lock);
-        return false;
+        size_t h = HashFn{}(key);
+        Segment* s = segments[segment_index(h)];
+        auto op = [&] {
+            const auto* kv = chain_find(s->buckets[bucket_of(h, s->buckets_per_segment)], key);
+            if (kv) value = kv->value;
+            return kv != nullptr;
+        };
+        return shared(s, op);
     }
 
     bool remove(const K& key) {
-        size_t h = Hash<K>{}(key);
-        size_t seg = segment_index(h);
-        Segment* s = segments[seg];
-        omp_set_lock(&s->lock);
-        auto& bucket = s->buckets[bucket_in_segment(h, seg)];
-        for (auto it = bucket.begin(); it != bucket.end(); ++it) {
-            if (it->key == key) {
-                bucket.erase(it);
-                element_count.fetch_sub(1, std::memory_order_relaxed);
-                omp_unset_lock(&s->lock);
-                return true;
+        size_t h = HashFn{}(key);
+        Segment* s = segments[segment_index(h)];
+        auto op = [&] {
+            auto& bucket = s->buckets[bucket_of(h, s->buckets_per_segment)];
+            for (auto it = bucket.begin(); it != bucket.end(); ++it) {
+                if (it->key == key) {
+                    bucket.erase(it);
+                    s->count--;
+                    element_count.sub(1);
+                    return true;
+                }
             }
+            return false;
+        };
+        return exclusive(s, op);
+    }
+
+    // Batched operations: keys are grouped by segment so each segment lock is
+    // taken once per batch; buckets are prefetched a few keys ahead of the walk.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            size_t seg = segment_index(sc.hashes[i]);
+            prefetch_write(segments[seg]);
+            sc.add(i, seg);
         }
-        omp_unset_lock(&s->lock);
-        return false;
+        sc.sort(n, NUM_SEGMENTS);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, true);
+
+        size_t added = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t seg = BatchScratch::group_of(sc.order[g]);
+            Segment* s = segments[seg];
+            size_t end = g;
+            while (end < n && BatchScratch::group_of(sc.order[end]) == seg) ++end;
+
+            s->lock.lock();
+            for (; g < end; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, true);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                auto& bucket = s->buckets[bucket_in_segment(sc.hashes[i], seg)];
+                auto* kv = chain_find(bucket, keys[i]);
+                bool is_new = kv == nullptr;
+                if (kv) kv->value = values[i];
+                if (is_new) {
+                    bucket.emplace_back(keys[i], values[i]);
+                    s->count++;
+                    maybe_grow(s);
+                }
+                if (inserted) inserted[i] = is_new;
+                added += is_new;
+            }
+            s->lock.unlock();
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            size_t seg = segment_index(sc.hashes[i]);
+            prefetch_read(segments[seg]);
+            sc.add(i, seg);
+        }
+        sc.sort(n, NUM_SEGMENTS);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, false);
+
+        size_t hits = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t seg = BatchScratch::group_of(sc.order[g]);
+            Segment* s = segments[seg];
+            size_t end = g;
+            while (end < n && BatchScratch::group_of(sc.order[end]) == seg) ++end;
+
+            s->lock.lock_shared();
+            for (; g < end; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, false);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                const auto* kv = chain_find(s->buckets[bucket_in_segment(sc.hashes[i], seg)], keys[i]);
+                found[i] = kv != nullptr;
+                if (kv) values[i] = kv->value;
+                hits += found[i];
+            }
+            s->lock.unlock_shared();
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h): one group per segment, grown once to its
+    // final size and then filled by one thread on the segment's NUMA node.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, NUM_SEGMENTS, [](size_t h) { return segment_index(h); }, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t seg = 0; seg < NUM_SEGMENTS; ++seg) {
+            Segment* s = segments[seg];
+            size_t bps = buckets_for(s->count + part.group_size(seg), s->buckets_per_segment);
+            if (bps != s->buckets_per_segment) rehash(s, bps);
+            NumaPreferredScope numa(s->node);
+            for (const BulkEntry* e = part.begin(seg); e != part.end(seg); ++e) {
+                bool is_new = bulk_append(s->buckets[bucket_of(e->hash, bps)], first[e->index], unique);
+                s->count += is_new;
+                added += is_new;
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // One group per segment (see common.h); read while no writer is active.
+    static constexpr size_t group_count() { return NUM_SEGMENTS; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        for (const auto& chain : segments[g]->buckets) {
+            for (const auto& kv : chain) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    size_t size() const { return element_count.load(); }
+
+    // Memory accounting (see common.h). locks and padding include the
+    // combining slots while combining is on.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        for (const Segment* s : segments) {
+            m.buckets += s->buckets.capacity() * sizeof(Chain);
+            for (const auto& chain : s->buckets) m.nodes += chain_node_bytes(chain);
+            const size_t header = sizeof(s->buckets) + sizeof(s->buckets_per_segment) + sizeof(s->count) +
+                                  sizeof(s->hint_data) + sizeof(s->hint_bps) + sizeof(s->node) + sizeof(s->combine);
+            m.locks += sizeof(Lock);
+            m.padding += sizeof(Segment) - header - sizeof(Lock);
+            m.other += header;
+            if (s->combine) m.locks += sizeof(CombiningSlots);
+        }
+        usage_add_object(m, sizeof(*this) + segments.capacity() * sizeof(Segment*));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    // Rehashes each segment, under its own lock, down to the fewest buckets
+    // that hold its count (never below the constructor's), then drops chain
+    // slack; see common.h.
+    size_t shrink_to_fit() {
+        const size_t min_bps = next_pow2((requested_bucket_count + NUM_SEGMENTS - 1) / NUM_SEGMENTS);
+        size_t freed = 0;
+        for (Segment* s : segments) {
+            s->lock.lock();
+            const size_t before = s->buckets.capacity() * sizeof(Chain);
+            const size_t bps = buckets_for(s->count, min_bps);
+            if (bps < s->buckets_per_segment) rehash(s, bps);
+            freed += before - s->buckets.capacity() * sizeof(Chain);
+            for (auto& chain : s->buckets) freed += chain_shrink(chain);
+            s->lock.unlock();
+        }
+        return freed;
+    }
+
+    // Flat combining (see combining.h) for insert, upsert and friends, remove
+    // and search; batched operations keep taking the lock. Switch it while
+    // no other thread uses the table.
+    void set_combining(bool on) {
+        for (auto s : segments) s->combine.reset(on ? new CombiningSlots() : nullptr);
+    }
+    bool combining() const { return segments[0]->combine != nullptr; }
+
+    // Buckets per chain length (see instrumentation.h); read while no writer is active.
+    std::vector<size_t> chain_length_histogram() const {
+        std::vector<size_t> hist;
+        for (auto s : segments) {
+            for (const auto& chain : s->buckets) chain_hist_add(hist, chain.size());
+        }
+        return hist;
+    }
+    // Current total (grows with load); read while no writer is active for an exact value.
+    size_t effective_bucket_count() const {
+        size_t total = 0;
+        for (auto s : segments) total += s->buckets_per_segment;
+        return total;
     }
+    // NUMA placement (see numa_placement.h).
+    static constexpr size_t segment_count() { return NUM_SEGMENTS; }
+    size_t segment_of(const K& key) const { return segment_index(HashFn{}(key)); }
+    int segment_node(size_t seg) const { return segments[seg]->node; }
 
-    size_t size() const { return element_count.load(std::memory_order_relaxed); }
-    size_t effective_bucket_count() const { return requested_bucket_count; } // exact now
     std::string getName() const { return "Segment-Based-Exact"; }
 };
 
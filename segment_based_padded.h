@@ -2,14 +2,16 @@
 #define SEGMENT_BASED_PADDED_H
 
 #include "common.h"
+#include "packed_chain.h"
 
-template<typename K, typename V>
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>>
 class SegmentBasedHashTablePadded {
 private:
-    static const size_t NUM_SEGMENTS = 16;
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
+    static const size_t NUM_SEGMENTS = 16;   // getSegmentIndex takes 4 hash bits
 
     struct alignas(64) Segment {
-        std::vector<std::list<KeyValue<K,V>>> buckets;
+        std::vector<Chain> buckets;
         omp_lock_t lock;
         size_t buckets_per_segment;
         Segment(size_t bps) : buckets_per_segment(bps) {
@@ -23,20 +25,28 @@ private:
 
     std::vector<Segment*> segments;
     size_t total_buckets;
-    std::atomic<size_t> element_count;
+    ElementCounter element_count;
 
+    // Top 4 hash bits pick the segment, low bits the bucket (bps is a power of two).
+    static size_t segment_of(size_t h) { return h >> (sizeof(size_t) * 8 - 4); }
     size_t getSegmentIndex(const K& key) const {
-        return Hash<K>{}(key) % NUM_SEGMENTS;
+        return segment_of(HashFn{}(key));
     }
     size_t getBucketIndex(const K& key, size_t bps) const {
-        return Hash<K>{}(key) % bps;
+        return HashFn{}(key) & (bps - 1);
+    }
+
+    void prefetch_bucket(const BatchScratch& sc, size_t j, size_t n, bool for_write) const {
+        if (j >= n) return;
+        const Segment* s = segments[BatchScratch::group_of(sc.order[j])];
+        const Chain* c = &s->buckets[sc.hashes[BatchScratch::index_of(sc.order[j])] & (s->buckets_per_segment - 1)];
+        if (for_write) prefetch_write(c); else prefetch_read(c);
     }
 
 public:
     SegmentBasedHashTablePadded(size_t bucket_count = 1024)
         : total_buckets(bucket_count), element_count(0) {
-        size_t bps = bucket_count / NUM_SEGMENTS;
-        if (bps == 0) bps = 1;
+        size_t bps = next_pow2((bucket_count + NUM_SEGMENTS - 1) / NUM_SEGMENTS);
         for (size_t i = 0; i < NUM_SEGMENTS; ++i) {
             segments.push_back(new Segment(bps));
         }
@@ -56,11 +66,42 @@ public:
             if (kv.key == key) { kv.value = value; omp_unset_lock(&seg->lock); return false; }
         }
         bucket.emplace_back(key, value);
-        element_count++;
+        element_count.add(1);
         omp_unset_lock(&seg->lock);
         return true;
     }
 
+    // Read-modify-write operations (see common.h), one lock acquisition each.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        Segment* seg = segments[getSegmentIndex(key)];
+        omp_set_lock(&seg->lock);
+        auto& bucket = seg->buckets[getBucketIndex(key, seg->buckets_per_segment)];
+        bool inserted = false;
+        if (auto* kv = chain_find(bucket, key)) {
+            fn(kv->value);
+        } else {
+            bucket.emplace_back(key, init);
+            element_count.add(1);
+            inserted = true;
+        }
+        omp_unset_lock(&seg->lock);
+        return inserted;
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        Segment* seg = segments[getSegmentIndex(key)];
+        omp_set_lock(&seg->lock);
+        auto* kv = chain_find(seg->buckets[getBucketIndex(key, seg->buckets_per_segment)], key);
+        if (kv) fn(kv->value);
+        omp_unset_lock(&seg->lock);
+        return kv != nullptr;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
         size_t seg_idx = getSegmentIndex(key);
         Segment* seg = segments[seg_idx];
@@ -83,7 +124,7 @@ public:
         for (auto it = bucket.begin(); it != bucket.end(); ++it) {
             if (it->key == key) {
                 bucket.erase(it);
-                element_count--;
+                element_count.sub(1);
                 omp_unset_lock(&seg->lock);
                 return true;
             }
@@ -92,6 +133,131 @@ public:
         return false;
     }
 
+    // Batched operations: keys are grouped by segment so each segment lock is
+    // taken once per batch; buckets are prefetched a few keys ahead of the walk.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            sc.add(i, segment_of(sc.hashes[i]));
+        }
+        sc.sort(n, NUM_SEGMENTS);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, true);
+
+        size_t added = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t seg = BatchScratch::group_of(sc.order[g]);
+            Segment* s = segments[seg];
+            omp_set_lock(&s->lock);
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == seg; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, true);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                auto& bucket = s->buckets[sc.hashes[i] & (s->buckets_per_segment - 1)];
+                auto* kv = chain_find(bucket, keys[i]);
+                bool is_new = kv == nullptr;
+                if (kv) kv->value = values[i];
+                if (is_new) bucket.emplace_back(keys[i], values[i]);
+                if (inserted) inserted[i] = is_new;
+                added += is_new;
+            }
+            omp_unset_lock(&s->lock);
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            sc.add(i, segment_of(sc.hashes[i]));
+        }
+        sc.sort(n, NUM_SEGMENTS);
+        for (size_t j = 0; j < BATCH_PREFETCH_DISTANCE; ++j) prefetch_bucket(sc, j, n, false);
+
+        size_t hits = 0;
+        for (size_t g = 0; g < n; ) {
+            uint32_t seg = BatchScratch::group_of(sc.order[g]);
+            Segment* s = segments[seg];
+            omp_set_lock(&s->lock);
+            for (; g < n && BatchScratch::group_of(sc.order[g]) == seg; ++g) {
+                prefetch_bucket(sc, g + BATCH_PREFETCH_DISTANCE, n, false);
+                uint32_t i = BatchScratch::index_of(sc.order[g]);
+                const auto* kv = chain_find(s->buckets[sc.hashes[i] & (s->buckets_per_segment - 1)], keys[i]);
+                found[i] = kv != nullptr;
+                if (kv) values[i] = kv->value;
+                hits += found[i];
+            }
+            omp_unset_lock(&s->lock);
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h): one group per segment, filled by one thread.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, NUM_SEGMENTS, [](size_t h) { return segment_of(h); }, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t seg = 0; seg < NUM_SEGMENTS; ++seg) {
+            Segment* s = segments[seg];
+            for (const BulkEntry* e = part.begin(seg); e != part.end(seg); ++e) {
+                added += bulk_append(s->buckets[e->hash & (s->buckets_per_segment - 1)], first[e->index], unique);
+            }
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    // One group per segment (see common.h); read while no writer is active.
+    static constexpr size_t group_count() { return NUM_SEGMENTS; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        for (const auto& chain : segments[g]->buckets) {
+            for (const auto& kv : chain) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Memory accounting (see common.h). Segments do not grow, so
+    // shrink_to_fit only drops chain slack, one segment lock at a time.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        for (const Segment* s : segments) {
+            m.buckets += s->buckets.capacity() * sizeof(Chain);
+            for (const auto& chain : s->buckets) m.nodes += chain_node_bytes(chain);
+            const size_t header = sizeof(s->buckets) + sizeof(s->buckets_per_segment);
+            m.locks += sizeof(omp_lock_t);
+            m.padding += sizeof(Segment) - header - sizeof(omp_lock_t);
+            m.other += header;
+        }
+        usage_add_object(m, sizeof(*this) + segments.capacity() * sizeof(Segment*));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    size_t shrink_to_fit() {
+        size_t freed = 0;
+        for (Segment* s : segments) {
+            omp_set_lock(&s->lock);
+            for (auto& chain : s->buckets) freed += chain_shrink(chain);
+            omp_unset_lock(&s->lock);
+        }
+        return freed;
+    }
+
     size_t size() const { return element_count.load(); }
     std::string getName() const { return "Segment-Based-Padded"; }
 };
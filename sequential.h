@@ -2,21 +2,23 @@
 #define SEQUENTIAL_H
 
 #include "common.h" // Use common.h for Hash and KeyValue structs
+#include "packed_chain.h"
 
-template<typename K, typename V>
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>>
 class SequentialHashTable {
 private:
-    std::vector<std::list<KeyValue<K, V>>> buckets;
+    using Chain = ChainFor<K, V, Alloc>;  // see packed_chain.h
+    std::vector<Chain> buckets;
     size_t bucket_count;
     size_t element_count;
     
     size_t hash(const K& key) const {
-        return Hash<K>{}(key) % bucket_count;
+        return HashFn{}(key) & (bucket_count - 1);  // bucket_count is a power of two
     }
 
 public:
     SequentialHashTable(size_t b_count = 1024) 
-        : bucket_count(b_count), element_count(0) {
+        : bucket_count(next_pow2(b_count)), element_count(0) {
         buckets.resize(bucket_count);
     }
     
@@ -26,11 +28,9 @@ public:
         size_t idx = hash(key);
         auto& bucket = buckets[idx];
         
-        for (auto& kv : bucket) {
-            if (kv.key == key) {
-                kv.value = value;
-                return false; 
-            }
+        if (auto* kv = chain_find(bucket, key)) {
+            kv->value = value;
+            return false;
         }
         
         bucket.emplace_back(key, value);
@@ -38,15 +38,36 @@ public:
         return true;
     }
     
+    // Read-modify-write operations (see common.h).
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        auto& bucket = buckets[hash(key)];
+        if (auto* kv = chain_find(bucket, key)) {
+            fn(kv->value);
+            return false;
+        }
+        bucket.emplace_back(key, init);
+        element_count++;
+        return true;
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        auto* kv = chain_find(buckets[hash(key)], key);
+        if (kv) fn(kv->value);
+        return kv != nullptr;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
     bool search(const K& key, V& value) const {
         size_t idx = hash(key);
         const auto& bucket = buckets[idx];
         
-        for (const auto& kv : bucket) {
-            if (kv.key == key) {
-                value = kv.value;
-                return true;
-            }
+        if (const auto* kv = chain_find(bucket, key)) {
+            value = kv->value;
+            return true;
         }
         
         return false;
@@ -67,6 +88,78 @@ public:
         return false;
     }
     
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        size_t added = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bool is_new = insert(keys[i], values[i]);
+            if (inserted) inserted[i] = is_new;
+            added += is_new;
+        }
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        size_t hits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            found[i] = search(keys[i], values[i]);
+            hits += found[i];
+        }
+        return hits;
+    }
+    
+    // Bulk load (see common.h): bucket ranges are filled by one thread each.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        BulkBucketGroups groups(bucket_count);
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, groups.count, groups, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t g = 0; g < groups.count; ++g) {
+            for (const BulkEntry* e = part.begin(g); e != part.end(g); ++e) {
+                added += bulk_append(buckets[e->hash & (bucket_count - 1)], first[e->index], unique);
+            }
+        }
+        element_count += added;
+        return added;
+    }
+
+    // Bucket ranges as groups (see common.h); read while no writer is active.
+    size_t group_count() const { return BulkBucketGroups(bucket_count).count; }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        BulkBucketGroups groups(bucket_count);
+        for (size_t b = groups.first_bucket(g); b < groups.first_bucket(g + 1); ++b) {
+            for (const auto& kv : buckets[b]) fn(kv.key, kv.value);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    // Memory accounting (see common.h).
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        m.buckets = buckets.capacity() * sizeof(Chain);
+        for (const auto& chain : buckets) m.nodes += chain_node_bytes(chain);
+        m.other = sizeof(*this);
+        m.entries = element_count;
+        return m;
+    }
+
+    size_t shrink_to_fit() {
+        size_t freed = 0;
+        for (auto& chain : buckets) freed += chain_shrink(chain);
+        return freed;
+    }
+
     size_t size() const {
         return element_count;
     }
@@ -0,0 +1,76 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Element counters for the concurrent tables.
+//
+// ShardedCounter spreads updates over padded per-thread slots, so inserts and
+// removes on independent buckets no longer bounce one shared cache line.
+// load() sums the slots: exact once updates have stopped, approximate (but
+// never negative) while they are running.
+// ExactCounter is the single shared atomic, for callers that need a
+// linearizable size() while the table is being modified.
+//
+// Compile-time overrides:
+//   -DCHT_EXACT_SIZE           // tables count with ExactCounter
+//   -DCHT_COUNTER_SLOTS=64     // slots per ShardedCounter (threads share slots modulo this)
+
+#ifndef CHT_COUNTER_SLOTS
+#define CHT_COUNTER_SLOTS 64
+#endif
+
+// Stable small id per thread, handed out on first use.
+inline unsigned counter_slot() {
+    static std::atomic<unsigned> next{0};
+    static thread_local unsigned id = next.fetch_add(1, std::memory_order_relaxed);
+    return id % CHT_COUNTER_SLOTS;
+}
+
+class ShardedCounter {
+    struct alignas(64) Slot { std::atomic<int64_t> v{0}; };
+    Slot slots[CHT_COUNTER_SLOTS];
+
+public:
+    explicit ShardedCounter(size_t init = 0) { slots[0].v.store(int64_t(init), std::memory_order_relaxed); }
+    ShardedCounter(const ShardedCounter&) = delete;
+    ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+    // Slots are usually private to one thread, but may be shared, hence the RMW.
+    void add(size_t d) { slots[counter_slot()].v.fetch_add(int64_t(d), std::memory_order_relaxed); }
+    void sub(size_t d) { slots[counter_slot()].v.fetch_sub(int64_t(d), std::memory_order_relaxed); }
+
+    // A thread may remove keys another thread counted, so slots can be negative.
+    size_t load() const {
+        int64_t sum = 0;
+        for (const auto& s : slots) sum += s.v.load(std::memory_order_relaxed);
+        return sum > 0 ? size_t(sum) : 0;
+    }
+
+    // Alignment filler inside the object (MemoryUsage::padding).
+    static constexpr size_t padding_bytes() { return CHT_COUNTER_SLOTS * (sizeof(Slot) - sizeof(std::atomic<int64_t>)); }
+};
+
+class ExactCounter {
+    std::atomic<size_t> v;
+
+public:
+    explicit ExactCounter(size_t init = 0) : v(init) {}
+    ExactCounter(const ExactCounter&) = delete;
+    ExactCounter& operator=(const ExactCounter&) = delete;
+
+    void add(size_t d) { v.fetch_add(d, std::memory_order_relaxed); }
+    void sub(size_t d) { v.fetch_sub(d, std::memory_order_relaxed); }
+    size_t load() const { return v.load(std::memory_order_relaxed); }
+    static constexpr size_t padding_bytes() { return 0; }
+};
+
+#ifdef CHT_EXACT_SIZE
+using ElementCounter = ExactCounter;
+#else
+using ElementCounter = ShardedCounter;
+#endif
+
+#endif // SHARDED_COUNTER_H
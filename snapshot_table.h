@@ -0,0 +1,395 @@
+#ifndef SNAPSHOT_TABLE_H
+#define SNAPSHOT_TABLE_H
+
+#include "common.h"
+#include "flat_hash_table.h"
+#include "locks.h"
+#include "reclaim.h"
+#include <atomic>
+#include <memory>
+
+// Read-optimized table for lookup-dominated workloads (RCU-style snapshots).
+//
+// The key space is split into segments by the top hash bits. Each segment is
+// an immutable FlatHashTable published through an atomic pointer: a writer
+// copies the segment, applies its change to the copy, publishes it with one
+// release store and retires the old copy through EBR (reclaim.h). A lookup is
+// an epoch enter, two pointer loads and a flat probe, so it is wait-free and
+// writes nothing but its own thread's epoch record.
+// Writers serialize per segment and pay a segment copy per call, so writes
+// should be rare or come in batches: insert_batch applies all keys of one
+// segment to a single copy. When a segment reaches twice the target size
+// the whole directory doubles, splitting every segment in two.
+//
+// Compile-time overrides:
+//   -DSNAPSHOT_SEGMENT_ENTRIES=256   // target entries per segment (the cost of one write)
+//   -DSNAPSHOT_WRITE_LOCKS=256       // writer lock stripes (power of two)
+
+#ifndef SNAPSHOT_SEGMENT_ENTRIES
+#define SNAPSHOT_SEGMENT_ENTRIES 256
+#endif
+
+#ifndef SNAPSHOT_WRITE_LOCKS
+#define SNAPSHOT_WRITE_LOCKS 256
+#endif
+
+template<typename K, typename V, typename HashFn = Hash<K>>
+class SnapshotHashTable {
+private:
+    static_assert((SNAPSHOT_WRITE_LOCKS & (SNAPSHOT_WRITE_LOCKS - 1)) == 0, "SNAPSHOT_WRITE_LOCKS must be a power of two");
+    static constexpr size_t NUM_LOCKS = SNAPSHOT_WRITE_LOCKS;
+    static constexpr unsigned MAX_BITS = 24;
+
+    using Segment = FlatHashTable<K, V, HashFn>;
+
+    // Segment pointers change only by publishing a new copy; the directory
+    // itself is replaced (with every writer lock held) when it doubles.
+    struct Directory {
+        unsigned bits;   // segment = top `bits` hash bits
+        std::unique_ptr<std::atomic<const Segment*>[]> segments;
+
+        explicit Directory(unsigned b) : bits(b), segments(new std::atomic<const Segment*>[size_t(1) << b]) {}
+        size_t count() const { return size_t(1) << bits; }
+        size_t index(size_t h) const { return bits ? h >> (sizeof(size_t) * 8 - bits) : 0; }
+
+        // A retired directory owns the segments it last pointed to.
+        static void destroy(void* p) {
+            Directory* d = static_cast<Directory*>(p);
+            for (size_t i = 0; i < d->count(); ++i) delete d->segments[i].load(std::memory_order_relaxed);
+            delete d;
+        }
+    };
+
+    struct PaddedLock {
+        alignas(64) TTASLock l;
+    };
+
+    std::atomic<Directory*> directory;
+    std::unique_ptr<PaddedLock[]> write_locks;
+    ElementCounter element_count;
+
+    static size_t segment_capacity() { return size_t(SNAPSHOT_SEGMENT_ENTRIES) * 2; }
+
+    // Locks the writer stripe of h's segment in the current directory.
+    // The directory cannot change while the stripe is held.
+    Directory* lock_segment(size_t h, size_t& seg) {
+        while (true) {
+            Directory* d = directory.load(std::memory_order_acquire);
+            seg = d->index(h);
+            write_locks[seg & (NUM_LOCKS - 1)].l.lock();
+            if (directory.load(std::memory_order_acquire) == d) return d;
+            write_locks[seg & (NUM_LOCKS - 1)].l.unlock();
+        }
+    }
+
+    void unlock_segment(size_t seg) { write_locks[seg & (NUM_LOCKS - 1)].l.unlock(); }
+
+    // Publishes copy as segment seg of d; caller holds its writer stripe.
+    void publish(Directory* d, size_t seg, Segment* copy) {
+        const Segment* old = d->segments[seg].exchange(copy, std::memory_order_acq_rel);
+        EpochDomain::instance().retire(const_cast<Segment*>(old));
+    }
+
+    // Double the directory unless another writer already replaced old.
+    void grow(Directory* old) {
+        if (old->bits >= MAX_BITS) return;
+        for (size_t i = 0; i < NUM_LOCKS; ++i) write_locks[i].l.lock();
+        if (directory.load(std::memory_order_relaxed) == old) {
+            Directory* d = new Directory(old->bits + 1);
+            const unsigned split_bit = unsigned(sizeof(size_t) * 8) - d->bits;
+            for (size_t i = 0; i < old->count(); ++i) {
+                const Segment* s = old->segments[i].load(std::memory_order_relaxed);
+                Segment* lo = new Segment(segment_capacity());
+                Segment* hi = new Segment(segment_capacity());
+                s->for_each([&](const K& k, const V& v) {
+                    size_t h = HashFn{}(k);
+                    ((h >> split_bit) & 1 ? hi : lo)->insert_hashed(k, v, h);
+                });
+                d->segments[2 * i].store(lo, std::memory_order_relaxed);
+                d->segments[2 * i + 1].store(hi, std::memory_order_relaxed);
+            }
+            directory.store(d, std::memory_order_release);
+            EpochDomain::instance().retire(old, &Directory::destroy);
+        }
+        for (size_t i = 0; i < NUM_LOCKS; ++i) write_locks[i].l.unlock();
+    }
+
+    // Copy-on-write step shared by every writer: apply(copy) to a private
+    // copy of h's segment and publish it if apply returns true.
+    template<typename Apply>
+    bool write(size_t h, Apply apply) {
+        EpochGuard guard;
+        size_t seg;
+        Directory* d = lock_segment(h, seg);
+        Segment* copy = new Segment(*d->segments[seg].load(std::memory_order_relaxed));
+        bool changed = apply(*copy);
+        size_t n = copy->size();
+        if (changed) publish(d, seg, copy);
+        else delete copy;
+        unlock_segment(seg);
+        if (n >= segment_capacity()) grow(d);
+        return changed;
+    }
+
+    const Segment* segment_for(size_t h) const {
+        Directory* d = directory.load(std::memory_order_acquire);
+        return d->segments[d->index(h)].load(std::memory_order_acquire);
+    }
+
+    // Lets writers that would change nothing skip the copy.
+    bool present(const K& key, size_t h) const {
+        EpochGuard guard;
+        V v;
+        return segment_for(h)->search_hashed(key, v, h);
+    }
+
+public:
+    // bucket_count is the expected number of entries; it sets the starting
+    // segment count, and the directory doubles from there.
+    explicit SnapshotHashTable(size_t bucket_count = 1024)
+        : write_locks(new PaddedLock[NUM_LOCKS]), element_count(0) {
+        unsigned bits = 0;
+        while (bits < MAX_BITS && (size_t(SNAPSHOT_SEGMENT_ENTRIES) << bits) < bucket_count) ++bits;
+        Directory* d = new Directory(bits);
+        for (size_t i = 0; i < d->count(); ++i) d->segments[i].store(new Segment(segment_capacity()), std::memory_order_relaxed);
+        directory.store(d, std::memory_order_release);
+    }
+
+    // Not safe against concurrent operations; copies already retired belong to EBR.
+    ~SnapshotHashTable() {
+        Directory::destroy(directory.load());
+    }
+
+    SnapshotHashTable(const SnapshotHashTable&) = delete;
+    SnapshotHashTable& operator=(const SnapshotHashTable&) = delete;
+
+    // Wait-free: no locks, no retries, no shared stores.
+    bool search(const K& key, V& value) const {
+        EpochGuard guard;
+        size_t h = HashFn{}(key);
+        return segment_for(h)->search_hashed(key, value, h);
+    }
+
+    // Writes always publish, even when they only overwrite a value.
+    bool insert(const K& key, const V& value) {
+        size_t h = HashFn{}(key);
+        bool inserted = false;
+        write(h, [&](Segment& s) {
+            inserted = s.insert_hashed(key, value, h);
+            return true;
+        });
+        if (inserted) element_count.add(1);
+        return inserted;
+    }
+
+    bool remove(const K& key) {
+        size_t h = HashFn{}(key);
+        if (!present(key, h)) return false;
+        bool removed = write(h, [&](Segment& s) { return s.remove_hashed(key, h); });
+        if (removed) element_count.sub(1);
+        return removed;
+    }
+
+    // Read-modify-write operations (see common.h). fn runs once, on the
+    // private copy, with the segment's writer stripe held.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        size_t h = HashFn{}(key);
+        bool inserted = false;
+        write(h, [&](Segment& s) {
+            inserted = s.upsert_hashed(key, fn, init, h);
+            return true;
+        });
+        if (inserted) element_count.add(1);
+        return inserted;
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        size_t h = HashFn{}(key);
+        if (!present(key, h)) return false;
+        return write(h, [&](Segment& s) { return s.compute_if_present_hashed(key, fn, h); });
+    }
+
+    bool insert_if_absent(const K& key, const V& value) {
+        if (present(key, HashFn{}(key))) return false;
+        return upsert(key, [](V&) {}, value);
+    }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
+    // Keys are grouped by segment, and each group is applied to one copy.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        EpochGuard guard;
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        Directory* d = directory.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            sc.add(i, d->index(sc.hashes[i]));
+        }
+        sc.sort(n, d->count());
+
+        size_t added = 0;
+        size_t i = 0;
+        while (i < n) {
+            size_t first = BatchScratch::index_of(sc.order[i]);
+            size_t seg;
+            Directory* cur = lock_segment(sc.hashes[first], seg);
+            Segment* copy = new Segment(*cur->segments[seg].load(std::memory_order_relaxed));
+            // Take the run of keys that still map to this segment.
+            for (; i < n; ++i) {
+                size_t k = BatchScratch::index_of(sc.order[i]);
+                if (cur->index(sc.hashes[k]) != seg) break;
+                bool is_new = copy->insert_hashed(keys[k], values[k], sc.hashes[k]);
+                if (inserted) inserted[k] = is_new;
+                added += is_new;
+            }
+            size_t sz = copy->size();
+            publish(cur, seg, copy);
+            unlock_segment(seg);
+            if (sz >= segment_capacity()) grow(cur);
+        }
+        element_count.add(added);
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        EpochGuard guard;
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        Directory* d = directory.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            prefetch_read(d->segments[d->index(sc.hashes[i])].load(std::memory_order_relaxed));
+        }
+        size_t hits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            const Segment* s = d->segments[d->index(sc.hashes[i])].load(std::memory_order_acquire);
+            found[i] = s->search_hashed(keys[i], values[i], sc.hashes[i]);
+            hits += found[i];
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h): the directory is sized for the final count
+    // once and every segment is rebuilt by one thread, with no copy per key.
+    // The old directory is freed directly, since nobody else may use the table.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        size_t n = size_t(last - first);
+        Directory* old = directory.load(std::memory_order_relaxed);
+        unsigned bits = old->bits;
+        while (bits < MAX_BITS && (size_t(SNAPSHOT_SEGMENT_ENTRIES) << bits) < element_count.load() + n) ++bits;
+        Directory* d = new Directory(bits);
+        const unsigned split = bits - old->bits;
+        BulkPartition part;
+        bulk_partition<HashFn>(first, n, d->count(), [d](size_t h) { return d->index(h); }, part);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t i = 0; i < d->count(); ++i) {
+            const Segment* prev = old->segments[i >> split].load(std::memory_order_relaxed);
+            Segment* seg;
+            if (split == 0) {
+                seg = new Segment(*prev);
+            } else {
+                seg = new Segment(segment_capacity());
+                prev->for_each([&](const K& k, const V& v) {
+                    size_t h = HashFn{}(k);
+                    if (d->index(h) == i) seg->insert_unique_hashed(k, v, h);
+                });
+            }
+            seg->reserve(seg->size() + part.group_size(i));
+            for (const BulkEntry* e = part.begin(i); e != part.end(i); ++e) {
+                const auto& src = first[e->index];
+                if (unique) { seg->insert_unique_hashed(bulk_key(src), bulk_value(src), e->hash); ++added; }
+                else added += seg->insert_hashed(bulk_key(src), bulk_value(src), e->hash);
+            }
+            d->segments[i].store(seg, std::memory_order_relaxed);
+        }
+        directory.store(d, std::memory_order_release);
+        Directory::destroy(old);
+        element_count.add(added);
+        return added;
+    }
+
+    // One group per segment of the current directory (see common.h); read
+    // while no writer is active.
+    size_t group_count() const { return segment_count(); }
+    template<typename F>
+    void for_each_in_group(size_t g, F fn) const {
+        directory.load(std::memory_order_acquire)->segments[g].load(std::memory_order_acquire)->for_each(fn);
+    }
+
+    // Whole-table walks over one directory, safe alongside writers: each
+    // segment is seen as one published copy, kept alive by EBR.
+    template<typename F>
+    void for_each(F fn) const {
+        EpochGuard guard;
+        const Directory* d = directory.load(std::memory_order_acquire);
+        for (size_t i = 0; i < d->count(); ++i) d->segments[i].load(std::memory_order_acquire)->for_each(fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        EpochGuard guard;   // the encountering thread keeps d alive for the whole region
+        const Directory* d = directory.load(std::memory_order_acquire);
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t i = 0; i < d->count(); ++i) {
+            EpochGuard segment_guard;
+            d->segments[i].load(std::memory_order_acquire)->for_each(fn);
+        }
+    }
+    FlatSlots<K, V> flat_group(size_t g) const {
+        return directory.load(std::memory_order_acquire)->segments[g].load(std::memory_order_acquire)->slots();
+    }
+
+    // Flat image loading (persist.h): any power-of-two group count up to
+    // 2^MAX_BITS becomes the directory, each group one segment, copied in
+    // parallel. Empty table only, with exclusive access.
+    template<typename SlotsOf>
+    bool load_flat_groups(size_t groups, SlotsOf slots_of) {
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < groups) ++bits;
+        if ((size_t(1) << bits) != groups || bits > MAX_BITS) return false;
+        Directory* d = new Directory(bits);
+        size_t added = 0;
+        #pragma omp parallel for schedule(dynamic, 1) reduction(+:added)
+        for (size_t g = 0; g < groups; ++g) {
+            Segment* seg = new Segment(8);
+            seg->assign_slots(slots_of(g));
+            added += seg->size();
+            d->segments[g].store(seg, std::memory_order_relaxed);
+        }
+        Directory::destroy(directory.exchange(d, std::memory_order_acq_rel));
+        element_count.add(added);
+        return true;
+    }
+
+    size_t size() const {
+        return element_count.load();
+    }
+
+    size_t segment_count() const {
+        return directory.load(std::memory_order_acquire)->count();
+    }
+
+    // Memory accounting (see common.h) of the published segments; copies
+    // still waiting for EBR are not counted. There is no shrink_to_fit: the
+    // directory only doubles, and every write already publishes a fresh copy.
+    MemoryUsage memory_usage() const {
+        EpochGuard guard;
+        const Directory* d = directory.load(std::memory_order_acquire);
+        MemoryUsage m;
+        for (size_t i = 0; i < d->count(); ++i) m += d->segments[i].load(std::memory_order_acquire)->memory_usage();
+        m.locks = NUM_LOCKS * sizeof(TTASLock);
+        m.padding += NUM_LOCKS * (sizeof(PaddedLock) - sizeof(TTASLock));
+        usage_add_object(m, sizeof(*this) + sizeof(Directory) + d->count() * sizeof(std::atomic<const Segment*>));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    std::string getName() const {
+        return "Snapshot-RCU";
+    }
+};
+
+#endif // SNAPSHOT_TABLE_H
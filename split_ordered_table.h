@@ -0,0 +1,461 @@
+#ifndef SPLIT_ORDERED_TABLE_H
+#define SPLIT_ORDERED_TABLE_H
+
+#include "common.h"
+#include "reclaim.h"
+#include "instrumentation.h"
+#include <atomic>
+#include <memory>
+
+// Lock-free resizable table: Shalev & Shavit split-ordered lists.
+//
+// All entries live in one Harris/Michael lock-free list sorted by the
+// bit-reversed hash (the "split-order key"). A bucket is just a dummy link in
+// that list, so doubling the bucket count moves nothing: bucket b + size
+// splits off bucket b the first time it is used, by linking its own dummy in
+// after b's. Buckets are initialized lazily and recursively from their parent
+// (b with its top bit cleared).
+// - Regular keys have the low split-order bit set, dummies have it clear, so a
+//   bucket's dummy always sorts before every key it owns.
+// - Dummies live inline in the bucket directory, a list of segments that
+//   double in size and are only ever added, never moved; growing is one CAS
+//   on the bucket count. One thread claims a bucket's initialization; the
+//   others start from the nearest initialized ancestor meanwhile, so nobody
+//   waits for it.
+// - Deletion, reclamation and values work as in LockFreeHashTable: marked next
+//   pointers, EBR (reclaim.h) and AtomicValue cells. Dummies are never removed.
+//
+// Compile-time overrides:
+//   -DSPLIT_MAX_LOAD=2        // average keys per bucket before the count doubles
+
+#ifndef SPLIT_MAX_LOAD
+#define SPLIT_MAX_LOAD 2
+#endif
+
+template<typename K, typename V, typename HashFn = Hash<K>, typename Alloc = DefaultNodeAllocator<KeyValue<K, V>>>
+class SplitOrderedHashTable {
+private:
+    struct Link {
+        std::atomic<Link*> next{nullptr};   // low bit set = this node is logically deleted
+        size_t so_key = 0;                  // bit-reversed hash; low bit set for regular nodes
+    };
+
+    struct Node : Link {
+        K key;
+        AtomicValue<V> value;
+
+        Node(size_t so, const K& k, const V& v) : key(k), value(v) { this->so_key = so; }
+    };
+    using NodeAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<Node>;
+
+    enum : uint32_t { UNINITIALIZED, CLAIMED, READY };
+
+    struct alignas(32) Dummy {
+        Link link;
+        std::atomic<uint32_t> state{UNINITIALIZED};
+    };
+
+    // Segment 0 holds buckets [0, FIRST_SEGMENT); segment s > 0 holds
+    // [FIRST_SEGMENT << (s - 1), FIRST_SEGMENT << s).
+    static constexpr unsigned FIRST_SEGMENT_BITS = 6;
+    static constexpr size_t FIRST_SEGMENT = size_t(1) << FIRST_SEGMENT_BITS;
+    static constexpr unsigned MAX_SEGMENTS = sizeof(size_t) * 8 - FIRST_SEGMENT_BITS;
+    static constexpr unsigned GROW_CHECK_INTERVAL = 64;   // inserts per thread between load checks
+
+    std::atomic<Dummy*> segments[MAX_SEGMENTS];
+    std::atomic<size_t> bucket_size;   // power of two
+    ElementCounter element_count;
+
+    static Node* make_node(size_t so, const K& k, const V& v) {
+        NodeAlloc a;
+        Node* n = a.allocate(1);
+        try {
+            ::new (static_cast<void*>(n)) Node(so, k, v);
+        } catch (...) {
+            a.deallocate(n, 1);
+            throw;
+        }
+        return n;
+    }
+
+    // Also the EBR deleter for retired nodes.
+    static void destroy_node(void* p) {
+        Node* n = static_cast<Node*>(p);
+        n->~Node();
+        NodeAlloc a;
+        a.deallocate(n, 1);
+    }
+
+    static bool is_regular(const Link* l) { return l->so_key & 1; }
+    static Node* as_node(Link* l) { return static_cast<Node*>(l); }
+
+    static size_t reverse_bits(size_t x) {
+        uint64_t v = __builtin_bswap64(uint64_t(x));
+        v = ((v >> 4) & 0x0f0f0f0f0f0f0f0fULL) | ((v & 0x0f0f0f0f0f0f0f0fULL) << 4);
+        v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+        v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+        return size_t(v >> (64 - sizeof(size_t) * 8));
+    }
+
+    static unsigned top_bit(size_t x) { return unsigned(sizeof(size_t) * 8 - 1 - __builtin_clzll(x)); }
+
+    static size_t so_regular(size_t h) { return reverse_bits(h) | 1; }
+    static size_t so_dummy(size_t b)   { return reverse_bits(b); }
+
+    static size_t parent_of(size_t b) { return b & ~(size_t(1) << top_bit(b)); }
+
+    static void locate(size_t b, unsigned& seg, size_t& off) {
+        if (b < FIRST_SEGMENT) { seg = 0; off = b; return; }
+        unsigned t = top_bit(b);
+        seg = t - FIRST_SEGMENT_BITS + 1;
+        off = b - (size_t(1) << t);
+    }
+
+    static size_t segment_base(unsigned seg) {
+        return seg == 0 ? 0 : FIRST_SEGMENT << (seg - 1);
+    }
+
+    static size_t segment_length(unsigned seg) {
+        return seg == 0 ? FIRST_SEGMENT : FIRST_SEGMENT << (seg - 1);
+    }
+
+    // Dummy of bucket b, allocating its segment on first use.
+    Dummy& dummy(size_t b) {
+        unsigned seg;
+        size_t off;
+        locate(b, seg, off);
+        Dummy* s = segments[seg].load(std::memory_order_acquire);
+        if (!s) {
+            size_t len = segment_length(seg);
+            Dummy* fresh = new Dummy[len];
+            for (size_t i = 0; i < len; ++i) fresh[i].link.so_key = so_dummy(segment_base(seg) + i);
+            if (segments[seg].compare_exchange_strong(s, fresh, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                s = fresh;
+            } else {
+                delete[] fresh;   // another thread installed it; s now holds theirs
+            }
+        }
+        return s[off];
+    }
+
+    // Dummy of bucket b if it is linked in, otherwise nullptr.
+    Link* ready_bucket(size_t b) const {
+        unsigned seg;
+        size_t off;
+        locate(b, seg, off);
+        Dummy* s = segments[seg].load(std::memory_order_acquire);
+        if (!s || s[off].state.load(std::memory_order_acquire) != READY) return nullptr;
+        return &s[off].link;
+    }
+
+    // Locate (so, key) in the list after start, unlinking marked nodes on the way
+    // (key == nullptr looks for the dummy with split-order key so).
+    // Returns true if found (cur is the node); otherwise cur is the first node
+    // ordered after the target and prev the link that points at it.
+    // Caller must hold an EpochGuard.
+    bool find(Link* start, size_t so, const K* key, std::atomic<Link*>*& prev, Link*& cur) {
+    retry:
+        prev = &start->next;
+        cur = prev->load(std::memory_order_acquire);
+        while (cur) {
+            Link* next = cur->next.load(std::memory_order_acquire);
+            if (is_marked(next)) {
+                Link* succ = without_mark(next);
+                Link* expected = cur;
+                if (!prev->compare_exchange_strong(expected, succ, std::memory_order_acq_rel)) goto retry;
+                EpochDomain::instance().retire(as_node(cur), &destroy_node);   // dummies are never marked
+                cur = succ;
+                continue;
+            }
+            if (cur->so_key > so) return false;
+            // Regular keys with equal full hashes share a split-order key.
+            if (cur->so_key == so && (!key || as_node(cur)->key == *key)) return true;
+            prev = &cur->next;
+            cur = next;
+        }
+        return false;
+    }
+
+    // Where operations on bucket b start: its dummy, which this call links in
+    // if nobody has claimed it yet, or else the nearest linked-in ancestor.
+    Link* bucket(size_t b) {
+        Dummy& d = dummy(b);
+        uint32_t state = d.state.load(std::memory_order_acquire);
+        if (state == READY) return &d.link;
+        Link* parent = bucket(parent_of(b));
+        if (state != UNINITIALIZED ||
+            !d.state.compare_exchange_strong(state, CLAIMED, std::memory_order_acq_rel)) {
+            return parent;
+        }
+        while (true) {
+            std::atomic<Link*>* prev;
+            Link* cur;
+            find(parent, d.link.so_key, nullptr, prev, cur);   // only the claimer links it, so never found
+            d.link.next.store(cur, std::memory_order_relaxed);
+            if (prev->compare_exchange_weak(cur, &d.link, std::memory_order_release, std::memory_order_relaxed)) break;
+        }
+        d.state.store(READY, std::memory_order_release);
+        return &d.link;
+    }
+
+    Link* bucket_for(size_t h) {
+        return bucket(h & (bucket_size.load(std::memory_order_acquire) - 1));
+    }
+
+    // Nearest linked-in ancestor of h's bucket; lookups never initialize.
+    Link* bucket_for(size_t h) const {
+        size_t b = h & (bucket_size.load(std::memory_order_acquire) - 1);
+        while (true) {
+            Link* d = ready_bucket(b);
+            if (d) return d;
+            b = parent_of(b);   // bucket 0 is always ready
+        }
+    }
+
+    void maybe_grow() {
+        static thread_local unsigned tick = 0;
+        if (++tick % GROW_CHECK_INTERVAL) return;
+        size_t n = bucket_size.load(std::memory_order_relaxed);
+        if (element_count.load() > n * SPLIT_MAX_LOAD && n < (size_t(1) << (sizeof(size_t) * 8 - 2))) {
+            bucket_size.compare_exchange_strong(n, n * 2, std::memory_order_acq_rel);
+        }
+    }
+
+    // Insert-or-apply on key; shared by insert/upsert. Returns true if inserted.
+    template<typename OnFound>
+    bool insert_with(const K& key, const V& init, OnFound on_found) {
+        EpochGuard guard;
+        size_t h = HashFn{}(key);
+        size_t so = so_regular(h);
+        Link* start = bucket_for(h);
+        Node* new_node = nullptr;
+
+        while (true) {
+            std::atomic<Link*>* prev;
+            Link* cur;
+            if (find(start, so, &key, prev, cur)) {
+                on_found(as_node(cur)->value);
+                if (new_node) destroy_node(new_node);
+                return false;
+            }
+            if (!new_node) new_node = make_node(so, key, init);
+            new_node->next.store(cur, std::memory_order_relaxed);
+            if (prev->compare_exchange_weak(cur, new_node, std::memory_order_release, std::memory_order_relaxed)) {
+                element_count.add(1);
+                maybe_grow();
+                return true;
+            }
+        }
+    }
+
+public:
+    // bucket_count is only the starting size: buckets are initialized on first
+    // use and the count doubles as the table fills.
+    SplitOrderedHashTable(size_t bucket_count = 1024)
+        : bucket_size(next_pow2(bucket_count)), element_count(0) {
+        for (auto& s : segments) s.store(nullptr, std::memory_order_relaxed);
+        dummy(0).state.store(READY, std::memory_order_relaxed);
+    }
+
+    // Not safe against concurrent operations; nodes already retired belong to EBR.
+    ~SplitOrderedHashTable() {
+        Link* cur = segments[0].load()[0].link.next.load();
+        while (cur) {
+            Link* next = without_mark(cur->next.load());
+            if (is_regular(cur)) destroy_node(as_node(cur));
+            cur = next;
+        }
+        for (auto& s : segments) delete[] s.load();
+    }
+
+    SplitOrderedHashTable(const SplitOrderedHashTable&) = delete;
+    SplitOrderedHashTable& operator=(const SplitOrderedHashTable&) = delete;
+
+    bool insert(const K& key, const V& value) {
+        return insert_with(key, value, [&](AtomicValue<V>& v) { v.store(value); });
+    }
+
+    // Read-modify-write operations (see common.h). As in LockFreeHashTable a
+    // present value is updated with a CAS loop, so fn may run more than once.
+    template<typename F>
+    bool upsert(const K& key, F fn, const V& init) {
+        return insert_with(key, init, [&](AtomicValue<V>& v) { v.update(fn); });
+    }
+
+    template<typename F>
+    bool compute_if_present(const K& key, F fn) {
+        EpochGuard guard;
+        size_t h = HashFn{}(key);
+        std::atomic<Link*>* prev;
+        Link* cur;
+        if (!find(bucket_for(h), so_regular(h), &key, prev, cur)) return false;
+        as_node(cur)->value.update(fn);
+        return true;
+    }
+
+    bool insert_if_absent(const K& key, const V& value) { return upsert(key, [](V&) {}, value); }
+    bool increment(const K& key, const V& delta) { return upsert(key, [&](V& v) { v += delta; }, delta); }
+
+    // Read-only walk: skips marked nodes instead of unlinking them.
+    bool search(const K& key, V& value) const {
+        EpochGuard guard;
+        size_t h = HashFn{}(key);
+        size_t so = so_regular(h);
+        Link* current = without_mark(bucket_for(h)->next.load(std::memory_order_acquire));
+
+        while (current && current->so_key <= so) {
+            Link* next = current->next.load(std::memory_order_acquire);
+            if (!is_marked(next) && current->so_key == so && as_node(current)->key == key) {
+                value = as_node(current)->value.load();
+                return true;
+            }
+            current = without_mark(next);
+        }
+        return false;
+    }
+
+    bool remove(const K& key) {
+        EpochGuard guard;
+        size_t h = HashFn{}(key);
+        size_t so = so_regular(h);
+        Link* start = bucket_for(h);
+
+        while (true) {
+            std::atomic<Link*>* prev;
+            Link* cur;
+            if (!find(start, so, &key, prev, cur)) return false;  // Not found
+
+            Link* next = cur->next.load(std::memory_order_acquire);
+            if (is_marked(next)) continue;  // lost the race to another remover; rescan
+            if (!cur->next.compare_exchange_weak(next, with_mark(next), std::memory_order_acq_rel)) continue;
+
+            // Logically deleted; now try to unlink, otherwise let a traversal do it.
+            Link* expected = cur;
+            if (prev->compare_exchange_strong(expected, next, std::memory_order_acq_rel)) {
+                EpochDomain::instance().retire(as_node(cur), &destroy_node);
+            } else {
+                find(start, so, &key, prev, cur);
+            }
+            element_count.sub(1);
+            return true;
+        }
+    }
+
+    // Batched operations: one epoch critical section per batch. Lookups
+    // prefetch their start dummies up front; inserts cannot, since finding a
+    // dummy may have to link it in.
+    size_t insert_batch(const K* keys, const V* values, size_t n, bool* inserted = nullptr) {
+        EpochGuard guard;
+        size_t added = 0;
+        for (size_t i = 0; i < n; ++i) {
+            bool is_new = insert(keys[i], values[i]);
+            if (inserted) inserted[i] = is_new;
+            added += is_new;
+        }
+        return added;
+    }
+
+    size_t search_batch(const K* keys, V* values, bool* found, size_t n) const {
+        EpochGuard guard;
+        BatchScratch& sc = batch_scratch();
+        sc.prepare(n);
+        for (size_t i = 0; i < n; ++i) {
+            sc.hashes[i] = HashFn{}(keys[i]);
+            prefetch_read(bucket_for(sc.hashes[i]));
+        }
+        size_t hits = 0;
+        for (size_t i = 0; i < n; ++i) {
+            found[i] = search(keys[i], values[i]);
+            hits += found[i];
+        }
+        return hits;
+    }
+
+    // Bulk load (see common.h). Every key goes into the one shared list, so
+    // there are no private groups to fill: the bucket count is raised once to
+    // its final size (buckets still initialize lazily), then threads insert
+    // in parallel, so a key repeated in the range keeps one of its values,
+    // not necessarily the last. unique saves nothing here.
+    template<typename It>
+    size_t bulk_build(It first, It last, bool unique = false) {
+        (void)unique;
+        size_t n = size_t(last - first);
+        size_t want = element_count.load() + n;
+        size_t b = bucket_size.load(std::memory_order_relaxed);
+        while (want > b * SPLIT_MAX_LOAD && b < (size_t(1) << (sizeof(size_t) * 8 - 2))) b *= 2;
+        bucket_size.store(b, std::memory_order_release);
+        size_t added = 0;
+        #pragma omp parallel for reduction(+:added) num_threads(bulk_threads(n))
+        for (size_t i = 0; i < n; ++i) added += insert(bulk_key(first[i]), bulk_value(first[i]));
+        return added;
+    }
+
+    // A single group (see common.h): the whole list in split order, dummies
+    // and deleted nodes skipped, under an EpochGuard so writers may run meanwhile.
+    size_t group_count() const { return 1; }
+    template<typename F>
+    void for_each_in_group(size_t, F fn) const {
+        EpochGuard guard;
+        for (Link* c = segments[0].load()[0].link.next.load(); c; ) {
+            Link* next = c->next.load();
+            if (is_regular(c) && !is_marked(next)) fn(as_node(c)->key, as_node(c)->value.load());
+            c = without_mark(next);
+        }
+    }
+    template<typename F>
+    void for_each(F fn) const {
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+    template<typename F>
+    void parallel_for_each(F fn, int threads = omp_get_max_threads()) const {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (size_t g = 0; g < group_count(); ++g) for_each_in_group(g, fn);
+    }
+
+    size_t size() const {
+        return element_count.load();
+    }
+
+    // Memory accounting (see common.h). Allocated dummy segments count as
+    // buckets whether or not their buckets are initialized yet. There is no
+    // shrink_to_fit: dummies are never removed, and removed nodes already go
+    // back through EBR.
+    MemoryUsage memory_usage() const {
+        MemoryUsage m;
+        for (unsigned seg = 0; seg < MAX_SEGMENTS; ++seg) {
+            if (!segments[seg].load(std::memory_order_acquire)) continue;
+            const size_t len = segment_length(seg);
+            m.buckets += len * (sizeof(Link) + sizeof(std::atomic<uint32_t>));
+            m.padding += len * (sizeof(Dummy) - sizeof(Link) - sizeof(std::atomic<uint32_t>));
+        }
+        m.nodes = element_count.load() * sizeof(Node);
+        usage_add_object(m, sizeof(*this));
+        m.entries = element_count.load();
+        return m;
+    }
+
+    // Keys per initialized bucket, i.e. between consecutive dummies (see
+    // instrumentation.h); read while no writer is active.
+    std::vector<size_t> chain_length_histogram() const {
+        std::vector<size_t> hist;
+        size_t n = 0;
+        for (Link* c = segments[0].load()[0].link.next.load(); c; c = without_mark(c->next.load())) {
+            if (is_regular(c)) { ++n; continue; }
+            chain_hist_add(hist, n);
+            n = 0;
+        }
+        chain_hist_add(hist, n);
+        return hist;
+    }
+
+    // Current (logical) bucket count; buckets nobody has used yet cost nothing.
+    size_t effective_bucket_count() const {
+        return bucket_size.load(std::memory_order_relaxed);
+    }
+
+    std::string getName() const {
+        return "Split-Ordered";
+    }
+};
+
+#endif // SPLIT_ORDERED_TABLE_H
@@ -1,9 +1,26 @@
 #include <iostream>
 #include <cassert>
+#include <memory>
+#include <vector>
 #include "coarse_grained.h"
 #include "segment_based.h"
 #include "fine_grained.h"
 #include "lock_free.h"
+#include "flat_hash_table.h"
+#include "agh_hash_table.h"
+#include "concurrent_set.h"
+#include "clock_cache.h"
+#include "cuckoo_hash_table.h"
+#include "split_ordered_table.h"
+#include "snapshot_table.h"
+#include "sequential.h"
+#include "workload.h"
+#include "hotset.h"
+#include "persist.h"
+#include "async_table.h"
+#include "fine_grained_padded.h"
+#include "coarse_grained_padded.h"
+#include "segment_based_padded.h"
 
 using namespace std;
 
@@ -78,6 +95,994 @@ void testConcurrent(const string& name, int num_threads) {
     cout << "✓ Concurrent test passed for " << name << endl;
 }
 
+// Mutual exclusion and try_lock for every lock policy; MCS also while
+// nested and released out of order
+template<typename Lock>
+void testLock(const string& name) {
+    cout << "\n=== Lock Test: " << name << " ===" << endl;
+    Lock lock;
+    long counter = 0;
+    const int N = 20000;
+    #pragma omp parallel for num_threads(4)
+    for (int i = 0; i < N; i++) {
+        if (i % 2) { lock.lock(); counter++; lock.unlock(); }
+        else { lock.lock(); counter += 2; lock.unlock(); }
+    }
+    assert(counter == N / 2 * 3);
+
+    assert(lock.try_lock());
+    #pragma omp parallel num_threads(2)
+    {
+        if (omp_get_thread_num() == 1) assert(!lock.try_lock() && !lock.try_lock_shared());
+    }
+    lock.unlock();
+    lock.lock_shared();
+    lock.unlock_shared();
+
+    Lock a, b;
+    a.lock(); b.lock();
+    a.unlock();
+    assert(a.try_lock());
+    b.unlock(); a.unlock();
+    cout << "✓ Lock test passed for " << name << endl;
+}
+
+// Cuckoo paths keep a fixed-size table filling past 90% before it grows,
+// and growth under concurrent inserts loses nothing
+void testCuckooOccupancy() {
+    cout << "\n=== Cuckoo Occupancy Test ===" << endl;
+    CuckooHashTable<int, int> ht(1 << 14);
+    const size_t slots = ht.slot_count();
+    int n = 0;
+    while (ht.slot_count() == slots) {
+        ht.insert(n, n + 1);
+        n++;
+    }
+    double reached = double(n - 1) / double(slots);
+    assert(reached >= 0.9);
+    int value;
+    for (int i = 0; i < n; i++) assert(ht.search(i, value) && value == i + 1);
+
+    CuckooHashTable<int, int> grown(64);
+    const int N = 200000;
+    #pragma omp parallel for num_threads(4)
+    for (int i = 0; i < N; i++) {
+        grown.insert(i, i);
+        if (i % 4 == 0) grown.remove(i);
+    }
+    assert(grown.size() == size_t(N - N / 4));
+    for (int i = 0; i < N; i++) assert(grown.search(i, value) == (i % 4 != 0));
+    cout << "✓ Cuckoo occupancy test passed (filled to " << int(reached * 100) << "% before growing)" << endl;
+}
+
+// Chain histograms account for every entry, and the latency histogram's
+// percentiles land within its bucket precision
+template<typename HT>
+void checkChainHistogram(const string& name) {
+    HT ht(256);
+    for (int i = 0; i < 5000; i++) ht.insert(i, i);
+    vector<size_t> hist = ht.chain_length_histogram();
+    size_t entries = 0;
+    for (size_t n = 0; n < hist.size(); n++) entries += n * hist[n];
+    assert(entries == ht.size());
+    ChainStats cs = chain_stats(hist);
+    assert(cs.mean >= 1.0 && cs.p99 <= cs.max && cs.max < hist.size());
+    cout << "  " << name << ": mean chain " << cs.mean << ", max " << cs.max << endl;
+}
+
+void testInstrumentation() {
+    cout << "\n=== Instrumentation Test ===" << endl;
+    LatencyHistogram a, b;
+    for (uint64_t ns = 1; ns <= 10000; ns++) (ns % 2 ? a : b).record(ns);
+    a.merge(b);
+    assert(a.samples() == 10000);
+    assert(a.percentile(0.0) == 1);
+    for (double q : {0.5, 0.99, 0.999}) {
+        double want = q * 10000, got = double(a.percentile(q));
+        assert(got <= want + 1 && got >= want * 0.96);
+    }
+    assert(LatencyHistogram().percentile(0.99) == 0);
+
+    vector<size_t> hist;
+    for (size_t n : {0, 1, 1, 2, 3, 70}) chain_hist_add(hist, n);
+    ChainStats cs = chain_stats(hist);
+    assert(hist.size() == 71 && cs.max == 70 && cs.mean == 77.0 / 5);
+
+#ifdef CHT_INSTRUMENT
+    lock_probe::reset();
+    TTASLock l;
+    for (int i = 0; i < 3; i++) { l.lock(); l.unlock(); }
+    assert(l.try_lock());
+    assert(!l.try_lock());
+    l.unlock();
+    LockStats ls = lock_probe::collect();
+    assert(ls.acquisitions == 4 && ls.contended == 0);
+#endif
+
+    checkChainHistogram<CoarseGrainedHashTable<int, int>>("Coarse-Grained");
+    checkChainHistogram<FineGrainedHashTable<int, int>>("Fine-Grained");
+    checkChainHistogram<SegmentBasedHashTable<int, int>>("Segment-Based");
+    checkChainHistogram<AGHHashTable<int, int>>("AGH");
+    checkChainHistogram<LockFreeHashTable<int, int>>("Lock-Free");
+    checkChainHistogram<SplitOrderedHashTable<int, int>>("Split-Ordered");
+    cout << "✓ Instrumentation test passed" << endl;
+}
+
+// Zipf ranks follow 1/r^theta, the mixes come out in their proportions, a
+// trace survives a save/load round trip, every generated remove hits, and
+// hot-set draws stay in the universe even when hotN exceeds it
+void testWorkload() {
+    cout << "\n=== Workload Test ===" << endl;
+    std::mt19937_64 rng(7);
+    ZipfGen zipf(1000, 0.99);
+    vector<int> freq(1001, 0);
+    const int draws = 200000;
+    for (int i = 0; i < draws; i++) {
+        uint64_t r = zipf.draw(rng);
+        assert(r >= 1 && r <= 1000);
+        freq[r]++;
+    }
+    double norm = 0;
+    for (int r = 1; r <= 1000; r++) norm += pow(r, -0.99);
+    for (int r : {1, 2, 10}) {
+        double want = draws * pow(r, -0.99) / norm;
+        assert(fabs(freq[r] - want) < 0.05 * want);
+    }
+
+    WorkloadSpec spec;
+    spec.mix = *find_workload_mix("churn");
+    spec.preload = 10000;
+    auto streams = generate_workload(spec, 4, 20000);
+    size_t total = 0, reads = 0, inserts = 0, removes = 0;
+    for (const auto& s : streams) {
+        total += s.size();
+        for (const WorkOp& op : s) {
+            reads += op.type == OpType::Read;
+            inserts += op.type == OpType::Insert;
+            removes += op.type == OpType::Remove;
+        }
+    }
+    assert(total == 20000);
+    assert(fabs(double(reads) / total - 0.5) < 0.02 && fabs(double(removes) / total - 0.25) < 0.02);
+
+    SequentialHashTable<int, int> ht(1024);
+    for (int i = 0; i < spec.preload; i++) ht.insert(i, i);
+    for (const auto& s : streams) {
+        for (const WorkOp& op : s) {
+            bool hit = apply_op<int>(ht, op);
+            if (op.type == OpType::Remove || op.type == OpType::Insert) assert(hit);
+        }
+    }
+    assert(ht.size() == spec.preload + inserts - removes);
+
+    Trace out, in;
+    out.preload = spec.preload;
+    out.ops = streams[0];
+    string path = "test_workload.trace";
+    assert(save_trace(path, out));
+    assert(load_trace(path, in));
+    std::remove(path.c_str());
+    assert(in.preload == out.preload && in.ops.size() == out.ops.size());
+    assert(memcmp(in.ops.data(), out.ops.data(), out.ops.size() * sizeof(WorkOp)) == 0);
+    auto slices = split_trace(in, 3);
+    assert(slices[0].size() + slices[1].size() + slices[2].size() == in.ops.size());
+
+    for (int hotN : {0, 10, 100, 500}) {
+        HotsetGen hot(100, hotN, 0.9, 3);
+        for (int i = 0; i < 10000; i++) {
+            int k = hot.draw();
+            assert(k >= 0 && k < 100);
+        }
+    }
+    cout << "✓ Workload test passed" << endl;
+}
+
+// Snapshot readers never miss a key while writers publish copies and the
+// directory doubles underneath them
+void testSnapshotReaders() {
+    cout << "\n=== Snapshot Readers Test ===" << endl;
+    SnapshotHashTable<int, int> ht(16);
+    const int N = 5000, EXTRA = 50000, BATCH = 500;
+    for (int i = 0; i < N; i++) ht.insert(i, i * 10);
+    const size_t segments = ht.segment_count();
+
+    std::atomic<bool> done{false};
+    int misses = 0;
+    #pragma omp parallel num_threads(4) reduction(+:misses)
+    {
+        if (omp_get_thread_num() == 0) {
+            vector<int> keys(BATCH), values(BATCH);
+            for (int b = 0; b < EXTRA; b += BATCH) {
+                for (int i = 0; i < BATCH; i++) { keys[i] = N + b + i; values[i] = keys[i] * 10; }
+                ht.insert_batch(keys.data(), values.data(), BATCH);
+                ht.insert(b % N, (b % N) * 10);   // republish an existing key
+            }
+            done.store(true);
+        } else {
+            int value;
+            while (!done.load()) {
+                for (int i = 0; i < N; i++) misses += !(ht.search(i, value) && value == i * 10);
+            }
+        }
+    }
+    assert(misses == 0);
+    assert(ht.size() == size_t(N + EXTRA));
+    assert(ht.segment_count() > segments);
+    int value;
+    for (int i = 0; i < N + EXTRA; i++) assert(ht.search(i, value) && value == i * 10);
+    cout << "✓ Snapshot readers test passed (" << segments << " -> " << ht.segment_count() << " segments)" << endl;
+}
+
+// Growth + backward-shift deletion in the open-addressing table
+void testFlatGrowth() {
+    cout << "\n=== Testing Flat growth/remove ===" << endl;
+    FlatHashTable<int, int> ht(8);
+    const int N = 10000;
+    for (int i = 0; i < N; i++) assert(ht.insert(i, i + 1) == true);
+    assert(ht.size() == (size_t)N);
+    for (int i = 0; i < N; i += 2) assert(ht.remove(i) == true);
+    assert(ht.size() == (size_t)N / 2);
+    int value;
+    for (int i = 0; i < N; i++) {
+        bool found = ht.search(i, value);
+        assert(found == (i % 2 == 1));
+        if (found) assert(value == i + 1);
+    }
+    cout << "✓ Flat growth/remove passed" << endl;
+}
+
+template<typename V> V as_value(int x) { return V(x); }
+template<> string as_value<string>(int x) { return to_string(x); }
+
+// Readers race against removers on the same chains; every surviving key must
+// still be found with its final value and the size must add up.
+template<typename HashTable, typename V = int>
+void testConcurrentRemove(const string& name, int num_threads) {
+    cout << "\n=== Concurrent Remove Test: " << name
+         << " (" << num_threads << " threads) ===" << endl;
+
+    HashTable ht(64);
+    const int N = 20000;
+    for (int i = 0; i < N; i++) ht.insert(i, as_value<V>(i));
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int tid = omp_get_thread_num();
+        V value;
+        for (int round = 0; round < 4; round++) {
+            for (int i = tid; i < N; i += num_threads) {
+                if (i % 2 == 0) ht.remove(i);
+                else ht.insert(i, as_value<V>(i + round));
+                ht.search((i * 7919) % N, value);  // touch other threads' chains
+            }
+        }
+    }
+
+    assert(ht.size() == (size_t)N / 2);
+    V value;
+    for (int i = 0; i < N; i++) {
+        bool found = ht.search(i, value);
+        assert(found == (i % 2 == 1));
+        if (found) assert(value == as_value<V>(i + 3));
+    }
+    cout << "✓ Concurrent remove test passed for " << name << endl;
+}
+
+// Batched API: per-key results must match the single-key semantics,
+// including a key repeated inside one batch.
+template<typename HashTable>
+void testBatch(const string& name) {
+    cout << "\n=== Batch Test: " << name << " ===" << endl;
+    HashTable ht(256);
+    const int N = 1000;
+    vector<int> keys(N), values(N);
+    for (int i = 0; i < N; i++) { keys[i] = i % (N / 2); values[i] = i; }
+    unique_ptr<bool[]> flags(new bool[N]);
+    assert(ht.insert_batch(keys.data(), values.data(), N, flags.get()) == (size_t)N / 2);
+    for (int i = 0; i < N; i++) assert(flags[i] == (i < N / 2));
+    assert(ht.size() == (size_t)N / 2);
+
+    vector<int> probe(N), out(N);
+    for (int i = 0; i < N; i++) probe[i] = i;
+    assert(ht.search_batch(probe.data(), out.data(), flags.get(), N) == (size_t)N / 2);
+    for (int i = 0; i < N; i++) {
+        assert(flags[i] == (i < N / 2));
+        if (flags[i]) assert(out[i] == i + N / 2);  // later duplicate wins
+    }
+    cout << "✓ Batch test passed for " << name << endl;
+}
+
+// An uncontended AGH segment merges its stripes down to one, and keys stay
+// reachable while segments re-stripe under concurrent traffic
+void testAdaptiveStripes() {
+    cout << "\n=== Adaptive Stripes Test ===" << endl;
+    AGHHashTable<int, int> ht(1 << 16, 48);
+    const size_t seg = ht.segment_of(0);
+    const size_t initial = ht.segment_stripes(seg);
+    assert(initial > 1);
+
+    vector<int> keys;
+    for (int k = 0; keys.size() < 256; k++) {
+        if (ht.segment_of(k) == seg) keys.push_back(k);
+    }
+    for (int k : keys) ht.insert(k, k);
+    int value;
+    for (int round = 0; round < 200000; round++) {
+        int k = keys[round % keys.size()];
+        assert(ht.search(k, value) && value == k);
+    }
+    assert(ht.segment_stripes(seg) == 1);
+    assert(ht.stripe_merges() >= 1);
+
+    const int N = 100000;
+    #pragma omp parallel for num_threads(4)
+    for (int i = 0; i < N; i++) {
+        ht.insert(1000000 + i, i);
+        ht.search(keys[i % keys.size()], value);
+        if (i % 3 == 0) ht.remove(1000000 + i);
+    }
+    for (int i = 0; i < N; i++) {
+        assert(ht.search(1000000 + i, value) == (i % 3 != 0));
+    }
+    for (int k : keys) assert(ht.search(k, value) && value == k);
+    cout << "✓ Adaptive stripes test passed (stripes: " << ht.stripe_total()
+         << ", splits: " << ht.stripe_splits() << ", merges: " << ht.stripe_merges() << ")" << endl;
+}
+
+// Undersized segment tables must grow per segment and keep every key reachable
+template<typename HashTable>
+void testGrowth(const string& name) {
+    cout << "\n=== Growth Test: " << name << " ===" << endl;
+    HashTable ht(16);
+    const int N = 50000;
+    #pragma omp parallel for num_threads(4)
+    for (int i = 0; i < N; i++) ht.insert(i, i * 3);
+    assert(ht.size() == (size_t)N);
+    assert(ht.effective_bucket_count() >= (size_t)N / 2);
+    int value;
+    for (int i = 0; i < N; i++) assert(ht.search(i, value) && value == i * 3);
+    cout << "✓ Growth test passed for " << name
+         << " (buckets: " << ht.effective_bucket_count() << ")" << endl;
+}
+
+// A fresh table loaded in one call, duplicates included, then a second
+// call merging into the filled table. Tables that insert in parallel
+// (last_wins = false) only promise that one of a repeated key's values stays.
+template<typename HashTable>
+void testBulkBuild(const string& name, bool last_wins = true) {
+    cout << "\n=== Bulk Build Test: " << name << " ===" << endl;
+    const int N = 30000;
+    vector<pair<int, int>> entries;
+    for (int i = 0; i < N; i++) entries.emplace_back(i, i);
+    for (int i = 0; i < N; i += 3) entries.emplace_back(i, -i);   // repeated key, later value
+    HashTable ht(64);
+    assert(ht.bulk_build(entries.begin(), entries.end()) == (size_t)N);
+    assert(ht.size() == (size_t)N);
+    int value;
+    for (int i = 0; i < N; i++) {
+        assert(ht.search(i, value));
+        if (i % 3 == 0) assert(value == -i || (!last_wins && value == i));
+        else assert(value == i);
+    }
+    assert(!ht.search(N, value));
+
+    vector<KeyValue<int, int>> more;
+    for (int i = N; i < 2 * N; i++) more.emplace_back(i, i * 2);
+    assert(ht.bulk_build(more.begin(), more.end(), true) == (size_t)N);
+    assert(ht.size() == 2 * (size_t)N);
+    for (int i = 1; i < N; i += 3) assert(ht.search(i, value) && value == i);
+    for (int i = N; i < 2 * N; i++) assert(ht.search(i, value) && value == i * 2);
+    ht.insert(2 * N, 1);
+    assert(ht.search(2 * N, value) && ht.remove(1) && !ht.search(1, value));
+    cout << "✓ Bulk build test passed for " << name << endl;
+}
+
+// Save, then load into a fresh table of the same type and into a chained
+// one; every group is visited once. Flat-layout files also open as a view.
+template<typename HashTable>
+void testPersist(const string& name) {
+    cout << "\n=== Persist Test: " << name << " ===" << endl;
+    const int N = 20000;
+    HashTable ht(1024);
+    for (int i = 0; i < N; i++) ht.insert(i, i * 7);
+    for (int i = 0; i < N; i += 5) ht.remove(i);
+    const size_t live = ht.size();
+
+    size_t visited = 0;
+    for (size_t g = 0; g < ht.group_count(); g++) ht.for_each_in_group(g, [&](const int& k, const int& v) {
+        assert(k % 5 != 0 && v == k * 7);
+        visited++;
+    });
+    assert(visited == live);
+
+    const string path = "/tmp/cht_persist_test.snap";
+    assert(save_snapshot(ht, path));
+    HashTable same(16);
+    assert(load_snapshot(path, same));
+    CoarseGrainedHashTable<int, int> other(16);
+    assert(load_snapshot(path, other));
+    assert(same.size() == live && other.size() == live);
+    int value;
+    for (int i = 0; i < N; i++) {
+        bool present = i % 5 != 0;
+        assert(same.search(i, value) == present && (!present || value == i * 7));
+        assert(other.search(i, value) == present && (!present || value == i * 7));
+    }
+    same.insert(N, 1);
+    assert(same.search(N, value) && same.size() == live + 1);
+
+    FlatSnapshotView<int, int> view;
+    assert(view.open(path) == has_flat_groups<HashTable>::value);
+    if (has_flat_groups<HashTable>::value) {
+        assert(view.size() == live);
+        for (int i = 0; i < N + 10; i++) {
+            bool present = i < N && i % 5 != 0;
+            assert(view.search(i, value) == present && (!present || value == i * 7));
+        }
+    }
+    assert(!load_snapshot("/tmp/cht_persist_missing.snap", same));
+    std::remove(path.c_str());
+    cout << "✓ Persist test passed for " << name << " (" << ht.group_count() << " groups)" << endl;
+}
+
+// for_each / parallel_for_each see every entry once, and top_k agrees with
+// a full sort (values repeat, so ties are broken by key)
+template<typename HashTable>
+void testIteration(const string& name) {
+    cout << "\n=== Iteration Test: " << name << " ===" << endl;
+    const int N = 20000;
+    HashTable ht(1024);
+    for (int i = 0; i < N; i++) ht.insert(i, (i * 37) % 1000);
+    for (int i = 0; i < N; i += 4) ht.remove(i);
+    const size_t live = ht.size();
+
+    size_t seen = 0;
+    long long key_sum = 0, expected_sum = 0;
+    ht.for_each([&](const int& k, const int& v) { assert(k % 4 != 0 && v == (k * 37) % 1000); seen++; key_sum += k; });
+    for (int i = 0; i < N; i++) if (i % 4 != 0) expected_sum += i;
+    assert(seen == live && key_sum == expected_sum);
+
+    std::atomic<size_t> par_seen{0};
+    std::atomic<long long> par_sum{0};
+    ht.parallel_for_each([&](const int& k, const int&) { par_seen++; par_sum += k; }, 4);
+    assert(par_seen.load() == live && par_sum.load() == expected_sum);
+
+    vector<pair<int, int>> all;
+    for (int i = 0; i < N; i++) if (i % 4 != 0) all.emplace_back(i, (i * 37) % 1000);
+    sort(all.begin(), all.end(), [](const pair<int, int>& a, const pair<int, int>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    auto top = top_k(ht, 50, 4);
+    assert(top.size() == 50 && std::equal(top.begin(), top.end(), all.begin()));
+    assert(top_k(ht, 0).empty() && top_k(ht, live + 10, 2).size() == live);
+    cout << "✓ Iteration test passed for " << name << endl;
+}
+
+// The lock-free cursor and the snapshot walk run against live writers: keys
+// never touched must each be seen exactly once.
+void testConcurrentIteration() {
+    cout << "\n=== Concurrent Iteration Test ===" << endl;
+    const int STABLE = 10000, CHURN = 4000;
+    LockFreeHashTable<int, int> lf(1024);
+    SnapshotHashTable<int, int> snap(1024);
+    for (int i = 0; i < STABLE; i++) { lf.insert(i, i); snap.insert(i, i); }
+    std::atomic<bool> done{false};
+    #pragma omp parallel num_threads(3)
+    {
+        if (omp_get_thread_num() == 0) {
+            for (int round = 0; round < 5; round++) {
+                vector<int> hits(STABLE, 0);
+                for (auto it = lf.iterate(); it.valid(); it.next()) {
+                    if (it.key() < STABLE) { assert(it.value() == it.key()); hits[it.key()]++; }
+                }
+                for (int h : hits) assert(h == 1);
+                hits.assign(STABLE, 0);
+                snap.for_each([&](const int& k, const int&) { if (k < STABLE) hits[k]++; });
+                for (int h : hits) assert(h == 1);
+            }
+            done = true;
+        } else {
+            int base = STABLE + omp_get_thread_num() * CHURN;
+            while (!done) {
+                for (int i = 0; i < CHURN; i++) { lf.insert(base + i, i); snap.insert(base + i, i); }
+                for (int i = 0; i < CHURN; i++) { lf.remove(base + i); snap.remove(base + i); }
+            }
+        }
+    }
+    ConcurrentSet<int> set(100);
+    for (int i = 0; i < 500; i++) set.insert_unique(i * 3);
+    set.insert_unique(std::numeric_limits<int>::max());
+    long long sum = 0;
+    size_t n = 0;
+    set.for_each([&](int k) { sum += k; n++; });
+    assert(n == 501 && sum == 3LL * 499 * 500 / 2 + std::numeric_limits<int>::max());
+    cout << "✓ Concurrent iteration test passed" << endl;
+}
+
+// Segments report a real node, homes split the segments into contiguous
+// blocks, and the table works however its segments were built
+template<typename HashTable>
+void testNumaPlacement(const string& name) {
+    cout << "\n=== NUMA Placement Test: " << name << " ===" << endl;
+    HashTable ht(1024);
+    const size_t segs = HashTable::segment_count();
+    for (size_t i = 0; i < segs; i++) {
+        assert(ht.segment_node(i) >= 0 && ht.segment_node(i) < numa_machine_nodes());
+    }
+    assert(numa_segment_home(0, segs, 2) == 0 && numa_segment_home(segs / 2 - 1, segs, 2) == 0);
+    assert(numa_segment_home(segs / 2, segs, 2) == 1 && numa_segment_home(segs - 1, segs, 2) == 1);
+    assert(numa_node_count() >= 1 && numa_node_count() <= numa_machine_nodes());
+
+    const int N = 20000;
+    #pragma omp parallel for num_threads(4)
+    for (int i = 0; i < N; i++) ht.insert(i, i);
+    int value;
+    for (int i = 0; i < N; i++) {
+        assert(ht.segment_of(i) < segs);
+        assert(ht.search(i, value) && value == i);
+    }
+    cout << "✓ NUMA placement test passed for " << name
+         << " (" << numa_node_count() << " node(s))" << endl;
+}
+
+// Nodes freed on one thread are reused by another; every key must survive
+// repeated fill/drain cycles, and the std::allocator instantiation must agree.
+void testPoolAllocator() {
+    cout << "\n=== Pool Allocator Test ===" << endl;
+    const int N = 20000;
+    FineGrainedHashTable<int, int> pooled(512);
+    FineGrainedHashTable<int, int, Hash<int>, std::allocator<KeyValue<int, int>>> plain(512);
+    for (int round = 0; round < 3; round++) {
+        #pragma omp parallel for num_threads(4)
+        for (int i = 0; i < N; i++) { pooled.insert(i, i + round); plain.insert(i, i + round); }
+        #pragma omp parallel for num_threads(4) schedule(static, 7)
+        for (int i = 0; i < N; i += 2) { assert(pooled.remove(i)); assert(plain.remove(i)); }
+        int a, b;
+        for (int i = 0; i < N; i++) {
+            bool fa = pooled.search(i, a), fb = plain.search(i, b);
+            assert(fa == (i % 2 == 1) && fa == fb);
+            if (fa) assert(a == i + round && a == b);
+        }
+    }
+    cout << "✓ Pool allocator test passed" << endl;
+}
+
+// std::allocator that counts the blocks it has outstanding.
+template<typename T>
+struct CountingAllocator {
+    using value_type = T;
+    static inline long live = 0;
+    CountingAllocator() noexcept = default;
+    template<typename U> CountingAllocator(const CountingAllocator<U>&) noexcept {}
+    T* allocate(size_t n) { CountingAllocator<char>::live++; return std::allocator<T>().allocate(n); }
+    void deallocate(T* p, size_t n) noexcept { CountingAllocator<char>::live--; std::allocator<T>().deallocate(p, n); }
+};
+template<typename T, typename U>
+bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept { return true; }
+template<typename T, typename U>
+bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) noexcept { return false; }
+
+// Packed chains: inline to heap growth, erase by swap-with-last, and a SIMD
+// lookup that must not match values equal to the key it looks for.
+void testPackedChain() {
+    cout << "\n=== Packed Chain Test ===" << endl;
+    static_assert(sizeof(PackedChain<int, int>) == 16, "packed chain header is 16 bytes");
+#ifndef CHT_LIST_CHAINS
+    static_assert(std::is_same<ChainFor<int, int, std::allocator<KeyValue<int, int>>>, PackedChain<int, int>>::value, "");
+    static_assert(std::is_same<ChainFor<short, bool, std::allocator<KeyValue<short, bool>>>, PackedChain<short, bool>>::value, "");
+#endif
+    static_assert(std::is_same<ChainFor<int, string, std::allocator<KeyValue<int, string>>>,
+                               std::list<KeyValue<int, string>, std::allocator<KeyValue<int, string>>>>::value, "");
+
+    PackedChain<int, int> c;
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 100; i++) c.emplace_back(i, 1000 + i);
+        assert(c.size() == 100);
+        for (int i = 0; i < 100; i++) assert(c.find(i) && c.find(i)->value == 1000 + i);
+        for (int i = 1000; i < 1100; i++) assert(!c.find(i));   // values never match
+        for (int i = 0; i < 100; i += 2) c.erase(c.find(i));
+        assert(c.size() == 50);
+        for (int i = 0; i < 100; i++) assert((c.find(i) != nullptr) == (i % 2 == 1));
+        c.clear();
+        assert(c.empty() && !c.find(1));
+    }
+
+    // shrink_to_fit drops the slack a mass erase leaves, then goes back inline.
+    for (int i = 0; i < 100; i++) c.emplace_back(i, i);
+    assert(c.heap_bytes() == 128 * sizeof(KeyValue<int, int>));
+    for (int i = 0; i < 90; i++) c.erase(c.find(i));
+    assert(c.shrink_to_fit() == 118 * sizeof(KeyValue<int, int>) && c.heap_bytes() == 10 * sizeof(KeyValue<int, int>));
+    for (int i = 90; i < 100; i++) assert(c.find(i) && c.find(i)->value == i);
+    for (int i = 90; i < 99; i++) c.erase(c.find(i));
+    assert(c.shrink_to_fit() == 10 * sizeof(KeyValue<int, int>) && c.heap_bytes() == 0);
+    assert(c.size() == 1 && c.find(99) && c.find(99)->value == 99 && c.shrink_to_fit() == 0);
+    c.emplace_back(1, 1);
+    assert(c.find(1) && c.find(99));
+
+    PackedChain<short, bool> small;   // two entries fit inline
+    for (short i = 0; i < 9; i++) small.emplace_back(i, i % 3 == 0);
+    for (short i = 0; i < 9; i++) assert(small.find(i) && small.find(i)->value == (i % 3 == 0));
+    while (!small.empty()) small.erase(small.begin());
+
+    // The heap block comes from the table's Alloc.
+    {
+        SequentialHashTable<int, int, Hash<int>, CountingAllocator<KeyValue<int, int>>> counted(1);
+        for (int i = 0; i < 100; i++) counted.insert(i, i);
+        assert(CountingAllocator<char>::live > 0);
+        for (int i = 0; i < 100; i++) counted.remove(i);
+        assert(CountingAllocator<char>::live == 0);
+    }
+
+    // One bucket, so every key shares a chain; a string value stays on std::list.
+    SequentialHashTable<int, int> one(1);
+    SequentialHashTable<int, string> strings(1);
+    const int N = 2000;
+    for (int i = 0; i < N; i++) { assert(one.insert(i, N + i)); strings.insert(i, to_string(i)); }
+    for (int i = 0; i < N; i += 3) { assert(one.remove(i)); strings.remove(i); }
+    int v;
+    string sv;
+    for (int i = 0; i < 2 * N; i++) {
+        bool expect = i < N && i % 3 != 0;
+        assert(one.search(i, v) == expect && strings.search(i, sv) == expect);
+        if (expect) assert(v == N + i && sv == to_string(i));
+    }
+
+    // Growth splits packed chains like list chains.
+    SegmentBasedHashTable<int, int> seg(16);
+    for (int i = 0; i < 50000; i++) seg.insert(i, i);
+    assert(seg.size() == 50000);
+    for (int i = 0; i < 50000; i++) assert(seg.search(i, v) && v == i);
+    cout << "✓ Packed chain test passed" << endl;
+}
+
+// Removes 9 keys in 10 from a table holding [0, N), then shrink_to_fit hands
+// memory back while the other threads keep inserting, reading and removing
+// keys of their own; the remaining keys must all survive.
+template<typename HashTable>
+void checkShrink(HashTable& ht, const string& name, int N, int num_threads) {
+    for (int i = 0; i < N; i++) if (i % 10) assert(ht.remove(i));
+    size_t before = ht.memory_usage().total();
+    size_t freed = 0;
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int t = omp_get_thread_num();
+        if (t == 0) {
+            freed = ht.shrink_to_fit();
+        } else {
+            int base = N + t * 10000, v;
+            for (int i = base; i < base + 2000; i++) ht.insert(i, i);
+            for (int i = base; i < base + 2000; i++) assert(ht.search(i, v) && v == i);
+            for (int i = base; i < base + 2000; i++) assert(ht.remove(i));
+        }
+    }
+    MemoryUsage after = ht.memory_usage();
+#ifndef CHT_LIST_CHAINS   // list chains hold no slack, only tables that grew would free anything
+    assert(freed > 0 && after.total() < before);
+#endif
+    if (num_threads == 1) assert(before - after.total() == freed);
+    assert(after.entries == (size_t)N / 10 && ht.size() == (size_t)N / 10);
+    int v = 0;
+    for (int i = 0; i < N; i++) assert(ht.search(i, v) == (i % 10 == 0) && (i % 10 || v == i));
+    assert(ht.shrink_to_fit() <= freed);
+    for (int i = 0; i < N; i++) ht.insert(i, -i);   // grows back
+    for (int i = 0; i < N; i++) assert(ht.search(i, v) && v == -i);
+    cout << "  " << name << ": " << before << " -> " << after.total() << " bytes after shrink_to_fit" << endl;
+}
+
+// memory_usage() reports every entry, its parts add up and it grows with the
+// table; tables with shrink_to_fit then run checkShrink.
+template<typename HashTable, bool Shrinks = true>
+void testMemoryUsage(const string& name, int num_threads = 4) {
+    cout << "\n=== Memory Usage Test: " << name << " ===" << endl;
+    HashTable ht(64);
+    const int N = 60000;
+    MemoryUsage empty = ht.memory_usage();
+    assert(empty.entries == 0 && empty.total() > 0 && empty.bytes_per_entry() == 0.0);
+    for (int i = 0; i < N; i++) ht.insert(i, i);
+    MemoryUsage full = ht.memory_usage();
+    assert(full.entries == (size_t)N && full.total() > empty.total());
+    assert(full.total() == full.buckets + full.nodes + full.locks + full.padding + full.other);
+    assert(full.bytes_per_entry() >= 8.0);
+    if constexpr (Shrinks) checkShrink(ht, name, N, num_threads);
+    cout << "✓ Memory usage test passed for " << name << " (" << full.bytes_per_entry() << " B/entry)" << endl;
+}
+
+// Sequential keys must spread over both the top bits (segments/stripes) and
+// the low bits (buckets); string hashing must cover every tail length.
+void testHashSpread() {
+    cout << "\n=== Hash Spread Test ===" << endl;
+    const size_t N = 1 << 16, SLOTS = 512;
+    vector<size_t> top(SLOTS, 0), low(SLOTS, 0);
+    for (size_t i = 0; i < N; i++) {
+        size_t h = Hash<int>{}(int(i));
+        top[h >> (sizeof(size_t) * 8 - 9)]++;
+        low[h & (SLOTS - 1)]++;
+    }
+    for (size_t i = 0; i < SLOTS; i++) {
+        assert(top[i] < 2 * N / SLOTS && low[i] < 2 * N / SLOTS);
+    }
+
+    string text = "the quick brown fox jumps over the lazy dog, again and again";
+    vector<size_t> seen;
+    for (size_t len = 0; len <= text.size(); len++) {
+        string a = text.substr(0, len), b = a;
+        assert(Hash<string>{}(a) == Hash<string>{}(b));
+        for (size_t h : seen) assert(h != Hash<string>{}(a));
+        seen.push_back(Hash<string>{}(a));
+    }
+    cout << "✓ Hash spread test passed" << endl;
+}
+
+// upsert / insert_if_absent / compute_if_present / increment
+template<typename HashTable>
+void testUpsert(const string& name, int num_threads) {
+    cout << "\n=== Upsert Test: " << name << " ===" << endl;
+    HashTable ht(64);
+    int value;
+
+    assert(ht.insert_if_absent(1, 10));
+    assert(!ht.insert_if_absent(1, 20));              // never overwrites
+    assert(ht.search(1, value) && value == 10);
+    assert(!ht.compute_if_present(2, [](int& v) { v = -1; }));
+    assert(!ht.search(2, value));                      // absent key stays absent
+    assert(ht.compute_if_present(1, [](int& v) { v *= 3; }));
+    assert(ht.search(1, value) && value == 30);
+    assert(!ht.upsert(1, [](int& v) { v += 1; }, 0));
+    assert(ht.upsert(2, [](int& v) { v += 1; }, 5));
+    assert(ht.search(1, value) && value == 31);
+    assert(ht.search(2, value) && value == 5);
+
+    // Every thread bumps every key; totals must be exact and each key
+    // reported as inserted exactly once.
+    const int KEYS = 1000, ROUNDS = 20;
+    size_t inserted = 0;
+    #pragma omp parallel for num_threads(num_threads) reduction(+:inserted)
+    for (int t = 0; t < num_threads; t++) {
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int k = 0; k < KEYS; k++) inserted += ht.increment(100 + k, 1);
+        }
+    }
+    assert(inserted == (size_t)KEYS);
+    assert(ht.size() == (size_t)KEYS + 2);
+    for (int k = 0; k < KEYS; k++) assert(ht.search(100 + k, value) && value == num_threads * ROUNDS);
+    cout << "✓ Upsert test passed for " << name << endl;
+}
+
+// Tables with flat combining switched on (combining.h).
+template<typename HT>
+struct Combining : HT {
+    explicit Combining(size_t buckets = 1024) : HT(buckets) { this->set_combining(true); }
+};
+
+// Many threads on a handful of hot keys, so lock holders serve waiters'
+// requests; counts must stay exact and lookups must see every write.
+template<typename HashTable>
+void testCombining(const string& name) {
+    cout << "\n=== Combining Test: " << name << " ===" << endl;
+    HashTable ht(64);
+    assert(!ht.combining());
+    ht.set_combining(true);
+    assert(ht.combining());
+    const int THREADS = 8, HOT = 4, ROUNDS = 20000;
+    size_t inserted = 0, removed = 0;
+    #pragma omp parallel num_threads(THREADS) reduction(+:inserted, removed)
+    {
+        int tid = omp_get_thread_num();
+        int value;
+        for (int r = 0; r < ROUNDS; r++) {
+            inserted += ht.increment(r % HOT, 1);
+            int own = 1000 + tid * ROUNDS + r;   // private keys, inserted then removed
+            assert(ht.insert(own, r));
+            assert(ht.search(own, value) && value == r);
+            if (r % 2) removed += ht.remove(own);
+        }
+    }
+    assert(inserted == (size_t)HOT && removed == size_t(THREADS * ROUNDS / 2));
+    assert(ht.size() == size_t(HOT + THREADS * ROUNDS / 2));
+    int value;
+    for (int k = 0; k < HOT; k++) assert(ht.search(k, value) && value == THREADS * ROUNDS / HOT);
+    ht.set_combining(false);
+    assert(ht.increment(0, 1) == false && ht.search(0, value) && value == THREADS * ROUNDS / HOT + 1);
+    cout << "✓ Combining test passed for " << name << endl;
+}
+
+#ifdef CHT_COROUTINES
+// Fire-and-forget coroutine for the co_await API.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+template<typename Async>
+DetachedTask addThenRead(Async& async, int key, atomic<int>& seen, atomic<int>& finished) {
+    co_await async.co_increment(key, 5);
+    auto r = co_await async.co_search(key);
+    if (r.ok) seen += r.value;
+    finished++;
+}
+#endif
+
+// Completion that submits its request again until quiet is set.
+struct FloodCtx {
+    atomic<bool> quiet{false};
+    atomic<long> runs{0};
+    function<void(AsyncRequest<int, int>&)> resubmit;
+    static void complete(AsyncRequest<int, int>& r) {
+        FloodCtx& f = *static_cast<FloodCtx*>(r.ctx);
+        f.runs++;
+        if (!f.quiet.load()) f.resubmit(r);
+    }
+};
+
+template<typename HashTable>
+void testAsync(const string& name) {
+    cout << "\n=== Async Test: " << name << " ===" << endl;
+    HashTable ht(64);
+    const int THREADS = 4, N = 5000, HOT = 100;
+    {
+        AsyncTable<int, int, HashTable> async(ht, 2);
+        #pragma omp parallel num_threads(THREADS)
+        {
+            int tid = omp_get_thread_num();
+            vector<future<AsyncResult<int>>> pending;
+            for (int i = 0; i < N; i++) pending.push_back(async.increment(i % HOT, 1));
+            for (auto& f : pending) f.get();
+            pending.clear();
+            // Searches queued behind unawaited inserts still see them.
+            for (int i = 0; i < N; i++) pending.push_back(async.insert(100000 + tid * N + i, i));
+            for (int i = 0; i < N; i++) pending.push_back(async.search(100000 + tid * N + i));
+            for (int i = 0; i < N; i++) assert(pending[i].get().ok);
+            for (int i = 0; i < N; i++) {
+                AsyncResult<int> r = pending[N + i].get();
+                assert(r.ok && r.value == i);
+            }
+        }
+        AsyncResult<int> hot = async.search(7).get();
+        assert(hot.ok && hot.value == THREADS * N / HOT);
+        assert(!async.search(-1).get().ok);
+
+        // Caller-owned requests with a completion callback.
+        atomic<int> done{0};
+        vector<AsyncRequest<int, int>> reqs(HOT);
+        for (int k = 0; k < HOT; k++) {
+            reqs[k].op = AsyncOp::Remove;
+            reqs[k].key = k;
+            reqs[k].ctx = &done;
+            reqs[k].complete = [](AsyncRequest<int, int>& r) { ++*static_cast<atomic<int>*>(r.ctx); };
+            async.submit(reqs[k]);
+        }
+        while (done.load() < HOT) this_thread::yield();
+        for (auto& r : reqs) assert(r.result);
+
+#ifdef CHT_COROUTINES
+        atomic<int> seen{0}, finished{0};
+        for (int k = 0; k < HOT; k++) addThenRead(async, k, seen, finished);
+        while (finished.load() < HOT) this_thread::yield();
+        assert(seen.load() == 5 * HOT);
+#endif
+    }
+    // Everything submitted ran before the workers stopped.
+    int value;
+#ifdef CHT_COROUTINES
+    assert(ht.size() == size_t(THREADS * N + HOT));
+    assert(ht.search(0, value) && value == 5);
+#else
+    assert(ht.size() == size_t(THREADS * N));
+    assert(!ht.search(0, value));
+#endif
+
+    // Flood requests resubmit themselves from the worker, so its own ring
+    // never holds less than a full batch; another thread still gets through.
+    HashTable flooded(64);
+    FloodCtx flood;
+    vector<AsyncRequest<int, int>> reqs(2 * CHT_ASYNC_BATCH);
+    {
+        AsyncTable<int, int, HashTable> async(flooded, 1);
+        flood.resubmit = [&](AsyncRequest<int, int>& r) { async.submit(r); };
+        for (auto& r : reqs) {
+            r.op = AsyncOp::Increment;
+            r.key = -1;
+            r.value = 1;
+            r.ctx = &flood;
+            r.complete = FloodCtx::complete;
+            async.submit(r);
+        }
+        while (flood.runs.load() < long(reqs.size())) this_thread::yield();
+        thread other([&] {
+            for (int i = 0; i < HOT; i++) assert(async.insert(i, i).get().ok);
+        });
+        other.join();
+        flood.quiet.store(true);
+    }
+    assert(flooded.search(-1, value) && value == int(flood.runs.load()));
+    assert(flooded.size() == size_t(HOT + 1));
+    cout << "✓ Async test passed for " << name << endl;
+}
+
+// Concurrent inserts of overlapping ranges count each key once, and the
+// set's empty-slot marker still works as a key.
+void testConcurrentSet() {
+    cout << "\n=== Concurrent Set Test ===" << endl;
+    ConcurrentSet<int> set(16);   // starts tiny, so shards grow under contention
+    const int N = 100000;
+    size_t added = 0;
+    // Four threads insert overlapping halves of [0, N)
+    #pragma omp parallel for num_threads(4) reduction(+:added)
+    for (int i = 0; i < 2 * N; i++) added += set.insert_unique(i % N);
+    assert(added == (size_t)N && set.size() == (size_t)N);
+    for (int i = 0; i < N; i++) assert(set.contains(i));
+    assert(!set.contains(N) && !set.contains(-1));
+
+    // The empty marker is an ordinary key to callers
+    int marker = numeric_limits<int>::max();
+    assert(!set.contains(marker) && set.insert_unique(marker) && !set.insert_unique(marker));
+    assert(set.contains(marker) && set.size() == (size_t)N + 1);
+
+    vector<long long> keys;
+    for (int i = 0; i < N; i++) keys.push_back((i * 7919LL) % 1000);
+    assert(count_distinct(keys.data(), keys.size(), 4) == 1000);
+    MemoryUsage m = set.memory_usage();
+    assert(m.entries == set.size() && m.buckets == set.slot_count() * sizeof(int) && m.total() > m.buckets);
+    cout << "✓ Concurrent set test passed (" << set.slot_count() * sizeof(int) / set.size()
+         << " bytes/key)" << endl;
+}
+
+// The cache never holds more than its capacity, keeps a hot key, and
+// counts every eviction.
+void testClockCache() {
+    cout << "\n=== Clock Cache Test ===" << endl;
+    ClockCache<int, int> cache(1000);
+    const size_t cap = cache.capacity();
+    assert(cap >= 1000);
+    int value;
+
+    // Shards fill unevenly, so only the total is bounded; key 0 keeps
+    // getting hit, so CLOCK never evicts it
+    assert(cache.insert(0, 0));
+    assert(!cache.insert(0, 7) && cache.search(0, value) && value == 7);
+    for (int i = 1; i < 10 * (int)cap; i++) {
+        assert(cache.search(0, value));
+        assert(cache.insert(i, i));
+        assert(cache.size() <= cap);
+    }
+    assert(cache.size() == cap);   // every shard has filled by now
+    assert(cache.evictions() == 10 * cap - cap);
+    assert(cache.search(0, value) && value == 7);
+    assert(cache.remove(0) && !cache.search(0, value) && cache.size() == cap - 1);
+    MemoryUsage m = cache.memory_usage();
+    assert(m.entries == cap - 1 && m.buckets >= cap * 2 * sizeof(int) && m.locks > 0);
+
+    // Concurrent churn never exceeds capacity and keeps evictions exact
+    ClockCache<int, int> shared(1000);
+    size_t inserted = 0;
+    #pragma omp parallel for num_threads(4) reduction(+:inserted)
+    for (int i = 0; i < 50000; i++) {
+        if (!shared.search(i % 3000, value)) inserted += shared.insert(i % 3000, i);
+    }
+    assert(shared.size() == shared.capacity());
+    assert(shared.evictions() == inserted - shared.size());
+    cout << "✓ Clock cache test passed" << endl;
+}
+
+// More threads than slots, and removals counted on other threads than the
+// matching inserts: once quiescent the sum must be exact.
+void testShardedCounter() {
+    cout << "\n=== Sharded Counter Test ===" << endl;
+    ShardedCounter c;
+    const int N = 100000;
+    #pragma omp parallel for num_threads(CHT_COUNTER_SLOTS + 16) schedule(static, 1)
+    for (int i = 0; i < N; i++) c.add(2);
+    #pragma omp parallel for num_threads(4) schedule(dynamic, 64)
+    for (int i = 0; i < N; i++) c.sub(1);
+    assert(c.load() == (size_t)N);
+    cout << "✓ Sharded counter test passed" << endl;
+}
+
 int main() {
     cout << "==================================" << endl;
     cout << "  Hash Table Correctness Tests" << endl;
@@ -88,12 +1093,175 @@ int main() {
     testHashTable<SegmentBasedHashTable<int, int>>("Segment-Based");
     testHashTable<FineGrainedHashTable<int, int>>("Fine-Grained");
     testHashTable<LockFreeHashTable<int, int>>("Lock-Free");
+    testHashTable<AGHHashTable<int, int>>("AGH");
+    testHashTable<FlatHashTable<int, int>>("Flat");
+    testHashTable<StripedFlatHashTable<int, int>>("Flat-Striped");
+    testHashTable<CuckooHashTable<int, int>>("Cuckoo");
+    testHashTable<SplitOrderedHashTable<int, int>>("Split-Ordered");
+    testHashTable<SnapshotHashTable<int, int>>("Snapshot");
+    testHashTable<FineGrainedHashTable<int, int, StdHash<int>>>("Fine-Grained<StdHash>");
+    testFlatGrowth();
+    testHashSpread();
     
     // Concurrent correctness tests
     testConcurrent<CoarseGrainedHashTable<int, int>>("Coarse-Grained", 4);
     testConcurrent<SegmentBasedHashTable<int, int>>("Segment-Based", 4);
     testConcurrent<FineGrainedHashTable<int, int>>("Fine-Grained", 4);
     testConcurrent<LockFreeHashTable<int, int>>("Lock-Free", 4);
+    testConcurrent<AGHHashTable<int, int>>("AGH", 4);
+    testConcurrent<StripedFlatHashTable<int, int>>("Flat-Striped", 4);
+    testConcurrent<CuckooHashTable<int, int>>("Cuckoo", 4);
+    testConcurrent<SplitOrderedHashTable<int, int>>("Split-Ordered", 4);
+    testConcurrent<SnapshotHashTable<int, int>>("Snapshot", 4);
+    testConcurrent<Combining<SegmentBasedHashTable<int, int>>>("Segment-Based/combining", 8);
+    testConcurrent<Combining<AGHHashTable<int, int>>>("AGH/combining", 8);
+
+    // Lock policies
+    testLock<RWSpinLock>("RWSpinLock");
+    testLock<TTASLock>("TTAS");
+    testLock<TicketLock>("Ticket");
+    testLock<MCSLock>("MCS");
+    testLock<SharedMutexLock>("shared_mutex");
+    testLock<OmpLock>("omp_lock_t");
+    using KV = DefaultNodeAllocator<KeyValue<int, int>>;
+    testConcurrent<CoarseGrainedHashTable<int, int, Hash<int>, KV, TicketLock>>("Coarse-Grained/Ticket", 4);
+    testConcurrent<FineGrainedHashTable<int, int, Hash<int>, KV, TTASLock>>("Fine-Grained/TTAS", 4);
+    testConcurrent<FineGrainedHashTable<int, int, Hash<int>, KV, SharedMutexLock>>("Fine-Grained/shared_mutex", 4);
+    testConcurrent<SegmentBasedHashTable<int, int, Hash<int>, KV, MCSLock>>("Segment-Based/MCS", 4);
+
+    testConcurrentRemove<FineGrainedHashTable<int, int>>("Fine-Grained", 4);
+    testConcurrentRemove<SegmentBasedHashTable<int, int>>("Segment-Based", 4);
+    testConcurrentRemove<AGHHashTable<int, int>>("AGH", 4);
+    testConcurrentRemove<LockFreeHashTable<int, int>>("Lock-Free", 4);
+    testConcurrentRemove<CuckooHashTable<int, int>>("Cuckoo", 4);
+    testConcurrentRemove<SplitOrderedHashTable<int, int>>("Split-Ordered", 4);
+    testConcurrentRemove<SnapshotHashTable<int, int>>("Snapshot", 4);
+    testConcurrentRemove<Combining<SegmentBasedHashTable<int, int>>>("Segment-Based/combining", 8);
+    testConcurrentRemove<Combining<AGHHashTable<int, int>>>("AGH/combining", 8);
+    testConcurrentRemove<LockFreeHashTable<int, string>, string>("Lock-Free<int,string>", 4);
+
+    // Batched operations
+    testBatch<CoarseGrainedHashTable<int, int>>("Coarse-Grained");
+    testBatch<FineGrainedHashTable<int, int>>("Fine-Grained");
+    testBatch<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testBatch<AGHHashTable<int, int>>("AGH");
+    testBatch<LockFreeHashTable<int, int>>("Lock-Free");
+    testBatch<StripedFlatHashTable<int, int>>("Flat-Striped");
+    testBatch<CuckooHashTable<int, int>>("Cuckoo");
+    testBatch<SplitOrderedHashTable<int, int>>("Split-Ordered");
+    testBatch<SnapshotHashTable<int, int>>("Snapshot");
+    testBatch<CoarseGrainedHashTablePadded<int, int>>("Coarse-Grained-Padded");
+    testBatch<FineGrainedHashTablePadded<int, int>>("Fine-Grained-Padded");
+    testBatch<SegmentBasedHashTablePadded<int, int>>("Segment-Based-Padded");
+
+    // Online resizing
+    testGrowth<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testGrowth<AGHHashTable<int, int>>("AGH");
+    testGrowth<SplitOrderedHashTable<int, int>>("Split-Ordered");
+    testAdaptiveStripes();
+
+    // NUMA segment placement
+    testNumaPlacement<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testNumaPlacement<AGHHashTable<int, int>>("AGH");
+
+    // Read-modify-write operations
+    testUpsert<CoarseGrainedHashTable<int, int>>("Coarse-Grained", 4);
+    testUpsert<SegmentBasedHashTable<int, int>>("Segment-Based", 4);
+    testUpsert<FineGrainedHashTable<int, int>>("Fine-Grained", 4);
+    testUpsert<LockFreeHashTable<int, int>>("Lock-Free", 4);
+    testUpsert<AGHHashTable<int, int>>("AGH", 4);
+    testUpsert<FlatHashTable<int, int>>("Flat", 1);
+    testUpsert<StripedFlatHashTable<int, int>>("Flat-Striped", 4);
+    testUpsert<CuckooHashTable<int, int>>("Cuckoo", 4);
+    testUpsert<SplitOrderedHashTable<int, int>>("Split-Ordered", 4);
+    testUpsert<SnapshotHashTable<int, int>>("Snapshot", 4);
+    testUpsert<Combining<SegmentBasedHashTable<int, int>>>("Segment-Based/combining", 8);
+    testUpsert<Combining<AGHHashTable<int, int>>>("AGH/combining", 8);
+    testCombining<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testCombining<AGHHashTable<int, int>>("AGH");
+    testCombining<SegmentBasedHashTable<int, int, Hash<int>, DefaultNodeAllocator<KeyValue<int, int>>, MCSLock>>("Segment-Based/MCS");
+
+    // Submission/completion front end (batched and per-op paths)
+    testAsync<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testAsync<LockFreeHashTable<int, int>>("Lock-Free");
+    testAsync<FineGrainedHashTablePadded<int, int>>("Fine-Grained-Padded");
+
+    // Memory accounting and shrink_to_fit
+    testMemoryUsage<SequentialHashTable<int, int>>("Sequential", 1);
+    testMemoryUsage<FlatHashTable<int, int>>("Flat", 1);
+    testMemoryUsage<CoarseGrainedHashTable<int, int>>("Coarse-Grained");
+    testMemoryUsage<CoarseGrainedHashTablePadded<int, int>>("Coarse-Grained-Padded");
+    testMemoryUsage<FineGrainedHashTable<int, int>>("Fine-Grained");
+    testMemoryUsage<FineGrainedHashTablePadded<int, int>>("Fine-Grained-Padded");
+    testMemoryUsage<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testMemoryUsage<SegmentBasedHashTablePadded<int, int>>("Segment-Based-Padded");
+    testMemoryUsage<AGHHashTable<int, int>>("AGH");
+    testMemoryUsage<StripedFlatHashTable<int, int>>("Flat-Striped");
+    testMemoryUsage<Combining<SegmentBasedHashTable<int, int>>>("Segment-Based/combining");
+    testMemoryUsage<LockFreeHashTable<int, int>, false>("Lock-Free");
+    testMemoryUsage<SplitOrderedHashTable<int, int>, false>("Split-Ordered");
+    testMemoryUsage<CuckooHashTable<int, int>, false>("Cuckoo");
+    testMemoryUsage<SnapshotHashTable<int, int>, false>("Snapshot");
+
+    // Parallel bulk loading
+    testBulkBuild<SequentialHashTable<int, int>>("Sequential");
+    testBulkBuild<CoarseGrainedHashTable<int, int>>("Coarse-Grained");
+    testBulkBuild<FineGrainedHashTable<int, int>>("Fine-Grained");
+    testBulkBuild<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testBulkBuild<AGHHashTable<int, int>>("AGH");
+    testBulkBuild<LockFreeHashTable<int, int>>("Lock-Free");
+    testBulkBuild<FlatHashTable<int, int>>("Flat");
+    testBulkBuild<StripedFlatHashTable<int, int>>("Flat-Striped");
+    testBulkBuild<SnapshotHashTable<int, int>>("Snapshot");
+    testBulkBuild<CoarseGrainedHashTablePadded<int, int>>("Coarse-Grained-Padded");
+    testBulkBuild<FineGrainedHashTablePadded<int, int>>("Fine-Grained-Padded");
+    testBulkBuild<SegmentBasedHashTablePadded<int, int>>("Segment-Based-Padded");
+    testBulkBuild<CuckooHashTable<int, int>>("Cuckoo", false);
+    testBulkBuild<SplitOrderedHashTable<int, int>>("Split-Ordered", false);
+
+    // Save / load / mapped view
+    testPersist<SequentialHashTable<int, int>>("Sequential");
+    testPersist<CoarseGrainedHashTable<int, int>>("Coarse-Grained");
+    testPersist<FineGrainedHashTable<int, int>>("Fine-Grained");
+    testPersist<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testPersist<AGHHashTable<int, int>>("AGH");
+    testPersist<LockFreeHashTable<int, int>>("Lock-Free");
+    testPersist<CuckooHashTable<int, int>>("Cuckoo");
+    testPersist<SplitOrderedHashTable<int, int>>("Split-Ordered");
+    testPersist<FlatHashTable<int, int>>("Flat");
+    testPersist<StripedFlatHashTable<int, int>>("Flat-Striped");
+    testPersist<SnapshotHashTable<int, int>>("Snapshot");
+    testPersist<CoarseGrainedHashTablePadded<int, int>>("Coarse-Grained-Padded");
+    testPersist<FineGrainedHashTablePadded<int, int>>("Fine-Grained-Padded");
+    testPersist<SegmentBasedHashTablePadded<int, int>>("Segment-Based-Padded");
+
+    // Iteration and top-K
+    testIteration<SequentialHashTable<int, int>>("Sequential");
+    testIteration<CoarseGrainedHashTable<int, int>>("Coarse-Grained");
+    testIteration<FineGrainedHashTable<int, int>>("Fine-Grained");
+    testIteration<SegmentBasedHashTable<int, int>>("Segment-Based");
+    testIteration<AGHHashTable<int, int>>("AGH");
+    testIteration<LockFreeHashTable<int, int>>("Lock-Free");
+    testIteration<CuckooHashTable<int, int>>("Cuckoo");
+    testIteration<SplitOrderedHashTable<int, int>>("Split-Ordered");
+    testIteration<FlatHashTable<int, int>>("Flat");
+    testIteration<StripedFlatHashTable<int, int>>("Flat-Striped");
+    testIteration<SnapshotHashTable<int, int>>("Snapshot");
+    testIteration<CoarseGrainedHashTablePadded<int, int>>("Coarse-Grained-Padded");
+    testIteration<FineGrainedHashTablePadded<int, int>>("Fine-Grained-Padded");
+    testIteration<SegmentBasedHashTablePadded<int, int>>("Segment-Based-Padded");
+    testConcurrentIteration();
+
+    testCuckooOccupancy();
+    testSnapshotReaders();
+    testInstrumentation();
+    testWorkload();
+
+    testConcurrentSet();
+    testClockCache();
+    testPoolAllocator();
+    testPackedChain();
+    testShardedCounter();
     
     cout << "\n✓✓✓ All tests passed! ✓✓✓" << endl;
     
@@ -6,12 +6,14 @@
 #include <iomanip>
 #include <omp.h>
 #include "../fine_grained.h"
+#include "../mapped_file.h"
 #include "word_count_common.h"
 
 using namespace std;
 
 // Word count using concurrent hash table library
-double wordCountWithLibrary(const string& filename, int num_threads, size_t& total_words, size_t& unique_words) {
+double wordCountWithLibrary(const string& filename, int num_threads, size_t& total_words, size_t& unique_words,
+                            size_t combine_threshold = 0) {
     FineGrainedHashTable<string, int> wordCount(8192);
     
     vector<string> words = readWordsFromFile(filename);
@@ -23,23 +25,34 @@ double wordCountWithLibrary(const string& filename, int num_threads, size_t& tot
     
     double start_time = omp_get_wtime();
     
-    #pragma omp parallel num_threads(num_threads)
-    {
-        #pragma omp for
-        for (size_t i = 0; i < words.size(); ++i) {
-            // Use increment method to atomically increment count
-            // This avoids race condition between search and insert
-            wordCount.increment(words[i], 1);
-        }
+    countWords(words, wordCount, num_threads, combine_threshold);
+    
+    double end_time = omp_get_wtime();
+    unique_words = wordCount.size();
+    
+    return end_time - start_time;
+}
+
+// Same count from a memory-mapped file; the timed phase includes tokenizing.
+double wordCountMapped(const string& filename, int num_threads, size_t& total_words, size_t& unique_words) {
+    FineGrainedHashTable<string, int> wordCount(8192);
+    
+    MappedFile file(filename);
+    if (!file.valid() || file.size() == 0) {
+        return -1;
     }
     
+    double start_time = omp_get_wtime();
+    
+    total_words = countWordsMapped(file.data(), file.size(), wordCount, num_threads, 0);
+    
     double end_time = omp_get_wtime();
     unique_words = wordCount.size();
     
     return end_time - start_time;
 }
 
-void runBenchmark(const string& filename, const vector<int>& thread_counts) {
+void runBenchmark(const string& filename, const vector<int>& thread_counts, size_t combine_threshold, bool use_mmap) {
     cout << "=====================================" << endl;
     cout << "  Word Count Performance Benchmark" << endl;
     cout << "=====================================" << endl;
@@ -88,6 +101,46 @@ void runBenchmark(const string& filename, const vector<int>& thread_counts) {
              << setw(15) << fixed << setprecision(2) << speedup << endl;
     }
     
+    // Same thread counts with thread-local pre-aggregation (--combine)
+    if (combine_threshold > 0) {
+        cout << "\n--- Library, combining (flush every " << combine_threshold << " distinct words) ---" << endl;
+        for (int threads : thread_counts) {
+            size_t total_words = 0, unique_words = 0;
+            double time = wordCountWithLibrary(filename, threads, total_words, unique_words, combine_threshold);
+            
+            if (time < 0) continue;
+            
+            double throughput = (total_words / time) / 1e6;
+            double speedup = (baseline_time > 0 && time > 0) ? baseline_time / time : 0.0;
+            
+            cout << setw(15) << "Combine"
+                 << setw(10) << threads
+                 << setw(15) << fixed << setprecision(4) << time
+                 << setw(20) << fixed << setprecision(2) << throughput
+                 << setw(15) << fixed << setprecision(2) << speedup << endl;
+        }
+    }
+    
+    // Tokenize + count from the mapped file (--mmap)
+    if (use_mmap) {
+        cout << "\n--- Library, mmap (tokenizing included in time) ---" << endl;
+        for (int threads : thread_counts) {
+            size_t total_words = 0, unique_words = 0;
+            double time = wordCountMapped(filename, threads, total_words, unique_words);
+            
+            if (time < 0) continue;
+            
+            double throughput = (total_words / time) / 1e6;
+            double speedup = (baseline_time > 0 && time > 0) ? baseline_time / time : 0.0;
+            
+            cout << setw(15) << "Mmap"
+                 << setw(10) << threads
+                 << setw(15) << fixed << setprecision(4) << time
+                 << setw(20) << fixed << setprecision(2) << throughput
+                 << setw(15) << fixed << setprecision(2) << speedup << endl;
+        }
+    }
+    
     // Summary
     cout << "\n--- Summary ---" << endl;
     if (baseline_time > 0) {
@@ -106,25 +159,34 @@ void runBenchmark(const string& filename, const vector<int>& thread_counts) {
 }
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " <input_file> [thread_counts...]" << endl;
-        cerr << "Example: " << argv[0] << " test.txt 1 2 4 8 16" << endl;
+    vector<string> args;
+    size_t combine_threshold = 0;
+    bool use_mmap = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--combine") == 0) combine_threshold = parseCombineFlag(arg);
+        else if (arg == "--mmap") use_mmap = true;
+        else args.push_back(arg);
+    }
+    if (args.empty()) {
+        cerr << "Usage: " << argv[0] << " <input_file> [thread_counts...] [--combine[=N]] [--mmap]" << endl;
+        cerr << "Example: " << argv[0] << " test.txt 1 2 4 8 16 --combine" << endl;
         return 1;
     }
     
-    string filename = argv[1];
+    string filename = args[0];
     vector<int> thread_counts;
     
-    if (argc > 2) {
-        for (int i = 2; i < argc; i++) {
-            thread_counts.push_back(stoi(argv[i]));
+    if (args.size() > 1) {
+        for (size_t i = 1; i < args.size(); i++) {
+            thread_counts.push_back(stoi(args[i]));
         }
     } else {
         // Default thread count
         thread_counts = {1, 2, 4, 8, 16};
     }
     
-    runBenchmark(filename, thread_counts);
+    runBenchmark(filename, thread_counts, combine_threshold, use_mmap);
     
     return 0;
 }
@@ -7,6 +7,10 @@
 #include <sstream>
 #include <cctype>
 #include <algorithm>
+#include <unordered_map>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // Clean word: convert to lowercase, remove punctuation
 inline std::string cleanWord(const std::string& word) {
@@ -43,5 +47,165 @@ inline std::vector<std::string> readWordsFromFile(const std::string& filename) {
     return words;
 }
 
+// Default number of distinct words a thread buffers before flushing (--combine).
+const size_t DEFAULT_COMBINE_THRESHOLD = 16384;
+
+// Parse "--combine" / "--combine=N"; returns 0 (direct increments) otherwise.
+inline size_t parseCombineFlag(const std::string& arg) {
+    if (arg == "--combine") return DEFAULT_COMBINE_THRESHOLD;
+    if (arg.compare(0, 10, "--combine=") == 0) return std::stoul(arg.substr(10));
+    return 0;
+}
+
+// Count words into a shared table: with flush_threshold == 0 every token is
+// an increment on the shared table; otherwise each thread pre-aggregates into
+// a private map and flushes it once it holds flush_threshold distinct words,
+// so a hot word costs one shared increment per flush instead of per token.
+// One per thread; whatever is still buffered is flushed on destruction.
+template<typename Table>
+class WordSink {
+    Table& table;
+    size_t threshold;
+    std::unordered_map<std::string, int> local;
+
+public:
+    WordSink(Table& t, size_t flush_threshold) : table(t), threshold(flush_threshold) {}
+    ~WordSink() { flush(); }
+    WordSink(const WordSink&) = delete;
+    WordSink& operator=(const WordSink&) = delete;
+
+    void add(const std::string& word) {
+        if (threshold == 0) {
+            table.increment(word, 1);
+            return;
+        }
+        ++local[word];
+        if (local.size() >= threshold) flush();
+    }
+
+    void flush() {
+        for (const auto& wc : local) table.increment(wc.first, wc.second);
+        local.clear();
+    }
+};
+
+template<typename Table>
+inline void countWords(const std::vector<std::string>& words, Table& table,
+                       int num_threads, size_t flush_threshold) {
+    #pragma omp parallel num_threads(num_threads)
+    {
+        WordSink<Table> sink(table, flush_threshold);
+        #pragma omp for nowait
+        for (size_t i = 0; i < words.size(); ++i) {
+            sink.add(words[i]);
+        }
+    }
+}
+
+// ---- Memory-mapped input (--mmap) ----
+// The file is split into fixed-size chunks that threads tokenize straight
+// into the table, so page faults, tokenizing and counting overlap and no
+// per-word strings are built up front. Tokens follow readWordsFromFile:
+// whitespace separates them, alphanumerics are kept lower-cased, anything
+// else is dropped.
+
+const size_t MMAP_CHUNK_BYTES = size_t(1) << 20;
+
+enum : unsigned char { CH_OTHER = 0, CH_SPACE = 1, CH_WORD = 2 };
+
+struct CharClassTable {
+    unsigned char cls[256];
+    char lower[256];
+    CharClassTable() {
+        for (int c = 0; c < 256; ++c) {
+            bool alnum = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            bool space = c == ' ' || (c >= '\t' && c <= '\r');
+            cls[c] = space ? CH_SPACE : alnum ? CH_WORD : CH_OTHER;
+            lower[c] = (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : char(c);
+        }
+    }
+};
+
+inline const CharClassTable& charClasses() {
+    static const CharClassTable table;
+    return table;
+}
+
+// Length of the run at p of bytes that need no cleaning ([a-z0-9]).
+inline size_t cleanRunLength(const char* p, const char* end) {
+    const char* start = p;
+#ifdef __SSE2__
+    const __m128i a_lo = _mm_set1_epi8('a' - 1), a_hi = _mm_set1_epi8('z' + 1);
+    const __m128i d_lo = _mm_set1_epi8('0' - 1), d_hi = _mm_set1_epi8('9' + 1);
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(v, a_lo), _mm_cmplt_epi8(v, a_hi));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, d_lo), _mm_cmplt_epi8(v, d_hi));
+        unsigned mask = unsigned(_mm_movemask_epi8(_mm_or_si128(lower, digit)));
+        if (mask != 0xFFFF) return size_t(p - start) + __builtin_ctz(~mask);
+        p += 16;
+    }
+#endif
+    while (p < end && ((*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9'))) ++p;
+    return size_t(p - start);
+}
+
+// Feed every token that starts in [begin, end) to sink; the last one may
+// extend past end. word is the caller's reusable buffer. Returns the number
+// of non-empty words.
+template<typename Sink>
+inline size_t tokenizeRange(const char* data, size_t size, size_t begin, size_t end,
+                            Sink& sink, std::string& word) {
+    const CharClassTable& ct = charClasses();
+    const unsigned char* d = reinterpret_cast<const unsigned char*>(data);
+    size_t i = begin;
+    size_t words = 0;
+
+    // A token straddling begin belongs to the previous range.
+    if (i > 0 && ct.cls[d[i - 1]] != CH_SPACE) {
+        while (i < size && ct.cls[d[i]] != CH_SPACE) ++i;
+    }
+    while (i < end) {
+        while (i < end && ct.cls[d[i]] == CH_SPACE) ++i;
+        if (i >= end) break;
+        word.clear();
+        while (i < size) {
+            size_t run = cleanRunLength(data + i, data + size);
+            word.append(data + i, run);
+            i += run;
+            if (i >= size) break;
+            unsigned char k = ct.cls[d[i]];
+            if (k == CH_SPACE) break;
+            if (k == CH_WORD) word.push_back(ct.lower[d[i]]);
+            ++i;
+        }
+        if (!word.empty()) {
+            sink.add(word);
+            ++words;
+        }
+    }
+    return words;
+}
+
+// Count the words of a mapped file; returns the total number of words.
+template<typename Table>
+inline size_t countWordsMapped(const char* data, size_t size, Table& table,
+                               int num_threads, size_t flush_threshold) {
+    size_t chunks = (size + MMAP_CHUNK_BYTES - 1) / MMAP_CHUNK_BYTES;
+    size_t total = 0;
+    #pragma omp parallel num_threads(num_threads) reduction(+:total)
+    {
+        WordSink<Table> sink(table, flush_threshold);
+        std::string word;
+        #pragma omp for schedule(dynamic) nowait
+        for (size_t c = 0; c < chunks; ++c) {
+            size_t begin = c * MMAP_CHUNK_BYTES;
+            size_t end = std::min(size, begin + MMAP_CHUNK_BYTES);
+            total += tokenizeRange(data, size, begin, end, sink, word);
+        }
+    }
+    return total;
+}
+
 #endif // WORD_COUNT_COMMON_H
 
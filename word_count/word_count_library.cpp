@@ -6,13 +6,40 @@
 #include <omp.h>
 #include <iomanip>
 #include "../fine_grained.h"  // Use our concurrent hash table library
+#include "../segment_based.h"
+#include "../mapped_file.h"
 #include "word_count_common.h"
 
 using namespace std;
 
 // Word count using concurrent hash table library
-double wordCountWithLibrary(const string& filename, int num_threads, size_t& total_words, size_t& unique_words) {
-    FineGrainedHashTable<string, int> wordCount(8192);  // Fine-grained locking implementation
+// combine_threshold > 0 selects thread-local pre-aggregation (see countWords).
+// use_mmap tokenizes the mapped file inside the timed phase; otherwise the
+// words are read up front and only counting is timed. load_seconds receives
+// the time spent before the timed phase. With top != nullptr, the top_n most
+// frequent words are collected into it afterwards (parallel top_k over the
+// table's bucket ranges), outside the timed phase.
+template<typename Table>
+double wordCountInto(Table& wordCount, const string& filename, int num_threads, size_t& total_words, size_t& unique_words,
+                     size_t combine_threshold, bool use_mmap, double* load_seconds,
+                     size_t top_n, vector<pair<string, int>>* top) {
+    double load_start = omp_get_wtime();
+    if (use_mmap) {
+        MappedFile file(filename);
+        if (!file.valid() || file.size() == 0) {
+            cerr << "Error: Cannot read file or file is empty: " << filename << endl;
+            return -1;
+        }
+        if (load_seconds) *load_seconds = omp_get_wtime() - load_start;
+        
+        double start_time = omp_get_wtime();
+        total_words = countWordsMapped(file.data(), file.size(), wordCount, num_threads, combine_threshold);
+        double end_time = omp_get_wtime();
+        unique_words = wordCount.size();
+        if (top) *top = top_k(wordCount, top_n, num_threads);
+        
+        return end_time - start_time;
+    }
     
     vector<string> words = readWordsFromFile(filename);
     if (words.empty()) {
@@ -21,36 +48,62 @@ double wordCountWithLibrary(const string& filename, int num_threads, size_t& tot
     }
     
     total_words = words.size();
+    if (load_seconds) *load_seconds = omp_get_wtime() - load_start;
     
     double start_time = omp_get_wtime();
     
     // Parallel word frequency counting
-    #pragma omp parallel num_threads(num_threads)
-    {
-        #pragma omp for
-        for (size_t i = 0; i < words.size(); ++i) {
-            // Use increment method to atomically increment count
-            // This avoids race condition between search and insert
-            wordCount.increment(words[i], 1);
-        }
-    }
+    countWords(words, wordCount, num_threads, combine_threshold);
     
     double end_time = omp_get_wtime();
     unique_words = wordCount.size();
+    if (top) *top = top_k(wordCount, top_n, num_threads);
     
     return end_time - start_time;
 }
 
+// flat_combining counts into a segment-based table whose hot segments are
+// updated by whichever thread holds their lock (see combining.h); otherwise
+// into the fine-grained table.
+double wordCountWithLibrary(const string& filename, int num_threads, size_t& total_words, size_t& unique_words,
+                            size_t combine_threshold = 0, bool use_mmap = false, double* load_seconds = nullptr,
+                            size_t top_n = 0, vector<pair<string, int>>* top = nullptr, bool flat_combining = false) {
+    if (flat_combining) {
+        SegmentBasedHashTable<string, int> wordCount(8192);
+        wordCount.set_combining(true);
+        return wordCountInto(wordCount, filename, num_threads, total_words, unique_words,
+                             combine_threshold, use_mmap, load_seconds, top_n, top);
+    }
+    FineGrainedHashTable<string, int> wordCount(8192);  // Fine-grained locking implementation
+    return wordCountInto(wordCount, filename, num_threads, total_words, unique_words,
+                         combine_threshold, use_mmap, load_seconds, top_n, top);
+}
+
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        cerr << "Usage: " << argv[0] << " <input_file> <num_threads> [output_file]" << endl;
+    // Flags may appear anywhere; the rest are positional.
+    vector<string> args;
+    size_t combine_threshold = 0;
+    bool use_mmap = false;
+    size_t top_n = 100;
+    bool flat_combining = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.compare(0, 9, "--combine") == 0) combine_threshold = parseCombineFlag(arg);
+        else if (arg == "--mmap") use_mmap = true;
+        else if (arg == "--flat-combining") flat_combining = true;
+        else if (arg.compare(0, 6, "--top=") == 0) top_n = stoul(arg.substr(6));
+        else args.push_back(arg);
+    }
+    if (args.size() < 2) {
+        cerr << "Usage: " << argv[0] << " <input_file> <num_threads> [output_file] [--combine[=N]] [--mmap] [--top=N] [--flat-combining]" << endl;
+        cerr << "       output_file receives the N most frequent words (default 100), one \"word<TAB>count\" per line" << endl;
         return 1;
     }
     
-    string filename = argv[1];
-    int num_threads = stoi(argv[2]);
-    bool output_results = (argc >= 4);
-    string output_file = output_results ? argv[3] : "";
+    string filename = args[0];
+    int num_threads = stoi(args[1]);
+    bool output_results = (args.size() >= 3);
+    string output_file = output_results ? args[2] : "";
     
     size_t total_words = 0;
     size_t unique_words = 0;
@@ -60,17 +113,39 @@ int main(int argc, char* argv[]) {
     cout << "=====================================" << endl;
     cout << "File: " << filename << endl;
     cout << "Threads: " << num_threads << endl;
+    if (combine_threshold > 0) {
+        cout << "Mode: combining (flush every " << combine_threshold << " distinct words)" << endl;
+    } else {
+        cout << "Mode: direct increment" << endl;
+    }
+    if (flat_combining) cout << "Table: segment-based, flat combining" << endl;
+    cout << "Input: " << (use_mmap ? "mmap, tokenized while counting" : "read into memory first") << endl;
     cout << endl;
     
-    double time = wordCountWithLibrary(filename, num_threads, total_words, unique_words);
+    double load_time = 0;
+    vector<pair<string, int>> top;
+    double time = wordCountWithLibrary(filename, num_threads, total_words, unique_words,
+                                       combine_threshold, use_mmap, &load_time,
+                                       top_n, output_results ? &top : nullptr, flat_combining);
     
     if (time < 0) {
         return 1;
     }
     
+    if (output_results) {
+        ofstream out(output_file);
+        for (const auto& wc : top) out << wc.first << '\t' << wc.second << '\n';
+        if (!out) {
+            cerr << "Error: Cannot write output file: " << output_file << endl;
+            return 1;
+        }
+        cout << "Wrote top " << top.size() << " words to " << output_file << endl;
+    }
+    
     cout << fixed << setprecision(4);
     cout << "Total words: " << total_words << endl;
     cout << "Unique words: " << unique_words << endl;
+    cout << "Load time: " << load_time << " seconds" << endl;
     cout << "Time: " << time << " seconds" << endl;
     cout << "Throughput: " << fixed << setprecision(2) 
          << (total_words / time / 1e6) << " M words/second" << endl;
@@ -0,0 +1,238 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <omp.h>
+#include "mapped_file.h"
+
+// Pregenerated benchmark workloads over int keys and values.
+//
+// A workload is one vector of WorkOp per thread, built before the timed loop
+// so the RNG and the key distribution cost nothing while it runs.
+// - ZipfGen: rejection-inversion Zipf sampler (Hörmann & Derflinger), O(1)
+//   setup and a few flops per draw for any theta >= 0 (0 = uniform).
+// - YCSB-style mixes A-F plus "churn" (insert fresh keys, remove the oldest
+//   ones). The tables are unordered, so the E scan is a search_batch over a
+//   run of consecutive keys.
+// - Traces: a flat binary file of WorkOp records, replayed with each thread
+//   taking one contiguous slice.
+//
+// Keys [0, preload) are expected to be in the table before the ops run;
+// Zipf rank r maps to key r-1, so the hottest keys are the smallest.
+
+enum class OpType : uint8_t { Read, Update, Insert, Remove, ReadModifyWrite, Scan };
+
+struct WorkOp {
+    OpType type;
+    uint8_t scan_len;   // Scan only: number of consecutive keys
+    uint16_t pad;
+    int32_t key;
+};
+static_assert(sizeof(WorkOp) == 8, "WorkOp is the on-disk trace record");
+
+class ZipfGen {
+    double n, theta;
+    double h_x1, h_n, s;
+
+    static double helper1(double x) {   // log1p(x) / x
+        return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double helper2(double x) {   // expm1(x) / x
+        return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+    double h(double x) const { return std::exp(-theta * std::log(x)); }
+    double h_integral(double x) const {
+        double log_x = std::log(x);
+        return helper2((1.0 - theta) * log_x) * log_x;
+    }
+    double h_integral_inverse(double x) const {
+        double t = x * (1.0 - theta);
+        if (t < -1.0) t = -1.0;
+        return std::exp(helper1(t) * x);
+    }
+
+public:
+    ZipfGen(uint64_t items, double theta_)
+        : n(double(items ? items : 1)), theta(theta_) {
+        h_x1 = h_integral(1.5) - 1.0;
+        h_n = h_integral(n + 0.5);
+        s = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    // Rank in [1, items]; rank 1 is the most likely.
+    template <class RNG>
+    uint64_t draw(RNG& rng) {
+        std::uniform_real_distribution<double> u01(0.0, 1.0);
+        while (true) {
+            double u = h_n + u01(rng) * (h_x1 - h_n);
+            double x = h_integral_inverse(u);
+            double k = std::floor(x + 0.5);
+            if (k < 1.0) k = 1.0;
+            else if (k > n) k = n;
+            if (k - x <= s || u >= h_integral(k + 0.5) - h(k)) return uint64_t(k);
+        }
+    }
+};
+
+// Fractions of each op type; they sum to 1.
+struct WorkloadMix {
+    const char* name;
+    double read, update, insert, remove, rmw, scan;
+    bool latest;   // reads favour recent inserts (YCSB D) instead of the Zipf ranks
+};
+
+inline const std::vector<WorkloadMix>& workload_mixes() {
+    static const std::vector<WorkloadMix> mixes = {
+        {"a",     0.50, 0.50, 0.00, 0.00, 0.00, 0.00, false},   // update heavy
+        {"b",     0.95, 0.05, 0.00, 0.00, 0.00, 0.00, false},   // read mostly
+        {"c",     1.00, 0.00, 0.00, 0.00, 0.00, 0.00, false},   // read only
+        {"d",     0.95, 0.00, 0.05, 0.00, 0.00, 0.00, true},    // read latest
+        {"e",     0.00, 0.00, 0.05, 0.00, 0.00, 0.95, false},   // short scans
+        {"f",     0.50, 0.00, 0.00, 0.00, 0.50, 0.00, false},   // read-modify-write
+        {"churn", 0.50, 0.00, 0.25, 0.25, 0.00, 0.00, false},   // steady size, keys turn over
+    };
+    return mixes;
+}
+
+inline const WorkloadMix* find_workload_mix(const std::string& name) {
+    for (const auto& m : workload_mixes()) {
+        if (name == m.name) return &m;
+    }
+    return nullptr;
+}
+
+struct WorkloadSpec {
+    WorkloadMix mix;
+    double theta = 0.99;
+    int preload = 0;
+    int max_scan = 100;
+    uint64_t seed = 0xC0FFEE;
+};
+
+// Splits total_ops evenly over `threads` streams, each generated in parallel
+// with its own RNG. Inserts use fresh keys from preload upwards
+// (interleaved by thread so they never collide); removes take preloaded keys
+// from the cold end, so every remove finds its key once.
+inline std::vector<std::vector<WorkOp>> generate_workload(const WorkloadSpec& spec, int threads, size_t total_ops) {
+    std::vector<std::vector<WorkOp>> per_thread(threads);
+    const WorkloadMix& m = spec.mix;
+    const double c_read = m.read, c_update = c_read + m.update, c_insert = c_update + m.insert,
+                 c_remove = c_insert + m.remove, c_rmw = c_remove + m.rmw;
+    const int preload = std::max(1, spec.preload);
+
+    #pragma omp parallel for num_threads(threads) schedule(static, 1)
+    for (int t = 0; t < threads; ++t) {
+        size_t n = total_ops / threads + (size_t(t) < total_ops % threads ? 1 : 0);
+        std::vector<WorkOp>& ops = per_thread[t];
+        ops.resize(n);
+        std::mt19937_64 rng(spec.seed + uint64_t(t) * 0x9E3779B97F4A7C15ULL);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+        std::uniform_int_distribution<int> scan_len(1, std::max(1, std::min(spec.max_scan, 255)));
+        ZipfGen zipf(uint64_t(preload), spec.theta);
+        int64_t inserts = 0, removes = 0;
+        int64_t latest = preload - 1;
+        for (size_t i = 0; i < n; ++i) {
+            WorkOp op{};
+            double c = coin(rng);
+            op.type = c < c_read ? OpType::Read : c < c_update ? OpType::Update : c < c_insert ? OpType::Insert
+                    : c < c_remove ? OpType::Remove : c < c_rmw ? OpType::ReadModifyWrite : OpType::Scan;
+            if (op.type == OpType::Insert) {
+                latest = int64_t(preload) + t + inserts++ * threads;
+                op.key = int32_t(latest);
+            } else if (op.type == OpType::Remove) {
+                op.key = int32_t(std::max<int64_t>(0, preload - 1 - t - removes++ * threads));
+            } else {
+                int64_t rank = int64_t(zipf.draw(rng));
+                // Latest: step back through this thread's own inserts, then into the preload.
+                op.key = int32_t(m.latest ? std::max<int64_t>(0, latest - (rank - 1) * threads) : rank - 1);
+                if (op.type == OpType::Scan) op.scan_len = uint8_t(scan_len(rng));
+            }
+            ops[i] = op;
+        }
+    }
+    return per_thread;
+}
+
+// Runs one op; V is the table's value type (the keys are int). Returns
+// whether the op found (or, for Insert, added) its key; scans count a hit
+// if any key of the run was present.
+template <class V, class HT>
+inline bool apply_op(HT& ht, const WorkOp& op) {
+    switch (op.type) {
+    case OpType::Read: { V v; return ht.search(op.key, v); }
+    case OpType::Update: return ht.compute_if_present(op.key, [&](V& v) { v = V(op.key); });
+    case OpType::Insert: return ht.insert(op.key, V(op.key));
+    case OpType::Remove: return ht.remove(op.key);
+    case OpType::ReadModifyWrite: return ht.compute_if_present(op.key, [](V& v) { v += 1; });
+    case OpType::Scan: {
+        int keys[255];
+        V vals[255];
+        bool found[255];
+        for (unsigned j = 0; j < op.scan_len; ++j) keys[j] = op.key + int(j);
+        return ht.search_batch(keys, vals, found, op.scan_len) != 0;
+    }
+    }
+    return false;
+}
+
+// ---- Binary traces ----
+// Layout: 8-byte magic "CHTTRACE", uint32 version (1), uint32 preload,
+// uint64 op count, then that many 8-byte WorkOp records (host byte order).
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t preload;
+    uint64_t count;
+};
+static_assert(sizeof(TraceHeader) == 24, "trace header layout");
+
+struct Trace {
+    int preload = 0;
+    std::vector<WorkOp> ops;
+};
+
+inline bool save_trace(const std::string& path, const Trace& trace) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) return false;
+    TraceHeader hdr;
+    std::memcpy(hdr.magic, "CHTTRACE", 8);
+    hdr.version = 1;
+    hdr.preload = uint32_t(trace.preload);
+    hdr.count = trace.ops.size();
+    bool ok = std::fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+              std::fwrite(trace.ops.data(), sizeof(WorkOp), trace.ops.size(), f) == trace.ops.size();
+    return std::fclose(f) == 0 && ok;
+}
+
+inline bool load_trace(const std::string& path, Trace& trace) {
+    MappedFile file(path);
+    if (!file.valid() || file.size() < sizeof(TraceHeader)) return false;
+    TraceHeader hdr;
+    std::memcpy(&hdr, file.data(), sizeof(hdr));
+    if (std::memcmp(hdr.magic, "CHTTRACE", 8) != 0 || hdr.version != 1) return false;
+    if (file.size() - sizeof(hdr) < hdr.count * sizeof(WorkOp)) return false;
+    trace.preload = int(hdr.preload);
+    trace.ops.resize(hdr.count);
+    std::memcpy(trace.ops.data(), file.data() + sizeof(hdr), hdr.count * sizeof(WorkOp));
+    return true;
+}
+
+// Contiguous slices, one per thread, so each thread replays its part in trace order.
+inline std::vector<std::vector<WorkOp>> split_trace(const Trace& trace, int threads) {
+    std::vector<std::vector<WorkOp>> per_thread(threads);
+    size_t n = trace.ops.size();
+    for (int t = 0; t < threads; ++t) {
+        size_t lo = n * t / threads, hi = n * (t + 1) / threads;
+        per_thread[t].assign(trace.ops.begin() + lo, trace.ops.begin() + hi);
+    }
+    return per_thread;
+}
+
+#endif // WORKLOAD_H